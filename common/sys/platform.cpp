@@ -49,8 +49,8 @@ namespace embree
   void os_shrink(void* ptr, size_t bytesNew, size_t bytesOld) 
   {
     size_t pageSize = 4096;
-    if (bytesNew & (pageSize-1)) 
-      bytesNew = (bytesNew+pageSize) & (pageSize-1);
+    bytesNew = (bytesNew+pageSize-1) & ~(pageSize-1);
+    if (bytesNew >= bytesOld) return;
 
     VirtualFree((char*)ptr+bytesNew,bytesOld-bytesNew,MEM_DECOMMIT);
   }
@@ -65,6 +65,52 @@ namespace embree
     FATAL("not implemented");
   }
 
+  void* os_malloc_huge(size_t bytes)
+  {
+    const size_t hugePageSize = 2*1024*1024;
+    bytes = (bytes+hugePageSize-1)&ssize_t(-ssize_t(hugePageSize));
+
+    /* reserve a larger range to find an aligned address, another thread may take it before we commit */
+    while (true) {
+      char* ptr = (char*) VirtualAlloc(NULL,bytes+hugePageSize,MEM_RESERVE,PAGE_READWRITE);
+      if (ptr == NULL) throw std::bad_alloc();
+      char* aligned = (char*) ((size_t(ptr)+hugePageSize-1)&ssize_t(-ssize_t(hugePageSize)));
+      VirtualFree(ptr,0,MEM_RELEASE);
+      ptr = (char*) VirtualAlloc(aligned,bytes,MEM_COMMIT|MEM_RESERVE,PAGE_READWRITE);
+      if (ptr != NULL) return ptr;
+    }
+  }
+
+  void os_advise_huge(void* ptr, size_t bytes) {
+  }
+
+  void* os_map_file(const char* fileName, size_t& bytes)
+  {
+    HANDLE file = CreateFileA(fileName,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file,&size) || size.QuadPart == 0) {
+      CloseHandle(file);
+      return NULL;
+    }
+
+    HANDLE mapping = CreateFileMapping(file,NULL,PAGE_WRITECOPY,0,0,NULL);
+    CloseHandle(file);
+    if (mapping == NULL) return NULL;
+
+    void* ptr = MapViewOfFile(mapping,FILE_MAP_COPY,0,0,0);
+    CloseHandle(mapping);
+    if (ptr == NULL) return NULL;
+
+    bytes = (size_t) size.QuadPart;
+    return ptr;
+  }
+
+  void os_unmap_file(void* ptr, size_t bytes) {
+    if (ptr) UnmapViewOfFile(ptr);
+  }
+
   double getSeconds() {
     LARGE_INTEGER freq, val;
     QueryPerformanceFrequency(&freq);
@@ -82,6 +128,9 @@ namespace embree
 
 #include <sys/time.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <errno.h>
 #include <string.h>
 
@@ -128,8 +177,8 @@ namespace embree
 #if defined(__MIC__)
     if (bytesOld > 16*4096) pageSize = 2*1024*1024;
 #endif
-    if (bytesNew & (pageSize-1)) 
-      bytesNew = (bytesNew+pageSize) & (pageSize-1);
+    bytesNew = (bytesNew+pageSize-1) & ~(pageSize-1);
+    if (bytesNew >= bytesOld) return;
 
     os_free((char*)ptr+bytesNew,bytesOld-bytesNew);
   }
@@ -178,6 +227,58 @@ namespace embree
 
   }
 
+  void* os_malloc_huge(size_t bytes)
+  {
+    const size_t hugePageSize = 2*1024*1024;
+    bytes = (bytes+hugePageSize-1)&ssize_t(-ssize_t(hugePageSize));
+
+    /* try explicit huge pages first, these are only available if configured by the administrator */
+#if defined(MAP_HUGETLB)
+    char* ptr = (char*) mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_HUGETLB, -1, 0);
+    if (ptr != NULL && ptr != MAP_FAILED) return ptr;
+#endif
+
+    /* otherwise map an aligned range and ask for transparent huge pages */
+    char* base = (char*) mmap(0, bytes+hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (base == NULL || base == MAP_FAILED) throw std::bad_alloc();
+    char* aligned = (char*) ((size_t(base)+hugePageSize-1)&ssize_t(-ssize_t(hugePageSize)));
+    if (aligned > base) munmap(base,aligned-base);
+    if (aligned+bytes < base+bytes+hugePageSize) munmap(aligned+bytes,base+hugePageSize-aligned);
+    os_advise_huge(aligned,bytes);
+    return aligned;
+  }
+
+  void os_advise_huge(void* ptr, size_t bytes) 
+  {
+#if defined(MADV_HUGEPAGE)
+    madvise(ptr,bytes,MADV_HUGEPAGE);
+#endif
+  }
+
+  void* os_map_file(const char* fileName, size_t& bytes)
+  {
+    int fd = open(fileName,O_RDONLY);
+    if (fd == -1) return NULL;
+
+    struct stat st;
+    if (fstat(fd,&st) == -1 || st.st_size == 0) {
+      close(fd);
+      return NULL;
+    }
+
+    /* private mapping allows relocating pointers in place */
+    void* ptr = mmap(0,st.st_size,PROT_READ | PROT_WRITE,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (ptr == NULL || ptr == MAP_FAILED) return NULL;
+
+    bytes = st.st_size;
+    return ptr;
+  }
+
+  void os_unmap_file(void* ptr, size_t bytes) {
+    if (ptr) munmap(ptr,bytes);
+  }
+
 
 #if defined(__MIC__)
 
@@ -319,6 +319,16 @@ namespace embree
   void  os_free   (void* ptr, size_t bytes);
   void* os_realloc(void* ptr, size_t bytesNew, size_t bytesOld);
 
+  /*! allocates 2MB aligned memory backed by huge pages if possible, free with os_free */
+  void* os_malloc_huge(size_t bytes);
+
+  /*! hints the OS to back a memory range with transparent huge pages */
+  void  os_advise_huge(void* ptr, size_t bytes);
+
+  /*! maps a file copy-on-write into memory, returns NULL if the file cannot get mapped */
+  void* os_map_file  (const char* fileName, size_t& bytes);
+  void  os_unmap_file(void* ptr, size_t bytes);
+
   /*! returns performance counter in seconds */
   double getSeconds();
 }
@@ -18,6 +18,8 @@
 #include "intrinsics.h"
 #include "stl/string.h"
 
+#include <vector>
+
 ////////////////////////////////////////////////////////////////////////////////
 /// All Platforms
 ////////////////////////////////////////////////////////////////////////////////
@@ -288,6 +290,33 @@ namespace embree
     GetConsoleScreenBufferInfo(handle, &info);
     return info.dwSize.X;
   }
+
+  static void readNumaNodes(std::vector<size_t>& nodeIDs, std::vector<std::vector<size_t> >& nodeThreads)
+  {
+    ULONG highest = 0;
+    if (!GetNumaHighestNodeNumber(&highest)) return;
+    for (ULONG n=0; n<=highest; n++) 
+    {
+      ULONGLONG mask = 0;
+      if (!GetNumaNodeProcessorMask((UCHAR)n,&mask) || mask == 0) continue;
+      std::vector<size_t> threads;
+      for (size_t i=0; i<64; i++) 
+        if (mask & (ULONGLONG(1) << i)) threads.push_back(i);
+      nodeIDs.push_back(n);
+      nodeThreads.push_back(threads);
+    }
+  }
+
+  static ssize_t getCurrentLogicalThread() {
+    return GetCurrentProcessorNumber();
+  }
+
+  /* pages can only get placed on NUMA nodes when they get allocated */
+  static void osNumaInterleave(void* ptr, size_t bytes, const std::vector<size_t>& nodeIDs) {
+  }
+
+  static void osNumaBind(void* ptr, size_t bytes, size_t nodeID) {
+  }
 }
 #endif
 
@@ -298,7 +327,16 @@ namespace embree
 #ifdef __LINUX__
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <algorithm>
+
+#define MPOL_BIND_       2
+#define MPOL_INTERLEAVE_ 3
+#define MPOL_MF_MOVE_    (1 << 1)
 
 namespace embree
 {
@@ -310,6 +348,76 @@ namespace embree
     if (bytes != -1) buf[bytes] = '\0';
     return std::string(buf);
   }
+
+  /*! parses lists of logical threads like 0-7,16-23 */
+  static std::vector<size_t> parseThreadList(const char* str)
+  {
+    std::vector<size_t> threads;
+    while (*str >= '0' && *str <= '9') 
+    {
+      char* next = NULL;
+      size_t begin = strtoul(str,&next,10), end = begin;
+      if (*next == '-') end = strtoul(next+1,&next,10);
+      for (size_t i=begin; i<=end; i++) threads.push_back(i);
+      str = *next == ',' ? next+1 : next;
+    }
+    return threads;
+  }
+
+  static void readNumaNodes(std::vector<size_t>& nodeIDs, std::vector<std::vector<size_t> >& nodeThreads)
+  {
+    DIR* dir = opendir("/sys/devices/system/node");
+    if (dir == NULL) return;
+    std::vector<size_t> ids;
+    while (struct dirent* entry = readdir(dir)) {
+      unsigned id; char c;
+      if (sscanf(entry->d_name,"node%u%c",&id,&c) == 1) ids.push_back(id);
+    }
+    closedir(dir);
+    std::sort(ids.begin(),ids.end());
+
+    for (size_t i=0; i<ids.size(); i++)
+    {
+      char name[64]; sprintf(name,"/sys/devices/system/node/node%u/cpulist",unsigned(ids[i]));
+      FILE* file = fopen(name,"r");
+      if (file == NULL) continue;
+      char buf[4096] = { 0 };
+      if (fgets(buf,sizeof(buf),file) == NULL) buf[0] = 0;
+      fclose(file);
+
+      /* nodes without logical threads only provide memory */
+      std::vector<size_t> threads = parseThreadList(buf);
+      if (threads.empty()) continue;
+      nodeIDs.push_back(ids[i]);
+      nodeThreads.push_back(threads);
+    }
+  }
+
+  static ssize_t getCurrentLogicalThread() {
+    return sched_getcpu();
+  }
+
+  static void osNumaPolicy(void* ptr, size_t bytes, int mode, const std::vector<size_t>& nodeIDs)
+  {
+#if defined(SYS_mbind)
+    const size_t bits = 8*sizeof(unsigned long);
+    unsigned long mask[1024/bits] = { 0 };
+    for (size_t i=0; i<nodeIDs.size(); i++)
+      if (nodeIDs[i] < 1024) mask[nodeIDs[i]/bits] |= 1ul << (nodeIDs[i]%bits);
+
+    /* the policy is only a hint, failures are ignored */
+    char* begin = (char*) (size_t(ptr) & ~size_t(PAGE_SIZE-1));
+    syscall(SYS_mbind,begin,bytes+((char*)ptr-begin),mode,mask,size_t(1024+1),MPOL_MF_MOVE_);
+#endif
+  }
+
+  static void osNumaInterleave(void* ptr, size_t bytes, const std::vector<size_t>& nodeIDs) {
+    osNumaPolicy(ptr,bytes,MPOL_INTERLEAVE_,nodeIDs);
+  }
+
+  static void osNumaBind(void* ptr, size_t bytes, size_t nodeID) {
+    osNumaPolicy(ptr,bytes,MPOL_BIND_,std::vector<size_t>(1,nodeID));
+  }
 }
 
 #endif
@@ -331,6 +439,20 @@ namespace embree
     if (_NSGetExecutablePath(buf, &size) != 0) return std::string();
     return std::string(buf);
   }
+
+  /* Mac OS X does not expose NUMA topology, a single node is assumed */
+  static void readNumaNodes(std::vector<size_t>& nodeIDs, std::vector<std::vector<size_t> >& nodeThreads) {
+  }
+
+  static ssize_t getCurrentLogicalThread() {
+    return -1;
+  }
+
+  static void osNumaInterleave(void* ptr, size_t bytes, const std::vector<size_t>& nodeIDs) {
+  }
+
+  static void osNumaBind(void* ptr, size_t bytes, size_t nodeID) {
+  }
 }
 
 #endif
@@ -366,3 +488,97 @@ namespace embree
 }
 #endif
 
+////////////////////////////////////////////////////////////////////////////////
+/// NUMA Topology
+////////////////////////////////////////////////////////////////////////////////
+
+namespace embree
+{
+  struct NumaTopology
+  {
+    NumaTopology ()
+    {
+      readNumaNodes(nodeIDs,nodeThreads);
+      const size_t numThreads = getNumberOfLogicalThreads();
+      if (nodeIDs.empty()) {
+        nodeIDs.push_back(0);
+        nodeThreads.push_back(std::vector<size_t>());
+        for (size_t i=0; i<numThreads; i++) nodeThreads[0].push_back(i);
+      }
+
+      /* sort logical threads by node, threads unknown to the OS topology go last */
+      threadNode.resize(numThreads,size_t(-1));
+      for (size_t n=0; n<nodeThreads.size(); n++) {
+        for (size_t i=0; i<nodeThreads[n].size(); i++) {
+          const size_t thread = nodeThreads[n][i];
+          if (thread >= numThreads || threadNode[thread] != size_t(-1)) continue;
+          threadNode[thread] = n;
+          orderedThreads.push_back(thread);
+        }
+      }
+      for (size_t i=0; i<numThreads; i++) {
+        if (threadNode[i] != size_t(-1)) continue;
+        threadNode[i] = 0;
+        orderedThreads.push_back(i);
+      }
+    }
+
+    std::vector<size_t> nodeIDs;                    //!< OS identifier of each node
+    std::vector<std::vector<size_t> > nodeThreads;  //!< logical threads of each node
+    std::vector<size_t> threadNode;                 //!< node of each logical thread
+    std::vector<size_t> orderedThreads;             //!< logical threads sorted by node
+  };
+
+  static const NumaTopology& getNumaTopology() {
+    static NumaTopology topology;
+    return topology;
+  }
+
+  size_t getNumberOfNumaNodes() {
+    return getNumaTopology().nodeIDs.size();
+  }
+
+  size_t getNumaNode(size_t thread) 
+  {
+    const NumaTopology& topology = getNumaTopology();
+    if (thread >= topology.threadNode.size()) return 0;
+    return topology.threadNode[thread];
+  }
+
+  /*! number of calls after which the NUMA node of a thread is determined again */
+  static const size_t NUMA_NODE_REFRESH_CALLS = 1024;
+
+  static __thread size_t g_currentNumaNode = 0;
+  static __thread size_t g_currentNumaNodeCalls = 0;
+
+  size_t getCurrentNumaNode() 
+  {
+    /* unpinned threads may migrate to other nodes */
+    if (unlikely((g_currentNumaNodeCalls++ & (NUMA_NODE_REFRESH_CALLS-1)) == 0)) {
+      const ssize_t thread = getCurrentLogicalThread();
+      g_currentNumaNode = thread < 0 ? 0 : getNumaNode(thread);
+    }
+    return g_currentNumaNode;
+  }
+
+  size_t getNumaOrderedThread(size_t threadIndex) 
+  {
+    const NumaTopology& topology = getNumaTopology();
+    if (topology.orderedThreads.empty()) return threadIndex;
+    return topology.orderedThreads[threadIndex % topology.orderedThreads.size()];
+  }
+
+  void numaInterleave(void* ptr, size_t bytes) 
+  {
+    const NumaTopology& topology = getNumaTopology();
+    if (topology.nodeIDs.size() <= 1 || bytes == 0) return;
+    osNumaInterleave(ptr,bytes,topology.nodeIDs);
+  }
+
+  void numaBind(void* ptr, size_t bytes, size_t node) 
+  {
+    const NumaTopology& topology = getNumaTopology();
+    if (topology.nodeIDs.size() <= 1 || bytes == 0 || node >= topology.nodeIDs.size()) return;
+    osNumaBind(ptr,bytes,topology.nodeIDs[node]);
+  }
+}
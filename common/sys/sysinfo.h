@@ -76,4 +76,22 @@ namespace embree
   
   /*! returns the size of the terminal window in characters */
   int getTerminalWidth();
+
+  /*! returns the number of NUMA nodes of the system, nodes are numbered consecutively */
+  size_t getNumberOfNumaNodes();
+
+  /*! returns the NUMA node of a logical thread */
+  size_t getNumaNode(size_t thread);
+
+  /*! returns the NUMA node of the calling thread, the node is determined again every 1024 calls */
+  size_t getCurrentNumaNode();
+
+  /*! maps a thread index to a logical thread, consecutive indices are placed on the same NUMA node */
+  size_t getNumaOrderedThread(size_t threadIndex);
+
+  /*! distributes the pages of a memory range round robin over all NUMA nodes */
+  void numaInterleave(void* ptr, size_t bytes);
+
+  /*! moves the pages of a memory range to a NUMA node */
+  void numaBind(void* ptr, size_t bytes, size_t node);
 }
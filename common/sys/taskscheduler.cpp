@@ -41,7 +41,7 @@ namespace embree
   
   TaskScheduler* TaskScheduler::instance = NULL;
 
-  void TaskScheduler::create(size_t numThreads)
+  void TaskScheduler::create(size_t numThreads, bool spawnThreads)
   {
     if (instance)
       throw std::runtime_error("Embree threads already running.");
@@ -55,7 +55,7 @@ namespace embree
 #endif
 
 #if 1
-    instance->createThreads(numThreads);
+    instance->createThreads(numThreads,spawnThreads);
 #else
     instance->createThreads(1);
     std::cout << "WARNING: Using only a single thread." << std::endl;
@@ -106,6 +106,23 @@ namespace embree
     instance->wait(0,instance->getNumThreads(),event);
   }
 
+  static __thread void* g_context = NULL;
+
+  void* TaskScheduler::getContext() {
+    return g_context;
+  }
+
+  void TaskScheduler::setContext(void* context) {
+    g_context = context;
+  }
+
+  void TaskScheduler::processTask(size_t threadIndex, size_t threadCount) 
+  {
+    if (!instance) throw std::runtime_error("Embree tasks not running.");
+    if (threadIndex >= instance->numThreads) throw std::runtime_error("invalid thread index");
+    instance->work(threadIndex,threadCount,false);
+  }
+
   void TaskScheduler::destroy() 
   {
     if (instance) {
@@ -127,7 +144,7 @@ namespace embree
   TaskScheduler::TaskScheduler () 
     : terminateThreads(false), numThreads(0), thread2event(NULL) {}
 
-  void TaskScheduler::createThreads(size_t numThreads_in)
+  void TaskScheduler::createThreads(size_t numThreads_in, bool spawnThreads)
   {
     numThreads = numThreads_in;
 #if defined(__MIC__)
@@ -142,9 +159,16 @@ namespace embree
 
     memset(thread2event,0,numThreads*sizeof(ThreadEvent));
 
-    /* generate all threads */
-    for (size_t t=0; t<numThreads; t++) {
-      threads.push_back(createThread((thread_func)threadFunction,new Thread(t,numThreads,this),4*1024*1024,t));
+    createQueues(numThreads);
+
+    /* generate all threads, threads with neighboring indices get pinned to the same NUMA node */
+    for (size_t t=0; t<numThreads && spawnThreads; t++) {
+#if defined(__MIC__)
+      const ssize_t affinity = t;
+#else
+      const ssize_t affinity = getNumaOrderedThread(t);
+#endif
+      threads.push_back(createThread((thread_func)threadFunction,new Thread(t,numThreads,this),4*1024*1024,affinity));
     }
 
     //setAffinity(0);
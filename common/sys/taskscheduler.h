@@ -69,15 +69,15 @@ namespace embree
     {
     public:
       __forceinline Task() 
-        : event(NULL), run(NULL), runData(NULL), complete(NULL), completeData(NULL), name(NULL), locks(0) {}
+        : event(NULL), run(NULL), runData(NULL), complete(NULL), completeData(NULL), name(NULL), locks(0), context(NULL) {}
 
       __forceinline Task(Event* event, runFunction run, void* runData, size_t elts, completeFunction complete, void* completeData, const char* name)
         : event(event), run(run), runData(runData), elts(elts), complete(complete), completeData(completeData), 
-        started(elts), completed(elts), name(name), locks(0) {}
+        started(elts), completed(elts), name(name), locks(0), context(getContext()) {}
 
       __forceinline Task(Event* event, completeFunction complete, void* completeData, const char* name)
         : event(event), run(NULL), runData(NULL), elts(1), complete(complete), completeData(completeData), 
-        started(1), completed(1), name(name), locks(0) {}
+        started(1), completed(1), name(name), locks(0), context(getContext()) {}
 
     public:
       Event* event;
@@ -90,6 +90,16 @@ namespace embree
       AtomicCounter completed;            //!< counts the number of completed task set elements
       const char* name;            //!< name of this task
       AtomicCounter locks;
+      void* context;               //!< context of the thread that created the task, active while the task runs
+    };
+
+    /*! sets the context of the current thread while in scope */
+    struct ContextScope
+    {
+      __forceinline ContextScope (void* context) : prev(getContext()) { setContext(context); }
+      __forceinline ~ContextScope () { setContext(prev); }
+    private:
+      void* prev;
     };
 
     /* an event that gets triggered by a task when completed */
@@ -137,8 +147,9 @@ namespace embree
     /*! single instance of task scheduler */
     static TaskScheduler* instance;
     
-    /*! creates the threads */
-    static void create(size_t numThreads = 0);
+    /*! creates the threads, without spawning threads all threads have
+     *  to be provided by the application through processTask */
+    static void create(size_t numThreads = 0, bool spawnThreads = true);
 
     /*! returns the number of threads used */
     static size_t getNumThreads();
@@ -162,6 +173,17 @@ namespace embree
     /*! waits for an event out of a task */
     static void waitForEvent(Event* event); // use only from main thread !!!
 
+    /*! lets an application thread execute the next available task,
+     *  returns immediately if no task is available */
+    static void processTask(size_t threadIndex, size_t threadCount);
+
+    /*! returns the context of the current thread, tasks inherit the
+     *  context of the thread that creates them */
+    static void* getContext();
+
+    /*! sets the context of the current thread */
+    static void setContext(void* context);
+
       /*! enters lockstep taskscheduler, main thread returns false */
     static bool enter(size_t threadIndex, size_t threadCount);
 
@@ -171,7 +193,10 @@ namespace embree
   protected:
 
     /*! creates all threads */
-    void createThreads(size_t numThreads);
+    void createThreads(size_t numThreads, bool spawnThreads);
+
+    /*! allocates per thread task queues before threads get spawned */
+    virtual void createQueues(size_t numThreads) {}
 
     /*! thread function */
     static void threadFunction(void* thread);
@@ -185,6 +210,11 @@ namespace embree
     /*! waits for an event out of a task */
     virtual void wait(size_t threadIndex, size_t threadCount, Event* event) = 0;
 
+    /*! processes next task */
+    virtual void work(size_t threadIndex, size_t threadCount, bool wait) { 
+      throw std::runtime_error("application threads not supported by task scheduler"); 
+    }
+
     /*! sets the terminate thread variable */
     virtual void terminate() = 0;
 
@@ -17,99 +17,83 @@
 #include "taskscheduler_sys.h"
 #include "tasklogger.h"
  
-#if 0
- 
 namespace embree
 {
-  TaskSchedulerSys::TaskSchedulerSys()
-    : begin(0), end(0), tasks(16*1024) {}
+  /*! number of attempts to find a task before a thread goes to sleep */
+  static const size_t SPIN_ITERATIONS = 1024;
 
-  void TaskSchedulerSys::add(ssize_t threadIndex, QUEUE queue, Task* task)
+  bool TaskSchedulerSys::TaskDeque::push(Task* task)
   {
-    if (task->event) 
-      task->event->inc();
-
-    mutex.lock();
+    const atomic_t b = bottom;
+    if (b-top >= SIZE) return false;
+    tasks[b&(SIZE-1)] = task;
+    __memory_barrier();
+    bottom = b+1;
+    return true;
+  }
 
-    /*! insert task to correct end of list */
-    switch (queue) {
-    case GLOBAL_FRONT: { size_t i = (--begin)&(tasks.size()-1); tasks[i] = task; break; }
-    case GLOBAL_BACK : { size_t i = (end++  )&(tasks.size()-1); tasks[i] = task; break; }
-    default          : throw std::runtime_error("invalid task queue");
+  TaskScheduler::Task* TaskSchedulerSys::TaskDeque::pop()
+  {
+    /* reserve bottom element, the exchange orders the write to bottom before the read of top */
+    const atomic_t b = bottom-1;
+    atomic_xchg(&bottom,b);
+    const atomic_t t = top;
+    if (t > b) { bottom = b+1; return NULL; }
+    Task* task = tasks[b&(SIZE-1)];
+
+    /* last element may get stolen concurrently */
+    if (t == b) {
+      if (atomic_cmpxchg(&top,t,t+1) != t) task = NULL;
+      bottom = b+1;
     }
-    
-    condition.broadcast();
-    mutex.unlock();
+    return task;
   }
 
-  void TaskSchedulerSys::run(size_t threadIndex, size_t threadCount)
+  TaskScheduler::Task* TaskSchedulerSys::TaskDeque::steal()
   {
-    while (true)
-    {      
-      /* wait for available task */
-      mutex.lock();
-      while ((end-begin) == 0 && !terminateThreads) {
-        condition.wait(mutex); continue;
-      }
-      
-      /* terminate this thread */
-      if (terminateThreads) {
-        mutex.unlock(); return;
-      }
-
-      /* take next task from stack */
-      size_t i = (end-1)&(tasks.size()-1);
-      Task* task = tasks[i]; 
-      if (task == NULL || task->started <= 0) {
-        tasks[i] = NULL; end--; mutex.unlock(); continue;
-      }
-      task->locks++;
-      mutex.unlock();
-
-      TaskScheduler::Event* event = task->event;
-      thread2event[threadIndex].event = event; 
+    const atomic_t t = top;
+    __memory_barrier();
+    const atomic_t b = bottom;
+    if (t >= b) return NULL;
+    Task* task = tasks[t&(SIZE-1)];
+    if (atomic_cmpxchg(&top,t,t+1) != t) return NULL;
+    return task;
+  }
 
-      /* run the task */
-      while (true) {
-        ssize_t elt = --task->started;
-        if (elt < 0) break;
-        if (task->run) task->run(task->runData,threadIndex,threadCount,elt,task->elts,task->event);
-      }
+  TaskSchedulerSys::TaskSchedulerSys()
+    : deques(NULL), numDeques(0), begin(0), end(0), tasks(16*1024), numSleeping(0) {}
 
-      /* complete the task */
-      mutex.lock();
-      if (--task->locks == 0) {
-        tasks[i] = NULL;
-        mutex.unlock();
-        if (task->complete) task->complete(task->completeData,threadIndex,threadCount,task->event);
-        if (event) event->dec();
-      } 
-      else 
-        mutex.unlock();
-    }
+  TaskSchedulerSys::~TaskSchedulerSys() {
+    alignedFree(deques);
   }
 
-  void TaskSchedulerSys::terminate() 
+  void TaskSchedulerSys::createQueues(size_t numThreads)
   {
-    mutex.lock();
-    terminateThreads = true;
-    condition.broadcast(); 
-    mutex.unlock();
+    alignedFree(deques);
+    deques = (TaskDeque*) alignedMalloc(numThreads*sizeof(TaskDeque));
+    for (size_t i=0; i<numThreads; i++) new (&deques[i]) TaskDeque;
+    numDeques = numThreads;
   }
-}
-
-#else
-
-namespace embree
-{
-  TaskSchedulerSys::TaskSchedulerSys()
-    : begin(0), end(0), tasks(16*1024) {}
 
   void TaskSchedulerSys::add(ssize_t threadIndex, QUEUE queue, Task* task)
   {
     if (task->event) 
       task->event->inc();
 
+    push(threadIndex,queue,task);
+  }
+
+  void TaskSchedulerSys::push(ssize_t threadIndex, QUEUE queue, Task* task)
+  {
+    /*! worker threads push back tasks to the bottom of their own deque,
+     *  thus the thread continues with its most recent task while
+     *  stealing threads take the oldest one. Front tasks go to the
+     *  front of the global queue, which gets processed last. */
+    if (queue == GLOBAL_BACK && threadIndex >= 0 && size_t(threadIndex) < numDeques && deques[threadIndex].push(task)) {
+      wakeup();
+      return;
+    }
+
     mutex.lock();
 
     /*! resize array if too small */
@@ -126,17 +110,84 @@ namespace embree
     switch (queue) {
     case GLOBAL_FRONT: { size_t i = (--begin)&(tasks.size()-1); tasks[i] = task; break; }
     case GLOBAL_BACK : { size_t i = (end++  )&(tasks.size()-1); tasks[i] = task; break; }
-    default          : throw std::runtime_error("invalid task queue");
+    default          : mutex.unlock(); throw std::runtime_error("invalid task queue");
     }
     
     condition.broadcast();
     mutex.unlock();
   }
 
+  void TaskSchedulerSys::wakeup()
+  {
+    /* the atomic operation orders the preceding push before reading the number of sleeping threads */
+    if (atomic_add(&numSleeping,0) == 0) 
+      return;
+
+    mutex.lock();
+    condition.broadcast(); 
+    mutex.unlock();
+  }
+
+  TaskScheduler::Task* TaskSchedulerSys::takeGlobal()
+  {
+    if (end == begin) return NULL;
+
+    mutex.lock();
+    if (end == begin) {
+      mutex.unlock();
+      return NULL;
+    }
+    Task* task = tasks[(--end)&(tasks.size()-1)];
+    mutex.unlock();
+    return task;
+  }
+
+  TaskScheduler::Task* TaskSchedulerSys::take(size_t threadIndex, size_t& elt)
+  {
+    /* first try own deque, then global queue */
+    Task* task = NULL;
+    if (threadIndex < numDeques) task = deques[threadIndex].pop();
+    if (task == NULL) task = takeGlobal();
+
+    /* steal from other threads */
+    for (size_t i=1; task == NULL && i<numDeques; i++)
+      task = deques[(threadIndex+i)%numDeques].steal();
+    if (task == NULL) return NULL;
+
+    /* make remaining elements of the task available to other threads */
+    elt = --task->started;
+    if (elt > 0) push(threadIndex,GLOBAL_BACK,task);
+    return task;
+  }
+
+  bool TaskSchedulerSys::hasTasks() const
+  {
+    if (end != begin) return true;
+    for (size_t i=0; i<numDeques; i++)
+      if (!deques[i].empty()) return true;
+    return false;
+  }
+
+  void TaskSchedulerSys::idle()
+  {
+    /* spin for a while before going to sleep */
+    for (size_t i=0; i<SPIN_ITERATIONS; i++) {
+      if (hasTasks() || terminateThreads) return;
+      __pause();
+    }
+
+    mutex.lock();
+    atomic_add(&numSleeping,1);
+    while (!hasTasks() && !terminateThreads)
+      condition.wait(mutex);
+    atomic_add(&numSleeping,-1);
+    mutex.unlock();
+  }
+
   void TaskSchedulerSys::wait(size_t threadIndex, size_t threadCount, Event* event)
   {
     event->dec();
-    while (!event->triggered()) { // FIMXE: does not wait on event
+    while (!event->triggered()) { // FIXME: does not wait on event
       work(threadIndex,threadCount,false);
     }
   }
@@ -144,28 +195,17 @@ namespace embree
   void TaskSchedulerSys::work(size_t threadIndex, size_t threadCount, bool wait)
   {
     /* wait for available task */
-    mutex.lock();
-    while ((end-begin) == 0 && !terminateThreads) {
-      if (wait) condition.wait(mutex);
-      else { mutex.unlock(); return; }
-    }
-    
-    /* terminate this thread */
-    if (terminateThreads) {
-      mutex.unlock();
-      return;
+    size_t elt = 0;
+    Task* task = NULL;
+    while ((task = take(threadIndex,elt)) == NULL) {
+      if (!wait || terminateThreads) return;
+      idle();
     }
     
-    /* take next task from stack */
-    size_t i = (end-1)&(tasks.size()-1);
-    Task* task = tasks[i]; 
-    size_t elt = --task->started;
-    if (elt == 0) end--;
-    mutex.unlock();
-    
     /* run the task */
     TaskScheduler::Event* event = task->event;
     thread2event[threadIndex].event = event; 
+    ContextScope scope(task->context);
     if (task->run) {
       size_t taskID = TaskLogger::beginTask(threadIndex,task->name,elt);
       task->run(task->runData,threadIndex,threadCount,elt,task->elts,task->event);
@@ -197,5 +237,3 @@ namespace embree
     mutex.unlock();
   }
 }
-
-#endif
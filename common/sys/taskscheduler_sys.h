@@ -22,7 +22,11 @@
 
 namespace embree
 {
-  /*! Task scheduler implementing a stack of tasks. */
+  /*! Task scheduler implementing work stealing. Each thread owns a
+   *  lock-free deque of tasks it pushes to and pops from at the
+   *  bottom, idle threads steal from the top of other deques. Tasks
+   *  added from outside the worker threads and GLOBAL_FRONT tasks go
+   *  to a global queue. */
   class __hidden TaskSchedulerSys : public TaskScheduler
   {
   public:
@@ -30,9 +34,12 @@ namespace embree
     /*! construction */
     TaskSchedulerSys();
 
+    /*! destruction */
+    ~TaskSchedulerSys();
+
   private:
 
-    /*! only a single initial task can be added from the main thread */
+    /*! adds a task to the deque of the calling thread or the global queue */
     void add(ssize_t threadIndex, QUEUE queue, Task* task);
 
     /*! waits for an event out of a task */
@@ -46,11 +53,65 @@ namespace embree
 
     /*! sets the terminate thread variable */
     void terminate();
-    
+
+    /*! allocates one deque per thread */
+    void createQueues(size_t numThreads);
+
+  private:
+
+    /*! pushes a task to the deque of the thread, or the global queue if the deque is full */
+    void push(ssize_t threadIndex, QUEUE queue, Task* task);
+
+    /*! takes the next task element from the own deque, the global queue, or another deque */
+    Task* take(size_t threadIndex, size_t& elt);
+
+    /*! takes the next task from the global queue */
+    Task* takeGlobal();
+
+    /*! checks if any task is available */
+    bool hasTasks() const;
+
+    /*! spins for a while and then sleeps until tasks become available */
+    void idle();
+
+    /*! wakes up sleeping threads */
+    void wakeup();
+
   private:
-    MutexSys mutex;           //!< mutex to protect access to task list
+
+    /*! Lock-free work stealing deque. Only the owning thread pushes and
+     *  pops at the bottom, other threads steal from the top. */
+    struct __aligned(64) TaskDeque 
+    {
+      enum { SIZE = 1024 };
+
+      TaskDeque () : top(0), bottom(0) {}
+
+      /*! checks if the deque is empty */
+      __forceinline bool empty() const { return bottom <= top; }
+
+      /*! pushes a task at the bottom, only called by the owner */
+      bool push(Task* task);
+
+      /*! pops a task from the bottom, only called by the owner */
+      Task* pop();
+
+      /*! steals a task from the top, called by any thread */
+      Task* steal();
+
+    public:
+      volatile atomic_t top;    char align0[64-sizeof(atomic_t)]; //!< next task to steal
+      volatile atomic_t bottom; char align1[64-sizeof(atomic_t)]; //!< next free slot of owner
+      Task* volatile tasks[SIZE];                                  //!< ring buffer of tasks
+    };
+
+    TaskDeque* deques;        //!< one deque per thread
+    size_t numDeques;         //!< number of deques
+
+    MutexSys mutex;           //!< mutex to protect access to global task list
     ConditionSys condition;   //!< condition to signal new tasks
-    size_t begin,end;         //!< current range of tasks
-    std::vector<Task*> tasks; //!< queue of tasks
+    volatile size_t begin,end;//!< current range of global tasks
+    std::vector<Task*> tasks; //!< global queue of tasks
+    volatile atomic_t numSleeping; //!< number of threads waiting on the condition
   };
 }
@@ -33,6 +33,13 @@
 #  define RTCORE_ALIGN(...) __attribute__((aligned(__VA_ARGS__)))
 #endif
 
+/*! Axis aligned bounding box representation */
+struct RTCORE_ALIGN(16) RTCBounds
+{
+  float lower_x, lower_y, lower_z, align0;
+  float upper_x, upper_y, upper_z, align1;
+};
+
 #include "rtcore_scene.h"
 #include "rtcore_geometry.h"
 #include "rtcore_geometry_user.h"
@@ -95,6 +102,32 @@ typedef void (*RTC_ERROR_FUNCTION)(const RTCError code, const char* str);
 /*! \brief Sets a callback function that is called whenever an error occurs. */
 RTCORE_API void rtcSetErrorFunction(RTC_ERROR_FUNCTION func);
 
+/*! \brief Type of memory monitor callback function. */
+typedef bool (*RTC_MEMORY_MONITOR_FUNCTION)(const long long bytes, const bool post);
+
+/*! \brief Sets the memory monitor callback function.
+
+  The callback is invoked whenever Embree allocates memory for
+  acceleration structures or build temporaries, with a positive number
+  of bytes and post set to false before the allocation, and again with
+  post set to true once the memory is in use. Released memory is
+  reported with a negative number of bytes and post set to true. The
+  application can reject an allocation by returning false from the
+  post=false call. The build of the scene that requested the memory
+  then stops at its next safe point, releases its memory and reports
+  RTC_OUT_OF_MEMORY from the commit call. The scene appears empty,
+  remains uncommitted and can get committed again. Passing NULL
+  disables the memory monitor. */
+RTCORE_API void rtcSetMemoryMonitorFunction(RTC_MEMORY_MONITOR_FUNCTION func);
+
+/*! \brief Returns idle memory to the operating system.
+
+  Frees all memory chunks of the internal memory pool that contain
+  no used blocks. Chunks backed by huge pages can only get freed as a
+  whole, thus the free blocks of the fullest chunks are handed out
+  first afterwards, such that the other chunks can become free. */
+RTCORE_API void rtcTrimMemory();
+
 /*! \brief Implementation specific (do not call).
 
   This function is implementation specific and only for debugging
@@ -29,8 +29,17 @@ enum RTCBufferType {
   RTC_VERTEX_BUFFER   = 0x02000000,
   RTC_VERTEX_BUFFER0  = 0x02000000,
   RTC_VERTEX_BUFFER1  = 0x02000001,
+  RTC_VERTEX_BUFFER2  = 0x02000002,
+  RTC_VERTEX_BUFFER3  = 0x02000003,
+  RTC_VERTEX_BUFFER4  = 0x02000004,
+  RTC_VERTEX_BUFFER5  = 0x02000005,
+  RTC_VERTEX_BUFFER6  = 0x02000006,
+  RTC_VERTEX_BUFFER7  = 0x02000007,
 };
 
+/*! maximal number of time steps of motion blurred triangle meshes */
+#define RTC_MAX_TIME_STEPS 8
+
 /*! \brief Supported types of matrix layout for functions involving matrices */
 enum RTCMatrixType {
   RTC_MATRIX_ROW_MAJOR = 0,
@@ -77,6 +86,18 @@ RTCORE_API unsigned rtcNewInstance (RTCScene target,                  //!< the s
                                     RTCScene source                   //!< the scene to instantiate
   );
 
+/*! \brief Creates a new motion blurred scene instance. 
+
+  Like rtcNewInstance, but the instance stores one transformation for
+  each of the numTimeSteps time steps (1 up to RTC_MAX_TIME_STEPS). The
+  time steps are distributed uniformly over the time range [0,1] and
+  the transformation is linearly interpolated to the time of the
+  ray. */
+RTCORE_API unsigned rtcNewInstance2 (RTCScene target,                  //!< the scene the instance belongs to
+                                     RTCScene source,                  //!< the scene to instantiate
+                                     size_t numTimeSteps               //!< number of transformations
+  );
+
 /*! \brief Sets transformation of the instance */
 RTCORE_API void rtcSetTransform (RTCScene scene,                          //!< scene handle
                                  unsigned geomID,                         //!< ID of geometry
@@ -84,15 +105,37 @@ RTCORE_API void rtcSetTransform (RTCScene scene,                          //!< s
                                  const float* xfm                         //!< transformation matrix
                                  );
 
+/*! \brief Sets transformation of some time step of a motion blurred instance */
+RTCORE_API void rtcSetTransform2 (RTCScene scene,                         //!< scene handle
+                                  unsigned geomID,                        //!< ID of geometry
+                                  RTCMatrixType layout,                   //!< layout of transformation matrix
+                                  const float* xfm,                       //!< transformation matrix
+                                  size_t timeStep                         //!< time step to set the transformation for
+                                  );
+
+/*! \brief Sets the transformations of many instances at once. The
+  matrices of the specified layout are stored consecutively in the xfms
+  array, 12 floats per matrix (16 floats for
+  RTC_MATRIX_COLUMN_MAJOR_ALIGNED16). If some geometry ID is invalid or
+  does not refer to an instance, no transformation gets changed. */
+RTCORE_API void rtcSetTransforms (RTCScene scene,                         //!< scene handle
+                                  const unsigned* geomIDs,                //!< IDs of the instances
+                                  size_t numTransforms,                   //!< number of instances to set the transformation for
+                                  RTCMatrixType layout,                   //!< layout of transformation matrices
+                                  const float* xfms                       //!< transformation matrices
+                                  );
+
 /*! \brief Creates a new triangle mesh. The number of triangles
   (numTriangles), number of vertices (numVertices), and number of time
-  steps (1 for normal meshes, and 2 for linear motion blur), have to
-  get specified. The triangle indices can be set be mapping and
-  writing to the index buffer (RTC_INDEX_BUFFER) and the triangle
-  vertices can be set by mapping and writing into the vertex buffer
-  (RTC_VERTEX_BUFFER). In case of linear motion blur, two vertex
-  buffers have to get filled (RTC_VERTEX_BUFFER0, RTC_VERTEX_BUFFER1),
-  one for each time step. The index buffer has the default layout of
+  steps (1 for normal meshes, and 2 up to RTC_MAX_TIME_STEPS for
+  motion blur), have to get specified. The triangle indices can be set
+  be mapping and writing to the index buffer (RTC_INDEX_BUFFER) and
+  the triangle vertices can be set by mapping and writing into the
+  vertex buffer (RTC_VERTEX_BUFFER). In case of motion blur, one vertex
+  buffer has to get filled for each time step (RTC_VERTEX_BUFFER0,
+  RTC_VERTEX_BUFFER1, ...). The time steps are distributed uniformly
+  over the time range [0,1] and the motion is linear between two time
+  steps. The index buffer has the default layout of
   three 32 bit integer indices for each triangle. An index points to
   the ith vertex. The vertex buffer stores single precision x,y,z
   floating point coordinates aligned to 16 bytes. The value of the 4th
@@ -167,6 +210,15 @@ RTCORE_API void rtcEnable (RTCScene scene, unsigned geomID);
   called after initializing some geometry for the first time. */
 RTCORE_API void rtcUpdate (RTCScene scene, unsigned geomID);
 
+/*! \brief Update part of a geometry buffer. 
+
+  Like rtcUpdate, but tells the implementation that only the count
+  elements of the specified buffer starting at element first got
+  modified. For deformable triangle meshes only the parts of the BVH
+  that reference modified vertices are refitted. Modified ranges
+  accumulate until the next rtcCommit. */
+RTCORE_API void rtcUpdateBufferRange (RTCScene scene, unsigned geomID, RTCBufferType type, size_t first, size_t count);
+
 /*! \brief Disable geometry. 
 
   Disabled geometry is not hit by any ray. Disabling and enabling
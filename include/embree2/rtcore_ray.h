@@ -20,6 +20,9 @@
 /*! \ingroup embree_kernel_api */
 /*! \{ */
 
+/*! maximal number of nested instance levels whose instance IDs are reported */
+#define RTC_MAX_INSTANCE_LEVELS 4
+
 /*! \brief Ray structure for an individual ray */
 struct RTCORE_ALIGN(16)  RTCRay
 {
@@ -48,6 +51,7 @@ public:
   int   geomID;        //!< geometry ID
   int   primID;        //!< primitive ID
   int   instID;        //!< instance ID
+  int   instIDStack[RTC_MAX_INSTANCE_LEVELS-1]; //!< instance IDs of the nested instance levels below instID
 };
 
 /*! Ray structure for packets of 4 rays. */
@@ -81,6 +85,7 @@ public:
   int   geomID[4];  //!< geometry ID
   int   primID[4];  //!< primitive ID
   int   instID[4];  //!< instance ID
+  int   instIDStack[RTC_MAX_INSTANCE_LEVELS-1][4]; //!< instance IDs of the nested instance levels below instID
 };
 
 /*! Ray structure for packets of 8 rays. */
@@ -114,6 +119,7 @@ public:
   int   geomID[8];  //!< geometry ID
   int   primID[8];  //!< primitive ID
   int   instID[8];  //!< instance ID
+  int   instIDStack[RTC_MAX_INSTANCE_LEVELS-1][8]; //!< instance IDs of the nested instance levels below instID
 };
 
 /*! \brief Ray structure for packets of 16 rays. */
@@ -147,6 +153,42 @@ public:
   int   geomID[16];  //!< geometry ID
   int   primID[16];  //!< primitive ID
   int   instID[16];  //!< instance ID
+  int   instIDStack[RTC_MAX_INSTANCE_LEVELS-1][16]; //!< instance IDs of the nested instance levels below instID
+};
+
+/*! \brief Ray structure for a stream of N rays in structure of arrays
+ *  layout. Each member points to an array of N elements. Of nested
+ *  instances only the outermost instance ID is reported. */
+struct RTCRayNp
+{
+  /* ray data */
+public:
+  float* orgx;     //!< x coordinate of ray origin
+  float* orgy;     //!< y coordinate of ray origin
+  float* orgz;     //!< z coordinate of ray origin
+  
+  float* dirx;     //!< x coordinate of ray direction
+  float* diry;     //!< y coordinate of ray direction
+  float* dirz;     //!< z coordinate of ray direction
+  
+  float* tnear;    //!< Start of ray segment 
+  float* tfar;     //!< End of ray segment (set to hit distance)
+
+  float* time;     //!< Time of this ray for motion blur
+  int*   mask;     //!< Used to mask out objects during traversal
+  
+  /* hit data */
+public:
+  float* Ngx;      //!< x coordinate of geometry normal
+  float* Ngy;      //!< y coordinate of geometry normal
+  float* Ngz;      //!< z coordinate of geometry normal
+  
+  float* u;        //!< Barycentric u coordinate of hit
+  float* v;        //!< Barycentric v coordinate of hit
+  
+  int*   geomID;   //!< geometry ID
+  int*   primID;   //!< primitive ID
+  int*   instID;   //!< instance ID
 };
 
 /*! @} */
@@ -25,6 +25,7 @@ struct RTCRay;
 struct RTCRay4;
 struct RTCRay8;
 struct RTCRay16;
+struct RTCRayNp;
 
 /*! scene flags */
 enum RTCSceneFlags 
@@ -38,6 +39,8 @@ enum RTCSceneFlags
   RTC_SCENE_COHERENT   = (1 << 9),    //!< optimize data structures for coherent rays
   RTC_SCENE_INCOHERENT = (1 << 10),    //!< optimize data structures for in-coherent rays (enabled by default)
   RTC_SCENE_HIGH_QUALITY = (1 << 11),  //!< create higher quality data structures
+  RTC_SCENE_NUMA_INTERLEAVE = (1 << 12), //!< interleave the memory of static data structures over all NUMA nodes
+  RTC_SCENE_NUMA_REPLICATE  = (1 << 13), //!< keep one copy of static data structures per NUMA node
 
   /* traversal algorithm flags */
   RTC_SCENE_ROBUST     = (1 << 16)     //!< use more robust traversal algorithms
@@ -55,6 +58,54 @@ enum RTCAlgorithmFlags
 /*! \brief Defines an opaque scene type */
 typedef struct __RTCScene {}* RTCScene;
 
+/*! \brief Closest point query. 
+
+  Finds the closest point on the triangles of the scene that lies
+  within the search radius around the query point. */
+struct RTCORE_ALIGN(16) RTCPointQuery
+{
+  /* query data */
+public:
+  float p[3];        //!< Query point
+  float radius;      //!< Search radius (set to distance of closest point)
+
+  /* result data */
+public:
+  float closest[3];  //!< Closest point on the surface
+  int   align0;
+
+  float u;           //!< Barycentric u coordinate of closest point
+  float v;           //!< Barycentric v coordinate of closest point
+
+  int   geomID;      //!< geometry ID of closest primitive, or -1 if nothing found within radius
+  int   primID;      //!< primitive ID of closest primitive
+};
+
+/*! traversal statistics of one ray type */
+struct RTCTraversalStatistics
+{
+  size_t rays;       //!< number of traced rays
+  size_t nodes;      //!< number of traversed nodes
+  size_t leaves;     //!< number of visited leaves
+  size_t prims;      //!< number of primitive intersection tests
+  size_t primHits;   //!< number of successful primitive intersection tests
+};
+
+/*! traversal statistics of a scene */
+struct RTCStatistics
+{
+  RTCTraversalStatistics normal;  //!< statistics of rtcIntersect calls
+  RTCTraversalStatistics shadow;  //!< statistics of rtcOccluded calls
+};
+
+/*! memory statistics of the internal memory pool and a scene */
+struct RTCMemoryStats
+{
+  size_t poolBytes;      //!< size of the internal memory pool
+  size_t poolUsedBytes;  //!< bytes of the pool used for builds and acceleration structures
+  size_t sceneBytes;     //!< bytes allocated for the acceleration structures of the scene
+};
+
 /*! Creates a new scene. */
 RTCORE_API RTCScene rtcNewScene (RTCSceneFlags flags, RTCAlgorithmFlags aflags);
 
@@ -63,6 +114,43 @@ RTCORE_API RTCScene rtcNewScene (RTCSceneFlags flags, RTCAlgorithmFlags aflags);
  *  rays. */
 RTCORE_API void rtcCommit (RTCScene scene);
 
+/*! Starts committing the geometry of the scene without waiting for
+ *  the build of the internal data structures to finish. Until
+ *  rtcWaitCommit returned or rtcIsCommitted returned true, the scene
+ *  must not get modified or traced, but other scenes can get traced
+ *  while the build runs on the Embree threads. */
+RTCORE_API void rtcCommitAsync (RTCScene scene);
+
+/*! Commits the geometry of the scene using application threads
+ *  instead of the Embree threads. Requires Embree to get initialized
+ *  with user_threads=N, and all N threads have to call this function
+ *  with their threadIndex in [0,N) and threadCount N. The function
+ *  returns in each thread after the commit finished. rtcCommit and
+ *  rtcCommitAsync cannot get used in this mode. */
+RTCORE_API void rtcCommitThread(RTCScene scene, unsigned int threadIndex, unsigned int threadCount);
+
+/*! Waits until a commit started with rtcCommitAsync finished. Returns
+ *  immediately if no commit is in flight. */
+RTCORE_API void rtcWaitCommit (RTCScene scene);
+
+/*! Tests if a commit started with rtcCommitAsync finished, without
+ *  blocking. */
+RTCORE_API bool rtcIsCommitted (RTCScene scene);
+
+/*! Writes the acceleration structures of a committed static scene
+ *  to a file. As static scenes free their geometry data during
+ *  commit, rtcLoadScene has to get called before rtcCommit to
+ *  compute the geometry hash stored in the file. */
+RTCORE_API void rtcSaveScene (RTCScene scene, const char* filename);
+
+/*! Loads the acceleration structures of an uncommitted static scene
+ *  from a file written by rtcSaveScene. The file is mapped into
+ *  memory instead of being read. Returns false if the file does not
+ *  exist or was written for different geometry, in which case the
+ *  scene has to get committed as usual. On success the scene is
+ *  committed and must not get committed again. */
+RTCORE_API bool rtcLoadScene (RTCScene scene, const char* filename);
+
 /*! Intersects a single ray with the scene. The ray has to be aligned
  *  to 16 bytes. This function can only be called for scenes with the
  *  RTC_INTERSECT1 flag set. */
@@ -87,6 +175,19 @@ RTCORE_API void rtcIntersect8 (const void* valid, RTCScene scene, RTCRay8& ray);
  *  called if the CPU supports the 16-wide Xeon Phi instructions. */
 RTCORE_API void rtcIntersect16 (const void* valid, RTCScene scene, RTCRay16& ray);
 
+/*! Intersects a stream of N rays stored as an array of RTCRay
+ *  structures with the scene. Consecutive rays are stride bytes
+ *  apart. The rays are internally regrouped into coherent packets of
+ *  the widest packet size enabled for the scene through the
+ *  RTC_INTERSECT1, RTC_INTERSECT4, RTC_INTERSECT8, or RTC_INTERSECT16
+ *  flags, thus filter functions have to be specified for that packet
+ *  size. */
+RTCORE_API void rtcIntersectN (RTCScene scene, RTCRay* rays, size_t N, size_t stride);
+
+/*! Intersects a stream of N rays stored in structure of arrays
+ *  layout with the scene. Otherwise identical to rtcIntersectN. */
+RTCORE_API void rtcIntersectNp (RTCScene scene, RTCRayNp& rays, size_t N);
+
 /*! Tests if a single ray is occluded by the scene. The ray has to be
  *  aligned to 16 bytes. This function can only be called for scenes
  *  with the RTC_INTERSECT1 flag set. */
@@ -113,6 +214,47 @@ RTCORE_API void rtcOccluded8 (const void* valid, RTCScene scene, RTCRay8& ray);
  *  instructions. */
 RTCORE_API void rtcOccluded16 (const void* valid, RTCScene scene, RTCRay16& ray);
 
+/*! Tests if a stream of N rays stored as an array of RTCRay
+ *  structures is occluded by the scene. Consecutive rays are stride
+ *  bytes apart. See rtcIntersectN for the used packet size. */
+RTCORE_API void rtcOccludedN (RTCScene scene, RTCRay* rays, size_t N, size_t stride);
+
+/*! Tests if a stream of N rays stored in structure of arrays layout
+ *  is occluded by the scene. Otherwise identical to rtcOccludedN. */
+RTCORE_API void rtcOccludedNp (RTCScene scene, RTCRayNp& rays, size_t N);
+
+/*! Finds the closest point on the triangles of the scene to the query
+ *  point that lies within the search radius. The geomID of the query
+ *  has to be initialized to -1. If some point is found, the radius,
+ *  closest point, barycentric coordinates, geomID, and primID of the
+ *  query are updated, otherwise the query is left unchanged. Point
+ *  queries are only supported for triangle meshes, for other
+ *  geometry or compact acceleration structures an
+ *  RTC_INVALID_OPERATION error is set. */
+RTCORE_API void rtcPointQuery (RTCScene scene, RTCPointQuery& query);
+
+/*! Returns the traversal statistics gathered for the scene by all
+ *  threads since the scene got created or the statistics got
+ *  reset. Statistics are only gathered if Embree got compiled with
+ *  RTCORE_STAT_COUNTERS enabled, otherwise all counters are zero and
+ *  an RTC_INVALID_OPERATION error is set. */
+RTCORE_API void rtcGetStatistics (RTCScene scene, RTCStatistics& stats);
+
+/*! Sets all traversal statistics of the scene to zero. */
+RTCORE_API void rtcResetStatistics (RTCScene scene);
+
+/*! Returns the size of the internal memory pool, the number of its
+ *  bytes in use, and the bytes allocated for the acceleration
+ *  structures of the scene. The scene can be NULL to only query the
+ *  memory pool. */
+RTCORE_API void rtcGetMemoryStats (RTCScene scene, RTCMemoryStats& stats);
+
+/*! Returns the bounds of the committed scene. For instances the
+ *  bounds enclose the transformed boxes of the top levels of the
+ *  instanced scene, and can thus be smaller than the transformed
+ *  bounds of the instanced scene. */
+RTCORE_API void rtcGetBounds (RTCScene scene, RTCBounds& bounds_o);
+
 /*! Deletes the scene. All contained geometry get also destroyed. */
 RTCORE_API void rtcDeleteScene (RTCScene scene);
 
@@ -20,10 +20,87 @@
 
 namespace embree
 {
+  /*! Header of a serialized acceleration structure. Each structure
+   *  starts page aligned inside the file, offsets are relative to the
+   *  header. */
+  struct AccelFileHeader
+  {
+    /*! alignment of acceleration structures inside the file */
+    static const size_t alignment = 4096;
+
+    /*! pads the stream to the start of the next structure */
+    static void align(std::ostream& out) 
+    {
+      const size_t pos = (size_t) out.tellp();
+      const size_t bytes = ((pos+alignment-1) & ~(alignment-1)) - pos;
+      for (size_t i=0; i<bytes; i++) out.put(0);
+    }
+
+    /*! aligns pointer to the start of the next structure */
+    static char* align(char* ptr) {
+      return (char*) (((size_t)ptr+alignment-1) & ~(alignment-1));
+    }
+
+    /*! writes an acceleration structure without data */
+    static void storeEmpty(std::ostream& out) 
+    {
+      align(out);
+      AccelFileHeader header; 
+      memset(&header,0,sizeof(header));
+      header.bytes = sizeof(header);
+      out.write((char*)&header,sizeof(header));
+    }
+
+    /*! skips an acceleration structure without data, returns false if the structure contains data */
+    static bool loadEmpty(char*& ptr, char* end) 
+    {
+      char* cur = align(ptr);
+      if (cur+sizeof(AccelFileHeader) > end) return false;
+      AccelFileHeader* header = (AccelFileHeader*) cur;
+      if (header->type[0] != 0) return false;
+      ptr = cur+header->bytes;
+      return true;
+    }
+
+  public:
+    char type[64];         //!< BVH and primitive type that determine the memory layout, empty if the structure holds no data
+    int64 bytes;           //!< size of the structure including this header
+    int64 root;            //!< root node as offset relative to this header
+    Vec3fa lower;          //!< lower bounds of the structure
+    Vec3fa upper;          //!< upper bounds of the structure
+    int64 numPrimitives;   //!< number of primitives
+    int64 numVertices;     //!< number of vertices
+  };
+
   /*! Base class for bounded geometry. */
   class Bounded : public RefCount {
   public:
     Bounded () : bounds(empty) {}
+
+    /*! writes the data structure to a stream, returns false if not supported */
+    virtual bool store (std::ostream& out) const { return false; }
+
+    /*! restores the data structure from a mapped file and advances the pointer, returns false if not supported */
+    virtual bool load (char*& ptr, char* end) { return false; }
+
+    /*! writes at most maxBounds boxes that together enclose the data
+     *  structure, obtained by descending up to depth levels into the
+     *  hierarchy, returns the number of boxes written */
+    virtual size_t childBounds (size_t depth, BBox3fa* bounds_o, size_t maxBounds) const { 
+      if (bounds.empty() || maxBounds == 0) return 0;
+      bounds_o[0] = bounds; 
+      return 1;
+    }
+
+    /*! makes the data structure immutable, called once the scene will not change anymore */
+    virtual void immutable () {};
+
+    /*! interleaves the memory of the immutable data structure over all NUMA nodes, or creates one copy per node */
+    virtual void numaDistribute (bool replicate) {};
+
+    /*! returns the number of bytes allocated for the data structure */
+    virtual size_t bytesAllocated () const { return 0; }
+
   public:
     BBox3fa bounds;
   };
@@ -71,6 +148,10 @@ namespace embree
     typedef void (*OccludedFunc16) (const void* valid, /*! pointer to valid mask */
                                     void* ptr,         /*!< pointer to user data */
                                     RTCRay16& ray      /*!< Ray packet to test occlusion. */);
+
+    /*! Type of point query function pointer. */
+    typedef void (*PointQueryFunc) (void* ptr,            /*!< pointer to user data */
+                                    RTCPointQuery& query  /*!< point query to perform */);
   
     struct Intersector1
     {
@@ -140,6 +221,22 @@ namespace embree
       OccludedFunc16 occluded;
     };
   
+    struct PointQuery1
+    {
+      PointQuery1 (ErrorFunc error = NULL) 
+      : query((PointQueryFunc)error), name(NULL) {}
+
+      PointQuery1 (PointQueryFunc query, const char* name)
+      : query(query), name(name) {}
+
+      operator bool() const { return name; }
+      
+    public:
+      static const char* type;
+      const char* name;
+      PointQueryFunc query;
+    };
+  
   public:
 
     /*! Construction */
@@ -148,9 +245,6 @@ namespace embree
     /*! Virtual destructor */
     virtual ~Accel() {}
 
-    /*! makes the acceleration structure immutable */
-    virtual void immutable () {};
-    
     /*! build accel */
     virtual void build (size_t threadIndex, size_t threadCount) = 0;
     
@@ -202,6 +296,13 @@ namespace embree
       intersectors.intersector16.occluded(valid,intersectors.ptr,ray);
     }
 
+    /*! Finds the closest point to the query point, returns false if not supported. */
+    __forceinline bool pointQuery (RTCPointQuery& query) {
+      if (!intersectors.pointQuery1) return false;
+      intersectors.pointQuery1.query(intersectors.ptr,query);
+      return true;
+    }
+
   public:
     struct Intersectors 
     {
@@ -226,6 +327,10 @@ namespace embree
           for (size_t i=0; i<ident; i++) std::cout << " ";
           std::cout << "intersector16 = " << intersector16.name << std::endl;
         }
+        if (pointQuery1.name) {
+          for (size_t i=0; i<ident; i++) std::cout << " ";
+          std::cout << "pointQuery1   = " << pointQuery1.name << std::endl;
+        }
       }
 
       void select(bool filter4, bool filter8, bool filter16)
@@ -257,6 +362,7 @@ namespace embree
       Intersector16 intersector16;
       Intersector16 intersector16_filter;
       Intersector16 intersector16_nofilter;
+      PointQuery1 pointQuery1;
     } intersectors;
   };
 
@@ -265,6 +371,10 @@ namespace embree
                              (Accel::OccludedFunc )intersector::occluded,  \
                              TOSTRING(isa) "::" TOSTRING(symbol));
 
+#define DEFINE_POINT_QUERY1(symbol,query)                              \
+  Accel::PointQuery1 symbol((Accel::PointQueryFunc)query::pointQuery,   \
+                            TOSTRING(isa) "::" TOSTRING(symbol));
+
 #define DEFINE_INTERSECTOR4(symbol,intersector)                         \
   Accel::Intersector4 symbol((Accel::IntersectFunc4)intersector::intersect, \
                              (Accel::OccludedFunc4)intersector::occluded,   \
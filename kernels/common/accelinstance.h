@@ -32,6 +32,15 @@ namespace embree
 
     void immutable () {
       delete builder; builder = NULL;
+      accel->immutable();
+    }
+
+    void numaDistribute (bool replicate) {
+      accel->numaDistribute(replicate);
+    }
+
+    size_t bytesAllocated () const {
+      return accel->bytesAllocated();
     }
 
     ~AccelInstance() {
@@ -45,6 +54,30 @@ namespace embree
       bounds = accel->bounds;
     }
 
+    bool store (std::ostream& out) const 
+    {
+      if (accel->bounds.empty()) {
+        AccelFileHeader::storeEmpty(out);
+        return true;
+      }
+      return accel->store(out);
+    }
+
+    bool load (char*& ptr, char* end) 
+    {
+      if (AccelFileHeader::loadEmpty(ptr,end)) {
+        bounds = empty;
+        return true;
+      }
+      if (!accel->load(ptr,end)) return false;
+      bounds = accel->bounds;
+      return true;
+    }
+
+    size_t childBounds (size_t depth, BBox3fa* bounds_o, size_t maxBounds) const {
+      return accel->childBounds(depth,bounds_o,maxBounds);
+    }
+
   private:
     Bounded* accel;
     Builder* builder;
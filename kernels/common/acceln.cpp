@@ -15,6 +15,7 @@
 // ======================================================================== //
 
 #include "acceln.h"
+#include "alloc.h"
 #include "embree2/rtcore_ray.h"
 
 namespace embree
@@ -100,6 +101,13 @@ namespace embree
     }
   }
 
+  void AccelN::pointQuery (void* ptr, RTCPointQuery& query) 
+  {
+    AccelN* This = (AccelN*)ptr;
+    for (size_t i=0; i<This->M; i++)
+      This->validAccels[i]->pointQuery(query);
+  }
+
   void AccelN::print(size_t ident)
   {
     for (size_t i=0; i<M; i++)
@@ -116,21 +124,73 @@ namespace embree
       accels[i]->immutable();
   }
 
+  void AccelN::numaDistribute(bool replicate)
+  {
+    for (size_t i=0; i<N; i++)
+      accels[i]->numaDistribute(replicate);
+  }
+
+  size_t AccelN::bytesAllocated () const
+  {
+    size_t bytes = 0;
+    for (size_t i=0; i<N; i++)
+      bytes += accels[i]->bytesAllocated();
+    return bytes;
+  }
+
+  void AccelN::clear() 
+  {
+    for (size_t i=0; i<N; i++)
+      delete accels[i];
+    N = 0;
+    finalize();
+  }
+
   void AccelN::build (size_t threadIndex, size_t threadCount) 
   {
-    /* build all acceleration structures */
-    M = 0;
+    /* build all acceleration structures, a build the memory monitor
+     * rejected memory for stops once all threads left the builder */
+    for (size_t i=0; i<N; i++) {
+      accels[i]->build(threadIndex,threadCount);
+      if (memoryMonitorRejected()) throw std::bad_alloc();
+    }
 
+    finalize();
+  }
+
+  bool AccelN::store (std::ostream& out) const
+  {
     for (size_t i=0; i<N; i++) 
-    {
+      if (!accels[i]->store(out)) return false;
+    return true;
+  }
 
-      accels[i]->build(threadIndex,threadCount);
+  size_t AccelN::childBounds (size_t depth, BBox3fa* bounds_o, size_t maxBounds) const
+  {
+    /* keeps one box free for each of the remaining structures */
+    size_t num = 0;
+    for (size_t i=0; i<M && num+M-i <= maxBounds; i++) 
+      num += validAccels[i]->childBounds(depth,bounds_o+num,maxBounds-num-(M-1-i));
+    return num;
+  }
+
+  bool AccelN::load (char*& ptr, char* end)
+  {
+    for (size_t i=0; i<N; i++) 
+      if (!accels[i]->load(ptr,end)) return false;
+    finalize();
+    return true;
+  }
 
+  void AccelN::finalize()
+  {
+    /* collect non-empty acceleration structures */
+    M = 0;
+    for (size_t i=0; i<N; i++) {
       if (accels[i]->bounds.empty()) continue;
       validAccels[M++] = accels[i];
     }
 
-
     if (M == 1) {
       intersectors = validAccels[0]->intersectors;
     }
@@ -141,6 +201,11 @@ namespace embree
       intersectors.intersector4 = Intersector4(&intersect4,&occluded4,"AccelN::intersector4");
       intersectors.intersector8 = Intersector8(&intersect8,&occluded8,"AccelN::intersector8");
       intersectors.intersector16= Intersector16(&intersect16,&occluded16,"AccelN::intersector16");
+
+      /* point queries are only possible if all structures support them */
+      intersectors.pointQuery1 = PointQuery1(&pointQuery,"AccelN::pointQuery1");
+      for (size_t i=0; i<M; i++) 
+        if (!validAccels[i]->intersectors.pointQuery1) intersectors.pointQuery1 = PointQuery1();
     }
     
     /*! calculate bounds */
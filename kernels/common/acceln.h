@@ -41,11 +41,23 @@ namespace embree
     static void occluded8 (const void* valid, void* ptr, RTCRay8& ray);
     static void occluded16 (const void* valid, void* ptr, RTCRay16& ray);
 
+  public:
+    static void pointQuery (void* ptr, RTCPointQuery& query);
+
   public:
     void print(size_t ident);
     void immutable();
+    void numaDistribute(bool replicate);
+    void clear(); //!< deletes all acceleration structures together with their memory
+    size_t bytesAllocated () const;
     void build (size_t threadIndex, size_t threadCount);
     void select(bool filter4, bool filter8, bool filter16);
+    bool store (std::ostream& out) const;
+    bool load (char*& ptr, char* end);
+    size_t childBounds (size_t depth, BBox3fa* bounds_o, size_t maxBounds) const;
+
+  private:
+    void finalize();
       
   public:
     Accel* accels[16];
@@ -16,44 +16,154 @@
 
 #include "alloc.h"
 
+#include <algorithm>
+
 namespace embree
 {
+  RTC_MEMORY_MONITOR_FUNCTION g_memory_monitor_function = NULL;
+
+  void memoryMonitor(ssize_t bytes)
+  {
+    RTC_MEMORY_MONITOR_FUNCTION monitor = g_memory_monitor_function;
+    if (monitor == NULL) return;
+    if (bytes > 0 && !monitor(bytes,false)) {
+      atomic_t* rejections = (atomic_t*) TaskScheduler::getContext();
+      if (rejections) atomic_add(rejections,1);
+    }
+    monitor(bytes,true);
+  }
+
+  bool memoryMonitorRejected() 
+  {
+    atomic_t* rejections = (atomic_t*) TaskScheduler::getContext();
+    return rejections && *rejections;
+  }
+
   Alloc Alloc::global;
+  bool Alloc::hugePages = false;
+  size_t Alloc::trimThreshold = 0;
 
-  Alloc::Alloc () {
-    blocks.reserve(1024);
+  Alloc::Alloc () : head(0), readers(0), freeBlocks(0), bytes(0) {
+    chunks.reserve(1024);
   }
 
   Alloc::~Alloc () {
   }
 
   size_t Alloc::size() const {
-    return size_t(blockSize)*blocks.size();
+    return bytes;
+  }
+
+  size_t Alloc::used() const {
+    const size_t free = size_t(freeBlocks)*blockSize;
+    return bytes > free ? bytes-free : 0;
+  }
+
+  void Alloc::push(void* ptr)
+  {
+    const atomic_t tagMask = atomic_t(blockSize-1);
+    while (true) {
+      const atomic_t h = head;
+      *(volatile atomic_t*)ptr = h & ~tagMask;
+      if (atomic_cmpxchg(&head,h,(atomic_t)ptr | ((h+1) & tagMask)) == h) {
+        atomic_add(&freeBlocks,1);
+        return;
+      }
+    }
+  }
+
+  void* Alloc::pop()
+  {
+    const atomic_t tagMask = atomic_t(blockSize-1);
+    atomic_add(&readers,1);
+    while (true) {
+      const atomic_t h = head;
+      char* ptr = (char*) (h & ~tagMask);
+      if (ptr == NULL) break;
+      /* the block may get popped and reused concurrently, the tag lets the exchange fail in this case */
+      const atomic_t next = *(volatile atomic_t*)ptr;
+      if (atomic_cmpxchg(&head,h,next | ((h+1) & tagMask)) == h) {
+        atomic_add(&freeBlocks,-1);
+        atomic_add(&readers,-1);
+        return ptr;
+      }
+    }
+    atomic_add(&readers,-1);
+    return NULL;
+  }
+
+  void Alloc::refill()
+  {
+    Lock<MutexSys> lock(mutex);
+    if (head & ~atomic_t(blockSize-1)) return; // some other thread refilled the pool
+
+    const bool huge = hugePages;
+    const size_t chunkSize = huge ? size_t(hugeChunkSize) : size_t(blockSize);
+    memoryMonitor(chunkSize);
+    char* ptr = (char*) (huge ? os_malloc_huge(chunkSize) : alignedMalloc(chunkSize,blockSize));
+    chunks.push_back(Chunk(ptr,chunkSize,huge));
+    bytes += chunkSize;
+    for (size_t i=0; i<chunkSize; i+=blockSize)
+      push(ptr+i);
+  }
+
+  void Alloc::trimIdle() 
+  {
+    if (trimThreshold && size()-used() > trimThreshold) 
+      clear();
   }
 
   void Alloc::clear()
   {
     Lock<MutexSys> lock(mutex);
-    for (size_t i=0; i<blocks.size(); i++)
-      alignedFree(blocks[i]);
-    blocks.clear();
+
+    /* collect all free blocks */
+    std::vector<char*> blocks;
+    while (void* ptr = pop()) blocks.push_back((char*)ptr);
+    std::sort(blocks.begin(),blocks.end());
+    std::sort(chunks.begin(),chunks.end());
+
+    /* concurrent pops may still read from the collected blocks */
+    while (readers) __pause();
+
+    /* release chunks whose blocks are all free, the pages of huge
+     * chunks can only get returned to the OS as a whole */
+    std::vector<std::pair<size_t,size_t> > partial;
+    size_t j=0, k=0;
+    for (size_t i=0; i<chunks.size(); i++) 
+    {
+      const Chunk& chunk = chunks[i];
+      const size_t begin = j;
+      while (j<blocks.size() && blocks[j] < chunk.ptr+chunk.bytes) j++;
+      if (j-begin == chunk.bytes/blockSize) {
+        if (chunk.huge) os_free(chunk.ptr,chunk.bytes);
+        else            alignedFree(chunk.ptr);
+        bytes -= chunk.bytes;
+        memoryMonitor(-ssize_t(chunk.bytes));
+        continue;
+      }
+      if (j > begin) partial.push_back(std::make_pair(j-begin,begin));
+      chunks[k++] = chunk;
+    }
+    chunks.resize(k,Chunk(NULL,0,false));
+
+    /* the free blocks of the fullest chunks get handed out first, such
+     * that the emptier chunks can become free and get released later */
+    std::sort(partial.rbegin(),partial.rend());
+    for (size_t i=0; i<partial.size(); i++)
+      for (size_t b=partial[i].second; b<partial[i].second+partial[i].first; b++)
+        push(blocks[b]);
   }
   
   void* Alloc::malloc() 
   {
-    Lock<MutexSys> lock(mutex);
-    if (blocks.size()) {
-      void* ptr = blocks.back();
-      blocks.pop_back();
-      return ptr;
+    while (true) {
+      if (void* ptr = pop()) return ptr;
+      refill();
     }
-    return alignedMalloc(blockSize,64);
   }
   
-  void Alloc::free(void* ptr) 
-  {
-    Lock<MutexSys> lock(mutex);
-    blocks.push_back(ptr);
+  void Alloc::free(void* ptr) {
+    push(ptr);
   }
 }
-
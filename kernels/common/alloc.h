@@ -20,15 +20,30 @@
 #include "sys/sync/mutex.h"
 #include "sys/taskscheduler.h"
 #include "math/math.h"
+#include "embree2/rtcore.h"
 
 #include <vector>
 
 namespace embree
 {
+  /*! memory monitor callback of the application, NULL if none is set */
+  extern RTC_MEMORY_MONITOR_FUNCTION g_memory_monitor_function;
+
+  /*! reports allocated (positive) or released (negative) bytes to the
+   *  memory monitor. A build sets a rejection counter as task context,
+   *  rejected allocations proceed and are counted there until the build
+   *  stops at its next safe point. */
+  void memoryMonitor(ssize_t bytes);
+
+  /*! returns true if the memory monitor rejected an allocation of the current build */
+  bool memoryMonitorRejected();
+
   /*! Global memory pool. Node, triangle, and intermediary build data
       is allocated from this memory pool and returned to it. The pool
-      does not return memory to the operating system unless the clear function
-      is called. */
+      does not return memory to the operating system unless the clear
+      function is called. Free blocks are kept in a lock-free stack, memory is
+      requested from the operating system in chunks of one or more
+      blocks. */
   class Alloc
   {
   public:
@@ -37,10 +52,19 @@ namespace embree
     //enum { blockSize = 512*4096 };
     enum { blockSize = 16*4096 };
     //enum { blockSize = 4*4096 };
+
+    /*! Size of chunks requested from the operating system when huge pages are enabled. */
+    enum { hugeChunkSize = 2*1024*1024 };
     
     /*! single allocator object */
     static Alloc global;
 
+    /*! backs memory blocks and large BVH allocations with 2MB huge pages */
+    static bool hugePages;
+
+    /*! number of free bytes in the pool above which the pool gets trimmed after builds, 0 disables automatic trimming */
+    static size_t trimThreshold;
+
     /*! Allocator default construction. */
     Alloc ();
 
@@ -49,19 +73,50 @@ namespace embree
 
     /*! returns size of memory pool */
     size_t size() const;
+
+    /*! returns number of bytes of the pool handed out to allocators */
+    size_t used() const;
     
-    /*! frees all available memory */
+    /*! frees all chunks whose blocks are all free */
     void clear();
+
+    /*! clears the pool if its free memory exceeds the trim threshold */
+    void trimIdle();
     
     /*! allocates a memory block */
     void* malloc();
     
     /*! frees a memory block */
     void free(void* ptr);
+
+  private:
+
+    /*! pushes a block onto the stack of free blocks */
+    void push(void* ptr);
+
+    /*! pops a block from the stack of free blocks, returns NULL if the stack is empty */
+    void* pop();
+
+    /*! requests a new chunk of blocks from the operating system */
+    void refill();
+
+    /*! chunk of memory requested from the operating system */
+    struct Chunk 
+    {
+      Chunk (char* ptr, size_t bytes, bool huge) : ptr(ptr), bytes(bytes), huge(huge) {}
+      bool operator< (const Chunk& other) const { return ptr < other.ptr; }
+      char* ptr;     //!< start of the chunk, aligned to the block size
+      size_t bytes;  //!< size of the chunk
+      bool huge;     //!< set if the chunk got allocated with os_malloc_huge
+    };
     
   private:
-    MutexSys mutex;                 //<! Mutex to protect access to blocks vector
-    std::vector<void*> blocks;      //<! list of available memory blocks
+    volatile atomic_t head;         //<! top of the stack of free blocks, the lower bits store a tag against the ABA problem
+    volatile atomic_t readers;      //<! number of threads currently popping blocks
+    volatile atomic_t freeBlocks;   //<! number of blocks on the stack of free blocks
+    MutexSys mutex;                 //<! Mutex to protect access to the chunks vector
+    std::vector<Chunk> chunks;      //<! all chunks of the pool
+    size_t bytes;                   //<! size of all chunks
   };
 
   /*! Base class for a each memory allocator. Allocates from blocks of the 
@@ -71,7 +126,7 @@ namespace embree
   public:
 
     /*! Default constructor. */
-    AllocatorBase () : ptr(NULL), cur(0), end(0) {
+    AllocatorBase () : state(0) {
     }
     
     /*! Returns all allocated blocks to Alloc class. */
@@ -85,36 +140,45 @@ namespace embree
       for (size_t i=0; i<blocks.size(); i++) {
         Alloc::global.free(blocks[i]); 
       }
-      ptr = NULL;
-      cur = end = 0;
+      state = 0;
       blocks.resize(0);
     }
 
     /*! returns number of bytes allocated */
-    size_t bytes () {
+    size_t bytes () const {
       return blocks.size() * Alloc::blockSize;
     }
 
-    /*! Allocates some number of bytes. */
+    /*! Allocates some number of bytes. Lock-free unless the current block is full. */
     void* malloc(size_t bytes) 
     {
-      Lock<MutexSys> lock(mutex);
-      cur += bytes;
-      if (cur <= end) return &ptr[cur - bytes];
-      ptr = (char*) Alloc::global.malloc();
-      blocks.push_back(ptr);
-      cur = 0;
-      end = Alloc::blockSize;
+      bytes = (bytes+granularity-1) & ~size_t(granularity-1);
       assert(bytes<=Alloc::blockSize);
-      cur += bytes;
-      return &ptr[cur - bytes];
+      while (true)
+      {
+        /* bump the offset inside the current block */
+        const atomic_t s = state;
+        char* ptr = (char*) (s & ~atomic_t(Alloc::blockSize-1));
+        const size_t cur = size_t(s & atomic_t(Alloc::blockSize-1))*granularity;
+        if (likely(ptr != NULL && cur+bytes <= Alloc::blockSize)) {
+          if (atomic_cmpxchg(&state,s,s+atomic_t(bytes/granularity)) == s) return ptr+cur;
+          continue;
+        }
+
+        /* only one thread fetches the next block */
+        Lock<MutexSys> lock(mutex);
+        if (state != s) continue;
+        char* block = (char*) Alloc::global.malloc();
+        blocks.push_back(block);
+        state = (atomic_t) block;
+      }
     }
     
   private:
-    MutexSys mutex;                  //!< mutex to protect access to this class
-    char*  ptr;                      //!< pointer to memory block
-    size_t cur;                      //!< Current location of the allocator.
-    size_t end;                      //!< End of the memory block.
+    enum { granularity = 16 };       //!< allocations are rounded to multiples of this size
+
+    MutexSys mutex;                  //!< mutex to protect fetching new blocks
+    volatile atomic_t state;         //!< pointer to the current memory block, the lower bits store the used bytes in units of granularity
     std::vector<void*> blocks;       //!< available memory blocks
   };
 
@@ -253,7 +317,7 @@ namespace embree
 
     /*! Allocator default construction. */
     LinearAllocatorPerThread () 
-      : ptr(NULL), cur(0), end(0), bytesAllocated(0)
+      : ptr(NULL), cur(0), end(0), bytesAllocated(0), bytesReported(0)
     {
       size_t numThreads = getNumberOfLogicalThreads();
       thread = new ThreadAllocator[numThreads];
@@ -263,9 +327,8 @@ namespace embree
 
     /*! Allocator destructor. */
     ~LinearAllocatorPerThread() {
+      release();
       delete[] thread; thread = NULL;
-      if (ptr) os_free(ptr,end); ptr = NULL;
-      cur = end = 0;
     }
 
     /*! Return pointer to start of memory region */
@@ -282,6 +345,9 @@ namespace embree
     /*! clears the allocator */
     void clear () 
     {
+      const size_t bytesMonitored = bytesReported ? bytesReported : size_t(cur);
+      if (bytesMonitored) memoryMonitor(-ssize_t(bytesMonitored));
+      bytesReported = 0;
       cur = 0;
       const size_t numThreads = getNumberOfLogicalThreads();
       for (size_t i=0; i<numThreads; i++) 
@@ -297,6 +363,7 @@ namespace embree
       if (bytes != size_t(end)) {
         if (ptr) os_free(ptr,end);
         ptr = (char*) os_reserve(bytes);
+        if (Alloc::hugePages) os_advise_huge(ptr,bytes);
         end = bytes;
       }
     }
@@ -313,6 +380,7 @@ namespace embree
         bytesAllocated = bytesAllocate;
         if (ptr) os_free(ptr,end);
         ptr = (char*) os_reserve(bytesReserved);
+        if (Alloc::hugePages) os_advise_huge(ptr,bytesReserved);
         os_commit(ptr,bytesAllocated);
         //memset(ptr,0,bytesAllocated);
         end = bytesReserved;
@@ -327,7 +395,44 @@ namespace embree
         if (ptr) os_free(ptr,end);
         ptr = (char*) os_malloc(bytes);
         end = bytes;
+        bytesAllocated = bytes;
       }
+
+      /* the whole block is reported once, allocations from it do not call the memory monitor */
+      memoryMonitor(bytes);
+      bytesReported = bytes;
+    }
+
+    /*! Allocates memory directly from the memory region without
+     *  going through the per thread blocks. Consecutive allocations of
+     *  a single thread are adjacent up to alignment. */
+    __forceinline void* malloc_linear(size_t bytes, size_t align = 16) 
+    {
+      cur += (align - size_t(cur)) & (align-1);
+      return malloc(bytes);
+    }
+
+    /*! returns all memory of the allocator to the operating system */
+    void release () 
+    {
+      clear();
+      if (ptr) os_free(ptr,end); ptr = NULL;
+      end = bytesAllocated = 0;
+    }
+
+    /*! exchanges the memory regions of two allocators */
+    void swap (LinearAllocatorPerThread& other)
+    {
+      const size_t numThreads = getNumberOfLogicalThreads();
+      for (size_t i=0; i<numThreads; i++) {
+        thread[i].clear();
+        other.thread[i].clear();
+      }
+      std::swap(ptr,other.ptr);
+      std::swap(cur,other.cur);
+      std::swap(end,other.end);
+      std::swap(bytesAllocated,other.bytesAllocated);
+      std::swap(bytesReported,other.bytesReported);
     }
 
     /*! returns number of committed memory */
@@ -337,6 +442,10 @@ namespace embree
 
     void shrink () {
       if (ptr == NULL) return;
+      if (bytesReported) {
+        memoryMonitor(-ssize_t(end-cur));
+        bytesReported = cur;
+      }
       os_shrink(ptr,cur,end);
       end = cur;
       bytesAllocated = cur;
@@ -347,6 +456,7 @@ namespace embree
     /*! Allocates some number of bytes. */
     void* malloc(size_t bytes) 
     {
+      if (unlikely(g_memory_monitor_function != NULL) && bytesReported == 0) memoryMonitor(bytes);
       ssize_t i = atomic_add(&cur,bytes);
       if (unlikely(i > end)) throw std::runtime_error("build out of memory");
       void* p = &ptr[i];
@@ -361,6 +471,7 @@ namespace embree
     atomic_t cur;              //!< Current location of the allocator.
     atomic_t end;              //!< End of the memory block.
     atomic_t bytesAllocated;
+    size_t bytesReported;      //!< size of a block reported up front to the memory monitor
   };
 
   class __aligned(64) GlobalAllocator
@@ -0,0 +1,203 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "accel.h"
+#include <deque>
+
+namespace embree
+{
+  /*! Writes BVHs to a stream and relocates them inside a mapped
+   *  file. Nodes and leaves are written in breadth first order, child
+   *  references get stored as offsets relative to the header. Only
+   *  primitive types that do not reference the geometry are
+   *  supported. */
+  template<typename BVH>
+    class BVHSerializer
+  {
+    typedef typename BVH::Node Node;
+    typedef typename BVH::NodeRef NodeRef;
+
+    /*! alignment of nodes inside the file */
+    static const size_t nodeAlignment = 64;
+
+  public:
+
+    /*! writes the BVH to the stream */
+    static bool store(const BVH* bvh, const char* name, std::ostream& out)
+    {
+      /* primitives have to be self contained and two level BVHs are not supported */
+      if (bvh->primTy.needVertices || bvh->primTy.name == "object") 
+        return false;
+      if (!bvh->objects.empty())
+        return false;
+
+      const std::string type = std::string(name) + "<" + bvh->primTy.name + ">";
+      const size_t leafAlignment = getLeafAlignment(bvh);
+
+      /* reserve space for header */
+      AccelFileHeader::align(out);
+      const std::streampos begin = out.tellp();
+      AccelFileHeader header; 
+      memset(&header,0,sizeof(header));
+      out.write((char*)&header,sizeof(header));
+
+      /* write nodes and leaves in the order their offsets got assigned */
+      size_t offset = sizeof(AccelFileHeader), written = sizeof(AccelFileHeader);
+      std::deque<std::pair<NodeRef,size_t> > queue;
+      header.root = BVH::emptyNode;
+      if (bvh->root != BVH::emptyNode) {
+        header.root = allocate(bvh,bvh->root,offset,leafAlignment);
+        queue.push_back(std::make_pair(bvh->root,size_t(header.root)));
+      }
+
+      while (!queue.empty())
+      {
+        NodeRef ref = queue.front().first;
+        const size_t ofs = queue.front().second & ~BVH::align_mask;
+        queue.pop_front();
+        pad(out,written,ofs);
+
+        if (ref.isNode()) 
+        {
+          Node node = *ref.node();
+          for (size_t c=0; c<BVH::N; c++) {
+            const NodeRef child = node.child(c);
+            if (child == BVH::emptyNode) continue;
+            node.child(c) = allocate(bvh,child,offset,leafAlignment);
+            queue.push_back(std::make_pair(child,size_t(node.child(c))));
+          }
+          out.write((char*)&node,sizeof(Node));
+          written += sizeof(Node);
+        }
+        else 
+        {
+          size_t num; char* prims = ref.leaf(num);
+          out.write(prims,num*bvh->primTy.bytes);
+          written += num*bvh->primTy.bytes;
+        }
+      }
+      if (!out.good()) return false;
+
+      /* write header */
+      strncpy(header.type,type.c_str(),sizeof(header.type)-1);
+      header.bytes = written;
+      header.lower = bvh->bounds.lower;
+      header.upper = bvh->bounds.upper;
+      header.numPrimitives = bvh->numPrimitives;
+      header.numVertices = bvh->numVertices;
+      const std::streampos end = out.tellp();
+      out.seekp(begin);
+      out.write((char*)&header,sizeof(header));
+      out.seekp(end);
+      return out.good();
+    }
+
+    /*! restores the BVH from a mapped file */
+    static bool load(BVH* bvh, const char* name, char*& ptr, char* end)
+    {
+      char* base = AccelFileHeader::align(ptr);
+      if (base+sizeof(AccelFileHeader) > end) return false;
+      const AccelFileHeader* header = (const AccelFileHeader*) base;
+
+      /* verify type and size of stored BVH */
+      const std::string type = std::string(name) + "<" + bvh->primTy.name + ">";
+      if (strncmp(header->type,type.c_str(),sizeof(header->type)) != 0) return false;
+      if (header->bytes < (int64)sizeof(AccelFileHeader) || header->bytes > end-base) return false;
+
+      /* relocate all references */
+      NodeRef root = size_t(header->root);
+      if (!relocate(bvh,root,base,header->bytes)) return false;
+
+      bvh->root = root;
+      bvh->bounds = BBox3fa(header->lower,header->upper);
+      bvh->numPrimitives = header->numPrimitives;
+      bvh->numVertices = header->numVertices;
+      ptr = base+header->bytes;
+      return true;
+    }
+
+  private:
+
+    /*! primitive blocks keep the largest power of two alignment of their size */
+    static size_t getLeafAlignment(const BVH* bvh) 
+    {
+      size_t align = size_t(1) << BVH::alignment;
+      while (align < nodeAlignment && bvh->primTy.bytes % (2*align) == 0) align *= 2;
+      return align;
+    }
+
+    /*! assigns the file offset of a node or leaf */
+    static NodeRef allocate(const BVH* bvh, NodeRef ref, size_t& offset, size_t leafAlignment)
+    {
+      if (ref.isNode()) {
+        offset = (offset+nodeAlignment-1) & ~(nodeAlignment-1);
+        const size_t ofs = offset;
+        offset += sizeof(Node);
+        return ofs | (ref & BVH::align_mask);
+      } 
+      size_t num; ref.leaf(num);
+      offset = (offset+leafAlignment-1) & ~(leafAlignment-1);
+      const size_t ofs = offset;
+      offset += num*bvh->primTy.bytes;
+      return ofs | (ref & BVH::align_mask);
+    }
+
+    /*! writes zeros until the specified offset is reached */
+    static void pad(std::ostream& out, size_t& written, size_t offset)
+    {
+      assert(written <= offset);
+      for (; written<offset; written++) out.put(0);
+    }
+
+    /*! converts an offset into a pointer, returns false for invalid offsets */
+    static bool relocate(const BVH* bvh, NodeRef& ref, char* base, size_t bytes)
+    {
+      const size_t ofs = ref & ~BVH::align_mask;
+      if (ofs < sizeof(AccelFileHeader)) return false;
+      if (ref.isNode()) {
+        if (ofs+sizeof(Node) > bytes) return false;
+      } else {
+        size_t num; ref.leaf(num);
+        if (ofs+num*bvh->primTy.bytes > bytes) return false;
+      }
+      ref = NodeRef((size_t)base + size_t(ref));
+      return true;
+    }
+
+    /*! converts all offsets of the BVH into pointers */
+    static bool relocate(BVH* bvh, NodeRef& root, char* base, size_t bytes)
+    {
+      if (root == BVH::emptyNode) return true;
+      if (!relocate((const BVH*)bvh,root,base,bytes)) return false;
+
+      std::vector<Node*> stack;
+      if (root.isNode()) stack.push_back(root.node());
+      while (!stack.empty())
+      {
+        Node* node = stack.back(); stack.pop_back();
+        for (size_t c=0; c<BVH::N; c++) {
+          NodeRef& child = node->child(c);
+          if (child == BVH::emptyNode) continue;
+          if (!relocate((const BVH*)bvh,child,base,bytes)) return false;
+          if (child.isNode()) stack.push_back(child.node());
+        }
+      }
+      return true;
+    }
+  };
+}
@@ -35,6 +35,7 @@
 
 #include "simd/simd.h"
 #include "embree2/rtcore.h"
+#include "embree2/rtcore_ray.h"
 #include "stat.h"
 
 #include <map>
@@ -51,6 +52,7 @@ namespace embree
 {
   /* global settings */
   extern size_t g_numThreads;
+  extern size_t g_numUserThreads;
   extern size_t g_verbose;
   extern std::string g_tri_accel;
   extern std::string g_tri_builder;
@@ -62,6 +64,9 @@ namespace embree
   extern int g_scene_flags;
   extern size_t g_benchmark;
   extern float g_memory_preallocation_factor;
+  extern float g_refit_rebuild_ratio;
+  extern size_t g_instance_bounds_depth;
+  extern std::string g_bvh_layout;
 
   /*! processes an error */
   void process_error(RTCError error, const char* code);
@@ -75,6 +80,8 @@ namespace embree
   __forceinline bool isCoherent  (RTCSceneFlags flags) { return flags & RTC_SCENE_COHERENT; }
   __forceinline bool isIncoherent(RTCSceneFlags flags) { return flags & RTC_SCENE_INCOHERENT; }
   __forceinline bool isHighQuality(RTCSceneFlags flags) { return flags & RTC_SCENE_HIGH_QUALITY; }
+  __forceinline bool isNumaInterleaved(RTCSceneFlags flags) { return flags & RTC_SCENE_NUMA_INTERLEAVE; }
+  __forceinline bool isNumaReplicated (RTCSceneFlags flags) { return flags & RTC_SCENE_NUMA_REPLICATE; }
 
   /*! CPU features */
   static const int SSE   = CPU_FEATURE_SSE; 
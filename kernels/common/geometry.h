@@ -84,6 +84,9 @@ namespace embree
 
     /*! Update geometry. */
     virtual void update ();
+
+    /*! Update geometry, only count elements of the specified buffer starting at first got modified. */
+    virtual void updateBufferRange (RTCBufferType type, size_t first, size_t count) { update(); }
     
     /*! Disable geometry. */
     virtual void disable ();
@@ -97,6 +100,14 @@ namespace embree
     /*! Verify the geometry */
     virtual bool verify () { return true; }
 
+    /*! Computes a hash of the geometry data, returns false if the data is not available anymore */
+    virtual bool hash (uint64& h) const { return false; }
+
+    /*! Combines a hash value with the specified data */
+    static __forceinline uint64 hashCombine (uint64 h, uint32 v) {
+      return (h ^ v) * 1099511628211ULL;
+    }
+
     /*! called if geometry is switching from disabled to enabled state */
     virtual void enabling() = 0;
 
@@ -154,11 +165,14 @@ namespace embree
     /*! instances only */
   public:
     
-    /*! Sets transformation of the instance */
-    virtual void setTransform(AffineSpace3fa& transform) {
+    /*! Sets transformation of the instance for some time step */
+    virtual void setTransform(AffineSpace3fa& transform, size_t timeStep) {
       process_error(RTC_INVALID_OPERATION,"operation not supported for this geometry"); 
     };
 
+    /*! returns true if the geometry supports setting a transformation */
+    virtual bool hasTransform() const { return false; }
+
     /*! user geometry only */
   public:
 
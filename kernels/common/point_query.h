@@ -0,0 +1,51 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "default.h"
+
+namespace embree
+{
+  /*! Closest point query. Has the same layout as RTCPointQuery. */
+  struct PointQuery
+  {
+    /*! Tests if we found some point. */
+    __forceinline operator bool() const { return geomID != -1; }
+
+    /*! squared search radius */
+    __forceinline float radius2() const { return radius*radius; }
+
+  public:
+    Vec3f p;           //!< Query point
+    float radius;      //!< Search radius
+
+    Vec3f closest;     //!< Closest point on the surface
+    int align0;
+
+    float u;           //!< Barycentric u coordinate of closest point
+    float v;           //!< Barycentric v coordinate of closest point
+    int geomID;        //!< geometry ID
+    int primID;        //!< primitive ID
+  };
+
+  /*! Outputs point query to stream. */
+  inline std::ostream& operator<<(std::ostream& cout, const PointQuery& query) {
+    return cout << "{ " << 
+      "p = " << query.p << ", radius = " << query.radius << ", closest = " << query.closest << ", " << 
+      "u = " << query.u << ", v = " << query.v << ", geomID = " << query.geomID << ", primID = " << query.primID << " }";
+  }
+}
@@ -49,6 +49,12 @@ namespace embree
     int geomID;        //!< geometry ID
     int primID;        //!< primitive ID
     int instID;        //!< instance ID
+    int instIDStack[RTC_MAX_INSTANCE_LEVELS-1]; //!< instance IDs of the nested instance levels below instID
+
+    /*! returns the instance ID of some instance level */
+    __forceinline int& instIDLevel(size_t level) { 
+      return level == 0 ? instID : instIDStack[level-1]; 
+    }
 
 #if defined(__MIC__)    
     __forceinline void update(const mic_m &m_mask,
@@ -49,6 +49,7 @@ namespace embree
     mic_i geomID;   //!< geometry ID
     mic_i primID;   //!< primitive ID
     mic_i instID;   //!< instance ID
+    mic_i instIDStack[RTC_MAX_INSTANCE_LEVELS-1]; //!< instance IDs of the nested instance levels below instID
 
     template<int PFHINT>
     __forceinline void prefetchHitData() const
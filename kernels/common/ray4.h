@@ -49,6 +49,12 @@ namespace embree
     ssei geomID;    //!< geometry ID
     ssei primID;    //!< primitive ID
     ssei instID;    //!< instance ID
+    ssei instIDStack[RTC_MAX_INSTANCE_LEVELS-1]; //!< instance IDs of the nested instance levels below instID
+
+    /*! returns the instance IDs of some instance level */
+    __forceinline ssei& instIDLevel(size_t level) { 
+      return level == 0 ? instID : instIDStack[level-1]; 
+    }
   };
 
   /*! Outputs ray to stream. */
@@ -50,6 +50,12 @@ namespace embree
     avxi geomID;    //!< geometry ID
     avxi primID;    //!< primitive ID
     avxi instID;    //!< instance ID
+    avxi instIDStack[RTC_MAX_INSTANCE_LEVELS-1]; //!< instance IDs of the nested instance levels below instID
+
+    /*! returns the instance IDs of some instance level */
+    __forceinline avxi& instIDLevel(size_t level) { 
+      return level == 0 ? instID : instIDStack[level-1]; 
+    }
   };
 
   /*! Outputs ray to stream. */
@@ -0,0 +1,303 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "raystream.h"
+#include "embree2/rtcore_ray.h"
+#include <algorithm>
+
+namespace embree
+{
+  /*! number of rays that get sorted together */
+  static const size_t RAY_STREAM_BLOCK_SIZE = 256;
+
+  /*! number of bits used per dimension to quantize ray origins */
+  static const size_t RAY_STREAM_ORIGIN_BITS = 9;
+
+  /*! Accessor for ray streams in array of structures layout. */
+  struct RayStreamAOS
+  {
+    __forceinline RayStreamAOS (RTCRay* rays, size_t stride) 
+      : ptr((char*)rays), stride(stride) {}
+
+    __forceinline RTCRay& get(size_t i) const { return *(RTCRay*)(ptr+i*stride); }
+
+    __forceinline float& orgx  (size_t i) const { return get(i).org[0]; }
+    __forceinline float& orgy  (size_t i) const { return get(i).org[1]; }
+    __forceinline float& orgz  (size_t i) const { return get(i).org[2]; }
+    __forceinline float& dirx  (size_t i) const { return get(i).dir[0]; }
+    __forceinline float& diry  (size_t i) const { return get(i).dir[1]; }
+    __forceinline float& dirz  (size_t i) const { return get(i).dir[2]; }
+    __forceinline float& tnear (size_t i) const { return get(i).tnear; }
+    __forceinline float& tfar  (size_t i) const { return get(i).tfar; }
+    __forceinline float& time  (size_t i) const { return get(i).time; }
+    __forceinline int&   mask  (size_t i) const { return get(i).mask; }
+    __forceinline float& Ngx   (size_t i) const { return get(i).Ng[0]; }
+    __forceinline float& Ngy   (size_t i) const { return get(i).Ng[1]; }
+    __forceinline float& Ngz   (size_t i) const { return get(i).Ng[2]; }
+    __forceinline float& u     (size_t i) const { return get(i).u; }
+    __forceinline float& v     (size_t i) const { return get(i).v; }
+    __forceinline int&   geomID(size_t i) const { return get(i).geomID; }
+    __forceinline int&   primID(size_t i) const { return get(i).primID; }
+    __forceinline int&   instID(size_t i) const { return get(i).instID; }
+    __forceinline int*   instIDStack(size_t i) const { return get(i).instIDStack; }
+
+  private:
+    char* ptr;
+    size_t stride;
+  };
+
+  /*! Accessor for ray streams in structure of arrays layout. */
+  struct RayStreamSOA
+  {
+    __forceinline RayStreamSOA (RTCRayNp& rays) 
+      : rays(rays) {}
+
+    __forceinline float& orgx  (size_t i) const { return rays.orgx[i]; }
+    __forceinline float& orgy  (size_t i) const { return rays.orgy[i]; }
+    __forceinline float& orgz  (size_t i) const { return rays.orgz[i]; }
+    __forceinline float& dirx  (size_t i) const { return rays.dirx[i]; }
+    __forceinline float& diry  (size_t i) const { return rays.diry[i]; }
+    __forceinline float& dirz  (size_t i) const { return rays.dirz[i]; }
+    __forceinline float& tnear (size_t i) const { return rays.tnear[i]; }
+    __forceinline float& tfar  (size_t i) const { return rays.tfar[i]; }
+    __forceinline float& time  (size_t i) const { return rays.time[i]; }
+    __forceinline int&   mask  (size_t i) const { return rays.mask[i]; }
+    __forceinline float& Ngx   (size_t i) const { return rays.Ngx[i]; }
+    __forceinline float& Ngy   (size_t i) const { return rays.Ngy[i]; }
+    __forceinline float& Ngz   (size_t i) const { return rays.Ngz[i]; }
+    __forceinline float& u     (size_t i) const { return rays.u[i]; }
+    __forceinline float& v     (size_t i) const { return rays.v[i]; }
+    __forceinline int&   geomID(size_t i) const { return rays.geomID[i]; }
+    __forceinline int&   primID(size_t i) const { return rays.primID[i]; }
+    __forceinline int&   instID(size_t i) const { return rays.instID[i]; }
+    __forceinline int*   instIDStack(size_t i) const { return NULL; } // nested instance IDs are not part of the SOA layout
+
+  private:
+    RTCRayNp& rays;
+  };
+
+  /*! copies ray i of the stream into slot k of a ray packet */
+  template<bool occlusion, typename Stream, typename RTCRayK>
+  __forceinline void gatherRay(const Stream& stream, size_t i, RTCRayK& ray, size_t k)
+  {
+    ray.orgx[k]   = stream.orgx(i);
+    ray.orgy[k]   = stream.orgy(i);
+    ray.orgz[k]   = stream.orgz(i);
+    ray.dirx[k]   = stream.dirx(i);
+    ray.diry[k]   = stream.diry(i);
+    ray.dirz[k]   = stream.dirz(i);
+    ray.tnear[k]  = stream.tnear(i);
+    ray.tfar[k]   = stream.tfar(i);
+    ray.time[k]   = stream.time(i);
+    ray.mask[k]   = stream.mask(i);
+    ray.geomID[k] = stream.geomID(i);
+    if (occlusion) return;
+    ray.Ngx[k]    = stream.Ngx(i);
+    ray.Ngy[k]    = stream.Ngy(i);
+    ray.Ngz[k]    = stream.Ngz(i);
+    ray.u[k]      = stream.u(i);
+    ray.v[k]      = stream.v(i);
+    ray.primID[k] = stream.primID(i);
+    ray.instID[k] = stream.instID(i);
+    if (const int* stack = stream.instIDStack(i))
+      for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++) ray.instIDStack[l][k] = stack[l];
+  }
+
+  /*! copies the hit data of slot k of a ray packet back into ray i of the stream */
+  template<bool occlusion, typename Stream, typename RTCRayK>
+  __forceinline void scatterHit(const Stream& stream, size_t i, const RTCRayK& ray, size_t k)
+  {
+    stream.geomID(i) = ray.geomID[k];
+    if (occlusion) return;
+    stream.tfar(i)   = ray.tfar[k];
+    stream.Ngx(i)    = ray.Ngx[k];
+    stream.Ngy(i)    = ray.Ngy[k];
+    stream.Ngz(i)    = ray.Ngz[k];
+    stream.u(i)      = ray.u[k];
+    stream.v(i)      = ray.v[k];
+    stream.primID(i) = ray.primID[k];
+    stream.instID(i) = ray.instID[k];
+    if (int* stack = stream.instIDStack(i))
+      for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++) stack[l] = ray.instIDStack[l][k];
+  }
+
+  /*! copies ray i of the stream into a single ray */
+  template<bool occlusion, typename Stream>
+  __forceinline void gatherRay(const Stream& stream, size_t i, RTCRay& ray)
+  {
+    ray.org[0] = stream.orgx(i);
+    ray.org[1] = stream.orgy(i);
+    ray.org[2] = stream.orgz(i);
+    ray.dir[0] = stream.dirx(i);
+    ray.dir[1] = stream.diry(i);
+    ray.dir[2] = stream.dirz(i);
+    ray.tnear  = stream.tnear(i);
+    ray.tfar   = stream.tfar(i);
+    ray.time   = stream.time(i);
+    ray.mask   = stream.mask(i);
+    ray.geomID = stream.geomID(i);
+    if (occlusion) return;
+    ray.Ng[0]  = stream.Ngx(i);
+    ray.Ng[1]  = stream.Ngy(i);
+    ray.Ng[2]  = stream.Ngz(i);
+    ray.u      = stream.u(i);
+    ray.v      = stream.v(i);
+    ray.primID = stream.primID(i);
+    ray.instID = stream.instID(i);
+    if (const int* stack = stream.instIDStack(i))
+      for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++) ray.instIDStack[l] = stack[l];
+  }
+
+  /*! copies the hit data of a single ray back into ray i of the stream */
+  template<bool occlusion, typename Stream>
+  __forceinline void scatterHit(const Stream& stream, size_t i, const RTCRay& ray)
+  {
+    stream.geomID(i) = ray.geomID;
+    if (occlusion) return;
+    stream.tfar(i)   = ray.tfar;
+    stream.Ngx(i)    = ray.Ng[0];
+    stream.Ngy(i)    = ray.Ng[1];
+    stream.Ngz(i)    = ray.Ng[2];
+    stream.u(i)      = ray.u;
+    stream.v(i)      = ray.v;
+    stream.primID(i) = ray.primID;
+    stream.instID(i) = ray.instID;
+    if (int* stack = stream.instIDStack(i))
+      for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++) stack[l] = ray.instIDStack[l];
+  }
+
+  /*! dispatches a ray packet to the packet kernels of the scene */
+  template<bool occlusion> __forceinline void tracePacket(Scene* scene, const void* valid, RTCRay4& ray) {
+    if (occlusion) scene->occluded4(valid,ray); else scene->intersect4(valid,ray);
+  }
+  template<bool occlusion> __forceinline void tracePacket(Scene* scene, const void* valid, RTCRay8& ray) {
+    if (occlusion) scene->occluded8(valid,ray); else scene->intersect8(valid,ray);
+  }
+  template<bool occlusion> __forceinline void tracePacket(Scene* scene, const void* valid, RTCRay16& ray) {
+    if (occlusion) scene->occluded16(valid,ray); else scene->intersect16(valid,ray);
+  }
+
+  /*! Sorts a block of rays by direction octant first and by the
+   *  morton code of the quantized ray origin second. The resulting
+   *  order is returned as block relative ray indices. */
+  template<typename Stream>
+  static void sortRays(Scene* scene, const Stream& stream, size_t begin, size_t N, unsigned int* order)
+  {
+    /* map scene bounds to the quantization grid */
+    const float cells = float(1 << RAY_STREAM_ORIGIN_BITS);
+    const BBox3fa bounds = scene->bounds;
+    const Vec3fa size = bounds.upper-bounds.lower;
+    const float sx = size.x > 0.0f ? cells/size.x : 0.0f;
+    const float sy = size.y > 0.0f ? cells/size.y : 0.0f;
+    const float sz = size.z > 0.0f ? cells/size.z : 0.0f;
+    const float maxCell = cells-1.0f;
+
+    uint64 keys[RAY_STREAM_BLOCK_SIZE];
+    for (size_t j=0; j<N; j++) 
+    {
+      const size_t i = begin+j;
+      const unsigned int octant = 
+        (stream.dirx(i) < 0.0f ? 1 : 0) | 
+        (stream.diry(i) < 0.0f ? 2 : 0) | 
+        (stream.dirz(i) < 0.0f ? 4 : 0);
+      const unsigned int cx = (unsigned int) clamp((stream.orgx(i)-bounds.lower.x)*sx,0.0f,maxCell);
+      const unsigned int cy = (unsigned int) clamp((stream.orgy(i)-bounds.lower.y)*sy,0.0f,maxCell);
+      const unsigned int cz = (unsigned int) clamp((stream.orgz(i)-bounds.lower.z)*sz,0.0f,maxCell);
+      const unsigned int code = (octant << (3*RAY_STREAM_ORIGIN_BITS)) | bitInterleave(cx,cy,cz);
+      keys[j] = (uint64(code) << 32) | uint64(j);
+    }
+    std::sort(keys,keys+N);
+    for (size_t j=0; j<N; j++)
+      order[j] = (unsigned int) keys[j];
+  }
+
+  /*! traces a stream of rays using packets of K rays */
+  template<bool occlusion, int K, typename RTCRayK, typename Stream>
+  static void tracePackets(Scene* scene, const Stream& stream, size_t N)
+  {
+    unsigned int order[RAY_STREAM_BLOCK_SIZE];
+    __aligned(64) int valid[K];
+    RTCRayK ray;
+
+    for (size_t begin=0; begin<N; begin+=RAY_STREAM_BLOCK_SIZE)
+    {
+      const size_t num = min(N-begin,RAY_STREAM_BLOCK_SIZE);
+      sortRays(scene,stream,begin,num,order);
+
+      for (size_t j=0; j<num; j+=K)
+      {
+        /* fill inactive slots of the last packet with a copy of the first ray */
+        const size_t active = min(num-j,size_t(K));
+        for (size_t k=0; k<K; k++) {
+          valid[k] = k < active ? -1 : 0;
+          gatherRay<occlusion>(stream,begin+order[j+(k < active ? k : 0)],ray,k);
+        }
+        tracePacket<occlusion>(scene,valid,ray);
+        for (size_t k=0; k<active; k++)
+          scatterHit<occlusion>(stream,begin+order[j+k],ray,k);
+      }
+    }
+  }
+
+  /*! traces a stream of rays one by one */
+  template<bool occlusion, typename Stream>
+  static void traceRays(Scene* scene, const Stream& stream, size_t N)
+  {
+    RTCRay ray;
+    for (size_t i=0; i<N; i++) 
+    {
+      gatherRay<occlusion>(stream,i,ray);
+      if (occlusion) scene->occluded(ray); else scene->intersect(ray);
+      scatterHit<occlusion>(stream,i,ray);
+    }
+  }
+
+  /*! selects the widest packet size enabled for the scene */
+  template<bool occlusion, typename Stream>
+  static void trace(Scene* scene, const Stream& stream, size_t N)
+  {
+    /* packet kernels not supported by the CPU have no name, disabled ones are NULL */
+    const Accel::Intersectors& intersectors = scene->intersectors;
+#if defined(__MIC__)
+    if (intersectors.intersector16 && intersectors.intersector16.intersect)
+      tracePackets<occlusion,16,RTCRay16>(scene,stream,N);
+#else
+    if (intersectors.intersector8 && intersectors.intersector8.intersect)
+      tracePackets<occlusion,8,RTCRay8>(scene,stream,N);
+    else if (intersectors.intersector4 && intersectors.intersector4.intersect)
+      tracePackets<occlusion,4,RTCRay4>(scene,stream,N);
+#endif
+    else
+      traceRays<occlusion>(scene,stream,N);
+  }
+
+  void RayStream::intersect (Scene* scene, RTCRay* rays, size_t N, size_t stride) {
+    trace<false>(scene,RayStreamAOS(rays,stride),N);
+  }
+
+  void RayStream::occluded (Scene* scene, RTCRay* rays, size_t N, size_t stride) {
+    trace<true>(scene,RayStreamAOS(rays,stride),N);
+  }
+
+  void RayStream::intersect (Scene* scene, RTCRayNp& rays, size_t N) {
+    trace<false>(scene,RayStreamSOA(rays),N);
+  }
+
+  void RayStream::occluded (Scene* scene, RTCRayNp& rays, size_t N) {
+    trace<true>(scene,RayStreamSOA(rays),N);
+  }
+}
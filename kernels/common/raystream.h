@@ -0,0 +1,42 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "common/default.h"
+#include "scene.h"
+
+namespace embree
+{
+  /*! Traces streams of rays by regrouping them into coherent ray
+   *  packets of the widest packet size enabled for the scene. */
+  class RayStream
+  {
+  public:
+
+    /*! Intersects a stream of rays in array of structures layout. */
+    static void intersect (Scene* scene, RTCRay* rays, size_t N, size_t stride);
+
+    /*! Tests occlusion for a stream of rays in array of structures layout. */
+    static void occluded (Scene* scene, RTCRay* rays, size_t N, size_t stride);
+
+    /*! Intersects a stream of rays in structure of arrays layout. */
+    static void intersect (Scene* scene, RTCRayNp& rays, size_t N);
+
+    /*! Tests occlusion for a stream of rays in structure of arrays layout. */
+    static void occluded (Scene* scene, RTCRayNp& rays, size_t N);
+  };
+}
@@ -24,6 +24,7 @@
 #include "common/alloc.h"
 #include "embree2/rtcore.h"
 #include "common/scene.h"
+#include "common/raystream.h"
 #include "sys/taskscheduler.h"
 #include "sys/thread.h"
 
@@ -83,10 +84,14 @@ namespace embree
   std::string g_hair_traverser = "default";    //!< traverser to use for hair
   double      g_hair_builder_replication_factor = 2.0f; // FIXME: add this also for triangles
   float       g_memory_preallocation_factor = 1.0f; 
+  float       g_refit_rebuild_ratio = 2.0f;   //!< rebuild refitted BVHs whose SAH cost grew by more than this factor
+  size_t      g_instance_bounds_depth = 2;    //!< number of BVH levels of the instanced scene transformed to get the instance bounds
+  std::string g_bvh_layout = "default";       //!< memory layout of BVH4s of static scenes: default, depth_first, or veb
 
   int g_scene_flags = -1;       //!< scene flags to use
   size_t g_verbose = 0;                   //!< verbosity of output
   size_t g_numThreads = 0;                //!< number of threads to use in builders
+  size_t g_numUserThreads = 0;            //!< number of application threads that join builds
   size_t g_benchmark = 0;
 
   void initSettings()
@@ -105,10 +110,16 @@ namespace embree
     g_hair_builder_replication_factor = 2.0f;
     
     g_memory_preallocation_factor = 1.0f;
+    g_refit_rebuild_ratio = 2.0f;
+    g_instance_bounds_depth = 2;
+    g_bvh_layout = "default";
+    Alloc::hugePages = false;
+    Alloc::trimThreshold = 0;
 
     g_scene_flags = -1;
     g_verbose = 0;
     g_numThreads = 0;
+    g_numUserThreads = 0;
     g_benchmark = 0;
   }
 
@@ -116,12 +127,14 @@ namespace embree
   {
     std::cout << "general:" << std::endl;
     std::cout << "  build threads = " << g_numThreads << std::endl;
+    std::cout << "  user threads  = " << g_numUserThreads << std::endl;
     std::cout << "  verbosity     = " << g_verbose << std::endl;
 
     std::cout << "triangles:" << std::endl;
     std::cout << "  accel         = " << g_tri_accel << std::endl;
     std::cout << "  builder       = " << g_tri_builder << std::endl;
     std::cout << "  traverser     = " << g_tri_traverser << std::endl;
+    std::cout << "  refit rebuild = " << g_refit_rebuild_ratio << std::endl;
 
     std::cout << "motion blur triangles:" << std::endl;
     std::cout << "  accel         = " << g_tri_accel_mb << std::endl;
@@ -134,8 +147,14 @@ namespace embree
     std::cout << "  traverser     = " << g_hair_traverser << std::endl;
     std::cout << "  replications  = " << g_hair_builder_replication_factor << std::endl;
 
-#if defined(__MIC__)
+    std::cout << "instances:" << std::endl;
+    std::cout << "  bounds depth  = " << g_instance_bounds_depth << std::endl;
+
     std::cout << "memory allocation:" << std::endl;
+    std::cout << "  huge pages    = " << Alloc::hugePages << std::endl;
+    std::cout << "  trim threshold = " << Alloc::trimThreshold/(1024*1024) << " MB" << std::endl;
+    std::cout << "  bvh layout    = " << g_bvh_layout << std::endl;
+#if defined(__MIC__)
     std::cout << "  preallocation_factor  = " << g_memory_preallocation_factor << std::endl;
 #endif
   }
@@ -242,6 +261,16 @@ namespace embree
 	    g_mutex.lock();
             return;
           }
+#endif
+        }
+        else if (tok == "user_threads" && parseSymbol(cfg,'=',pos)) 
+	{
+	  g_numUserThreads = parseInt(cfg,pos);
+#if defined(__MIC__)
+          g_mutex.unlock();
+          process_error(RTC_INVALID_OPERATION,"user threads not supported on Xeon Phi");
+          g_mutex.lock();
+          return;
 #endif
         }
         else if (tok == "isa" && parseSymbol (cfg,'=',pos)) 
@@ -282,6 +311,12 @@ namespace embree
             g_verbose = parseInt (cfg,pos);
 	else if (tok == "benchmark" && parseSymbol (cfg,'=',pos))
             g_benchmark = parseInt (cfg,pos);
+        else if (tok == "bvh_layout" && parseSymbol (cfg,'=',pos))
+            g_bvh_layout = parseIdentifier (cfg,pos);
+        else if (tok == "hugepages" && parseSymbol (cfg,'=',pos))
+            Alloc::hugePages = parseInt (cfg,pos) != 0;
+        else if (tok == "trim_threshold" && parseSymbol (cfg,'=',pos))
+            Alloc::trimThreshold = size_t(parseInt (cfg,pos))*1024*1024;
         else if (tok == "flags") {
           g_scene_flags = 0;
           if (parseSymbol (cfg,'=',pos)) {
@@ -293,6 +328,8 @@ namespace embree
               else if (flag == "coherent") g_scene_flags |= RTC_SCENE_COHERENT;
               else if (flag == "incoherent") g_scene_flags |= RTC_SCENE_INCOHERENT;
               else if (flag == "high_quality") g_scene_flags |= RTC_SCENE_HIGH_QUALITY;
+              else if (flag == "numa_interleave") g_scene_flags |= RTC_SCENE_NUMA_INTERLEAVE;
+              else if (flag == "numa_replicate") g_scene_flags |= RTC_SCENE_NUMA_REPLICATE;
               else if (flag == "robust") g_scene_flags |= RTC_SCENE_ROBUST;
             } while (parseSymbol (cfg,',',pos));
           }
@@ -302,6 +339,10 @@ namespace embree
 	    g_memory_preallocation_factor = parseFloat (cfg,pos);
 	    DBG_PRINT( g_memory_preallocation_factor );
 	  }
+        else if (tok == "refit_rebuild_ratio" && parseSymbol (cfg,'=',pos))
+          g_refit_rebuild_ratio = parseFloat (cfg,pos);
+        else if (tok == "instance_bounds_depth" && parseSymbol (cfg,'=',pos))
+          g_instance_bounds_depth = parseInt (cfg,pos);
         
       } while (findNext (cfg,',',pos));
     }
@@ -367,7 +408,8 @@ namespace embree
     if (g_verbose >= 2) 
       printSettings();
     
-    TaskScheduler::create(g_numThreads);
+    if (g_numUserThreads) TaskScheduler::create(g_numUserThreads,false);
+    else                  TaskScheduler::create(g_numThreads);
 
     CATCH_END;
   }
@@ -447,6 +489,18 @@ namespace embree
     g_error_function = func;
   }
 
+  RTCORE_API void rtcSetMemoryMonitorFunction(RTC_MEMORY_MONITOR_FUNCTION func) {
+    g_memory_monitor_function = func;
+  }
+
+  RTCORE_API void rtcTrimMemory() 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcTrimMemory);
+    Alloc::global.clear();
+    CATCH_END;
+  }
+
   RTCORE_API void rtcDebug()
   {
     Lock<MutexSys> lock(g_mutex);
@@ -473,13 +527,88 @@ namespace embree
     CATCH_BEGIN;
     TRACE(rtcCommit);
     VERIFY_HANDLE(scene);
+    if (g_numUserThreads) {
+      process_error(RTC_INVALID_OPERATION,"rtcCommitThread has to get used when user threads are enabled");
+      return;
+    }
     ((Scene*)scene)->build();
     CATCH_END;
   }
+
+  RTCORE_API void rtcCommitAsync (RTCScene scene) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcCommitAsync);
+    VERIFY_HANDLE(scene);
+    if (g_numUserThreads) {
+      process_error(RTC_INVALID_OPERATION,"rtcCommitThread has to get used when user threads are enabled");
+      return;
+    }
+    ((Scene*)scene)->buildAsync();
+    CATCH_END;
+  }
+
+  RTCORE_API void rtcCommitThread (RTCScene scene, unsigned int threadIndex, unsigned int threadCount) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcCommitThread);
+    VERIFY_HANDLE(scene);
+    if (threadCount != g_numUserThreads) {
+      process_error(RTC_INVALID_OPERATION,"thread count has to match the user_threads configuration");
+      return;
+    }
+    if (threadIndex >= threadCount) {
+      process_error(RTC_INVALID_ARGUMENT,"invalid thread index");
+      return;
+    }
+    ((Scene*)scene)->joinBuild(threadIndex,threadCount);
+    CATCH_END;
+  }
+
+  RTCORE_API void rtcWaitCommit (RTCScene scene) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcWaitCommit);
+    VERIFY_HANDLE(scene);
+    ((Scene*)scene)->waitBuild();
+    CATCH_END;
+  }
+
+  RTCORE_API bool rtcIsCommitted (RTCScene scene) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcIsCommitted);
+    VERIFY_HANDLE(scene);
+    return ((Scene*)scene)->isBuildFinished();
+    CATCH_END;
+    return false;
+  }
+
+  RTCORE_API void rtcSaveScene (RTCScene scene, const char* filename) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcSaveScene);
+    VERIFY_HANDLE(scene);
+    VERIFY_HANDLE(filename);
+    ((Scene*)scene)->store(filename);
+    CATCH_END;
+  }
+
+  RTCORE_API bool rtcLoadScene (RTCScene scene, const char* filename) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcLoadScene);
+    VERIFY_HANDLE(scene);
+    VERIFY_HANDLE(filename);
+    return ((Scene*)scene)->load(filename);
+    CATCH_END;
+    return false;
+  }
   
   RTCORE_API void rtcIntersect (RTCScene scene, RTCRay& ray) 
   {
     TRACE(rtcIntersect);
+    STAT(((Scene*)scene)->stat.enter());
     STAT3(normal.travs,1,1,1);
 #if defined(DEBUG)
     if (!((Scene*)scene)->is_build) process_error(RTC_INVALID_OPERATION,"scene got not committed");
@@ -491,6 +620,7 @@ namespace embree
   RTCORE_API void rtcIntersect4 (const void* valid, RTCScene scene, RTCRay4& ray) 
   {
     TRACE(rtcIntersect4);
+    STAT(((Scene*)scene)->stat.enter());
 #if defined(__MIC__)
     process_error(RTC_INVALID_OPERATION,"rtcIntersect4 not supported on Xeon Phi");    
 #else
@@ -508,6 +638,7 @@ namespace embree
   RTCORE_API void rtcIntersect8 (const void* valid, RTCScene scene, RTCRay8& ray) 
   {
     TRACE(rtcIntersect8);
+    STAT(((Scene*)scene)->stat.enter());
 #if defined(__MIC__)
     process_error(RTC_INVALID_OPERATION,"rtcIntersect8 not supported on Xeon Phi");                                    
 #else
@@ -525,6 +656,7 @@ namespace embree
   RTCORE_API void rtcIntersect16 (const void* valid, RTCScene scene, RTCRay16& ray) 
   {
     TRACE(rtcIntersect16);
+    STAT(((Scene*)scene)->stat.enter());
 #if !defined(__MIC__)
     process_error(RTC_INVALID_OPERATION,"rtcIntersect16 only supported on Xeon Phi");
 #else
@@ -539,9 +671,31 @@ namespace embree
 #endif
   }
   
+  RTCORE_API void rtcIntersectN (RTCScene scene, RTCRay* rays, size_t N, size_t stride) 
+  {
+    TRACE(rtcIntersectN);
+    STAT(((Scene*)scene)->stat.enter());
+#if defined(DEBUG)
+    if (!((Scene*)scene)->is_build) process_error(RTC_INVALID_OPERATION,"scene got not committed");
+    if (stride < sizeof(RTCRay)) process_error(RTC_INVALID_ARGUMENT,"ray stride smaller than ray size");   
+#endif
+    RayStream::intersect((Scene*)scene,rays,N,stride);
+  }
+
+  RTCORE_API void rtcIntersectNp (RTCScene scene, RTCRayNp& rays, size_t N) 
+  {
+    TRACE(rtcIntersectNp);
+    STAT(((Scene*)scene)->stat.enter());
+#if defined(DEBUG)
+    if (!((Scene*)scene)->is_build) process_error(RTC_INVALID_OPERATION,"scene got not committed");
+#endif
+    RayStream::intersect((Scene*)scene,rays,N);
+  }
+  
   RTCORE_API void rtcOccluded (RTCScene scene, RTCRay& ray) 
   {
     TRACE(rtcOccluded);
+    STAT(((Scene*)scene)->stat.enter());
     STAT3(shadow.travs,1,1,1);
 #if defined(DEBUG)
     if (!((Scene*)scene)->is_build) process_error(RTC_INVALID_OPERATION,"scene got not committed");
@@ -553,6 +707,7 @@ namespace embree
   RTCORE_API void rtcOccluded4 (const void* valid, RTCScene scene, RTCRay4& ray) 
   {
     TRACE(rtcOccluded4);
+    STAT(((Scene*)scene)->stat.enter());
 #if defined(__MIC__)
     process_error(RTC_INVALID_OPERATION,"rtcOccluded4 not supported on Xeon Phi");
 #else
@@ -570,6 +725,7 @@ namespace embree
   RTCORE_API void rtcOccluded8 (const void* valid, RTCScene scene, RTCRay8& ray) 
   {
     TRACE(rtcOccluded8);
+    STAT(((Scene*)scene)->stat.enter());
 #if defined(__MIC__)
     process_error(RTC_INVALID_OPERATION,"rtcOccluded8 not supported on Xeon Phi");
 #else
@@ -587,6 +743,7 @@ namespace embree
   RTCORE_API void rtcOccluded16 (const void* valid, RTCScene scene, RTCRay16& ray) 
   {
     TRACE(rtcOccluded16);
+    STAT(((Scene*)scene)->stat.enter());
 #if !defined(__MIC__)
     process_error(RTC_INVALID_OPERATION,"rtcOccluded16 only supported on Xeon Phi");
 #else
@@ -601,6 +758,107 @@ namespace embree
 #endif
   }
   
+  RTCORE_API void rtcOccludedN (RTCScene scene, RTCRay* rays, size_t N, size_t stride) 
+  {
+    TRACE(rtcOccludedN);
+    STAT(((Scene*)scene)->stat.enter());
+#if defined(DEBUG)
+    if (!((Scene*)scene)->is_build) process_error(RTC_INVALID_OPERATION,"scene got not committed");
+    if (stride < sizeof(RTCRay)) process_error(RTC_INVALID_ARGUMENT,"ray stride smaller than ray size");   
+#endif
+    RayStream::occluded((Scene*)scene,rays,N,stride);
+  }
+
+  RTCORE_API void rtcOccludedNp (RTCScene scene, RTCRayNp& rays, size_t N) 
+  {
+    TRACE(rtcOccludedNp);
+    STAT(((Scene*)scene)->stat.enter());
+#if defined(DEBUG)
+    if (!((Scene*)scene)->is_build) process_error(RTC_INVALID_OPERATION,"scene got not committed");
+#endif
+    RayStream::occluded((Scene*)scene,rays,N);
+  }
+  
+  RTCORE_API void rtcPointQuery (RTCScene scene, RTCPointQuery& query) 
+  {
+    TRACE(rtcPointQuery);
+    STAT(((Scene*)scene)->stat.enter());
+#if defined(DEBUG)
+    if (!((Scene*)scene)->is_build) process_error(RTC_INVALID_OPERATION,"scene got not committed");
+#endif
+    if (!((Scene*)scene)->pointQuery(query))
+      process_error(RTC_INVALID_OPERATION,"point queries not supported by the acceleration structures of the scene");
+  }
+
+#if defined(__USE_STAT_COUNTERS__)
+  static void copyStatistics(RTCTraversalStatistics& dst, const Stat::Counters::Rays& src)
+  {
+    dst.rays     = src.travs;
+    dst.nodes    = src.trav_nodes;
+    dst.leaves   = src.trav_leaves;
+    dst.prims    = src.trav_prims;
+    dst.primHits = src.trav_prim_hits;
+  }
+#endif
+
+  RTCORE_API void rtcGetStatistics (RTCScene scene, RTCStatistics& stats) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcGetStatistics);
+    VERIFY_HANDLE(scene);
+    memset(&stats,0,sizeof(RTCStatistics));
+#if defined(__USE_STAT_COUNTERS__)
+    Stat::Counters cntrs;
+    ((Scene*)scene)->stat.gather(cntrs);
+    copyStatistics(stats.normal,cntrs.active.normal);
+    copyStatistics(stats.shadow,cntrs.active.shadow);
+#else
+    process_error(RTC_INVALID_OPERATION,"embree got compiled without RTCORE_STAT_COUNTERS");
+#endif
+    CATCH_END;
+  }
+
+  RTCORE_API void rtcResetStatistics (RTCScene scene) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcResetStatistics);
+    VERIFY_HANDLE(scene);
+#if defined(__USE_STAT_COUNTERS__)
+    ((Scene*)scene)->stat.reset();
+#else
+    process_error(RTC_INVALID_OPERATION,"embree got compiled without RTCORE_STAT_COUNTERS");
+#endif
+    CATCH_END;
+  }
+  
+  RTCORE_API void rtcGetBounds (RTCScene scene, RTCBounds& bounds_o) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcGetBounds);
+    VERIFY_HANDLE(scene);
+    const BBox3fa bounds = ((Scene*)scene)->bounds;
+    bounds_o.lower_x = bounds.lower.x;
+    bounds_o.lower_y = bounds.lower.y;
+    bounds_o.lower_z = bounds.lower.z;
+    bounds_o.align0  = 0;
+    bounds_o.upper_x = bounds.upper.x;
+    bounds_o.upper_y = bounds.upper.y;
+    bounds_o.upper_z = bounds.upper.z;
+    bounds_o.align1  = 0;
+    CATCH_END;
+  }
+  
+  RTCORE_API void rtcGetMemoryStats (RTCScene scene, RTCMemoryStats& stats) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcGetMemoryStats);
+    memset(&stats,0,sizeof(RTCMemoryStats));
+    stats.poolBytes = Alloc::global.size();
+    stats.poolUsedBytes = Alloc::global.used();
+    if (scene) stats.sceneBytes = ((Scene*)scene)->accels.bytesAllocated();
+    CATCH_END;
+  }
+  
   RTCORE_API void rtcDeleteScene (RTCScene scene) 
   {
     CATCH_BEGIN;
@@ -616,19 +874,25 @@ namespace embree
     TRACE(rtcNewInstance);
     VERIFY_HANDLE(target);
     VERIFY_HANDLE(source);
-    return ((Scene*) target)->newInstance((Scene*) source);
+    return ((Scene*) target)->newInstance((Scene*) source,1);
     CATCH_END;
     return -1;
   }
 
-  RTCORE_API void rtcSetTransform (RTCScene scene, unsigned geomID, RTCMatrixType layout, const float* xfm) 
+  RTCORE_API unsigned rtcNewInstance2 (RTCScene target, RTCScene source, size_t numTimeSteps) 
   {
     CATCH_BEGIN;
-    TRACE(rtcSetTransform);
-    VERIFY_HANDLE(scene);
-    VERIFY_GEOMID(geomID);
-    VERIFY_HANDLE(xfm);
+    TRACE(rtcNewInstance2);
+    VERIFY_HANDLE(target);
+    VERIFY_HANDLE(source);
+    return ((Scene*) target)->newInstance((Scene*) source,numTimeSteps);
+    CATCH_END;
+    return -1;
+  }
 
+  /*! converts a transformation matrix of the specified layout */
+  static AffineSpace3fa convertTransform(RTCMatrixType layout, const float* xfm)
+  {
     AffineSpace3fa transform = one;
     switch (layout) 
     {
@@ -657,8 +921,60 @@ namespace embree
       ERROR("Unknown matrix type");
       break;
     }
-    ((Scene*) scene)->get_locked(geomID)->setTransform(transform);
+    return transform;
+  }
+
+  RTCORE_API void rtcSetTransform (RTCScene scene, unsigned geomID, RTCMatrixType layout, const float* xfm) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcSetTransform);
+    VERIFY_HANDLE(scene);
+    VERIFY_GEOMID(geomID);
+    VERIFY_HANDLE(xfm);
+    AffineSpace3fa transform = convertTransform(layout,xfm);
+    ((Scene*) scene)->get_locked(geomID)->setTransform(transform,0);
+    CATCH_END;
+  }
 
+  RTCORE_API void rtcSetTransform2 (RTCScene scene, unsigned geomID, RTCMatrixType layout, const float* xfm, size_t timeStep) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcSetTransform2);
+    VERIFY_HANDLE(scene);
+    VERIFY_GEOMID(geomID);
+    VERIFY_HANDLE(xfm);
+    AffineSpace3fa transform = convertTransform(layout,xfm);
+    ((Scene*) scene)->get_locked(geomID)->setTransform(transform,timeStep);
+    CATCH_END;
+  }
+
+  RTCORE_API void rtcSetTransforms (RTCScene scene, const unsigned* geomIDs, size_t numTransforms, RTCMatrixType layout, const float* xfms) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcSetTransforms);
+    VERIFY_HANDLE(scene);
+    VERIFY_HANDLE(geomIDs);
+    VERIFY_HANDLE(xfms);
+    Scene* s = (Scene*) scene;
+    const size_t numFloats = layout == RTC_MATRIX_COLUMN_MAJOR_ALIGNED16 ? 16 : 12;
+    Lock<AtomicMutex> lock(s->geometriesMutex);
+
+    /* validate the whole batch first, such that an error leaves all transforms unchanged */
+    for (size_t i=0; i<numTransforms; i++) 
+    {
+      if (geomIDs[i] >= s->size() || s->get(geomIDs[i]) == NULL) {
+        process_error(RTC_INVALID_ARGUMENT,"invalid geometry ID");
+        return;
+      }
+      if (!s->get(geomIDs[i])->hasTransform()) {
+        process_error(RTC_INVALID_OPERATION,"operation not supported for this geometry");
+        return;
+      }
+    }
+    for (size_t i=0; i<numTransforms; i++) {
+      AffineSpace3fa transform = convertTransform(layout,xfms+i*numFloats);
+      s->get(geomIDs[i])->setTransform(transform,0);
+    }
     CATCH_END;
   }
 
@@ -753,6 +1069,16 @@ namespace embree
     CATCH_END;
   }
 
+  RTCORE_API void rtcUpdateBufferRange (RTCScene scene, unsigned geomID, RTCBufferType type, size_t first, size_t count) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcUpdateBufferRange);
+    VERIFY_HANDLE(scene);
+    VERIFY_GEOMID(geomID);
+    ((Scene*)scene)->get_locked(geomID)->updateBufferRange(type,first,count);
+    CATCH_END;
+  }
+
   RTCORE_API void rtcDisable (RTCScene scene, unsigned geomID) 
   {
     CATCH_BEGIN;
@@ -59,6 +59,14 @@ namespace embree
     return rtcSetErrorFunction((RTC_ERROR_FUNCTION)f);
   }
   
+  extern "C" void ispcSetMemoryMonitorFunction(void* f) {
+    return rtcSetMemoryMonitorFunction((RTC_MEMORY_MONITOR_FUNCTION)f);
+  }
+
+  extern "C" void ispcTrimMemory() {
+    rtcTrimMemory();
+  }
+
   extern "C" void ispcDebug() {
     rtcDebug();
   }
@@ -72,6 +80,26 @@ namespace embree
   extern "C" void ispcCommitScene (RTCScene scene) {
     return rtcCommit(scene);
   }
+
+  extern "C" void ispcCommitSceneAsync (RTCScene scene) {
+    return rtcCommitAsync(scene);
+  }
+
+  extern "C" void ispcWaitCommitScene (RTCScene scene) {
+    return rtcWaitCommit(scene);
+  }
+
+  extern "C" bool ispcIsSceneCommitted (RTCScene scene) {
+    return rtcIsCommitted(scene);
+  }
+
+  extern "C" void ispcSaveScene (RTCScene scene, const char* filename) {
+    rtcSaveScene(scene,filename);
+  }
+
+  extern "C" bool ispcLoadScene (RTCScene scene, const char* filename) {
+    return rtcLoadScene(scene,filename);
+  }
   
   extern "C" void ispcIntersect1 (RTCScene scene, RTCRay& ray) {
     rtcIntersect(scene,ray);
@@ -105,6 +133,26 @@ namespace embree
     rtcOccluded16(valid,scene,ray);
   }
   
+  extern "C" void ispcPointQuery1 (RTCScene scene, RTCPointQuery& query) {
+    rtcPointQuery(scene,query);
+  }
+
+  extern "C" void ispcGetStatistics (RTCScene scene, RTCStatistics& stats) {
+    rtcGetStatistics(scene,stats);
+  }
+
+  extern "C" void ispcResetStatistics (RTCScene scene) {
+    rtcResetStatistics(scene);
+  }
+
+  extern "C" void ispcGetMemoryStats (RTCScene scene, RTCMemoryStats& stats) {
+    rtcGetMemoryStats(scene,stats);
+  }
+  
+  extern "C" void ispcGetBounds (RTCScene scene, RTCBounds& bounds_o) {
+    rtcGetBounds(scene,bounds_o);
+  }
+  
   extern "C" void ispcDeleteScene (RTCScene scene) {
     rtcDeleteScene(scene);
   }
@@ -113,9 +161,21 @@ namespace embree
     return rtcNewInstance(target,source);
   }
   
+  extern "C" unsigned ispcNewInstance2 (RTCScene target, RTCScene source, size_t numTimeSteps) {
+    return rtcNewInstance2(target,source,numTimeSteps);
+  }
+  
   extern "C" void ispcSetTransform (RTCScene scene, unsigned geomID, RTCMatrixType layout, const float* xfm) {
     return rtcSetTransform(scene,geomID,layout,xfm);
   }
+
+  extern "C" void ispcSetTransform2 (RTCScene scene, unsigned geomID, RTCMatrixType layout, const float* xfm, size_t timeStep) {
+    return rtcSetTransform2(scene,geomID,layout,xfm,timeStep);
+  }
+
+  extern "C" void ispcSetTransforms (RTCScene scene, const unsigned* geomIDs, size_t numTransforms, RTCMatrixType layout, const float* xfms) {
+    return rtcSetTransforms(scene,geomIDs,numTransforms,layout,xfms);
+  }
   
   extern "C" unsigned ispcNewUserGeometry (RTCScene scene, size_t numItems) {
     return rtcNewUserGeometry(scene,numItems);
@@ -153,6 +213,10 @@ namespace embree
     rtcUpdate(scene,geomID);
   }
   
+  extern "C" void ispcUpdateBufferRange (RTCScene scene, unsigned geomID, RTCBufferType type, size_t first, size_t count) {
+    rtcUpdateBufferRange(scene,geomID,type,first,count);
+  }
+  
   extern "C" void ispcDisable (RTCScene scene, unsigned geomID) {
     rtcDisable(scene,geomID);
   }
@@ -15,6 +15,7 @@
 // ======================================================================== //
 
 #include "scene.h"
+#include "alloc.h"
 
 #if !defined(__MIC__)
 #include "bvh4/bvh4_builder_toplevel.h" // FIXME: remove
@@ -28,18 +29,25 @@
 #include "xeonphi/bvh4hair/bvh4hair.h"
 #endif
 
+#include <fstream>
+
 namespace embree
 {
   Scene::Scene (RTCSceneFlags sflags, RTCAlgorithmFlags aflags)
-    : flags(sflags), aflags(aflags), numMappedBuffers(0), is_build(false), needTriangles(false), needVertices(false),
+    : flags(sflags), aflags(aflags), numMappedBuffers(0), buildEvent(NULL), is_build(false), is_building(false), build_rejected(false), buildRejections(0), needTriangles(false), needVertices(false),
       numTriangleMeshes(0), numTriangleMeshes2(0), numTriangles(0), numTriangles2(0), numBezierCurves(0), numBezierCurves2(0), numUserGeometries1(0), 
-      numIntersectionFilters4(0), numIntersectionFilters8(0), numIntersectionFilters16(0)
+      numIntersectionFilters4(0), numIntersectionFilters8(0), numIntersectionFilters16(0),
+      geometryHash(0), geometryHashValid(false), fileData(NULL), fileBytes(0)
   {
     if (g_scene_flags != -1)
       flags = (RTCSceneFlags) g_scene_flags;
 
     geometries.reserve(128);
+    createAccels();
+  }
 
+  void Scene::createAccels()
+  {
 #if defined(__MIC__)
     accels.add( BVH4mb::BVH4mbTriangle1ObjectSplitBinnedSAH(this) );
     accels.add( BVH4i::BVH4iVirtualGeometryBinnedSAH(this) );
@@ -117,21 +125,28 @@ namespace embree
         switch (mode) {
         case /*0b00*/ 0: 
 #if defined (__TARGET_AVX__)
-          if (has_feature(AVX2)) // on AVX machines BVH8 gives lower performance, only enable on AVX2!
+          /* on AVX machines BVH8 gives lower performance, only enable on
+           * AVX2! NUMA placement is only implemented for BVH4. */
+          if (has_feature(AVX2) && !isNumaInterleaved() && !isNumaReplicated())
 	  {
-            if (isHighQuality()) accels.add(BVH8::BVH8Triangle8SpatialSplit(this)); 
-            else                 accels.add(BVH8::BVH8Triangle8ObjectSplit(this)); 
+            if      (isHighQuality())              accels.add(BVH8::BVH8Triangle8SpatialSplit(this)); 
+            else if (g_tri_builder == "presplits") accels.add(BVH8::BVH8Triangle8PreSplit(this)); 
+            else                                   accels.add(BVH8::BVH8Triangle8ObjectSplit(this)); 
           }
           else 
 #endif
           {
-            if (isHighQuality()) accels.add(BVH4::BVH4Triangle4SpatialSplit(this));
-            else                 accels.add(BVH4::BVH4Triangle4ObjectSplit(this)); 
+            if      (isHighQuality())              accels.add(BVH4::BVH4Triangle4SpatialSplit(this));
+            else if (g_tri_builder == "presplits") accels.add(BVH4::BVH4Triangle4PreSplit(this));
+            else                                   accels.add(BVH4::BVH4Triangle4ObjectSplit(this)); 
           }
           break;
 
         case /*0b01*/ 1: accels.add(BVH4::BVH4Triangle4vObjectSplit(this)); break;
-        case /*0b10*/ 2: accels.add(BVH4::BVH4Triangle4iObjectSplit(this)); break;
+        case /*0b10*/ 2: 
+          if (has_feature(SSE42)) accels.add(BVH4::BVH4Triangle4iCompressed(this)); // compressed traversal requires SSE4.2
+          else                    accels.add(BVH4::BVH4Triangle4iObjectSplit(this)); 
+          break;
         case /*0b11*/ 3: accels.add(BVH4::BVH4Triangle4iObjectSplit(this)); break;
         }
       } 
@@ -158,6 +173,8 @@ namespace embree
     else if (g_tri_accel == "bvh4.triangle1v")        accels.add(BVH4::BVH4Triangle1v(this));
     else if (g_tri_accel == "bvh4.triangle4v")        accels.add(BVH4::BVH4Triangle4v(this));
     else if (g_tri_accel == "bvh4.triangle4i")        accels.add(BVH4::BVH4Triangle4i(this));
+    else if (g_tri_accel == "bvh4c.triangle4")        accels.add(BVH4::BVH4Triangle4Compressed(this));
+    else if (g_tri_accel == "bvh4c.triangle4i")       accels.add(BVH4::BVH4Triangle4iCompressed(this));
 #if defined (__TARGET_AVX__)
     else if (g_tri_accel == "bvh8.triangle8")         accels.add(BVH8::BVH8Triangle8(this));
 #endif
@@ -199,8 +216,10 @@ namespace embree
 
   Scene::~Scene () 
   {
+    waitBuild();
     for (size_t i=0; i<geometries.size(); i++)
       delete geometries[i];
+    if (fileData) os_unmap_file(fileData,fileBytes);
   }
 
   unsigned Scene::newUserGeometry (size_t items) 
@@ -209,8 +228,21 @@ namespace embree
     return geom->id;
   }
   
-  unsigned Scene::newInstance (Scene* scene) {
-    Geometry* geom = new Instance(this,scene);
+  unsigned Scene::newInstance (Scene* scene, size_t numTimeSteps) 
+  {
+#if defined(__MIC__)
+    if (numTimeSteps != 1) {
+      process_error(RTC_INVALID_OPERATION,"only 1 time step supported");
+      return -1;
+    }
+#else
+    if (numTimeSteps == 0 || numTimeSteps > RTC_MAX_TIME_STEPS) {
+      process_error(RTC_INVALID_OPERATION,"only 1 up to RTC_MAX_TIME_STEPS time steps supported");
+      return -1;
+    }
+#endif
+
+    Geometry* geom = new Instance(this,scene,numTimeSteps);
     return geom->id;
   }
 
@@ -221,10 +253,17 @@ namespace embree
       return -1;
     }
 
+#if defined(__MIC__)
     if (numTimeSteps == 0 || numTimeSteps > 2) {
       process_error(RTC_INVALID_OPERATION,"only 1 or 2 time steps supported");
       return -1;
     }
+#else
+    if (numTimeSteps == 0 || numTimeSteps > RTC_MAX_TIME_STEPS) {
+      process_error(RTC_INVALID_OPERATION,"only 1 up to RTC_MAX_TIME_STEPS time steps supported");
+      return -1;
+    }
+#endif
     
     Geometry* geom = new TriangleMesh(this,gflags,numTriangles,numVertices,numTimeSteps);
     return geom->id;
@@ -273,13 +312,94 @@ namespace embree
     accels.build(threadIndex,threadCount);
   }
 
-  void Scene::task_build(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event) {
-    build(threadIndex,threadCount);
+  void Scene::task_build(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event) 
+  {
+    /* the tasks of the build count the allocations the memory monitor rejects for this scene */
+    buildRejections = 0;
+    try {
+      TaskScheduler::ContextScope scope(&buildRejections);
+      build(threadIndex,threadCount);
+      finishBuild();
+    }
+    catch (std::bad_alloc&) {
+      abortBuild();
+      return;
+    }
+
+    /* return memory of the build temporaries to the OS if the pool holds too much idle memory */
+    Alloc::global.trimIdle();
+  }
+
+  void Scene::abortBuild () 
+  {
+    /* the acceleration structures get recreated to release all memory of
+     * the build, the next commit builds the scene from scratch */
+    accels.clear();
+    createAccels();
+    Alloc::global.clear();
+
+    /* the builders already marked the geometries they built as unmodified */
+    for (size_t i=0; i<geometries.size(); i++)
+      if (geometries[i] && geometries[i]->state == Geometry::ENABLED)
+        geometries[i]->state = Geometry::MODIFIED;
+
+    bounds = empty;
+    intersectors = accels.intersectors;
+    build_rejected = true;
+    is_build = false;
+    is_building = false;
   }
 
   void Scene::build () 
   {
     Lock<MutexSys> lock(mutex);
+    spawnBuild();
+    syncBuild();
+  }
+
+  void Scene::buildAsync () 
+  {
+    Lock<MutexSys> lock(mutex);
+    spawnBuild();
+  }
+
+  void Scene::waitBuild () 
+  {
+    Lock<MutexSys> lock(mutex);
+    syncBuild();
+  }
+
+  void Scene::joinBuild (size_t threadIndex, size_t threadCount) 
+  {
+    /* all threads work on the build until it finished */
+    if (threadIndex != 0) {
+      TaskScheduler::syncThreads(threadIndex,threadCount);
+      while (is_building)
+        TaskScheduler::processTask(threadIndex,threadCount);
+      TaskScheduler::syncThreads(threadIndex,threadCount);
+      return;
+    }
+
+    /* first thread spawns the build task, the other threads have to pass the barriers even if that fails */
+    Lock<MutexSys> lock(mutex);
+    try {
+      spawnBuild();
+    } catch (...) {
+      TaskScheduler::syncThreads(threadIndex,threadCount);
+      TaskScheduler::syncThreads(threadIndex,threadCount);
+      throw;
+    }
+    TaskScheduler::syncThreads(threadIndex,threadCount);
+    while (is_building)
+      TaskScheduler::processTask(threadIndex,threadCount);
+    TaskScheduler::syncThreads(threadIndex,threadCount);
+    syncBuild();
+  }
+
+  void Scene::spawnBuild () 
+  {
+    /* finish previous asynchronous build */
+    syncBuild();
 
     if (isStatic() && isBuild()) {
       process_error(RTC_INVALID_OPERATION,"static geometries cannot get committed twice");
@@ -303,19 +423,61 @@ namespace embree
     }
 #endif
 
+#if !defined(__MIC__)
+    if (numTimeSegments() > RTC_MAX_TIME_STEPS-1) {
+      process_error(RTC_INVALID_OPERATION,"time steps of motion blurred triangle meshes do not fit into RTC_MAX_TIME_STEPS common time steps");
+      return;
+    }
+#endif
+
     /* select fast code path if no intersection filter is present */
     accels.select(numIntersectionFilters4,numIntersectionFilters8,numIntersectionFilters16);
 
     /* spawn build task */
-    TaskScheduler::EventSync event;
-    new (&task) TaskScheduler::Task(&event,NULL,NULL,1,_task_build,this,"scene_build");
+    buildEvent = new TaskScheduler::EventSync;
+    is_building = true;
+    new (&task) TaskScheduler::Task(buildEvent,NULL,NULL,1,_task_build,this,"scene_build");
     TaskScheduler::addTask(-1,TaskScheduler::GLOBAL_FRONT,&task);
-    event.sync();
+  }
+
+  size_t Scene::numTimeSegments() const
+  {
+    /* least common multiple of the segment counts, so that every time step of every mesh is a segment boundary */
+    size_t numSegments = 1;
+    for (size_t i=0; i<geometries.size(); i++) 
+    {
+      const Geometry* geom = geometries[i];
+      if (geom == NULL || !geom->isEnabled() || geom->type != TRIANGLE_MESH) continue;
+      const size_t n = ((const TriangleMesh*)geom)->numTimeSteps-1;
+      if (n == 0) continue;
+      size_t a = numSegments, b = n;
+      while (b) { const size_t r = a%b; a = b; b = r; }
+      numSegments = numSegments/a*n;
+    }
+    return numSegments;
+  }
+
+  void Scene::syncBuild () 
+  {
+    if (buildEvent == NULL) return;
+    buildEvent->sync();
+    delete buildEvent; buildEvent = NULL;
 
+    if (build_rejected) {
+      build_rejected = false;
+      process_error(RTC_OUT_OF_MEMORY,"memory monitor rejected allocation");
+    }
+  }
+
+  void Scene::finishBuild () 
+  {
     /* make static geometry immutable */
     if (isStatic()) 
     {
       accels.immutable();
+      if      (isNumaReplicated ()) accels.numaDistribute(true);
+      else if (isNumaInterleaved()) accels.numaDistribute(false);
+      if (memoryMonitorRejected()) throw std::bad_alloc();
       for (size_t i=0; i<geometries.size(); i++)
         geometries[i]->immutable();
     }
@@ -357,5 +519,131 @@ namespace embree
       std::cout << "selected scene intersector" << std::endl;
       intersectors.print(2);
     }
+
+    is_building = false;
+  }
+
+  /*! header of a scene file */
+  struct SceneFileHeader
+  {
+    char magic[16];        //!< identifies scene files
+    char embree[16];       //!< Embree version that wrote the file
+    int64 version;         //!< version of the file format
+    uint64 hash;           //!< hash of the geometry
+    int64 numAccels;       //!< number of acceleration structures stored
+  };
+
+  static const char* sceneFileMagic = "embree2 scene";
+  static const int64 sceneFileVersion = 2;
+
+  bool Scene::computeHash (uint64& hash) const
+  {
+    hash = 14695981039346656037ULL;
+    for (size_t i=0; i<geometries.size(); i++) 
+    {
+      Geometry* geom = geometries[i];
+      if (geom == NULL || !geom->isEnabled()) continue;
+      hash = Geometry::hashCombine(hash,(uint32)i);
+      if (!geom->hash(hash)) return false;
+    }
+    return true;
+  }
+
+  void Scene::store (const char* fileName)
+  {
+    Lock<MutexSys> lock(mutex);
+    syncBuild();
+
+    if (!isStatic() || !isBuild()) {
+      process_error(RTC_INVALID_OPERATION,"only committed static scenes can get stored");
+      return;
+    }
+
+    /* geometry of static scenes may already got freed during commit */
+    if (!geometryHashValid) 
+    {
+      if (!computeHash(geometryHash)) {
+        process_error(RTC_INVALID_OPERATION,"geometry data not available anymore, call rtcLoadScene before committing the scene");
+        return;
+      }
+      geometryHashValid = true;
+    }
+
+    std::ofstream out(fileName,std::ios::out | std::ios::binary);
+    if (!out.is_open()) {
+      process_error(RTC_INVALID_OPERATION,"cannot open file for writing");
+      return;
+    }
+
+    SceneFileHeader header;
+    memset(&header,0,sizeof(header));
+    strncpy(header.magic,sceneFileMagic,sizeof(header.magic)-1);
+    strncpy(header.embree,__EMBREE_VERSION__,sizeof(header.embree)-1);
+    header.version = sceneFileVersion;
+    header.hash = geometryHash;
+    header.numAccels = accels.N;
+    out.write((char*)&header,sizeof(header));
+
+    const bool success = accels.store(out) && out.good();
+    out.close();
+    if (!success) {
+      std::remove(fileName);
+      process_error(RTC_INVALID_OPERATION,"acceleration structure does not support storing");
+    }
+  }
+
+  bool Scene::load (const char* fileName)
+  {
+    Lock<MutexSys> lock(mutex);
+    syncBuild();
+
+    if (!isStatic() || isBuild()) {
+      process_error(RTC_INVALID_OPERATION,"scenes can only get loaded into uncommitted static scenes");
+      return false;
+    }
+
+    if (!ready()) {
+      process_error(RTC_INVALID_OPERATION,"not all buffers are unmapped");
+      return false;
+    }
+
+    /* the hash is also required to store the scene after the commit */
+    if (!computeHash(geometryHash)) {
+      process_error(RTC_INVALID_OPERATION,"geometry cannot get hashed");
+      return false;
+    }
+    geometryHashValid = true;
+
+    /* map file copy-on-write */
+    size_t bytes = 0;
+    char* ptr = (char*) os_map_file(fileName,bytes);
+    if (ptr == NULL) return false;
+    char* end = ptr+bytes;
+
+    /* verify that the file matches the scene */
+    const SceneFileHeader* header = (const SceneFileHeader*) ptr;
+    if (bytes < sizeof(SceneFileHeader) ||
+        strncmp(header->magic,sceneFileMagic,sizeof(header->magic)) != 0 ||
+        strncmp(header->embree,__EMBREE_VERSION__,sizeof(header->embree)) != 0 ||
+        header->version != sceneFileVersion ||
+        header->hash != geometryHash ||
+        header->numAccels != accels.N)
+    {
+      os_unmap_file(ptr,bytes);
+      return false;
+    }
+
+    /* relocate acceleration structures inside the mapped file, each structure verifies its BVH and primitive type */
+    accels.select(numIntersectionFilters4,numIntersectionFilters8,numIntersectionFilters16);
+    char* cur = ptr+sizeof(SceneFileHeader);
+    if (!accels.load(cur,end)) {
+      os_unmap_file(ptr,bytes);
+      return false;
+    }
+
+    fileData = ptr; fileBytes = bytes;
+    is_building = true;
+    finishBuild();
+    return true;
   }
 }
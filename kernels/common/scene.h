@@ -36,6 +36,7 @@ namespace embree
     /*! Scene construction */
     Scene (RTCSceneFlags flags, RTCAlgorithmFlags aflags);
 
+    void createAccels();
     void createTriangleAccel();
     void createHairAccel();
 
@@ -46,7 +47,7 @@ namespace embree
     unsigned int newUserGeometry (size_t items);
 
     /*! Creates a new scene instance. */
-    unsigned int newInstance (Scene* scene);
+    unsigned int newInstance (Scene* scene, size_t numTimeSteps);
 
     /*! Creates a new triangle mesh. */
     unsigned int newTriangleMesh (RTCGeometryFlags flags, size_t maxTriangles, size_t maxVertices, size_t numTimeSteps);
@@ -57,11 +58,56 @@ namespace embree
     /*! Builds acceleration structure for the scene. */
     void build ();
 
+    /*! Starts building the acceleration structure for the scene
+     *  without waiting for the build to finish. */
+    void buildAsync ();
+
+    /*! Waits until an asynchronous build of the scene finished. */
+    void waitBuild ();
+
+    /*! Builds acceleration structure for the scene using
+     *  application threads. All threadCount threads have to call
+     *  this function. */
+    void joinBuild (size_t threadIndex, size_t threadCount);
+
     void build (size_t threadIndex, size_t threadCount);
 
+    /*! Writes the acceleration structures of the committed scene to a file. */
+    void store (const char* fileName);
+
+    /*! Restores the acceleration structures from a file written by
+     *  store. Returns false if the file does not exist or does not
+     *  match the geometry of the scene. */
+    bool load (const char* fileName);
+
+    /*! appends boxes that together enclose the committed scene */
+    size_t childBounds (size_t depth, BBox3fa* bounds_o, size_t maxBounds) const {
+      return accels.childBounds(depth,bounds_o,maxBounds);
+    }
+
     /*! build task */
     TASK_COMPLETE_FUNCTION(Scene,task_build);
     TaskScheduler::Task task;
+    TaskScheduler::EventSync* buildEvent;
+
+  private:
+
+    /*! validates the scene and spawns the build task, requires the scene mutex */
+    void spawnBuild ();
+
+    /*! waits for a spawned build task, requires the scene mutex */
+    void syncBuild ();
+
+    /*! makes the scene ready for tracing after the build */
+    void finishBuild ();
+
+    /*! drops the acceleration structures of a build the memory monitor rejected memory for */
+    void abortBuild ();
+
+    /*! computes the hash of all geometries, returns false if some geometry data is not available */
+    bool computeHash (uint64& hash) const;
+
+  public:
 
     /* return number of geometries */
     __forceinline size_t size() const { return geometries.size(); }
@@ -75,6 +121,9 @@ namespace embree
     /* determines of the scene is ready to get build */
     bool ready() { return numMappedBuffers == 0; }
 
+    /* returns the smallest number of time segments that contains the time steps of all motion blurred triangle meshes */
+    size_t numTimeSegments() const;
+
     /* get mesh by ID */
     __forceinline       Geometry* get(size_t i)       { assert(i < geometries.size()); return geometries[i]; }
     __forceinline const Geometry* get(size_t i) const { assert(i < geometries.size()); return geometries[i]; }
@@ -129,10 +178,15 @@ namespace embree
     __forceinline bool isCoherent() const { return embree::isCoherent(flags); }
     __forceinline bool isRobust() const { return embree::isRobust(flags); }
     __forceinline bool isHighQuality() const { return embree::isHighQuality(flags); }
+    __forceinline bool isNumaInterleaved() const { return embree::isNumaInterleaved(flags); }
+    __forceinline bool isNumaReplicated() const { return embree::isNumaReplicated(flags); }
 
     /* test if scene got already build */
     __forceinline bool isBuild() const { return is_build; }
 
+    /* test if an asynchronous build of the scene finished */
+    __forceinline bool isBuildFinished() const { return !is_building; }
+
   public:
     std::vector<int> usedIDs;
     std::vector<Geometry*> geometries; //!< list of all user geometries
@@ -145,8 +199,20 @@ namespace embree
     bool needTriangles;
     bool needVertices;
     bool is_build;
+    volatile bool is_building;
+    bool build_rejected;               //!< set if the memory monitor rejected an allocation of the last build
+    atomic_t buildRejections;          //!< number of allocations of the running build the memory monitor rejected
     MutexSys mutex;
     AtomicMutex geometriesMutex;
+#if defined(__USE_STAT_COUNTERS__)
+    Stat stat;                         //!< traversal statistics of this scene
+#endif
+
+  private:
+    uint64 geometryHash;               //!< geometry hash computed before the build
+    bool geometryHashValid;            //!< set if geometryHash got computed
+    void* fileData;                    //!< mapped file the acceleration structures got loaded from
+    size_t fileBytes;                  //!< size of the mapped file
 
   public:
     atomic_t numTriangleMeshes;        //!< number of enabled triangle meshes // FIXME: remove
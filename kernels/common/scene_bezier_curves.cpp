@@ -141,6 +141,32 @@ namespace embree
     if (freeVertices ) vertices[1].free();
   }
 
+  bool BezierCurves::hash (uint64& h) const
+  {
+    if (!curves.getPtr()) return false;
+    for (size_t j=0; j<numTimeSteps; j++)
+      if (!vertices[j].getPtr()) return false;
+
+    h = hashCombine(h,BEZIER_CURVES);
+    h = hashCombine(h,flags);
+    h = hashCombine(h,mask);
+    h = hashCombine(h,numTimeSteps);
+    h = hashCombine(h,(uint32)numCurves);
+    h = hashCombine(h,(uint32)numVertices);
+    for (size_t i=0; i<numCurves; i++) 
+      h = hashCombine(h,curve(i));
+    for (size_t j=0; j<numTimeSteps; j++) {
+      for (size_t i=0; i<numVertices; i++) {
+        const Vertex& v = vertices[j][i];
+        h = hashCombine(h,*(uint32*)&v.x);
+        h = hashCombine(h,*(uint32*)&v.y);
+        h = hashCombine(h,*(uint32*)&v.z);
+        h = hashCombine(h,*(uint32*)&v.r);
+      }
+    }
+    return true;
+  }
+
   bool BezierCurves::verify () 
   {
     float range = sqrtf(0.5f*FLT_MAX);
@@ -41,6 +41,7 @@ namespace embree
       void unmap(RTCBufferType type);
       void setUserData (void* ptr, bool ispc);
       void immutable ();
+      bool hash (uint64& h) const;
       bool verify ();
       
     public:
@@ -22,7 +22,8 @@ namespace embree
   TriangleMesh::TriangleMesh (Scene* parent, RTCGeometryFlags flags, size_t numTriangles, size_t numVertices, size_t numTimeSteps)
     : Geometry(parent,TRIANGLE_MESH,numTriangles,flags), 
       mask(-1), numTimeSteps(numTimeSteps),
-      numTriangles(numTriangles), numVertices(numVertices)
+      numTriangles(numTriangles), numVertices(numVertices),
+      modifiedVerticesBegin(0), modifiedVerticesEnd(numVertices)
   {
     triangles.init(numTriangles,sizeof(Triangle));
     for (size_t i=0; i<numTimeSteps; i++) {
@@ -43,6 +44,34 @@ namespace embree
     else                   { atomic_add(&parent->numTriangleMeshes2,-1); atomic_add(&parent->numTriangles2,-numTriangles); }
   }
 
+  void TriangleMesh::update () 
+  {
+    modifiedVerticesBegin = 0;
+    modifiedVerticesEnd = numVertices;
+    Geometry::update();
+  }
+
+  void TriangleMesh::updateBufferRange (RTCBufferType type, size_t first, size_t count) 
+  {
+    if (type == RTC_INDEX_BUFFER) {
+      update();
+      return;
+    }
+    if (!isVertexBuffer(type)) {
+      process_error(RTC_INVALID_ARGUMENT,"unknown buffer type");
+      return;
+    }
+    if (first > numVertices || count > numVertices-first) {
+      process_error(RTC_INVALID_ARGUMENT,"vertex range out of bounds");
+      return;
+    }
+    if (count) {
+      modifiedVerticesBegin = min(modifiedVerticesBegin,first);
+      modifiedVerticesEnd   = max(modifiedVerticesEnd,first+count);
+    }
+    Geometry::update();
+  }
+
   void TriangleMesh::setMask (unsigned mask) 
   {
     if (parent->isStatic() && parent->isBuild()) {
@@ -67,7 +96,7 @@ namespace embree
 
     /* verify that all vertex accesses are 16 bytes aligned */
 #if defined(__MIC__)
-    if (type == RTC_VERTEX_BUFFER0 || type == RTC_VERTEX_BUFFER1) {
+    if (isVertexBuffer(type)) {
       if (((size_t(ptr) + offset) & 0xF) || (stride & 0xF)) {
         process_error(RTC_INVALID_OPERATION,"data must be 16 bytes aligned");
         return;
@@ -75,28 +104,19 @@ namespace embree
     }
 #endif
 
-    switch (type) {
-    case RTC_INDEX_BUFFER  : 
+    if (type == RTC_INDEX_BUFFER) {
       triangles.set(ptr,offset,stride); 
-      break;
-    case RTC_VERTEX_BUFFER0: 
-      vertices[0].set(ptr,offset,stride); 
-      if (numVertices) {
-        /* test if array is properly padded */
-        volatile int w = *((int*)&vertices[0][numVertices-1]+3); // FIXME: is failing hard avoidable?
-      }
-      break;
-    case RTC_VERTEX_BUFFER1: 
-      vertices[1].set(ptr,offset,stride); 
+    }
+    else if (isVertexBuffer(type)) {
+      const size_t t = type - RTC_VERTEX_BUFFER0;
+      vertices[t].set(ptr,offset,stride); 
       if (numVertices) {
         /* test if array is properly padded */
-        volatile int w = *((int*)&vertices[1][numVertices-1]+3); // FIXME: is failing hard avoidable?
+        volatile int w = *((int*)&vertices[t][numVertices-1]+3); // FIXME: is failing hard avoidable?
       }
-      break;
-    default: 
-      process_error(RTC_INVALID_ARGUMENT,"unknown buffer type");
-      break;
     }
+    else 
+      process_error(RTC_INVALID_ARGUMENT,"unknown buffer type");
   }
 
   void* TriangleMesh::map(RTCBufferType type) 
@@ -106,12 +126,9 @@ namespace embree
       return NULL;
     }
 
-    switch (type) {
-    case RTC_INDEX_BUFFER  : return triangles  .map(parent->numMappedBuffers);
-    case RTC_VERTEX_BUFFER0: return vertices[0].map(parent->numMappedBuffers);
-    case RTC_VERTEX_BUFFER1: return vertices[1].map(parent->numMappedBuffers);
-    default                : process_error(RTC_INVALID_ARGUMENT,"unknown buffer type"); return NULL;
-    }
+    if      (type == RTC_INDEX_BUFFER) return triangles.map(parent->numMappedBuffers);
+    else if (isVertexBuffer(type))     return vertices[type-RTC_VERTEX_BUFFER0].map(parent->numMappedBuffers);
+    else { process_error(RTC_INVALID_ARGUMENT,"unknown buffer type"); return NULL; }
   }
 
   void TriangleMesh::unmap(RTCBufferType type) 
@@ -121,12 +138,9 @@ namespace embree
       return;
     }
 
-    switch (type) {
-    case RTC_INDEX_BUFFER  : triangles  .unmap(parent->numMappedBuffers); break;
-    case RTC_VERTEX_BUFFER0: vertices[0].unmap(parent->numMappedBuffers); break;
-    case RTC_VERTEX_BUFFER1: vertices[1].unmap(parent->numMappedBuffers); break;
-    default                : process_error(RTC_INVALID_ARGUMENT,"unknown buffer type"); break;
-    }
+    if      (type == RTC_INDEX_BUFFER) triangles.unmap(parent->numMappedBuffers);
+    else if (isVertexBuffer(type))     vertices[type-RTC_VERTEX_BUFFER0].unmap(parent->numMappedBuffers);
+    else process_error(RTC_INVALID_ARGUMENT,"unknown buffer type");
   }
 
   void TriangleMesh::setUserData (void* ptr, bool ispc) {
@@ -138,8 +152,37 @@ namespace embree
     bool freeTriangles = !parent->needTriangles;
     bool freeVertices  = !parent->needVertices;
     if (freeTriangles) triangles.free();
-    if (freeVertices ) vertices[0].free();
-    if (freeVertices ) vertices[1].free();
+    if (freeVertices ) 
+      for (size_t j=0; j<numTimeSteps; j++) vertices[j].free();
+  }
+
+  bool TriangleMesh::hash (uint64& h) const
+  {
+    if (!triangles.getPtr()) return false;
+    for (size_t j=0; j<numTimeSteps; j++)
+      if (!vertices[j].getPtr()) return false;
+
+    h = hashCombine(h,TRIANGLE_MESH);
+    h = hashCombine(h,flags);
+    h = hashCombine(h,mask);
+    h = hashCombine(h,numTimeSteps);
+    h = hashCombine(h,(uint32)numTriangles);
+    h = hashCombine(h,(uint32)numVertices);
+    for (size_t i=0; i<numTriangles; i++) {
+      const Triangle& tri = triangle(i);
+      h = hashCombine(h,tri.v[0]);
+      h = hashCombine(h,tri.v[1]);
+      h = hashCombine(h,tri.v[2]);
+    }
+    for (size_t j=0; j<numTimeSteps; j++) {
+      for (size_t i=0; i<numVertices; i++) {
+        const Vec3fa& v = vertex(i,j);
+        h = hashCombine(h,*(uint32*)&v.x);
+        h = hashCombine(h,*(uint32*)&v.y);
+        h = hashCombine(h,*(uint32*)&v.z);
+      }
+    }
+    return true;
   }
 
   bool TriangleMesh::verify () 
@@ -35,12 +35,15 @@ namespace embree
   public:
     void enabling();
     void disabling();
+    void update ();
+    void updateBufferRange (RTCBufferType type, size_t first, size_t count);
     void setMask (unsigned mask);
     void setBuffer(RTCBufferType type, void* ptr, size_t offset, size_t stride);
     void* map(RTCBufferType type);
     void unmap(RTCBufferType type);
     void setUserData (void* ptr, bool ispc);
     void immutable ();
+    bool hash (uint64& h) const;
     bool verify ();
     
   public:
@@ -63,6 +66,39 @@ namespace embree
       assert(j < numTimeSteps);
       return vertices[j][i];
     }
+
+    /*! returns i'th vertex at time t in [0,1], interpolating linearly between the time steps */
+    __forceinline Vec3fa vertexAtTime(size_t i, float t) const 
+    {
+      if (numTimeSteps == 1) return vertex(i);
+      const float ft = clamp(t,0.0f,1.0f)*float(numTimeSteps-1);
+      const size_t j = min(size_t(ft),size_t(numTimeSteps-2));
+      const float f = ft-float(j);
+      return (1.0f-f)*vertex(i,j) + f*vertex(i,j+1);
+    }
+
+    /*! tests if the buffer type is a vertex buffer of some time step of the mesh */
+    __forceinline bool isVertexBuffer(RTCBufferType type) const {
+      return type >= RTC_VERTEX_BUFFER0 && type < RTC_VERTEX_BUFFER0+numTimeSteps;
+    }
+    
+    /*! resets the range of modified vertices after the mesh got committed */
+    __forceinline void resetModifiedVertices() {
+      modifiedVerticesBegin = numVertices; modifiedVerticesEnd = 0;
+    }
+
+    /*! tests if some vertex of the range [lower,upper] got modified */
+    __forceinline bool verticesModified(size_t lower, size_t upper) const {
+      return lower < modifiedVerticesEnd && upper >= modifiedVerticesBegin;
+    }
+
+    /*! extends the range [lower,upper] by the vertices of the i'th triangle */
+    __forceinline void extendVertexRange(size_t i, size_t& lower, size_t& upper) const 
+    {
+      const Triangle& tri = triangle(i);
+      lower = min(lower,size_t(tri.v[0]),size_t(tri.v[1]),size_t(tri.v[2]));
+      upper = max(upper,size_t(tri.v[0]),size_t(tri.v[1]),size_t(tri.v[2]));
+    }
     
     /*! returns the stride in bytes of the triangle buffer */
     __forceinline size_t getTriangleBufferStride() const {
@@ -167,12 +203,15 @@ namespace embree
     
   public:
     unsigned int mask;                //!< for masking out geometry
-    unsigned char numTimeSteps;       //!< number of time steps (1 or 2)
+    unsigned char numTimeSteps;       //!< number of time steps (1 up to RTC_MAX_TIME_STEPS)
     
     BufferT<Triangle> triangles;      //!< array of triangles
     size_t numTriangles;              //!< number of triangles
     
-    BufferT<Vec3fa> vertices[2];      //!< vertex array
+    BufferT<Vec3fa> vertices[RTC_MAX_TIME_STEPS]; //!< vertex array for each time step
     size_t numVertices;               //!< number of vertices
+
+    size_t modifiedVerticesBegin;     //!< first vertex modified since the last commit
+    size_t modifiedVerticesEnd;       //!< end of the range of vertices modified since the last commit
   };
 }
@@ -156,9 +156,13 @@ namespace embree
   extern AccelSet::Intersector8 InstanceIntersector8;
   extern AccelSet::Intersector16 InstanceIntersector16;
 
-  Instance::Instance (Scene* parent, Accel* object) 
-    : UserGeometryBase(parent,USER_GEOMETRY,1), local2world(one), world2local(one), object(object)
+  __thread size_t Instance::level = 0;
+
+  Instance::Instance (Scene* parent, Accel* object, size_t numTimeSteps) 
+    : UserGeometryBase(parent,USER_GEOMETRY,1), local2world(one), world2local(one), object(object), numTimeSteps(numTimeSteps)
   {
+    for (size_t i=0; i<numTimeSteps; i++)
+      local2worlds[i] = one;
     intersectors.ptr = this;
     intersectors.boundsPtr = this;
     boundsFunc = InstanceBoundsFunc;
@@ -168,9 +172,16 @@ namespace embree
     intersectors.intersector16 = InstanceIntersector16;
   }
   
-  void Instance::setTransform(AffineSpace3fa& xfm)
+  void Instance::setTransform(AffineSpace3fa& xfm, size_t timeStep)
   {
-    local2world = xfm;
-    world2local = rcp(xfm);
+    if (timeStep >= numTimeSteps) {
+      process_error(RTC_INVALID_ARGUMENT,"invalid time step");
+      return;
+    }
+    local2worlds[timeStep] = xfm;
+    if (timeStep == 0) {
+      local2world = xfm;
+      world2local = rcp(xfm);
+    }
   }
 }
@@ -68,13 +68,29 @@ namespace embree
   struct Instance : public UserGeometryBase
   {
   public:
-    Instance (Scene* parent, Accel* object); 
-    virtual void setTransform(AffineSpace3fa& local2world);
+    Instance (Scene* parent, Accel* object, size_t numTimeSteps); 
+    virtual void setTransform(AffineSpace3fa& local2world, size_t timeStep);
+    virtual bool hasTransform() const { return true; }
     virtual void build(size_t threadIndex, size_t threadCount) {}
+
+    /*! returns the world to local transformation at time t in [0,1], interpolating linearly between the time steps */
+    __forceinline AffineSpace3fa getWorld2Local(float t) const 
+    {
+      if (numTimeSteps == 1) return world2local;
+      const float ft = clamp(t,0.0f,1.0f)*float(numTimeSteps-1);
+      const size_t j = min(size_t(ft),numTimeSteps-2);
+      const float f = ft-float(j);
+      return rcp((1.0f-f)*local2worlds[j] + f*local2worlds[j+1]);
+    }
     
   public:
-    AffineSpace3fa local2world;
-    AffineSpace3fa world2local;
+    AffineSpace3fa local2world;       //!< transformation of the first time step
+    AffineSpace3fa world2local;       //!< inverse transformation of the first time step
     Accel* object;
+    size_t numTimeSteps;              //!< number of time steps (1 up to RTC_MAX_TIME_STEPS)
+    AffineSpace3fa local2worlds[RTC_MAX_TIME_STEPS]; //!< transformation of each time step
+
+  public:
+    static __thread size_t level;     //!< number of instances the calling thread currently traverses
   };
 }
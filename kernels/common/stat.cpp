@@ -18,22 +18,92 @@
 
 namespace embree
 {
-  Stat Stat::instance; 
-  
-  Stat::Stat () {
-  }
+  __thread Stat::Counters* Stat::current = &Stat::shared;
+  __thread size_t Stat::currentID = 0;
+  __thread size_t Stat::threadIndex = 0;
+  Stat::Counters Stat::shared;
 
-  Stat::~Stat () 
+  /*! keeps track of all statistics objects */
+  static struct StatRegistry
   {
+    ~StatRegistry () 
+    {
 #ifdef __USE_STAT_COUNTERS__
-    Stat::print(std::cout);
+      Stat::print(std::cout);
 #endif
+    }
+
+    MutexSys mutex;
+    std::vector<Stat*> stats;   //!< all existing statistics objects
+    Stat::Counters retired;     //!< counters of already destroyed objects
+    AtomicCounter nextID;       //!< next ID to hand out to a statistics object
+    AtomicCounter numThreads;   //!< number of threads that got an index
+  } registry;
+
+  Stat::Stat () 
+  {
+    for (size_t i=0; i<maxThreads; i++) threads[i] = NULL;
+    Lock<MutexSys> lock(registry.mutex);
+    id = ++registry.nextID;
+    registry.stats.push_back(this);
+  }
+
+  Stat::~Stat () 
+  {
+    Lock<MutexSys> lock(registry.mutex);
+    gather(registry.retired);
+    registry.stats.erase(std::find(registry.stats.begin(),registry.stats.end(),this));
+    for (size_t i=0; i<maxThreads; i++) delete threads[i];
+  }
+
+  void Stat::bind()
+  {
+    if (threadIndex == 0) threadIndex = ++registry.numThreads;
+    currentID = id;
+    if (threadIndex > maxThreads) { current = &shared; return; }
+
+    /* only the calling thread ever writes its own slot */
+    ThreadCounters*& cntrs = threads[threadIndex-1];
+    if (cntrs == NULL) cntrs = new ThreadCounters;
+    current = &cntrs->cntrs;
+  }
+
+  void Stat::gather(Counters& cntrs) const
+  {
+    for (size_t i=0; i<maxThreads; i++)
+      if (threads[i]) cntrs.add(threads[i]->cntrs);
+  }
+
+  void Stat::reset()
+  {
+    for (size_t i=0; i<maxThreads; i++)
+      if (threads[i]) threads[i]->cntrs.clear();
+  }
+
+  void Stat::clear()
+  {
+    Lock<MutexSys> lock(registry.mutex);
+    for (size_t i=0; i<registry.stats.size(); i++)
+      registry.stats[i]->reset();
+    registry.retired.clear();
+    shared.clear();
   }
 
   void Stat::print(std::ostream& cout)
   {
-    Counters& cntrs = instance.cntrs;
+    Counters cntrs;
+    {
+      Lock<MutexSys> lock(registry.mutex);
+      for (size_t i=0; i<registry.stats.size(); i++)
+        registry.stats[i]->gather(cntrs);
+      cntrs.add(registry.retired);
+      cntrs.add(shared);
+    }
+    print(cout,cntrs);
+  }
 
+  void Stat::print(std::ostream& cout, const Counters& cntrs)
+  {
     /* print absolute numbers */
     cout << "--------- ABSOLUTE ---------" << std::endl;
     cout << "  #normal_travs   = " << float(cntrs.code.normal.travs            )*1E-6 << "M" << std::endl;
@@ -32,7 +32,9 @@
 
 namespace embree
 {
-  /*! Gathers ray tracing statistics. */
+  /*! Gathers ray tracing statistics. Each thread increments its own
+   *  cache line padded block of counters without atomic operations,
+   *  the blocks of all threads are only summed up when queried. */
   class Stat
   { 
   public:
@@ -51,41 +53,86 @@ namespace embree
         memset(this,0,sizeof(Counters)); 
       }
 
+      /*! adds the counters of another block */
+      void add(const Counters& other) {
+        for (size_t i=0; i<sizeof(Counters)/sizeof(size_t); i++)
+          ((size_t*)this)[i] += ((const size_t*)&other)[i];
+      }
+
     public:
 
-	/* per packet and per ray stastics */
-	struct {
-	  /* normal and shadow ray statistics */
-	  struct {
-	    AtomicCounter travs;
-	    AtomicCounter trav_nodes;
-	    AtomicCounter trav_leaves;
-	    AtomicCounter trav_prims;
-	    AtomicCounter trav_prim_hits;
+      /*! statistics of one ray type */
+      struct Rays {
+        size_t travs;
+        size_t trav_nodes;
+        size_t trav_leaves;
+        size_t trav_prims;
+        size_t trav_prim_hits;
 #if defined(__MIC__)
-	    AtomicCounter trav_hit_boxes[16+1];
+        size_t trav_hit_boxes[16+1];
 #endif
+      };
+
+      /* per packet and per ray stastics */
+      struct {
+        Rays normal, shadow;   //!< normal and shadow ray statistics
+      } all, active, code;
+
+    };
 
-	  } normal, shadow;
-	} all, active, code;
+  private:
 
+    /*! counters of one thread, padded to not share cache lines with other threads */
+    struct ThreadCounters
+    {
+      char align0[64];
+      Counters cntrs;
+      char align1[64];
     };
 
+    /*! maximal number of threads with own counters, further threads share one block */
+    static const size_t maxThreads = 1024;
+
   public:
 
+    /*! makes the counters of this object the current counters of the calling thread */
+    __forceinline void enter() {
+      if (unlikely(currentID != id)) bind();
+    }
+
+    /*! returns the current counters of the calling thread */
     static __forceinline Counters& get() {
-      return instance.cntrs;
+      return *current;
     }
+
+    /*! sums up the counters of all threads */
+    void gather(Counters& cntrs) const;
+
+    /*! clears the counters of all threads */
+    void reset();
     
-    static void clear() {
-      instance.cntrs.clear();
-    }
+    /*! clears all statistics */
+    static void clear();
     
+    /*! prints the statistics summed up over all objects */
     static void print(std::ostream& cout);
 
-  private: 
-    Counters cntrs;
+    /*! prints the statistics of some counters */
+    static void print(std::ostream& cout, const Counters& cntrs);
+
+  private:
+
+    /*! selects the counters of the calling thread */
+    void bind();
+
+  private:
+    size_t id;                               //!< unique ID of this object
+    ThreadCounters* threads[maxThreads];     //!< counters of each thread
+
   private:
-    static Stat instance;
+    static __thread Counters* current;       //!< current counters of the calling thread
+    static __thread size_t currentID;        //!< ID of the object the current counters belong to
+    static __thread size_t threadIndex;      //!< index of the calling thread plus one
+    static Counters shared;                  //!< counters for threads without own counters
   };
 }
@@ -0,0 +1,243 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "presplit.h"
+#include "primrefgen.h"
+
+#define PRESPLIT_SPACE_FACTOR         1.30f  // array size relative to number of triangles
+#define PRESPLIT_AREA_THRESHOLD      20.0f   // minimal ratio of bounds area to triangle area for splitting
+#define PRESPLITS_TREE_DEPTH          4      // split triangles into 2^depth pieces
+#define NUM_PRESPLITS_PER_TRIANGLE   (1 << PRESPLITS_TREE_DEPTH)
+
+namespace embree
+{
+  namespace isa
+  {
+    size_t PreSplitArrayGen::capacity(size_t numPrimitives) {
+      return size_t(double(numPrimitives)*PRESPLIT_SPACE_FACTOR);
+    }
+
+    void PreSplitArrayGen::split_sequential(size_t threadIndex, size_t threadCount, const Scene* scene, PrimRef* prims, size_t capacity, PrimInfo& pinfo) {
+      PreSplitArrayGen(threadIndex,threadCount,scene,prims,capacity,pinfo,false);
+    }
+
+    void PreSplitArrayGen::split_parallel(size_t threadIndex, size_t threadCount, const Scene* scene, PrimRef* prims, size_t capacity, PrimInfo& pinfo) {
+      PreSplitArrayGen(threadIndex,threadCount,scene,prims,capacity,pinfo,true);
+    }
+
+    PreSplitArrayGen::PreSplitArrayGen(size_t threadIndex, size_t threadCount, const Scene* scene, PrimRef* prims, size_t capacity, PrimInfo& pinfo, bool parallel)
+      : scene(scene), prims(prims), numPrimitives(pinfo.size()), pinfo_o(pinfo), taskCount(parallel ? threadCount : 1), cutoff(-1), remaining(0)
+    {
+      /* number of triangles we have space to split */
+      if (capacity <= numPrimitives) return;
+      size_t budget = (capacity-numPrimitives)/(NUM_PRESPLITS_PER_TRIANGLE-1);
+      if (budget == 0) return;
+
+      /* count split candidates by area of their bounds */
+      counts.resize(taskCount*BUCKETS);
+      if (parallel) TaskScheduler::dispatchTask(_task_count_parallel, this, threadIndex, threadCount);
+      else          task_count_parallel(threadIndex,threadCount,0,1,NULL);
+
+      /* select the candidates with largest bounds that fit into the array */
+      for (ssize_t b=BUCKETS-1; b>=0; b--)
+      {
+        size_t num = 0;
+        for (size_t t=0; t<taskCount; t++) num += counts[t*BUCKETS+b];
+        if (num <= budget) { budget -= num; continue; }
+        cutoff = b; remaining = budget;
+        break;
+      }
+
+      /* each task splits a fixed share of the cutoff bucket and writes its pieces to a fixed offset */
+      offsets.resize(taskCount);
+      size_t numSplits = 0;
+      for (size_t t=0; t<taskCount; t++)
+      {
+        offsets[t] = numPrimitives + numSplits*(NUM_PRESPLITS_PER_TRIANGLE-1);
+        for (ssize_t b=cutoff+1; b<ssize_t(BUCKETS); b++) numSplits += counts[t*BUCKETS+b];
+        if (cutoff < 0) continue;
+        const size_t n = min(counts[t*BUCKETS+cutoff],remaining);
+        counts[t*BUCKETS+cutoff] = n; remaining -= n;
+        numSplits += n;
+      }
+      if (numSplits == 0) return;
+
+      /* split selected triangles */
+      pinfo_o.reset();
+      if (parallel) TaskScheduler::dispatchTask(_task_split_parallel, this, threadIndex, threadCount);
+      else          task_split_parallel(threadIndex,threadCount,0,1,NULL);
+      assert(pinfo_o.size() == numPrimitives + numSplits*(NUM_PRESPLITS_PER_TRIANGLE-1));
+    }
+
+    __forceinline ssize_t PreSplitArrayGen::bucket(const PrimRef& prim, Vec3fa& v0, Vec3fa& v1, Vec3fa& v2) const
+    {
+      const TriangleMesh* mesh = scene->getTriangleMesh(prim.geomID());
+      const TriangleMesh::Triangle& tri = mesh->triangle(prim.primID());
+      v0 = mesh->vertex(tri.v[0]);
+      v1 = mesh->vertex(tri.v[1]);
+      v2 = mesh->vertex(tri.v[2]);
+      const float areaTri = 0.5f*length(cross(v1-v0,v2-v0));
+      const float areaBox = area(prim.bounds());
+      if (!(areaBox > PRESPLIT_AREA_THRESHOLD*areaTri)) return -1;
+      union { float f; int i; } u; u.f = areaBox;
+      return (u.i >> 23) & (BUCKETS-1);
+    }
+
+    __forceinline void splitTriangle(const PrimRef& prim, int dim, float pos,
+                                     const Vec3fa& a, const Vec3fa& b, const Vec3fa& c, PrimRef& left_o, PrimRef& right_o)
+    {
+      BBox3fa left = empty, right = empty;
+      const Vec3fa v[3] = { a,b,c };
+
+      /* clip triangle to left and right box by processing all edges */
+      Vec3fa v1 = v[2];
+      for (size_t i=0; i<3; i++)
+      {
+        Vec3fa v0 = v1; v1 = v[i];
+        float v0d = v0[dim], v1d = v1[dim];
+
+        if (v0d <= pos) left. extend(v0); // this point is on left side
+        if (v0d >= pos) right.extend(v0); // this point is on right side
+
+        if ((v0d < pos && pos < v1d) || (v1d < pos && pos < v0d)) // the edge crosses the splitting location
+        {
+          assert((v1d-v0d) != 0.0f);
+          Vec3fa c = v0 + (pos-v0d)/(v1d-v0d)*(v1-v0);
+          left.extend(c);
+          right.extend(c);
+        }
+      }
+
+      /* clip against current bounds, keep current bounds if numerical issues leave a side empty */
+      const BBox3fa bounds = prim.bounds();
+      BBox3fa cleft (max(left .lower,bounds.lower),min(left .upper,bounds.upper));
+      BBox3fa cright(max(right.lower,bounds.lower),min(right.upper,bounds.upper));
+      if (cleft .empty()) cleft  = bounds;
+      if (cright.empty()) cright = bounds;
+
+      new (&left_o ) PrimRef(cleft, prim.geomID(), prim.primID());
+      new (&right_o) PrimRef(cright,prim.geomID(), prim.primID());
+    }
+
+    __forceinline void PreSplitArrayGen::subdivide(const PrimRef& prim, const Vec3fa& v0, const Vec3fa& v1, const Vec3fa& v2, PrimRef* pieces) const
+    {
+      /* split each piece at the center of its largest extent, the pieces of the next level are stored at 2*i and 2*i+1 */
+      pieces[0] = prim;
+      for (size_t d=0, n=1; d<PRESPLITS_TREE_DEPTH; d++, n*=2)
+      {
+        for (ssize_t i=ssize_t(n)-1; i>=0; i--)
+        {
+          const PrimRef piece = pieces[i];
+          const Vec3fa size = piece.upper-piece.lower;
+          const int dim = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+          const float pos = 0.5f*(piece.lower[dim]+piece.upper[dim]);
+          splitTriangle(piece,dim,pos,v0,v1,v2,pieces[2*i+0],pieces[2*i+1]);
+        }
+      }
+    }
+
+    void PreSplitArrayGen::task_count_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event)
+    {
+      const size_t start = (taskIndex+0)*numPrimitives/taskCount;
+      const size_t end   = (taskIndex+1)*numPrimitives/taskCount;
+      size_t* hist = &counts[taskIndex*BUCKETS];
+      for (size_t b=0; b<BUCKETS; b++) hist[b] = 0;
+
+      Vec3fa v0,v1,v2;
+      for (size_t i=start; i<end; i++) {
+        const ssize_t b = bucket(prims[i],v0,v1,v2);
+        if (b >= 0) hist[b]++;
+      }
+    }
+
+    void PreSplitArrayGen::task_split_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event)
+    {
+      const size_t start = (taskIndex+0)*numPrimitives/taskCount;
+      const size_t end   = (taskIndex+1)*numPrimitives/taskCount;
+      size_t numCutoff = cutoff >= 0 ? counts[taskIndex*BUCKETS+cutoff] : 0;
+      size_t dst = offsets[taskIndex];
+
+      PrimInfo pinfo(empty);
+      Vec3fa v0,v1,v2;
+      __aligned(32) PrimRef pieces[NUM_PRESPLITS_PER_TRIANGLE];
+      for (size_t i=start; i<end; i++)
+      {
+        const ssize_t b = bucket(prims[i],v0,v1,v2);
+        bool split = b >= 0 && b > cutoff;
+        if (b >= 0 && b == cutoff && numCutoff) { split = true; numCutoff--; }
+
+        if (!split) {
+          pinfo.add(prims[i].bounds(),prims[i].center2());
+          continue;
+        }
+
+        subdivide(prims[i],v0,v1,v2,pieces);
+        prims[i] = pieces[0];
+        pinfo.add(pieces[0].bounds(),pieces[0].center2());
+        for (size_t j=1; j<NUM_PRESPLITS_PER_TRIANGLE; j++) {
+          prims[dst++] = pieces[j];
+          pinfo.add(pieces[j].bounds(),pieces[j].center2());
+        }
+      }
+      pinfo_o.atomic_extend(pinfo);
+    }
+
+    // =======================================================================================================
+    // =======================================================================================================
+    // =======================================================================================================
+
+    void PreSplitListGen::generate(size_t threadIndex, size_t threadCount, PrimRefBlockAlloc<PrimRef>* alloc, const Scene* scene, PrimRefList& prims, PrimInfo& pinfo) {
+      PreSplitListGen(threadIndex,threadCount,alloc,scene,prims,pinfo);
+    }
+
+    PreSplitListGen::PreSplitListGen(size_t threadIndex, size_t threadCount, PrimRefBlockAlloc<PrimRef>* alloc, const Scene* scene, PrimRefList& prims, PrimInfo& pinfo)
+      : scene(scene), alloc(alloc), array(NULL), bytesArray(0), prims_o(prims), pinfo_o(pinfo)
+    {
+      bytesArray = PreSplitArrayGen::capacity(scene->numTriangles)*sizeof(PrimRef);
+      array = (PrimRef*) os_malloc(bytesArray);
+      TaskScheduler::executeTask(threadIndex,threadCount,_task_gen,this,threadCount,"build::presplits");
+      os_free(array,bytesArray);
+    }
+
+    void PreSplitListGen::task_gen(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event)
+    {
+      /* all worker threads enter tasking system */
+      if (TaskScheduler::enter(threadIndex,threadCount))
+	return;
+
+      PrimRefArrayGen ::generate_parallel(threadIndex,threadCount,scene,TRIANGLE_MESH,1,array,pinfo_o);
+      PreSplitArrayGen::split_parallel   (threadIndex,threadCount,scene,array,bytesArray/sizeof(PrimRef),pinfo_o);
+      TaskScheduler::dispatchTask(_task_copy_parallel, this, threadIndex, threadCount);
+
+      /* release all threads again */
+      TaskScheduler::leave(threadIndex,threadCount);
+    }
+
+    void PreSplitListGen::task_copy_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event)
+    {
+      const size_t start = (taskIndex+0)*pinfo_o.size()/taskCount;
+      const size_t end   = (taskIndex+1)*pinfo_o.size()/taskCount;
+      if (start == end) return;
+
+      PrimRefList::item* block = prims_o.insert(alloc->malloc(threadIndex));
+      for (size_t i=start; i<end; i++) {
+        if (likely(block->insert(array[i]))) continue;
+        block = prims_o.insert(alloc->malloc(threadIndex));
+        block->insert(array[i]);
+      }
+    }
+  }
+}
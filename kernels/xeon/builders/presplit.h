@@ -0,0 +1,107 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "common/scene.h"
+#include "primrefalloc.h"
+#include "primrefblock.h"
+#include "heuristic_fallback.h"
+
+namespace embree
+{
+  namespace isa
+  {
+    /*! Splits triangles whose bounding box is large compared to their
+     *  surface area into smaller pieces before the build
+     *  (pre-splits). Split triangles are subdivided by clipping them
+     *  at the center of their bounds, the first piece replaces the
+     *  original build primitive and the others are appended to the
+     *  array. Triangles with the largest bounds get split first, until
+     *  the free space at the end of the array is used up. */
+    class PreSplitArrayGen
+    {
+      /*! number of histogram buckets, one per exponent of the bounds area */
+      static const size_t BUCKETS = 256;
+
+    public:
+
+      /*! returns the size of the build primitive array to allocate for numPrimitives triangles */
+      static size_t capacity(size_t numPrimitives);
+
+      /*! splits triangles of the primitive array prims[0,pinfo.size()) and appends the pieces up to capacity */
+      static void split_sequential(size_t threadIndex, size_t threadCount, const Scene* scene, PrimRef* prims, size_t capacity, PrimInfo& pinfo);
+      static void split_parallel  (size_t threadIndex, size_t threadCount, const Scene* scene, PrimRef* prims, size_t capacity, PrimInfo& pinfo);
+
+    private:
+
+      /*! standard constructor that schedules the tasks */
+      PreSplitArrayGen (size_t threadIndex, size_t threadCount, const Scene* scene, PrimRef* prims, size_t capacity, PrimInfo& pinfo, bool parallel);
+
+      /*! returns the histogram bucket of a triangle, or -1 if the triangle should not get split */
+      __forceinline ssize_t bucket(const PrimRef& prim, Vec3fa& v0, Vec3fa& v1, Vec3fa& v2) const;
+
+      /*! subdivides a triangle into pieces */
+      __forceinline void subdivide(const PrimRef& prim, const Vec3fa& v0, const Vec3fa& v1, const Vec3fa& v2, PrimRef* pieces) const;
+
+      /*! parallel task to count the split candidates */
+      TASK_RUN_FUNCTION(PreSplitArrayGen,task_count_parallel);
+
+      /*! parallel task to split the selected candidates */
+      TASK_RUN_FUNCTION(PreSplitArrayGen,task_split_parallel);
+
+      /* input data */
+    private:
+      const Scene* scene;           //!< input geometry
+      PrimRef* prims;               //!< array of build primitives
+      size_t numPrimitives;         //!< number of build primitives before splitting
+      PrimInfo& pinfo_o;            //!< bounding information of primitives
+      size_t taskCount;             //!< number of tasks of both stages
+      std::vector<size_t> counts;   //!< histogram of split candidates per task
+      std::vector<size_t> offsets;  //!< offset into the primitive array of each task
+      ssize_t cutoff;               //!< all candidates in buckets above cutoff get split
+      size_t remaining;             //!< number of candidates in the cutoff bucket that still get split
+    };
+
+    /*! Generates a list of pre-split triangle build primitives from the scene. */
+    class PreSplitListGen
+    {
+      typedef atomic_set<PrimRefBlockT<PrimRef> > PrimRefList;
+
+    public:
+      static void generate(size_t threadIndex, size_t threadCount, PrimRefBlockAlloc<PrimRef>* alloc, const Scene* scene, PrimRefList& prims, PrimInfo& pinfo);
+
+    private:
+
+      /*! standard constructor that schedules the task */
+      PreSplitListGen (size_t threadIndex, size_t threadCount, PrimRefBlockAlloc<PrimRef>* alloc, const Scene* scene, PrimRefList& prims, PrimInfo& pinfo);
+
+      /*! generates and splits the build primitive array */
+      TASK_RUN_FUNCTION(PreSplitListGen,task_gen);
+
+      /*! parallel task to copy the build primitive array into the list */
+      TASK_RUN_FUNCTION(PreSplitListGen,task_copy_parallel);
+
+    private:
+      const Scene* scene;                  //!< input geometry
+      PrimRefBlockAlloc<PrimRef>* alloc;   //!< allocator for build primitive blocks
+      PrimRef* array;                      //!< temporary array of build primitives
+      size_t bytesArray;                   //!< size of the temporary array
+      PrimRefList& prims_o;                //!< list of build primitives
+      PrimInfo& pinfo_o;                   //!< bounding information of primitives
+    };
+  }
+}
@@ -75,7 +75,7 @@ namespace embree
 	  /* handle triangle mesh */
 	case TRIANGLE_MESH: {
 	  const TriangleMesh* mesh = (const TriangleMesh*)geom;
-	  if (mesh->numTimeSteps & numTimeSteps) {
+	  if ((mesh->numTimeSteps == 1 ? 1 : 2) & numTimeSteps) {
 	    ssize_t s = max(start-cur,ssize_t(0));
 	    ssize_t e = min(end  -cur,ssize_t(mesh->numTriangles));
 	    for (ssize_t j=s; j<e; j++) {
@@ -219,7 +219,7 @@ namespace embree
 	  /* handle triangle mesh */
 	case TRIANGLE_MESH: {
 	  const TriangleMesh* mesh = (const TriangleMesh*)geom;
-	  if (mesh->numTimeSteps & numTimeSteps) {
+	  if ((mesh->numTimeSteps == 1 ? 1 : 2) & numTimeSteps) {
 	    ssize_t s = max(start-cur,ssize_t(0));
 	    ssize_t e = min(end  -cur,ssize_t(mesh->numTriangles));
 	    for (ssize_t j=s; j<e; j++) {
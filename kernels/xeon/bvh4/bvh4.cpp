@@ -15,6 +15,7 @@
 // ======================================================================== //
 
 #include "bvh4.h"
+#include "bvh4_compressor.h"
 
 #include "geometry/bezier1.h"
 #include "geometry/bezier1i.h"
@@ -26,6 +27,7 @@
 #include "geometry/triangle4i.h"
 
 #include "common/accelinstance.h"
+#include "common/bvh_serializer.h"
 
 namespace embree
 {
@@ -38,6 +40,12 @@ namespace embree
   DECLARE_SYMBOL(Accel::Intersector1,BVH4Triangle4vIntersector1Pluecker);
   DECLARE_SYMBOL(Accel::Intersector1,BVH4Triangle4iIntersector1Pluecker);
   DECLARE_SYMBOL(Accel::Intersector1,BVH4VirtualIntersector1);
+  DECLARE_SYMBOL(Accel::Intersector1,BVH4CTriangle4Intersector1Moeller);
+  DECLARE_SYMBOL(Accel::Intersector1,BVH4CTriangle4iIntersector1Pluecker);
+
+  DECLARE_SYMBOL(Accel::PointQuery1,BVH4Triangle4PointQuery);
+  DECLARE_SYMBOL(Accel::PointQuery1,BVH4Triangle8PointQuery);
+  DECLARE_SYMBOL(Accel::PointQuery1,BVH4Triangle4vPointQuery);
 
   DECLARE_SYMBOL(Accel::Intersector4,BVH4Bezier1Intersector4Chunk);
   DECLARE_SYMBOL(Accel::Intersector4,BVH4Bezier1iIntersector4Chunk);
@@ -55,6 +63,9 @@ namespace embree
   DECLARE_SYMBOL(Accel::Intersector4,BVH4Triangle4vIntersector4HybridPluecker);
   DECLARE_SYMBOL(Accel::Intersector4,BVH4Triangle4iIntersector4ChunkPluecker);
   DECLARE_SYMBOL(Accel::Intersector4,BVH4VirtualIntersector4Chunk);
+  DECLARE_SYMBOL(Accel::Intersector4,BVH4CTriangle4Intersector4HybridMoeller);
+  DECLARE_SYMBOL(Accel::Intersector4,BVH4CTriangle4Intersector4HybridMoellerNoFilter);
+  DECLARE_SYMBOL(Accel::Intersector4,BVH4CTriangle4iIntersector4HybridPluecker);
 
   DECLARE_SYMBOL(Accel::Intersector8,BVH4Bezier1Intersector8Chunk);
   DECLARE_SYMBOL(Accel::Intersector8,BVH4Bezier1iIntersector8Chunk);
@@ -72,6 +83,9 @@ namespace embree
   DECLARE_SYMBOL(Accel::Intersector8,BVH4Triangle4vIntersector8HybridPluecker);
   DECLARE_SYMBOL(Accel::Intersector8,BVH4Triangle4iIntersector8ChunkPluecker);
   DECLARE_SYMBOL(Accel::Intersector8,BVH4VirtualIntersector8Chunk);
+  DECLARE_SYMBOL(Accel::Intersector8,BVH4CTriangle4Intersector8HybridMoeller);
+  DECLARE_SYMBOL(Accel::Intersector8,BVH4CTriangle4Intersector8HybridMoellerNoFilter);
+  DECLARE_SYMBOL(Accel::Intersector8,BVH4CTriangle4iIntersector8HybridPluecker);
 
   DECLARE_TOPLEVEL_BUILDER(BVH4BuilderTopLevelFast);
 
@@ -100,6 +114,7 @@ namespace embree
   DECLARE_SCENE_BUILDER(BVH4Triangle4vBuilderFast);
   DECLARE_SCENE_BUILDER(BVH4Triangle4iBuilderFast);
   DECLARE_SCENE_BUILDER(BVH4UserGeometryBuilderFast);
+  DECLARE_SCENE_BUILDER(BVH4UserGeometryRefitFast);
 
   DECLARE_TRIANGLEMESH_BUILDER(BVH4Triangle1MeshBuilderFast);
   DECLARE_TRIANGLEMESH_BUILDER(BVH4Triangle4MeshBuilderFast);
@@ -160,6 +175,7 @@ namespace embree
     SELECT_SYMBOL_DEFAULT_AVX(features,BVH4Triangle4vBuilderFast);
     SELECT_SYMBOL_DEFAULT_AVX(features,BVH4Triangle4iBuilderFast);
     SELECT_SYMBOL_DEFAULT_AVX(features,BVH4UserGeometryBuilderFast);
+    SELECT_SYMBOL_DEFAULT_AVX(features,BVH4UserGeometryRefitFast);
     
     SELECT_SYMBOL_DEFAULT_AVX(features,BVH4Triangle1MeshBuilderFast);
     SELECT_SYMBOL_DEFAULT_AVX(features,BVH4Triangle4MeshBuilderFast);
@@ -200,6 +216,13 @@ namespace embree
     SELECT_SYMBOL_DEFAULT_SSE41_AVX     (features,BVH4Triangle4vIntersector1Pluecker);
     SELECT_SYMBOL_DEFAULT_SSE41_AVX     (features,BVH4Triangle4iIntersector1Pluecker);
     SELECT_SYMBOL_DEFAULT_SSE41_AVX_AVX2(features,BVH4VirtualIntersector1);
+    SELECT_SYMBOL_DEFAULT_SSE41_AVX_AVX2(features,BVH4CTriangle4Intersector1Moeller);
+    SELECT_SYMBOL_DEFAULT_SSE41_AVX_AVX2(features,BVH4CTriangle4iIntersector1Pluecker);
+
+    /* select point queries */
+    SELECT_SYMBOL_DEFAULT_AVX_AVX2(features,BVH4Triangle4PointQuery);
+    SELECT_SYMBOL_AVX_AVX2        (features,BVH4Triangle8PointQuery);
+    SELECT_SYMBOL_DEFAULT_AVX_AVX2(features,BVH4Triangle4vPointQuery);
 
     /* select intersectors4 */
     SELECT_SYMBOL_DEFAULT_AVX_AVX2      (features,BVH4Bezier1Intersector4Chunk);
@@ -221,6 +244,9 @@ namespace embree
     SELECT_SYMBOL_SSE42_AVX             (features,BVH4Triangle4vIntersector4HybridPluecker);
     SELECT_SYMBOL_DEFAULT_SSE41_AVX     (features,BVH4Triangle4iIntersector4ChunkPluecker);
     SELECT_SYMBOL_DEFAULT_SSE41_AVX_AVX2(features,BVH4VirtualIntersector4Chunk);
+    SELECT_SYMBOL_SSE42_AVX_AVX2        (features,BVH4CTriangle4Intersector4HybridMoeller); // no compressed traversal below SSE4.2
+    SELECT_SYMBOL_SSE42_AVX_AVX2        (features,BVH4CTriangle4Intersector4HybridMoellerNoFilter);
+    SELECT_SYMBOL_SSE42_AVX_AVX2        (features,BVH4CTriangle4iIntersector4HybridPluecker);
 
     /* select intersectors8 */
     SELECT_SYMBOL_AVX_AVX2(features,BVH4Bezier1Intersector8Chunk);
@@ -239,15 +265,30 @@ namespace embree
     SELECT_SYMBOL_AVX     (features,BVH4Triangle4vIntersector8HybridPluecker);
     SELECT_SYMBOL_AVX     (features,BVH4Triangle4iIntersector8ChunkPluecker);
     SELECT_SYMBOL_AVX_AVX2(features,BVH4VirtualIntersector8Chunk);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH4CTriangle4Intersector8HybridMoeller);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH4CTriangle4Intersector8HybridMoellerNoFilter);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH4CTriangle4iIntersector8HybridPluecker);
   }
 
   BVH4::BVH4 (const PrimitiveType& primTy, void* geometry)
   : primTy(primTy), geometry(geometry), root(emptyNode),
-    numPrimitives(0), numVertices(0) {}
+    numPrimitives(0), numVertices(0), compressed(false) {}
 
   BVH4::~BVH4 () {
     for (size_t i=0; i<objects.size(); i++) 
       delete objects[i];
+    for (size_t i=0; i<numaAllocs.size(); i++) 
+      delete numaAllocs[i];
+  }
+
+  size_t BVH4::bytesAllocated() const
+  {
+    size_t bytes = alloc.bytes();
+    for (size_t i=0; i<objects.size(); i++)
+      if (objects[i]) bytes += objects[i]->bytesAllocated();
+    for (size_t i=0; i<numaAllocs.size(); i++)
+      bytes += numaAllocs[i]->bytes();
+    return bytes;
   }
 
   void BVH4::init(size_t numPrimitives, size_t numThreads)
@@ -285,6 +326,208 @@ namespace embree
     }
   }
 
+  size_t BVH4::childBounds(size_t depth, BBox3fa* bounds_o, size_t maxBounds) const {
+    if (root == emptyNode || maxBounds == 0) return 0;
+    return childBounds(root,bounds,depth,bounds_o,maxBounds);
+  }
+
+  size_t BVH4::childBounds(NodeRef node, const BBox3fa& bounds, size_t depth, BBox3fa* bounds_o, size_t maxBounds) const
+  {
+    /* stop descending when the children may not fit anymore */
+    if (depth == 0 || !node.isNode() || maxBounds < N) {
+      bounds_o[0] = bounds;
+      return 1;
+    }
+
+    size_t numChildren = 0;
+    for (size_t c=0; c<N; c++) {
+      const NodeRef child = compressed ? node.compressedNode()->child(c) : node.node()->child(c);
+      numChildren += child != emptyNode;
+    }
+
+    /* each child keeps one box free for each of its remaining siblings */
+    size_t num = 0;
+    for (size_t c=0; c<N; c++) 
+    {
+      const NodeRef child = compressed ? node.compressedNode()->child(c) : node.node()->child(c);
+      if (child == emptyNode) continue;
+      const BBox3fa cbounds = compressed ? node.compressedNode()->bounds(c) : node.node()->bounds(c);
+      num += childBounds(child,cbounds,depth-1,bounds_o+num,maxBounds-num-(--numChildren));
+    }
+    return num;
+  }
+
+  void BVH4::immutable () 
+  {
+    if      (g_bvh_layout == "depth_first") compact(false);
+    else if (g_bvh_layout == "veb"        ) compact(true);
+  }
+
+  void BVH4::compact (bool veb)
+  {
+    /* toplevel BVHs link into the memory of the object BVHs */
+    if (root == emptyNode || !objects.empty()) 
+      return;
+
+    double t0 = 0.0;
+    if (g_verbose >= 2) {
+      std::cout << "compacting BVH4 <" << primTy.name << "> ... " << std::flush;
+      t0 = getSeconds();
+    }
+
+    size_t levels = 0, numNodes = 0;
+    LinearAllocatorPerThread dst;
+    dst.init_malloc(compactBytes(levels,numNodes));
+
+    /* the memory of the builder gets released with dst */
+    root = compactTo(dst,levels,veb);
+    alloc.swap(dst);
+    alloc.shrink();
+
+    if (g_verbose >= 2) {
+      double t1 = getSeconds();
+      std::cout << "[DONE]" << std::endl;
+      std::cout << "  dt = " << 1000.0f*(t1-t0) << "ms, " << numNodes << " nodes, " 
+                << 1E-6*double(alloc.bytes()) << " MB" << std::endl;
+    }
+  }
+
+  void BVH4::numaDistribute (bool replicate)
+  {
+    if (root == emptyNode) 
+      return;
+
+    if (!replicate) {
+      numaInterleave(alloc.base(),alloc.bytes());
+      for (size_t i=0; i<objects.size(); i++)
+        if (objects[i]) objects[i]->numaDistribute(false);
+      return;
+    }
+
+    /* toplevel BVHs link into the memory of the object BVHs */
+    if (!objects.empty()) 
+      return;
+
+    /* the pages of each copy get bound to their node before they are
+     * first written, the copy of node 0 replaces the original BVH */
+    const size_t numaNodes = max(getNumberOfNumaNodes(),size_t(1));
+    size_t levels = 0, numNodes = 0;
+    const size_t bytes = compactBytes(levels,numNodes);
+    for (size_t n=0; n<numaNodes; n++) 
+    {
+      LinearAllocatorPerThread* dst = new LinearAllocatorPerThread;
+      dst->init_malloc(bytes);
+      numaBind(dst->base(),bytes,n);
+      numaRoots.push_back(compactTo(*dst,levels,g_bvh_layout == "veb"));
+      dst->shrink();
+      if (n == 0) {
+        root = numaRoots[0];
+        alloc.swap(*dst);
+        delete dst;
+      }
+      else numaAllocs.push_back(dst);
+    }
+  }
+
+  size_t BVH4::compactBytes (size_t& levels, size_t& numNodes) const
+  {
+    /* nodes get aligned to cache lines, leaves to the leaf alignment */
+    size_t leafBytes = 0; numNodes = 0;
+    levels = compactCount(root,numNodes,leafBytes);
+    const size_t nodeBytes = compressed ? sizeof(CompressedNode) : sizeof(Node);
+    return numNodes*(nodeBytes+64) + leafBytes;
+  }
+
+  BVH4::NodeRef BVH4::compactTo (LinearAllocatorPerThread& dst, size_t levels, bool veb) const
+  {
+    NodeRef newRoot = emptyNode;
+    const CompactItem item(root,&newRoot);
+    if (veb) {
+      std::vector<CompactItem> frontier;
+      compactVEB(item,levels,dst,frontier);
+      assert(frontier.empty());
+    }
+    else 
+      compactDepthFirst(item,dst);
+    return newRoot;
+  }
+
+  size_t BVH4::compactCount (NodeRef node, size_t& numNodes, size_t& leafBytes) const
+  {
+    if (node.isLeaf()) {
+      size_t num; node.leaf(num);
+      leafBytes += num*primTy.bytes + (1 << alignment);
+      return 0;
+    }
+    numNodes++;
+    size_t levels = 0;
+    for (size_t c=0; c<N; c++) {
+      const NodeRef child = compressed ? node.compressedNode()->child(c) : node.node()->child(c);
+      if (child == emptyNode) continue;
+      levels = max(levels,compactCount(child,numNodes,leafBytes));
+    }
+    return levels+1;
+  }
+
+  void BVH4::compactCopy (const CompactItem& item, LinearAllocatorPerThread& dst, std::vector<CompactItem>& children) const
+  {
+    const NodeRef node = item.first;
+    if (node.isLeaf()) {
+      size_t num; const char* prims = node.leaf(num);
+      char* ptr = (char*) dst.malloc_linear(num*primTy.bytes,1 << alignment);
+      memcpy(ptr,prims,num*primTy.bytes);
+      *item.second = NodeRef(size_t(ptr) | (node & align_mask));
+      return;
+    }
+
+    const size_t nodeBytes = compressed ? sizeof(CompressedNode) : sizeof(Node);
+    char* ptr = (char*) dst.malloc_linear(nodeBytes,64);
+    memcpy(ptr,(const char*)size_t(node),nodeBytes);
+    *item.second = NodeRef(size_t(ptr));
+
+    /* leaves follow their parent, inner nodes get copied later */
+    for (size_t c=0; c<N; c++) 
+    {
+      NodeRef& child = compressed ? ((CompressedNode*)ptr)->child(c) : ((Node*)ptr)->child(c);
+      if (child == emptyNode) continue;
+      if (child.isLeaf()) compactCopy(CompactItem(child,&child),dst,children);
+      else children.push_back(CompactItem(child,&child));
+    }
+  }
+
+  void BVH4::compactDepthFirst (const CompactItem& item, LinearAllocatorPerThread& dst) const
+  {
+    std::vector<CompactItem> children;
+    compactCopy(item,dst,children);
+    for (size_t i=0; i<children.size(); i++)
+      compactDepthFirst(children[i],dst);
+  }
+
+  void BVH4::compactVEB (const CompactItem& item, size_t levels, LinearAllocatorPerThread& dst, std::vector<CompactItem>& frontier) const
+  {
+    if (levels <= 1) {
+      compactCopy(item,dst,frontier);
+      return;
+    }
+
+    /* store the top half of the levels first, followed by each subtree below */
+    const size_t top = (levels+1)/2;
+    std::vector<CompactItem> middle;
+    compactVEB(item,top,dst,middle);
+    for (size_t i=0; i<middle.size(); i++)
+      compactVEB(middle[i],levels-top,dst,frontier);
+  }
+
+  bool BVH4::store(std::ostream& out) const {
+    if (compressed) return false;
+    return BVHSerializer<BVH4>::store(this,"BVH4",out);
+  }
+
+  bool BVH4::load(char*& ptr, char* end) {
+    if (compressed) return false;
+    return BVHSerializer<BVH4>::load(this,"BVH4",ptr,end);
+  }
+
   Accel::Intersectors BVH4Bezier1Intersectors(BVH4* bvh)
   {
     Accel::Intersectors intersectors;
@@ -328,6 +571,7 @@ namespace embree
     intersectors.intersector8_filter   = BVH4Triangle4Intersector8ChunkMoeller;
     intersectors.intersector8_nofilter = BVH4Triangle4Intersector8ChunkMoellerNoFilter;
     intersectors.intersector16 = NULL;
+    intersectors.pointQuery1 = BVH4Triangle4PointQuery;
     return intersectors;
   }
 
@@ -341,6 +585,7 @@ namespace embree
     intersectors.intersector8_filter = BVH4Triangle4Intersector8HybridMoeller;
     intersectors.intersector8_nofilter = BVH4Triangle4Intersector8HybridMoellerNoFilter;
     intersectors.intersector16 = NULL;
+    intersectors.pointQuery1 = BVH4Triangle4PointQuery;
     return intersectors;
   }
 
@@ -355,6 +600,7 @@ namespace embree
     intersectors.intersector8_filter   = BVH4Triangle8Intersector8ChunkMoeller;
     intersectors.intersector8_nofilter = BVH4Triangle8Intersector8ChunkMoellerNoFilter;
     intersectors.intersector16 = NULL;
+    intersectors.pointQuery1 = BVH4Triangle8PointQuery;
     return intersectors;
   }
 
@@ -368,6 +614,7 @@ namespace embree
     intersectors.intersector8_filter   = BVH4Triangle8Intersector8HybridMoeller;
     intersectors.intersector8_nofilter = BVH4Triangle8Intersector8HybridMoellerNoFilter;
     intersectors.intersector16 = NULL;
+    intersectors.pointQuery1 = BVH4Triangle8PointQuery;
     return intersectors;
   }
 
@@ -390,6 +637,7 @@ namespace embree
     intersectors.intersector4 = BVH4Triangle4vIntersector4ChunkPluecker;
     intersectors.intersector8 = BVH4Triangle4vIntersector8HybridPluecker;
     intersectors.intersector16 = NULL;
+    intersectors.pointQuery1 = BVH4Triangle4vPointQuery;
     return intersectors;
   }
 
@@ -401,6 +649,7 @@ namespace embree
     intersectors.intersector4 = BVH4Triangle4vIntersector4HybridPluecker;
     intersectors.intersector8 = BVH4Triangle4vIntersector8HybridPluecker;
     intersectors.intersector16 = NULL;
+    intersectors.pointQuery1 = BVH4Triangle4vPointQuery;
     return intersectors;
   }
 
@@ -415,6 +664,30 @@ namespace embree
     return intersectors;
   }
 
+  Accel::Intersectors BVH4CTriangle4Intersectors(BVH4* bvh)
+  {
+    Accel::Intersectors intersectors;
+    intersectors.ptr = bvh;
+    intersectors.intersector1 = BVH4CTriangle4Intersector1Moeller;
+    intersectors.intersector4_filter   = BVH4CTriangle4Intersector4HybridMoeller;
+    intersectors.intersector4_nofilter = BVH4CTriangle4Intersector4HybridMoellerNoFilter;
+    intersectors.intersector8_filter   = BVH4CTriangle4Intersector8HybridMoeller;
+    intersectors.intersector8_nofilter = BVH4CTriangle4Intersector8HybridMoellerNoFilter;
+    intersectors.intersector16 = NULL;
+    return intersectors;
+  }
+
+  Accel::Intersectors BVH4CTriangle4iIntersectors(BVH4* bvh)
+  {
+    Accel::Intersectors intersectors;
+    intersectors.ptr = bvh;
+    intersectors.intersector1 = BVH4CTriangle4iIntersector1Pluecker;
+    intersectors.intersector4 = BVH4CTriangle4iIntersector4HybridPluecker;
+    intersectors.intersector8 = BVH4CTriangle4iIntersector8HybridPluecker;
+    intersectors.intersector16 = NULL;
+    return intersectors;
+  }
+
   Accel* BVH4::BVH4Bezier1(Scene* scene)
   { 
     BVH4* accel = new BVH4(Bezier1Type::type,scene);
@@ -442,7 +715,11 @@ namespace embree
     else if (g_tri_builder == "spatialsplit") builder = BVH4Triangle1Builder(accel,scene,1);
     else if (g_tri_builder == "objectsplit" ) builder = BVH4Triangle1Builder(accel,scene,0);
     else if (g_tri_builder == "morton"      ) builder = BVH4Triangle1BuilderMorton(accel,scene,0);
+    else if (g_tri_builder == "morton64"    ) builder = BVH4Triangle1BuilderMorton(accel,scene,1);
+    else if (g_tri_builder == "morton.restructure"  ) builder = BVH4Triangle1BuilderMorton(accel,scene,2);
+    else if (g_tri_builder == "morton64.restructure") builder = BVH4Triangle1BuilderMorton(accel,scene,3);
     else if (g_tri_builder == "fast"        ) builder = BVH4Triangle1BuilderFast(accel,scene,0);
+    else if (g_tri_builder == "presplits"   ) builder = BVH4Triangle1BuilderFast(accel,scene,1);
     else throw std::runtime_error("unknown builder "+g_tri_builder+" for BVH4<Triangle1>");
 
     return new AccelInstance(accel,builder,intersectors);
@@ -463,12 +740,36 @@ namespace embree
     else if (g_tri_builder == "spatialsplit") builder = BVH4Triangle4Builder(accel,scene,1);
     else if (g_tri_builder == "objectsplit" ) builder = BVH4Triangle4Builder(accel,scene,0);
     else if (g_tri_builder == "morton"      ) builder = BVH4Triangle4BuilderMorton(accel,scene,0);
+    else if (g_tri_builder == "morton64"    ) builder = BVH4Triangle4BuilderMorton(accel,scene,1);
+    else if (g_tri_builder == "morton.restructure"  ) builder = BVH4Triangle4BuilderMorton(accel,scene,2);
+    else if (g_tri_builder == "morton64.restructure") builder = BVH4Triangle4BuilderMorton(accel,scene,3);
     else if (g_tri_builder == "fast"        ) builder = BVH4Triangle4BuilderFast(accel,scene,0);
+    else if (g_tri_builder == "presplits"   ) builder = BVH4Triangle4BuilderFast(accel,scene,1);
     else throw std::runtime_error("unknown builder "+g_tri_builder+" for BVH4<Triangle4>");
 
     return new AccelInstance(accel,builder,intersectors);
   }
 
+  Accel* BVH4::BVH4Triangle4Compressed(Scene* scene)
+  { 
+    BVH4* accel = new BVH4(SceneTriangle4::type,scene);
+    Accel::Intersectors intersectors = BVH4CTriangle4Intersectors(accel);
+    
+    Builder* builder = NULL;
+    if      (g_tri_builder == "default"     ) builder = BVH4Triangle4Builder(accel,scene,0);
+    else if (g_tri_builder == "spatialsplit") builder = BVH4Triangle4Builder(accel,scene,1);
+    else if (g_tri_builder == "objectsplit" ) builder = BVH4Triangle4Builder(accel,scene,0);
+    else if (g_tri_builder == "morton"      ) builder = BVH4Triangle4BuilderMorton(accel,scene,0);
+    else if (g_tri_builder == "morton64"    ) builder = BVH4Triangle4BuilderMorton(accel,scene,1);
+    else if (g_tri_builder == "morton.restructure"  ) builder = BVH4Triangle4BuilderMorton(accel,scene,2);
+    else if (g_tri_builder == "morton64.restructure") builder = BVH4Triangle4BuilderMorton(accel,scene,3);
+    else if (g_tri_builder == "fast"        ) builder = BVH4Triangle4BuilderFast(accel,scene,0);
+    else if (g_tri_builder == "presplits"   ) builder = BVH4Triangle4BuilderFast(accel,scene,1);
+    else throw std::runtime_error("unknown builder "+g_tri_builder+" for BVH4C<Triangle4>");
+
+    return new AccelInstance(accel,new BVH4Compressor(accel,builder),intersectors);
+  }
+
 #if defined (__TARGET_AVX__)
 
   Accel* BVH4::BVH4Triangle8(Scene* scene)
@@ -486,7 +787,11 @@ namespace embree
     else if (g_tri_builder == "spatialsplit") builder = BVH4Triangle8Builder(accel,scene,1);
     else if (g_tri_builder == "objectsplit" ) builder = BVH4Triangle8Builder(accel,scene,0);
     else if (g_tri_builder == "morton"      ) builder = BVH4Triangle8BuilderMorton(accel,scene,0);
+    else if (g_tri_builder == "morton64"    ) builder = BVH4Triangle8BuilderMorton(accel,scene,1);
+    else if (g_tri_builder == "morton.restructure"  ) builder = BVH4Triangle8BuilderMorton(accel,scene,2);
+    else if (g_tri_builder == "morton64.restructure") builder = BVH4Triangle8BuilderMorton(accel,scene,3);
     else if (g_tri_builder == "fast"        ) builder = BVH4Triangle8BuilderFast(accel,scene,0);
+    else if (g_tri_builder == "presplits"   ) builder = BVH4Triangle8BuilderFast(accel,scene,1);
     else throw std::runtime_error("unknown builder "+g_tri_builder+" for BVH4<Triangle8>");
 
     return new AccelInstance(accel,builder,intersectors);
@@ -503,7 +808,11 @@ namespace embree
     else if (g_tri_builder == "spatialsplit") builder = BVH4Triangle1vBuilder(accel,scene,1);
     else if (g_tri_builder == "objectsplit" ) builder = BVH4Triangle1vBuilder(accel,scene,0);
     else if (g_tri_builder == "morton"      ) builder = BVH4Triangle1vBuilderMorton(accel,scene,0);
+    else if (g_tri_builder == "morton64"    ) builder = BVH4Triangle1vBuilderMorton(accel,scene,1);
+    else if (g_tri_builder == "morton.restructure"  ) builder = BVH4Triangle1vBuilderMorton(accel,scene,2);
+    else if (g_tri_builder == "morton64.restructure") builder = BVH4Triangle1vBuilderMorton(accel,scene,3);
     else if (g_tri_builder == "fast"        ) builder = BVH4Triangle1vBuilderFast(accel,scene,0);
+    else if (g_tri_builder == "presplits"   ) builder = BVH4Triangle1vBuilderFast(accel,scene,1);
     else throw std::runtime_error("unknown builder "+g_tri_builder+" for BVH4<Triangle1v>");
         
     return new AccelInstance(accel,builder,intersectors);
@@ -524,7 +833,11 @@ namespace embree
     else if (g_tri_builder == "spatialsplit") builder = BVH4Triangle4vBuilder(accel,scene,1);
     else if (g_tri_builder == "objectsplit" ) builder = BVH4Triangle4vBuilder(accel,scene,0);
     else if (g_tri_builder == "morton"      ) builder = BVH4Triangle4vBuilderMorton(accel,scene,0);
+    else if (g_tri_builder == "morton64"    ) builder = BVH4Triangle4vBuilderMorton(accel,scene,1);
+    else if (g_tri_builder == "morton.restructure"  ) builder = BVH4Triangle4vBuilderMorton(accel,scene,2);
+    else if (g_tri_builder == "morton64.restructure") builder = BVH4Triangle4vBuilderMorton(accel,scene,3);
     else if (g_tri_builder == "fast"        ) builder = BVH4Triangle4vBuilderFast(accel,scene,0);
+    else if (g_tri_builder == "presplits"   ) builder = BVH4Triangle4vBuilderFast(accel,scene,1);
     else throw std::runtime_error("unknown builder "+g_tri_builder+" for BVH4<Triangle4v>");
 
     return new AccelInstance(accel,builder,intersectors);
@@ -540,18 +853,52 @@ namespace embree
     else if (g_tri_builder == "spatialsplit") builder = BVH4Triangle4iBuilder(accel,scene,1);
     else if (g_tri_builder == "objectsplit" ) builder = BVH4Triangle4iBuilder(accel,scene,0);
     else if (g_tri_builder == "fast"        ) builder = BVH4Triangle4iBuilderFast(accel,scene,0);
+    else if (g_tri_builder == "presplits"   ) builder = BVH4Triangle4iBuilderFast(accel,scene,1);
     else if (g_tri_builder == "morton"      ) builder = BVH4Triangle4iBuilderMorton(accel,scene,0);
+    else if (g_tri_builder == "morton64"    ) builder = BVH4Triangle4iBuilderMorton(accel,scene,1);
+    else if (g_tri_builder == "morton.restructure"  ) builder = BVH4Triangle4iBuilderMorton(accel,scene,2);
+    else if (g_tri_builder == "morton64.restructure") builder = BVH4Triangle4iBuilderMorton(accel,scene,3);
     else throw std::runtime_error("unknown builder "+g_tri_builder+" for BVH4<Triangle4i>");
 
     scene->needVertices = true;
     return new AccelInstance(accel,builder,intersectors);
   }
 
+  Accel* BVH4::BVH4Triangle4iCompressed(Scene* scene)
+  {
+    BVH4* accel = new BVH4(SceneTriangle4i::type,scene);
+    Accel::Intersectors intersectors = BVH4CTriangle4iIntersectors(accel);
+
+    Builder* builder = NULL;
+    if      (g_tri_builder == "default"     ) builder = BVH4Triangle4iBuilder(accel,scene,0);
+    else if (g_tri_builder == "spatialsplit") builder = BVH4Triangle4iBuilder(accel,scene,1);
+    else if (g_tri_builder == "objectsplit" ) builder = BVH4Triangle4iBuilder(accel,scene,0);
+    else if (g_tri_builder == "fast"        ) builder = BVH4Triangle4iBuilderFast(accel,scene,0);
+    else if (g_tri_builder == "presplits"   ) builder = BVH4Triangle4iBuilderFast(accel,scene,1);
+    else if (g_tri_builder == "morton"      ) builder = BVH4Triangle4iBuilderMorton(accel,scene,0);
+    else if (g_tri_builder == "morton64"    ) builder = BVH4Triangle4iBuilderMorton(accel,scene,1);
+    else if (g_tri_builder == "morton.restructure"  ) builder = BVH4Triangle4iBuilderMorton(accel,scene,2);
+    else if (g_tri_builder == "morton64.restructure") builder = BVH4Triangle4iBuilderMorton(accel,scene,3);
+    else throw std::runtime_error("unknown builder "+g_tri_builder+" for BVH4C<Triangle4i>");
+
+    scene->needVertices = true;
+    return new AccelInstance(accel,new BVH4Compressor(accel,builder),intersectors);
+  }
+
+  /*! returns the mode of the morton builder for dynamic meshes */
+  static size_t mortonBuilderMode()
+  {
+    if (g_tri_builder == "morton64"            ) return 1;
+    if (g_tri_builder == "morton.restructure"  ) return 2;
+    if (g_tri_builder == "morton64.restructure") return 3;
+    return 0;
+  }
+
   void createTriangleMeshTriangle1Morton(TriangleMesh* mesh, BVH4*& accel, Builder*& builder)
   {
     if (mesh->numTimeSteps != 1) throw std::runtime_error("internal error");
     accel = new BVH4(TriangleMeshTriangle1::type,mesh->parent);
-    builder = BVH4Triangle1MeshBuilderMorton(accel,mesh,0);
+    builder = BVH4Triangle1MeshBuilderMorton(accel,mesh,mortonBuilderMode());
   } 
 
   void createTriangleMeshTriangle1(TriangleMesh* mesh, BVH4*& accel, Builder*& builder)
@@ -561,7 +908,7 @@ namespace embree
     switch (mesh->flags) {
     case RTC_GEOMETRY_STATIC:     builder = BVH4Triangle1MeshBuilderFast(accel,mesh,0); break;
     case RTC_GEOMETRY_DEFORMABLE: builder = BVH4Triangle1MeshRefitFast(accel,mesh,0); break;
-    case RTC_GEOMETRY_DYNAMIC:    builder = BVH4Triangle1MeshBuilderMorton(accel,mesh,0); break;
+    case RTC_GEOMETRY_DYNAMIC:    builder = BVH4Triangle1MeshBuilderMorton(accel,mesh,mortonBuilderMode()); break;
     default: throw std::runtime_error("internal error"); 
     }
   } 
@@ -573,7 +920,7 @@ namespace embree
     switch (mesh->flags) {
     case RTC_GEOMETRY_STATIC:     builder = BVH4Triangle4MeshBuilderFast(accel,mesh,0); break;
     case RTC_GEOMETRY_DEFORMABLE: builder = BVH4Triangle4MeshRefitFast(accel,mesh,0); break;
-    case RTC_GEOMETRY_DYNAMIC:    builder = BVH4Triangle4MeshBuilderMorton(accel,mesh,0); break;
+    case RTC_GEOMETRY_DYNAMIC:    builder = BVH4Triangle4MeshBuilderMorton(accel,mesh,mortonBuilderMode()); break;
     default: throw std::runtime_error("internal error"); 
     }
   } 
@@ -585,7 +932,7 @@ namespace embree
     switch (mesh->flags) {
     case RTC_GEOMETRY_STATIC:     builder = BVH4Triangle1vMeshBuilderFast(accel,mesh,0); break;
     case RTC_GEOMETRY_DEFORMABLE: builder = BVH4Triangle1vMeshRefitFast  (accel,mesh,0); break;
-    case RTC_GEOMETRY_DYNAMIC:    builder = BVH4Triangle1vMeshBuilderMorton(accel,mesh,0); break;
+    case RTC_GEOMETRY_DYNAMIC:    builder = BVH4Triangle1vMeshBuilderMorton(accel,mesh,mortonBuilderMode()); break;
     default: throw std::runtime_error("internal error"); 
     }
   } 
@@ -597,7 +944,7 @@ namespace embree
     switch (mesh->flags) {
     case RTC_GEOMETRY_STATIC:     builder = BVH4Triangle4vMeshBuilderFast(accel,mesh,0); break;
     case RTC_GEOMETRY_DEFORMABLE: builder = BVH4Triangle4vMeshRefitFast(accel,mesh,0); break;
-    case RTC_GEOMETRY_DYNAMIC:    builder = BVH4Triangle4vMeshBuilderMorton(accel,mesh,0); break;
+    case RTC_GEOMETRY_DYNAMIC:    builder = BVH4Triangle4vMeshBuilderMorton(accel,mesh,mortonBuilderMode()); break;
     default: throw std::runtime_error("internal error"); 
     }
   } 
@@ -609,7 +956,7 @@ namespace embree
     switch (mesh->flags) {
     case RTC_GEOMETRY_STATIC:     builder = BVH4Triangle4iMeshBuilderFast(accel,mesh,0); break;
     case RTC_GEOMETRY_DEFORMABLE: builder = BVH4Triangle4iMeshRefitFast(accel,mesh,0); break;
-    case RTC_GEOMETRY_DYNAMIC:    builder = BVH4Triangle4iMeshBuilderMorton(accel,mesh,0); break;
+    case RTC_GEOMETRY_DYNAMIC:    builder = BVH4Triangle4iMeshBuilderMorton(accel,mesh,mortonBuilderMode()); break;
     default: throw std::runtime_error("internal error"); 
     }
   } 
@@ -688,6 +1035,26 @@ namespace embree
     return new AccelInstance(accel,builder,intersectors);
   }
 
+#endif
+
+  Accel* BVH4::BVH4Triangle4PreSplit(Scene* scene)
+  {
+    BVH4* accel = new BVH4(SceneTriangle4::type,scene);
+    Builder* builder = BVH4Triangle4BuilderFast(accel,scene,1);
+    Accel::Intersectors intersectors = BVH4Triangle4IntersectorsHybrid(accel);
+    return new AccelInstance(accel,builder,intersectors);
+  }
+
+#if defined (__TARGET_AVX__)
+
+  Accel* BVH4::BVH4Triangle8PreSplit(Scene* scene)
+  {
+    BVH4* accel = new BVH4(SceneTriangle8::type,scene);
+    Builder* builder = BVH4Triangle8BuilderFast(accel,scene,1);
+    Accel::Intersectors intersectors = BVH4Triangle8IntersectorsHybrid(accel);
+    return new AccelInstance(accel,builder,intersectors);
+  }
+
 #endif
 
   Accel* BVH4::BVH4Triangle1ObjectSplit(Scene* scene)
@@ -757,6 +1124,16 @@ namespace embree
     }
     
     void pack(char* This, atomic_set<PrimRefBlock>::block_iterator_unsafe& prims, void* geom) const {}
+
+    BBox3fa update(char* prim, size_t num, void* geom) const 
+    {
+      BBox3fa bounds = empty;
+      for (size_t i=0; i<num; i++) {
+        const AccelSetItem& item = ((AccelSetItem*)prim)[i];
+        bounds.extend(item.accel->bounds(item.item));
+      }
+      return bounds;
+    }
   };
 
   static VirtualAccelObjectType virtual_accel_object_ty;
@@ -770,7 +1147,9 @@ namespace embree
     intersectors.intersector4 = BVH4VirtualIntersector4Chunk;
     intersectors.intersector8 = BVH4VirtualIntersector8Chunk;
     intersectors.intersector16 = NULL;
-    Builder* builder = BVH4UserGeometryBuilderFast(accel,scene,0);
+    Builder* builder = NULL;
+    if (scene->isDynamic()) builder = BVH4UserGeometryRefitFast(accel,scene,0); // refit when only instance transforms change
+    else                    builder = BVH4UserGeometryBuilderFast(accel,scene,0);
     return new AccelInstance(accel,builder,intersectors);
   }
 
@@ -31,8 +31,9 @@ namespace embree
     ALIGNED_CLASS;
   public:
     
-    /*! forward declaration of node type */
+    /*! forward declaration of node types */
     struct Node;
+    struct CompressedNode;
 
     /*! branching width of the tree */
     static const size_t N = 4;
@@ -99,6 +100,10 @@ namespace embree
       /*! returns node pointer */
       __forceinline       Node* node()       { assert(isNode()); return (      Node*)ptr; }
       __forceinline const Node* node() const { assert(isNode()); return (const Node*)ptr; }
+
+      /*! returns compressed node pointer */
+      __forceinline       CompressedNode* compressedNode()       { assert(isNode()); return (      CompressedNode*)ptr; }
+      __forceinline const CompressedNode* compressedNode() const { assert(isNode()); return (const CompressedNode*)ptr; }
       
       /*! returns leaf pointer */
       __forceinline char* leaf(size_t& num) const {
@@ -171,6 +176,115 @@ namespace embree
       NodeRef children[N];    //!< Pointer to the 4 children (can be a node or leaf)
     };
 
+    /*! BVH4 Node with child bounds quantized to 8 bits relative to the
+     *  bounds of the node. The node takes 80 instead of 128 bytes, as
+     *  the four 64 bit child references are kept to stay compatible
+     *  with NodeRef and the BVH4 leaf encoding. */
+    struct CompressedNode
+    {
+      /*! Clears the node. */
+      __forceinline void clear() 
+      {
+        offset = Vec3f(0.0f); scale = Vec3f(1.0f);
+        for (size_t i=0; i<N; i++) {
+          lower_x[i] = lower_y[i] = lower_z[i] = 255;
+          upper_x[i] = upper_y[i] = upper_z[i] = 0;
+          children[i] = emptyNode;
+        }
+      }
+
+      /*! Sets the bounds of the node, all child bounds have to lie inside. */
+      __forceinline void set(const BBox3fa& bounds) 
+      {
+        offset = Vec3f(bounds.lower.x,bounds.lower.y,bounds.lower.z);
+        scale.x = quantizeScale(bounds.lower.x,bounds.upper.x);
+        scale.y = quantizeScale(bounds.lower.y,bounds.upper.y);
+        scale.z = quantizeScale(bounds.lower.z,bounds.upper.z);
+      }
+
+      /*! Sets bounding box of child. The quantized box always encloses the original box. */
+      __forceinline void set(size_t i, const BBox3fa& bounds) 
+      {
+        assert(i < N);
+        lower_x[i] = quantizeLower(offset.x,scale.x,bounds.lower.x); upper_x[i] = quantizeUpper(offset.x,scale.x,bounds.upper.x);
+        lower_y[i] = quantizeLower(offset.y,scale.y,bounds.lower.y); upper_y[i] = quantizeUpper(offset.y,scale.y,bounds.upper.y);
+        lower_z[i] = quantizeLower(offset.z,scale.z,bounds.lower.z); upper_z[i] = quantizeUpper(offset.z,scale.z,bounds.upper.z);
+      }
+
+      /*! Sets bounding box and ID of child. */
+      __forceinline void set(size_t i, const BBox3fa& bounds, const NodeRef& childID) {
+        set(i,bounds);
+        children[i] = childID;
+      }
+
+      /*! Returns bounds of specified child. */
+      __forceinline BBox3fa bounds(size_t i) const 
+      {
+        assert(i < N);
+        const Vec3fa lower(decode(offset.x,scale.x,lower_x[i]),decode(offset.y,scale.y,lower_y[i]),decode(offset.z,scale.z,lower_z[i]));
+        const Vec3fa upper(decode(offset.x,scale.x,upper_x[i]),decode(offset.y,scale.y,upper_y[i]),decode(offset.z,scale.z,upper_z[i]));
+        return BBox3fa(lower,upper);
+      }
+
+      /*! Decodes one plane of all 4 children, the byte offset selects lower_x (0), upper_x (4), lower_y (8), ... */
+      __forceinline ssef decode4(size_t ofs, float offset, float scale) const {
+        const unsigned char* q = (const unsigned char*)&lower_x + ofs;
+#if defined(__SSE4_1__)
+        const ssei i = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(*(const int*)q));
+#else
+        const ssei i(q[0],q[1],q[2],q[3]);
+#endif
+        return ssef(offset) + ssef(scale)*ssef(i);
+      }
+
+      /*! Returns reference to specified child */
+      __forceinline       NodeRef& child(size_t i)       { assert(i<N); return children[i]; }
+      __forceinline const NodeRef& child(size_t i) const { assert(i<N); return children[i]; }
+
+    private:
+
+      /*! decodes a single quantized plane */
+      static __forceinline float decode(float offset, float scale, unsigned char q) { 
+        return offset + scale*float(q); 
+      }
+
+      /*! calculates scale such that 255 maps to the upper bound */
+      static __forceinline float quantizeScale(float lower, float upper) 
+      {
+        float scale = (upper-lower)/255.0f;
+        if (scale <= 0.0f) return 1.0f;
+        for (float eps=4.0f*float(ulp); decode(lower,scale,255) < upper; eps *= 2.0f) scale *= 1.0f+eps;
+        return scale;
+      }
+
+      /*! rounds lower bound down */
+      static __forceinline unsigned char quantizeLower(float offset, float scale, float lower) 
+      {
+        int q = (int) clamp(floorf((lower-offset)/scale),0.0f,255.0f);
+        while (q > 0 && decode(offset,scale,q) > lower) q--;
+        return (unsigned char) q;
+      }
+
+      /*! rounds upper bound up */
+      static __forceinline unsigned char quantizeUpper(float offset, float scale, float upper) 
+      {
+        int q = (int) clamp(ceilf((upper-offset)/scale),0.0f,255.0f);
+        while (q < 255 && decode(offset,scale,q) < upper) q++;
+        return (unsigned char) q;
+      }
+
+    public:
+      NodeRef children[N];      //!< Pointer to the 4 children (can be a node or leaf)
+      Vec3f offset;             //!< lower bounds of the node
+      Vec3f scale;              //!< size of one quantization step
+      unsigned char lower_x[N]; //!< X dimension of quantized lower bounds of all 4 children.
+      unsigned char upper_x[N]; //!< X dimension of quantized upper bounds of all 4 children.
+      unsigned char lower_y[N]; //!< Y dimension of quantized lower bounds of all 4 children.
+      unsigned char upper_y[N]; //!< Y dimension of quantized upper bounds of all 4 children.
+      unsigned char lower_z[N]; //!< Z dimension of quantized lower bounds of all 4 children.
+      unsigned char upper_z[N]; //!< Z dimension of quantized upper bounds of all 4 children.
+    };
+
     /*! swap the children of two nodes */
     __forceinline static void swap(Node* a, size_t i, Node* b, size_t j)
     {
@@ -221,6 +335,8 @@ namespace embree
     static Accel* BVH4Triangle1v(Scene* scene);
     static Accel* BVH4Triangle4v(Scene* scene);
     static Accel* BVH4Triangle4i(Scene* scene);
+    static Accel* BVH4Triangle4Compressed(Scene* scene);
+    static Accel* BVH4Triangle4iCompressed(Scene* scene);
     static Accel* BVH4UserGeometry(Scene* scene);
     
     static Accel* BVH4BVH4Triangle1Morton(Scene* scene);
@@ -233,6 +349,8 @@ namespace embree
     static Accel* BVH4Triangle1SpatialSplit(Scene* scene);
     static Accel* BVH4Triangle4SpatialSplit(Scene* scene);
     static Accel* BVH4Triangle8SpatialSplit(Scene* scene);
+    static Accel* BVH4Triangle4PreSplit(Scene* scene);
+    static Accel* BVH4Triangle8PreSplit(Scene* scene);
     static Accel* BVH4Triangle1ObjectSplit(Scene* scene);
     static Accel* BVH4Triangle4ObjectSplit(Scene* scene);
     static Accel* BVH4Triangle8ObjectSplit(Scene* scene);
@@ -252,12 +370,68 @@ namespace embree
     /*! Clears the barrier bits of a subtree. */
     void clearBarrier(NodeRef& node);
 
+    /*! writes the BVH to a stream */
+    bool store (std::ostream& out) const;
+
+    /*! restores the BVH from a mapped file */
+    bool load (char*& ptr, char* end);
+
+    /*! writes the boxes of the subtrees depth levels below the root, at most maxBounds of them */
+    size_t childBounds (size_t depth, BBox3fa* bounds_o, size_t maxBounds) const;
+
+    /*! compacts the BVH if requested by the bvh_layout setting */
+    void immutable ();
+
+    /*! copies the BVH into a single memory block, nodes get stored
+     *  in depth first or van Emde Boas order with the primitive blocks
+     *  of their leaves directly behind them */
+    void compact (bool veb);
+
+    /*! interleaves the BVH memory over all NUMA nodes, or creates one copy of the BVH per node */
+    void numaDistribute (bool replicate);
+
+    /*! returns the root of the copy of the BVH that is local to the NUMA node of the calling thread */
+    __forceinline NodeRef getRoot() const {
+      if (likely(numaRoots.empty())) return root;
+      return numaRoots[getCurrentNumaNode()];
+    }
+
+  private:
+    size_t childBounds (NodeRef node, const BBox3fa& bounds, size_t depth, BBox3fa* bounds_o, size_t maxBounds) const;
+
+    /*! reference to a node of the old BVH and the slot in the compacted BVH that points to it */
+    typedef std::pair<NodeRef,NodeRef*> CompactItem;
+
+    /*! returns the number of bytes required to store a copy of the BVH */
+    size_t compactBytes (size_t& levels, size_t& numNodes) const;
+
+    /*! copies the BVH into a memory region that is large enough, returns the root of the copy */
+    NodeRef compactTo (LinearAllocatorPerThread& dst, size_t levels, bool veb) const;
+
+    /*! counts nodes and leaf bytes of a subtree, returns the number of node levels */
+    size_t compactCount (NodeRef node, size_t& numNodes, size_t& leafBytes) const;
+
+    /*! copies a node together with its leaves, and appends its inner children to the list */
+    void compactCopy (const CompactItem& item, LinearAllocatorPerThread& dst, std::vector<CompactItem>& children) const;
+
+    /*! copies a subtree in depth first order */
+    void compactDepthFirst (const CompactItem& item, LinearAllocatorPerThread& dst) const;
+
+    /*! copies the top levels of a subtree in van Emde Boas order, and appends the subtrees below to the frontier */
+    void compactVEB (const CompactItem& item, size_t levels, LinearAllocatorPerThread& dst, std::vector<CompactItem>& frontier) const;
+
+  public:
+
     LinearAllocatorPerThread alloc;
 
     __forceinline Node* allocNode(size_t thread) {
       Node* node = (Node*) alloc.malloc(thread,sizeof(Node),1 << alignment); node->clear(); return node;
     }
 
+    __forceinline CompressedNode* allocCompressedNode(size_t thread) {
+      CompressedNode* node = (CompressedNode*) alloc.malloc(thread,sizeof(CompressedNode),1 << alignment); node->clear(); return node;
+    }
+
     __forceinline char* allocPrimitiveBlocks(size_t thread, size_t num) {
       return (char*) alloc.malloc(thread,num*primTy.bytes,1 << alignment);
     }
@@ -266,7 +440,12 @@ namespace embree
     __forceinline NodeRef encodeNode(Node* node) { 
       return NodeRef((size_t) node);
     }
-    
+
+    /*! Encodes a compressed node */
+    __forceinline NodeRef encodeNode(CompressedNode* node) {
+      return NodeRef((size_t) node);
+    }
+
     /*! Encodes a leaf */
     __forceinline NodeRef encodeLeaf(void* tri, size_t num) {
       assert(!((size_t)tri & align_mask)); 
@@ -275,10 +454,8 @@ namespace embree
 
   public:
     
-    /*! calculates the amount of bytes allocated */
-    size_t bytesAllocated() {
-      return alloc.bytes();
-    }
+    /*! calculates the amount of bytes allocated, including object BVHs and NUMA copies */
+    size_t bytesAllocated() const;
 
   public:
     const PrimitiveType& primTy;       //!< primitive type stored in the BVH
@@ -286,10 +463,16 @@ namespace embree
     NodeRef root;                      //!< Root node
     size_t numPrimitives;
     size_t numVertices;
+    bool compressed;                   //!< set if nodes are stored as CompressedNode
 
     /*! data arrays for fast builders */
   public:
     std::vector<BVH4*> objects;
+
+    /*! copies of the BVH for each NUMA node */
+  private:
+    std::vector<LinearAllocatorPerThread*> numaAllocs;
+    std::vector<NodeRef> numaRoots;
   };
 
   // FIXME: move the below code to somewhere else
@@ -37,9 +37,24 @@ namespace embree
           lower.w = area(this->bounds());
       }
       
+      __forceinline BuildRef (const BBox3fa& bounds, BVH4::NodeRef node, size_t objectID) 
+        : lower(bounds.lower), upper(bounds.upper), node(node)
+      {
+        if (node.isLeaf())
+          lower.w = 0.0f;
+        else
+          lower.w = area(this->bounds());
+        upper.a = objectID;
+      }
+      
       __forceinline BBox3fa bounds () const {
         return BBox3fa(lower,upper);
       }
+
+      /*! returns the ID of the object the reference points into */
+      __forceinline size_t objectID () const {
+        return upper.a;
+      }
       
       friend bool operator< (const BuildRef& a, const BuildRef& b) {
         return a.lower.w < b.lower.w;
@@ -19,6 +19,7 @@
 #include "bvh4_statistics.h"
 #include "bvh4_builder_binner.h"
 #include "builders/primrefgen.h"
+#include "builders/presplit.h"
 
 #include "geometry/bezier1.h"
 #include "geometry/bezier1i.h"
@@ -67,15 +68,15 @@ namespace embree
       needAllThreads = geom->size() > THRESHOLD_FOR_SINGLE_THREADED;
     }
 
-    BVH4TriangleBuilderFast::BVH4TriangleBuilderFast (BVH4* bvh, Scene* scene, 
+    BVH4TriangleBuilderFast::BVH4TriangleBuilderFast (BVH4* bvh, Scene* scene, size_t mode,
 						      size_t logBlockSize, size_t logSAHBlockSize, bool needVertices, size_t primBytes, 
 						      const size_t minLeafSize, const size_t maxLeafSize)
-      : scene(scene), mesh(NULL), BVH4BuilderFast(bvh,logBlockSize,logSAHBlockSize,needVertices,primBytes,minLeafSize,maxLeafSize) {}
+      : scene(scene), mesh(NULL), enablePreSplits(mode > 0), BVH4BuilderFast(bvh,logBlockSize,logSAHBlockSize,needVertices,primBytes,minLeafSize,maxLeafSize) {}
 
     BVH4TriangleBuilderFast::BVH4TriangleBuilderFast (BVH4* bvh, TriangleMesh* mesh, 
 						      size_t logBlockSize, size_t logSAHBlockSize, bool needVertices, size_t primBytes, 
 						      const size_t minLeafSize, const size_t maxLeafSize)
-      : scene(mesh->parent), mesh(mesh), BVH4BuilderFast(bvh,logBlockSize,logSAHBlockSize,needVertices,primBytes,minLeafSize,maxLeafSize) 
+      : scene(mesh->parent), mesh(mesh), enablePreSplits(false), BVH4BuilderFast(bvh,logBlockSize,logSAHBlockSize,needVertices,primBytes,minLeafSize,maxLeafSize) 
     {
       needAllThreads = mesh->numTriangles > THRESHOLD_FOR_SINGLE_THREADED;
     }
@@ -95,25 +96,25 @@ namespace embree
     BVH4Bezier1iBuilderFast::BVH4Bezier1iBuilderFast (BVH4* bvh, Scene* scene)
       : BVH4BezierBuilderFast(bvh,scene,0,0,false,sizeof(Bezier1i),1,1) {}
 
-    BVH4Triangle1BuilderFast::BVH4Triangle1BuilderFast (BVH4* bvh, Scene* scene)
-      : BVH4TriangleBuilderFast(bvh,scene,0,0,false,sizeof(Triangle1),2,inf) {}
+    BVH4Triangle1BuilderFast::BVH4Triangle1BuilderFast (BVH4* bvh, Scene* scene, size_t mode)
+      : BVH4TriangleBuilderFast(bvh,scene,mode,0,0,false,sizeof(Triangle1),2,inf) {}
 
-    BVH4Triangle4BuilderFast::BVH4Triangle4BuilderFast (BVH4* bvh, Scene* scene)
-      : BVH4TriangleBuilderFast(bvh,scene,2,2,false,sizeof(Triangle4),4,inf) {}
+    BVH4Triangle4BuilderFast::BVH4Triangle4BuilderFast (BVH4* bvh, Scene* scene, size_t mode)
+      : BVH4TriangleBuilderFast(bvh,scene,mode,2,2,false,sizeof(Triangle4),4,inf) {}
 
 #if defined(__AVX__)
-    BVH4Triangle8BuilderFast::BVH4Triangle8BuilderFast (BVH4* bvh, Scene* scene)
-      : BVH4TriangleBuilderFast(bvh,scene,3,2,false,sizeof(Triangle8),8,inf) {}
+    BVH4Triangle8BuilderFast::BVH4Triangle8BuilderFast (BVH4* bvh, Scene* scene, size_t mode)
+      : BVH4TriangleBuilderFast(bvh,scene,mode,3,2,false,sizeof(Triangle8),8,inf) {}
 #endif
     
-    BVH4Triangle1vBuilderFast::BVH4Triangle1vBuilderFast (BVH4* bvh, Scene* scene)
-      : BVH4TriangleBuilderFast(bvh,scene,0,0,false,sizeof(Triangle1v),2,inf) {}
+    BVH4Triangle1vBuilderFast::BVH4Triangle1vBuilderFast (BVH4* bvh, Scene* scene, size_t mode)
+      : BVH4TriangleBuilderFast(bvh,scene,mode,0,0,false,sizeof(Triangle1v),2,inf) {}
 
-    BVH4Triangle4vBuilderFast::BVH4Triangle4vBuilderFast (BVH4* bvh, Scene* scene)
-      : BVH4TriangleBuilderFast(bvh,scene,2,2,false,sizeof(Triangle4v),4,inf) {}
+    BVH4Triangle4vBuilderFast::BVH4Triangle4vBuilderFast (BVH4* bvh, Scene* scene, size_t mode)
+      : BVH4TriangleBuilderFast(bvh,scene,mode,2,2,false,sizeof(Triangle4v),4,inf) {}
     
-    BVH4Triangle4iBuilderFast::BVH4Triangle4iBuilderFast (BVH4* bvh, Scene* scene)
-      : BVH4TriangleBuilderFast(bvh,scene,2,2,true,sizeof(Triangle4i),4,inf) {}
+    BVH4Triangle4iBuilderFast::BVH4Triangle4iBuilderFast (BVH4* bvh, Scene* scene, size_t mode)
+      : BVH4TriangleBuilderFast(bvh,scene,mode,2,2,true,sizeof(Triangle4i),4,inf) {}
 
     BVH4Triangle1BuilderFast::BVH4Triangle1BuilderFast (BVH4* bvh, TriangleMesh* mesh)
       : BVH4TriangleBuilderFast(bvh,mesh,0,0,false,sizeof(Triangle1),2,inf) {}
@@ -151,12 +152,12 @@ namespace embree
     void BVH4BuilderFast::build(size_t threadIndex, size_t threadCount) 
     {
       /* calculate size of scene */
-      size_t numPrimitivesOld = numPrimitives;
       bvh->numPrimitives = numPrimitives = number_of_primitives();
+      const size_t numPrimRefs = number_of_primitive_refs();
       needAllThreads = numPrimitives > THRESHOLD_FOR_SINGLE_THREADED;
 	  
       /* initialize BVH */
-      bvh->init(numPrimitives, needAllThreads ? (threadCount+1) : 1); // threadCount+1 for toplevel build
+      bvh->init(numPrimRefs, needAllThreads ? (threadCount+1) : 1); // threadCount+1 for toplevel build
 
       /* skip build for empty scene */
       if (numPrimitives == 0) 
@@ -167,10 +168,10 @@ namespace embree
         std::cout << "building BVH4<" << bvh->primTy.name << "> with " << TOSTRING(isa) "::BVH4BuilderFast ... " << std::flush;
       
       /* allocate build primitive array */
-      if (numPrimitivesOld != numPrimitives)
+      if (bytesPrims != numPrimRefs * sizeof(PrimRef))
       {
 	if (prims) os_free(prims,bytesPrims);
-	bytesPrims = numPrimitives * sizeof(PrimRef);
+	bytesPrims = numPrimRefs * sizeof(PrimRef);
         prims = (PrimRef* ) os_malloc(bytesPrims);  memset(prims,0,bytesPrims);
       }
       
@@ -256,16 +257,24 @@ namespace embree
       else      return scene->numTriangles;
     }
     
+    size_t BVH4TriangleBuilderFast::number_of_primitive_refs() 
+    {
+      if (enablePreSplits) return PreSplitArrayGen::capacity(numPrimitives);
+      else                 return numPrimitives;
+    }
+    
     void BVH4TriangleBuilderFast::create_primitive_array_sequential(size_t threadIndex, size_t threadCount, PrimInfo& pinfo)
     {
       if (mesh) PrimRefArrayGenFromGeometry<TriangleMesh>::generate_sequential(threadIndex, threadCount, mesh , prims, pinfo);
       else      PrimRefArrayGen                          ::generate_sequential(threadIndex, threadCount, scene, TRIANGLE_MESH, 1, prims, pinfo);
+      if (enablePreSplits) PreSplitArrayGen::split_sequential(threadIndex, threadCount, scene, prims, number_of_primitive_refs(), pinfo);
     }
 
     void BVH4TriangleBuilderFast::create_primitive_array_parallel  (size_t threadIndex, size_t threadCount, PrimInfo& pinfo) 
     {
       if (mesh) PrimRefArrayGenFromGeometry<TriangleMesh>::generate_parallel(threadIndex, threadCount, mesh , prims, pinfo);
       else      PrimRefArrayGen                          ::generate_parallel(threadIndex, threadCount, scene, TRIANGLE_MESH, 1, prims, pinfo);
+      if (enablePreSplits) PreSplitArrayGen::split_parallel(threadIndex, threadCount, scene, prims, number_of_primitive_refs(), pinfo);
     }
 
     // =======================================================================================================
@@ -779,7 +788,7 @@ namespace embree
 
       /* create initial build record */
       BuildRecord br;
-      br.init(pinfo,0,numPrimitives);
+      br.init(pinfo,0,pinfo.size());
       br.depth = 1;
       br.parent = &bvh->root;
 
@@ -812,7 +821,7 @@ namespace embree
 
       /* create initial build record */
       BuildRecord br;
-      br.init(pinfo,0,numPrimitives);
+      br.init(pinfo,0,pinfo.size());
       br.depth = 1;
       br.parent = &bvh->root;
       
@@ -854,14 +863,14 @@ namespace embree
     
     Builder* BVH4Bezier1BuilderFast    (void* bvh, Scene* scene, size_t mode) { return new class BVH4Bezier1BuilderFast ((BVH4*)bvh,scene); }
     Builder* BVH4Bezier1iBuilderFast   (void* bvh, Scene* scene, size_t mode) { return new class BVH4Bezier1iBuilderFast ((BVH4*)bvh,scene); }
-    Builder* BVH4Triangle1BuilderFast  (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle1BuilderFast ((BVH4*)bvh,scene); }
-    Builder* BVH4Triangle4BuilderFast  (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle4BuilderFast ((BVH4*)bvh,scene); }
+    Builder* BVH4Triangle1BuilderFast  (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle1BuilderFast ((BVH4*)bvh,scene,mode); }
+    Builder* BVH4Triangle4BuilderFast  (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle4BuilderFast ((BVH4*)bvh,scene,mode); }
 #if defined(__AVX__)
-    Builder* BVH4Triangle8BuilderFast  (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle8BuilderFast ((BVH4*)bvh,scene); }
+    Builder* BVH4Triangle8BuilderFast  (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle8BuilderFast ((BVH4*)bvh,scene,mode); }
 #endif
-    Builder* BVH4Triangle1vBuilderFast (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle1vBuilderFast((BVH4*)bvh,scene); }
-    Builder* BVH4Triangle4vBuilderFast (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle4vBuilderFast((BVH4*)bvh,scene); }
-    Builder* BVH4Triangle4iBuilderFast (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle4iBuilderFast((BVH4*)bvh,scene); }
+    Builder* BVH4Triangle1vBuilderFast (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle1vBuilderFast((BVH4*)bvh,scene,mode); }
+    Builder* BVH4Triangle4vBuilderFast (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle4vBuilderFast((BVH4*)bvh,scene,mode); }
+    Builder* BVH4Triangle4iBuilderFast (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle4iBuilderFast((BVH4*)bvh,scene,mode); }
     Builder* BVH4UserGeometryBuilderFast(void* bvh, Scene* scene, size_t mode) { return new class BVH4UserGeometryBuilderFast((BVH4*)bvh,scene); }
 
     Builder* BVH4Bezier1MeshBuilderFast    (void* bvh, BezierCurves* geom, size_t mode) { return new class BVH4Bezier1BuilderFast ((BVH4*)bvh,geom); }
@@ -119,6 +119,9 @@ namespace embree
 
       /*! compute number of primitives */
       virtual size_t number_of_primitives() = 0;
+
+      /*! compute size of build primitive array */
+      virtual size_t number_of_primitive_refs() { return numPrimitives; }
     
       /*! creates build primitive array (sequential version) */
       virtual void create_primitive_array_sequential(size_t threadIndex, size_t threadCount, PrimInfo& pinfo) = 0;
@@ -205,20 +208,22 @@ namespace embree
     class BVH4TriangleBuilderFast : public BVH4BuilderFast
     {
     public:
-      BVH4TriangleBuilderFast (BVH4* bvh, Scene* scene,       size_t logBlockSize, size_t logSAHBlockSize, bool needVertices, size_t primBytes, const size_t minLeafSize, const size_t maxLeafSize);
+      BVH4TriangleBuilderFast (BVH4* bvh, Scene* scene,       size_t mode, size_t logBlockSize, size_t logSAHBlockSize, bool needVertices, size_t primBytes, const size_t minLeafSize, const size_t maxLeafSize);
       BVH4TriangleBuilderFast (BVH4* bvh, TriangleMesh* mesh, size_t logBlockSize, size_t logSAHBlockSize, bool needVertices, size_t primBytes, const size_t minLeafSize, const size_t maxLeafSize);
       size_t number_of_primitives();
+      size_t number_of_primitive_refs();
       void create_primitive_array_sequential(size_t threadIndex, size_t threadCount, PrimInfo& pinfo);
       void create_primitive_array_parallel  (size_t threadIndex, size_t threadCount, PrimInfo& pinfo) ;
     public:
       Scene* scene;         //!< input scene
       TriangleMesh* mesh;   //!< input mesh
+      bool enablePreSplits; //!< splits large triangles before the build
     };
 
     class BVH4Triangle1BuilderFast : public BVH4TriangleBuilderFast
     {
     public:
-      BVH4Triangle1BuilderFast (BVH4* bvh, Scene* scene);
+      BVH4Triangle1BuilderFast (BVH4* bvh, Scene* scene, size_t mode);
       BVH4Triangle1BuilderFast (BVH4* bvh, TriangleMesh* mesh);
       void createSmallLeaf(BuildRecord& current, Allocator& leafAlloc, size_t threadID);
     };
@@ -226,7 +231,7 @@ namespace embree
     class BVH4Triangle4BuilderFast : public BVH4TriangleBuilderFast
     {
     public:
-      BVH4Triangle4BuilderFast (BVH4* bvh, Scene* scene);
+      BVH4Triangle4BuilderFast (BVH4* bvh, Scene* scene, size_t mode);
       BVH4Triangle4BuilderFast (BVH4* bvh, TriangleMesh* mesh);
       void createSmallLeaf(BuildRecord& current, Allocator& leafAlloc, size_t threadID);
     };
@@ -234,7 +239,7 @@ namespace embree
     class BVH4Triangle8BuilderFast : public BVH4TriangleBuilderFast
     {
     public:
-      BVH4Triangle8BuilderFast (BVH4* bvh, Scene* scene);
+      BVH4Triangle8BuilderFast (BVH4* bvh, Scene* scene, size_t mode);
       BVH4Triangle8BuilderFast (BVH4* bvh, TriangleMesh* mesh);
       void createSmallLeaf(BuildRecord& current, Allocator& leafAlloc, size_t threadID);
     };
@@ -242,7 +247,7 @@ namespace embree
     class BVH4Triangle1vBuilderFast : public BVH4TriangleBuilderFast
     {
     public:
-      BVH4Triangle1vBuilderFast (BVH4* bvh, Scene* scene);
+      BVH4Triangle1vBuilderFast (BVH4* bvh, Scene* scene, size_t mode);
       BVH4Triangle1vBuilderFast (BVH4* bvh, TriangleMesh* mesh);
       void createSmallLeaf(BuildRecord& current, Allocator& leafAlloc, size_t threadID);
     };
@@ -250,7 +255,7 @@ namespace embree
     class BVH4Triangle4vBuilderFast : public BVH4TriangleBuilderFast
     {
     public:
-      BVH4Triangle4vBuilderFast (BVH4* bvh, Scene* scene);
+      BVH4Triangle4vBuilderFast (BVH4* bvh, Scene* scene, size_t mode);
       BVH4Triangle4vBuilderFast (BVH4* bvh, TriangleMesh* mesh);
       void createSmallLeaf(BuildRecord& current, Allocator& leafAlloc, size_t threadID);
     };
@@ -258,7 +263,7 @@ namespace embree
     class BVH4Triangle4iBuilderFast : public BVH4TriangleBuilderFast
     {
     public:
-      BVH4Triangle4iBuilderFast (BVH4* bvh, Scene* scene);
+      BVH4Triangle4iBuilderFast (BVH4* bvh, Scene* scene, size_t mode);
       BVH4Triangle4iBuilderFast (BVH4* bvh, TriangleMesh* mesh);
       void createSmallLeaf(BuildRecord& current, Allocator& leafAlloc, size_t threadID);
     };
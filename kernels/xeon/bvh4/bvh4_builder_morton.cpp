@@ -17,6 +17,7 @@
 #include "bvh4.h"
 #include "bvh4_builder_morton.h"
 #include "bvh4_statistics.h"
+#include "bvh4_restructure.h"
 
 #include "geometry/triangle1.h"
 #include "geometry/triangle4.h"
@@ -39,64 +40,65 @@ namespace embree
 
     std::auto_ptr<BVH4BuilderMorton::MortonBuilderState> BVH4BuilderMorton::g_state(NULL);
     
-    BVH4BuilderMorton::BVH4BuilderMorton (BVH4* bvh, Scene* scene, TriangleMesh* mesh, size_t logBlockSize, bool needVertices, size_t primBytes, const size_t minLeafSize, const size_t maxLeafSize)
-      : bvh(bvh), scene(scene), mesh(mesh), logBlockSize(logBlockSize), needVertices(needVertices), primBytes(primBytes), minLeafSize(minLeafSize), maxLeafSize(maxLeafSize),
-	topLevelItemThreshold(0), encodeShift(0), encodeMask(-1), morton(NULL), bytesMorton(0), numGroups(0), numPrimitives(0), numAllocatedPrimitives(0), numAllocatedNodes(0)
+    BVH4BuilderMorton::BVH4BuilderMorton (BVH4* bvh, Scene* scene, TriangleMesh* mesh, size_t mode, size_t logBlockSize, bool needVertices, size_t primBytes, const size_t minLeafSize, const size_t maxLeafSize)
+      : bvh(bvh), scene(scene), mesh(mesh), logBlockSize(logBlockSize), needVertices(needVertices), primBytes(primBytes), minLeafSize(minLeafSize), maxLeafSize(maxLeafSize), use64BitCodes((mode & 1) != 0), restructureTree((mode & 2) != 0),
+	topLevelItemThreshold(0), encodeShift(0), encodeMask(-1), morton(NULL), morton64(NULL), bytesMorton(0), numGroups(0), numPrimitives(0), numAllocatedPrimitives(0), numAllocatedNodes(0)
     {
       needAllThreads = true;
       if (mesh) needAllThreads = mesh->numTriangles > 50000;
     }
     
-    BVH4Triangle1BuilderMorton::BVH4Triangle1BuilderMorton (BVH4* bvh, Scene* scene)
-      : BVH4BuilderMorton(bvh,scene,NULL,0,false,sizeof(Triangle1),4,inf) {}
+    BVH4Triangle1BuilderMorton::BVH4Triangle1BuilderMorton (BVH4* bvh, Scene* scene, size_t mode)
+      : BVH4BuilderMorton(bvh,scene,NULL,mode,0,false,sizeof(Triangle1),4,inf) {}
 
-    BVH4Triangle4BuilderMorton::BVH4Triangle4BuilderMorton (BVH4* bvh, Scene* scene)
-      : BVH4BuilderMorton(bvh,scene,NULL,2,false,sizeof(Triangle4),4,inf) {}
+    BVH4Triangle4BuilderMorton::BVH4Triangle4BuilderMorton (BVH4* bvh, Scene* scene, size_t mode)
+      : BVH4BuilderMorton(bvh,scene,NULL,mode,2,false,sizeof(Triangle4),4,inf) {}
 
 #if defined(__AVX__)
-    BVH4Triangle8BuilderMorton::BVH4Triangle8BuilderMorton (BVH4* bvh, Scene* scene)
-      : BVH4BuilderMorton(bvh,scene,NULL,3,false,sizeof(Triangle8),8,inf) {}
+    BVH4Triangle8BuilderMorton::BVH4Triangle8BuilderMorton (BVH4* bvh, Scene* scene, size_t mode)
+      : BVH4BuilderMorton(bvh,scene,NULL,mode,3,false,sizeof(Triangle8),8,inf) {}
 #endif
     
-    BVH4Triangle1vBuilderMorton::BVH4Triangle1vBuilderMorton (BVH4* bvh, Scene* scene)
-      : BVH4BuilderMorton(bvh,scene,NULL,0,false,sizeof(Triangle1v),4,inf) {}
+    BVH4Triangle1vBuilderMorton::BVH4Triangle1vBuilderMorton (BVH4* bvh, Scene* scene, size_t mode)
+      : BVH4BuilderMorton(bvh,scene,NULL,mode,0,false,sizeof(Triangle1v),4,inf) {}
 
-    BVH4Triangle4vBuilderMorton::BVH4Triangle4vBuilderMorton (BVH4* bvh, Scene* scene)
-      : BVH4BuilderMorton(bvh,scene,NULL,2,false,sizeof(Triangle4v),4,inf) {}
+    BVH4Triangle4vBuilderMorton::BVH4Triangle4vBuilderMorton (BVH4* bvh, Scene* scene, size_t mode)
+      : BVH4BuilderMorton(bvh,scene,NULL,mode,2,false,sizeof(Triangle4v),4,inf) {}
 
-    BVH4Triangle4iBuilderMorton::BVH4Triangle4iBuilderMorton (BVH4* bvh, Scene* scene)
-      : BVH4BuilderMorton(bvh,scene,NULL,2,true,sizeof(Triangle4i),4,inf) {}
+    BVH4Triangle4iBuilderMorton::BVH4Triangle4iBuilderMorton (BVH4* bvh, Scene* scene, size_t mode)
+      : BVH4BuilderMorton(bvh,scene,NULL,mode,2,true,sizeof(Triangle4i),4,inf) {}
 
-    BVH4Triangle1BuilderMorton::BVH4Triangle1BuilderMorton (BVH4* bvh, TriangleMesh* mesh)
-      : BVH4BuilderMorton(bvh,mesh->parent,mesh,0,false,sizeof(Triangle1),4,inf) {}
+    BVH4Triangle1BuilderMorton::BVH4Triangle1BuilderMorton (BVH4* bvh, TriangleMesh* mesh, size_t mode)
+      : BVH4BuilderMorton(bvh,mesh->parent,mesh,mode,0,false,sizeof(Triangle1),4,inf) {}
 
-    BVH4Triangle4BuilderMorton::BVH4Triangle4BuilderMorton (BVH4* bvh, TriangleMesh* mesh)
-      : BVH4BuilderMorton(bvh,mesh->parent,mesh,2,false,sizeof(Triangle4),4,inf) {}
+    BVH4Triangle4BuilderMorton::BVH4Triangle4BuilderMorton (BVH4* bvh, TriangleMesh* mesh, size_t mode)
+      : BVH4BuilderMorton(bvh,mesh->parent,mesh,mode,2,false,sizeof(Triangle4),4,inf) {}
 
 #if defined(__AVX__)
-    BVH4Triangle8BuilderMorton::BVH4Triangle8BuilderMorton (BVH4* bvh, TriangleMesh* mesh)
-      : BVH4BuilderMorton(bvh,mesh->parent,mesh,3,false,sizeof(Triangle8),8,inf) {}
+    BVH4Triangle8BuilderMorton::BVH4Triangle8BuilderMorton (BVH4* bvh, TriangleMesh* mesh, size_t mode)
+      : BVH4BuilderMorton(bvh,mesh->parent,mesh,mode,3,false,sizeof(Triangle8),8,inf) {}
 #endif
     
-    BVH4Triangle1vBuilderMorton::BVH4Triangle1vBuilderMorton (BVH4* bvh, TriangleMesh* mesh)
-      : BVH4BuilderMorton(bvh,mesh->parent,mesh,0,false,sizeof(Triangle1v),4,inf) {}
+    BVH4Triangle1vBuilderMorton::BVH4Triangle1vBuilderMorton (BVH4* bvh, TriangleMesh* mesh, size_t mode)
+      : BVH4BuilderMorton(bvh,mesh->parent,mesh,mode,0,false,sizeof(Triangle1v),4,inf) {}
 
-    BVH4Triangle4vBuilderMorton::BVH4Triangle4vBuilderMorton (BVH4* bvh, TriangleMesh* mesh)
-      : BVH4BuilderMorton(bvh,mesh->parent,mesh,2,false,sizeof(Triangle4v),4,inf) {}
+    BVH4Triangle4vBuilderMorton::BVH4Triangle4vBuilderMorton (BVH4* bvh, TriangleMesh* mesh, size_t mode)
+      : BVH4BuilderMorton(bvh,mesh->parent,mesh,mode,2,false,sizeof(Triangle4v),4,inf) {}
 
-    BVH4Triangle4iBuilderMorton::BVH4Triangle4iBuilderMorton (BVH4* bvh, TriangleMesh* mesh)
-      : BVH4BuilderMorton(bvh,mesh->parent,mesh,2,true,sizeof(Triangle4i),4,inf) {}
+    BVH4Triangle4iBuilderMorton::BVH4Triangle4iBuilderMorton (BVH4* bvh, TriangleMesh* mesh, size_t mode)
+      : BVH4BuilderMorton(bvh,mesh->parent,mesh,mode,2,true,sizeof(Triangle4i),4,inf) {}
         
     BVH4BuilderMorton::~BVH4BuilderMorton () 
     {
-      if (morton) os_free(morton,bytesMorton);
+      if (morton  ) os_free(morton  ,bytesMorton);
+      if (morton64) os_free(morton64,bytesMorton);
       bvh->alloc.shrink();
     }
     
     void BVH4BuilderMorton::build(size_t threadIndex, size_t threadCount) 
     {
       if (g_verbose >= 2)
-        std::cout << "building BVH4<" << bvh->primTy.name << "> with " << TOSTRING(isa) << "::BVH4BuilderMorton ... " << std::flush;
+        std::cout << "building BVH4<" << bvh->primTy.name << "> with " << TOSTRING(isa) << (use64BitCodes ? "::BVH4BuilderMorton64Bit ... " : "::BVH4BuilderMorton ... ") << std::flush;
       
       /* do some global inits first */
       init(threadIndex,threadCount);
@@ -187,9 +189,15 @@ namespace embree
       if (numPrimitivesOld != numPrimitives)
       {
 	bvh->init(numPrimitives);
-        if (morton) os_free(morton,bytesMorton);
-	bytesMorton = ((numPrimitives+7)&(-8)) * sizeof(MortonID32Bit);
-        morton = (MortonID32Bit* ) os_malloc(bytesMorton); memset(morton,0,bytesMorton);
+        if (morton  ) os_free(morton  ,bytesMorton); morton   = NULL;
+        if (morton64) os_free(morton64,bytesMorton); morton64 = NULL;
+        if (use64BitCodes) {
+          bytesMorton = ((numPrimitives+7)&(-8)) * sizeof(MortonID64Bit);
+          morton64 = (MortonID64Bit*) os_malloc(bytesMorton); memset(morton64,0,bytesMorton);
+        } else {
+          bytesMorton = ((numPrimitives+7)&(-8)) * sizeof(MortonID32Bit);
+          morton = (MortonID32Bit* ) os_malloc(bytesMorton); memset(morton,0,bytesMorton);
+        }
       }
     }
     
@@ -291,7 +299,7 @@ namespace embree
       /* compute mapping from world space into 3D grid */
       const ssef base     = (ssef)global_bounds.centBounds.lower;
       const ssef diagonal = (ssef)global_bounds.centBounds.upper - (ssef)global_bounds.centBounds.lower;
-      const ssef scale    = select(diagonal != 0, rcp(diagonal) * ssef(LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
+      const ssef scale    = select(diagonal != 0, rcp(diagonal) * ssef(MortonID32Bit::LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
       
       size_t currentID = startID;
       size_t offset = startOffset;
@@ -351,17 +359,61 @@ namespace embree
       }
     }
     
+    void BVH4BuilderMorton::computeMortonCodes(const size_t startID, const size_t endID, 
+                                               const size_t startGroup, const size_t startOffset, 
+                                               MortonID64Bit* __restrict__ const dest)
+    {
+      /* compute mapping from world space into 3D grid */
+      const ssef base     = (ssef)global_bounds.centBounds.lower;
+      const ssef diagonal = (ssef)global_bounds.centBounds.upper - (ssef)global_bounds.centBounds.lower;
+      const ssef scale    = select(diagonal != 0, rcp(diagonal) * ssef(MortonID64Bit::LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
+      
+      size_t currentID = startID;
+      size_t offset = startOffset;
+      
+      for (size_t group = startGroup; group<numGroups; group++) 
+      {       
+        Geometry* geom = scene->get(group);
+        if (!geom || !geom->isEnabled() || geom->type != TRIANGLE_MESH) continue;
+        TriangleMesh* mesh = (TriangleMesh*) geom;
+        if (mesh->numTimeSteps != 1) continue;
+        const size_t numTriangles = min(mesh->numTriangles-offset,endID-currentID);
+        
+        for (size_t i=0; i<numTriangles; i++)	  
+        {
+          const BBox3fa b = mesh->bounds(offset+i);
+          const ssef lower = (ssef)b.lower;
+          const ssef upper = (ssef)b.upper;
+          const ssef centroid = lower+upper;
+          const ssei binID = ssei((centroid-base)*scale);
+          unsigned int index = offset+i;
+          if (this->mesh == NULL) index |= group << encodeShift;
+          dest[currentID].code  = MortonID64Bit::encode(extract<0>(binID),extract<1>(binID),extract<2>(binID));
+          dest[currentID].index = index;
+          currentID++;
+        }
+        offset = 0;
+        if (currentID == endID) break;
+      }
+    }
+    
     void BVH4BuilderMorton::computeMortonCodes(const size_t threadID, const size_t numThreads, size_t taskIndex, size_t taskCount, TaskScheduler::Event* taskGroup)
     {      
       const size_t startID = (threadID+0)*numPrimitives/numThreads;
       const size_t endID   = (threadID+1)*numPrimitives/numThreads;
       
-      /* store the morton codes temporarily in 'node' memory */
-      MortonID32Bit* __restrict__ const dest = (MortonID32Bit*)bvh->alloc.base();
-      computeMortonCodes(startID,endID,g_state->startGroup[threadID],g_state->startGroupOffset[threadID],dest);
+      /* store the morton codes temporarily in 'node' memory, or directly in the morton array if the radix sort ends there */
+      if (use64BitCodes) {
+        MortonID64Bit* __restrict__ const dest = radixInput(morton64,(MortonID64Bit*)bvh->alloc.base());
+        computeMortonCodes(startID,endID,g_state->startGroup[threadID],g_state->startGroupOffset[threadID],dest);
+      } else {
+        MortonID32Bit* __restrict__ const dest = radixInput(morton,(MortonID32Bit*)bvh->alloc.base());
+        computeMortonCodes(startID,endID,g_state->startGroup[threadID],g_state->startGroupOffset[threadID],dest);
+      }
     }
     
-    void BVH4BuilderMorton::recreateMortonCodes(BuildRecord& current) const
+    template<typename MortonID>
+    void BVH4BuilderMorton::recreateMortonCodes(MortonID* __restrict__ const morton, BuildRecord& current) const
     {
       assert(current.size() > 4);
       CentGeomBBox3fa global_bounds;
@@ -379,7 +431,7 @@ namespace embree
       /* compute mapping from world space into 3D grid */
       const ssef base     = (ssef)global_bounds.centBounds.lower;
       const ssef diagonal = (ssef)global_bounds.centBounds.upper - (ssef)global_bounds.centBounds.lower;
-      const ssef scale    = select(diagonal != 0,rcp(diagonal) * ssef(LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
+      const ssef scale    = select(diagonal != 0,rcp(diagonal) * ssef(MortonID::LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
       
       for (size_t i=current.begin; i<current.end; i++)
       {
@@ -395,10 +447,9 @@ namespace embree
         const unsigned int bx = extract<0>(binID);
         const unsigned int by = extract<1>(binID);
         const unsigned int bz = extract<2>(binID);
-        const unsigned int code = bitInterleave(bx,by,bz);
-        morton[i].code  = code;
+        morton[i].code = MortonID::encode(bx,by,bz);
       }
-      quicksort_insertionsort_ascending<MortonID32Bit,512>(morton,current.begin,current.end-1); 
+      quicksort_insertionsort_ascending<MortonID,512>(morton,current.begin,current.end-1); 
       
 #if defined(DEBUG)
       for (size_t i=current.begin; i<current.end-1; i++)
@@ -407,20 +458,28 @@ namespace embree
     }
     
     void BVH4BuilderMorton::radixsort(const size_t threadID, const size_t numThreads, size_t taskIndex, size_t taskCount, TaskScheduler::Event* taskGroup)
+    {
+      if (use64BitCodes) radixsort(threadID,numThreads,morton64,(MortonID64Bit*)bvh->alloc.base());
+      else               radixsort(threadID,numThreads,morton  ,(MortonID32Bit*)bvh->alloc.base());
+    }
+
+    template<typename MortonID>
+    void BVH4BuilderMorton::radixsort(const size_t threadID, const size_t numThreads, MortonID* __restrict__ const morton, MortonID* __restrict__ const tmp)
     {
       const size_t startID = (threadID+0)*numPrimitives/numThreads;
       const size_t endID   = (threadID+1)*numPrimitives/numThreads;
       
-      MortonID32Bit* __restrict__ mortonID[2];
-      mortonID[0] = (MortonID32Bit*) morton; 
-      mortonID[1] = (MortonID32Bit*) bvh->alloc.base();
+      MortonID* __restrict__ mortonID[2];
+      mortonID[0] = morton; 
+      mortonID[1] = tmp;
       MortonBuilderState::ThreadRadixCountTy* radixCount = g_state->radixCount;
       
-      /* we need 3 iterations to process all 32 bits */
-      for (size_t b=0; b<3; b++)
+      /* we need 3 iterations to process all bits of 32 bit codes and 6 iterations for 64 bit codes, the last iteration writes into the morton array */
+      const size_t numPasses = radixPasses<MortonID>();
+      for (size_t b=0; b<numPasses; b++)
       {
-        const MortonID32Bit* __restrict src = (MortonID32Bit*) &mortonID[((b+1)%2)][0];
-        MortonID32Bit*       __restrict dst = (MortonID32Bit*) &mortonID[((b+0)%2)][0];
+        const MortonID* __restrict src = &mortonID[((numPasses-b+0)%2)][0];
+        MortonID*       __restrict dst = &mortonID[((numPasses-b+1)%2)][0];
         
         /* shift and mask to extract some number of bits */
         const unsigned int mask = RADIX_BUCKETS_MASK;
@@ -461,7 +520,7 @@ namespace embree
           const size_t index = src[i].get(shift, mask);
           dst[offset[index]++] = src[i];
         }
-        if (b < 2) TaskScheduler::syncThreads(threadID,numThreads);
+        if (b+1 < numPasses) TaskScheduler::syncThreads(threadID,numThreads);
       }
     }
     
@@ -474,6 +533,7 @@ namespace embree
         const unsigned int taskID = atomic_add(&g_state->taskCounter,1);
         if (taskID >= g_state->buildRecords.size()) break;
 	recurse(g_state->buildRecords[taskID],nodeAlloc,leafAlloc,RECURSE,threadID);
+        if (restructureTree) BVH4Restructure::restructure(bvh,*g_state->buildRecords[taskID].parent,nodeAlloc);
         g_state->buildRecords[taskID].parent->setBarrier();
       }
     }
@@ -495,7 +555,7 @@ namespace embree
       
       for (size_t i=0; i<items; i++) 
       {	
-        const size_t index = morton[start+i].index;
+        const size_t index = primIndex(start+i);
         const size_t primID = index & encodeMask; 
         const size_t geomID = this->mesh ? this->mesh->id : (index >> encodeShift); 
         const TriangleMesh* mesh = scene->getTriangleMesh(geomID);
@@ -537,7 +597,7 @@ namespace embree
       
       for (size_t i=0; i<items; i++)
       {
-        const size_t index = morton[start+i].index;
+        const size_t index = primIndex(start+i);
         const size_t primID = index & encodeMask; 
         const size_t geomID = this->mesh ? this->mesh->id : (index >> encodeShift); 
         const TriangleMesh* mesh = scene->getTriangleMesh(geomID);
@@ -577,7 +637,7 @@ namespace embree
       
       for (size_t i=0; i<items; i++)
       {
-        const size_t index = morton[start+i].index;
+        const size_t index = primIndex(start+i);
         const size_t primID = index & encodeMask; 
         const size_t geomID = this->mesh ? this->mesh->id : (index >> encodeShift); 
         const TriangleMesh* mesh = scene->getTriangleMesh(geomID);
@@ -613,7 +673,7 @@ namespace embree
       
       for (size_t i=0; i<items; i++) 
       {	
-        const size_t index = morton[start+i].index;
+        const size_t index = primIndex(start+i);
         const size_t primID = index & encodeMask; 
         const size_t geomID = this->mesh ? this->mesh->id : (index >> encodeShift); 
         const TriangleMesh* mesh = scene->getTriangleMesh(geomID);
@@ -654,7 +714,7 @@ namespace embree
       
       for (size_t i=0; i<items; i++)
       {
-        const size_t index = morton[start+i].index;
+        const size_t index = primIndex(start+i);
         const size_t primID = index & encodeMask; 
         const size_t geomID = this->mesh ? this->mesh->id : (index >> encodeShift); 
         const TriangleMesh* mesh = scene->getTriangleMesh(geomID);
@@ -694,7 +754,7 @@ namespace embree
       
       for (size_t i=0; i<items; i++)
       {
-	const size_t index = morton[start+i].index;
+	const size_t index = primIndex(start+i);
         const size_t primID = index & encodeMask; 
         const size_t geomID = this->mesh ? this->mesh->id : (index >> encodeShift); 
         const TriangleMesh* mesh = scene->getTriangleMesh(geomID);
@@ -771,24 +831,23 @@ namespace embree
       return bounds0;
     }  
     
-    __forceinline void BVH4BuilderMorton::split(BuildRecord& current,
+    template<typename MortonID>
+    __forceinline void BVH4BuilderMorton::split(MortonID* __restrict__ const morton,
+                                                BuildRecord& current,
                                                 BuildRecord& left,
                                                 BuildRecord& right) const
     {
-      const unsigned int code_start = morton[current.begin].code;
-      const unsigned int code_end   = morton[current.end-1].code;
-      unsigned int bitpos = clz(code_start^code_end);
+      typedef typename MortonID::Code Code;
+      Code code_diff = morton[current.begin].code ^ morton[current.end-1].code;
       
       /* if all items mapped to same morton code, then create new morton codes for the items */
-      if (unlikely(bitpos == 32)) 
+      if (unlikely(code_diff == 0)) 
       {
-        recreateMortonCodes(current);
-        const unsigned int code_start = morton[current.begin].code;
-        const unsigned int code_end   = morton[current.end-1].code;
-        bitpos = clz(code_start^code_end);
+        recreateMortonCodes(morton,current);
+        code_diff = morton[current.begin].code ^ morton[current.end-1].code;
         
         /* if the morton code is still the same, goto fall back split */
-        if (unlikely(bitpos == 32)) 
+        if (unlikely(code_diff == 0)) 
         {
           size_t center = (current.begin + current.end)/2; 
           left.init(current.begin,center);
@@ -798,15 +857,14 @@ namespace embree
       }
       
       /* split the items at the topmost different morton code bit */
-      const unsigned int bitpos_diff = 31-bitpos;
-      const unsigned int bitmask = 1 << bitpos_diff;
+      const Code bitmask = Code(1) << MortonID::highestBit(code_diff);
       
       /* find location where bit differs using binary search */
       size_t begin = current.begin;
       size_t end   = current.end;
       while (begin + 1 != end) {
         const size_t mid = (begin+end)/2;
-        const unsigned bit = morton[mid].code & bitmask;
+        const Code bit = morton[mid].code & bitmask;
         if (bit == 0) begin = mid; else end = mid;
       }
       size_t center = end;
@@ -818,6 +876,12 @@ namespace embree
       left.init(current.begin,center);
       right.init(center,current.end);
     }
+
+    __forceinline void BVH4BuilderMorton::split(BuildRecord& current, BuildRecord& left, BuildRecord& right) const
+    {
+      if (use64BitCodes) split(morton64,current,left,right);
+      else               split(morton  ,current,left,right);
+    }
     
     BBox3fa BVH4BuilderMorton::recurse(BuildRecord& current, Allocator& nodeAlloc, Allocator& leafAlloc, const size_t mode, const size_t threadID) 
     {
@@ -969,10 +1033,14 @@ namespace embree
     
     BBox3fa BVH4BuilderMorton::refitTopLevel(NodeRef& ref) const
     { 
-      /* stop here if we encounter a barrier */
+      /* stop here if we encounter a barrier, the barriers are kept for the restructuring of the toplevel part */
       if (unlikely(ref.isBarrier())) {
-        ref.clearBarrier();
-        return nodeBounds(ref);
+        if (!restructureTree) {
+          ref.clearBarrier();
+          return nodeBounds(ref);
+        }
+        NodeRef child = ref; child.clearBarrier();
+        return nodeBounds(child);
       }
       
       /* return point bound for empty nodes */
@@ -1024,18 +1092,19 @@ namespace embree
       global_bounds = computeBounds();
       bvh->bounds = global_bounds.geomBounds;
 
-      /* compute morton codes */
-      if (mesh)
-        computeMortonCodes(0,numPrimitives,mesh->id,0,morton);
-      else
-        computeMortonCodes(0,numPrimitives,0,0,morton);
-
-      /* sort morton codes */
-      std::sort(&morton[0],&morton[numPrimitives]); // FIXME: use radix sort
+      /* compute and sort morton codes */
+      const size_t startGroup = mesh ? mesh->id : 0;
+      if (use64BitCodes) {
+        computeMortonCodes(0,numPrimitives,startGroup,0,morton64);
+        std::sort(&morton64[0],&morton64[numPrimitives]); // FIXME: use radix sort
+      } else {
+        computeMortonCodes(0,numPrimitives,startGroup,0,morton);
+        std::sort(&morton[0],&morton[numPrimitives]); // FIXME: use radix sort
+      }
       
 #if defined(DEBUG)
       for (size_t i=1; i<numPrimitives; i++)
-        assert(morton[i-1].code <= morton[i].code);
+        assert(use64BitCodes ? morton64[i-1].code <= morton64[i].code : morton[i-1].code <= morton[i].code);
 #endif	    
       
       BuildRecord br;
@@ -1048,6 +1117,10 @@ namespace embree
       __aligned(64) Allocator nodeAlloc(&bvh->alloc);
       __aligned(64) Allocator leafAlloc(&bvh->alloc);
       recurse(br,nodeAlloc,leafAlloc,RECURSE,threadIndex);	    
+
+      /* optimize the tree */
+      if (restructureTree) 
+        BVH4Restructure::restructure(bvh,bvh->root,nodeAlloc);
             
       /* stop measurement */
       if (g_verbose >= 2) dt = getSeconds()-t0;
@@ -1075,10 +1148,18 @@ namespace embree
       TaskScheduler::dispatchTask( _computeMortonCodes, this, threadIndex, threadCount );   
 
       /* padding */
-      MortonID32Bit* __restrict__ const dest = (MortonID32Bit*) bvh->alloc.base();
-      for (size_t i=numPrimitives; i<( (numPrimitives+7)&(-8) ); i++) {
-        dest[i].code  = 0xffffffff; 
-        dest[i].index = 0;
+      if (use64BitCodes) {
+        MortonID64Bit* __restrict__ const dest = radixInput(morton64,(MortonID64Bit*)bvh->alloc.base());
+        for (size_t i=numPrimitives; i<( (numPrimitives+7)&(-8) ); i++) {
+          dest[i].code  = MortonID64Bit::Code(-1); 
+          dest[i].index = 0;
+        }
+      } else {
+        MortonID32Bit* __restrict__ const dest = radixInput(morton,(MortonID32Bit*)bvh->alloc.base());
+        for (size_t i=numPrimitives; i<( (numPrimitives+7)&(-8) ); i++) {
+          dest[i].code  = 0xffffffff; 
+          dest[i].index = 0;
+        }
       }
 
       /* sort morton codes */
@@ -1086,7 +1167,7 @@ namespace embree
 
 #if defined(DEBUG)
       for (size_t i=1; i<numPrimitives; i++)
-        assert(morton[i-1].code <= morton[i].code);
+        assert(use64BitCodes ? morton64[i-1].code <= morton64[i].code : morton[i-1].code <= morton[i].code);
 #endif	    
 
       /* build and extract top-level tree */
@@ -1114,6 +1195,12 @@ namespace embree
       
       /* refit toplevel part of tree */
       refitTopLevel(bvh->root);
+
+      /* restructure toplevel part of tree */
+      if (restructureTree) {
+        BVH4Restructure::restructure(bvh,bvh->root,nodeAlloc);
+        bvh->clearBarrier(bvh->root);
+      }
       
       /* release all threads again */
       TaskScheduler::leave(threadIndex,threadCount);
@@ -1122,23 +1209,23 @@ namespace embree
       if (g_verbose >= 2) dt = getSeconds()-t0;
     }
 
-    Builder* BVH4Triangle1BuilderMorton  (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle1BuilderMorton ((BVH4*)bvh,scene); }
-    Builder* BVH4Triangle4BuilderMorton  (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle4BuilderMorton ((BVH4*)bvh,scene); }
+    Builder* BVH4Triangle1BuilderMorton  (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle1BuilderMorton ((BVH4*)bvh,scene,mode); }
+    Builder* BVH4Triangle4BuilderMorton  (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle4BuilderMorton ((BVH4*)bvh,scene,mode); }
 #if defined(__AVX__)
-    Builder* BVH4Triangle8BuilderMorton  (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle8BuilderMorton ((BVH4*)bvh,scene); }
+    Builder* BVH4Triangle8BuilderMorton  (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle8BuilderMorton ((BVH4*)bvh,scene,mode); }
 #endif
-    Builder* BVH4Triangle1vBuilderMorton (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle1vBuilderMorton((BVH4*)bvh,scene); }
-    Builder* BVH4Triangle4vBuilderMorton (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle4vBuilderMorton((BVH4*)bvh,scene); }
-    Builder* BVH4Triangle4iBuilderMorton (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle4iBuilderMorton((BVH4*)bvh,scene); }
+    Builder* BVH4Triangle1vBuilderMorton (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle1vBuilderMorton((BVH4*)bvh,scene,mode); }
+    Builder* BVH4Triangle4vBuilderMorton (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle4vBuilderMorton((BVH4*)bvh,scene,mode); }
+    Builder* BVH4Triangle4iBuilderMorton (void* bvh, Scene* scene, size_t mode) { return new class BVH4Triangle4iBuilderMorton((BVH4*)bvh,scene,mode); }
 
-    Builder* BVH4Triangle1MeshBuilderMorton  (void* bvh, TriangleMesh* mesh, size_t mode) { return new class BVH4Triangle1BuilderMorton ((BVH4*)bvh,mesh); }
-    Builder* BVH4Triangle4MeshBuilderMorton  (void* bvh, TriangleMesh* mesh, size_t mode) { return new class BVH4Triangle4BuilderMorton ((BVH4*)bvh,mesh); }
+    Builder* BVH4Triangle1MeshBuilderMorton  (void* bvh, TriangleMesh* mesh, size_t mode) { return new class BVH4Triangle1BuilderMorton ((BVH4*)bvh,mesh,mode); }
+    Builder* BVH4Triangle4MeshBuilderMorton  (void* bvh, TriangleMesh* mesh, size_t mode) { return new class BVH4Triangle4BuilderMorton ((BVH4*)bvh,mesh,mode); }
 #if defined(__AVX__)
-    Builder* BVH4Triangle8MeshBuilderMorton  (void* bvh, TriangleMesh* mesh, size_t mode) { return new class BVH4Triangle8BuilderMorton ((BVH4*)bvh,mesh); }
+    Builder* BVH4Triangle8MeshBuilderMorton  (void* bvh, TriangleMesh* mesh, size_t mode) { return new class BVH4Triangle8BuilderMorton ((BVH4*)bvh,mesh,mode); }
 #endif
-    Builder* BVH4Triangle1vMeshBuilderMorton (void* bvh, TriangleMesh* mesh, size_t mode) { return new class BVH4Triangle1vBuilderMorton((BVH4*)bvh,mesh); }
-    Builder* BVH4Triangle4vMeshBuilderMorton (void* bvh, TriangleMesh* mesh, size_t mode) { return new class BVH4Triangle4vBuilderMorton((BVH4*)bvh,mesh); }
-    Builder* BVH4Triangle4iMeshBuilderMorton (void* bvh, TriangleMesh* mesh, size_t mode) { return new class BVH4Triangle4iBuilderMorton((BVH4*)bvh,mesh); }
+    Builder* BVH4Triangle1vMeshBuilderMorton (void* bvh, TriangleMesh* mesh, size_t mode) { return new class BVH4Triangle1vBuilderMorton((BVH4*)bvh,mesh,mode); }
+    Builder* BVH4Triangle4vMeshBuilderMorton (void* bvh, TriangleMesh* mesh, size_t mode) { return new class BVH4Triangle4vBuilderMorton((BVH4*)bvh,mesh,mode); }
+    Builder* BVH4Triangle4iMeshBuilderMorton (void* bvh, TriangleMesh* mesh, size_t mode) { return new class BVH4Triangle4iBuilderMorton((BVH4*)bvh,mesh,mode); }
   }
 }
 
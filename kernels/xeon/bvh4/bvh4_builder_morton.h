@@ -40,9 +40,6 @@ namespace embree
       static const size_t MAX_TOP_LEVEL_BINS = 1024;
       static const size_t NUM_TOP_LEVEL_BINS = 1024 + 4*BVH4::maxBuildDepth;
 
-      static const size_t LATTICE_BITS_PER_DIM = 10;
-      static const size_t LATTICE_SIZE_PER_DIM = size_t(1) << LATTICE_BITS_PER_DIM;
-      
       static const size_t RADIX_BITS = 11;
       static const size_t RADIX_BUCKETS = (1 << RADIX_BITS);
       static const size_t RADIX_BUCKETS_MASK = (RADIX_BUCKETS-1);
@@ -78,6 +75,11 @@ namespace embree
 
       struct __aligned(8) MortonID32Bit
       {
+        typedef unsigned int Code;
+
+        static const size_t LATTICE_BITS_PER_DIM = 10;
+        static const size_t LATTICE_SIZE_PER_DIM = size_t(1) << LATTICE_BITS_PER_DIM;
+
         union {
           struct {
 	    unsigned int code;
@@ -102,8 +104,62 @@ namespace embree
         
         __forceinline bool operator<(const MortonID32Bit &m) const { return code < m.code; } 
         __forceinline bool operator>(const MortonID32Bit &m) const { return code > m.code; } 
+
+        /*! interleaves the bits of the lattice coordinates */
+        static __forceinline Code encode(const unsigned int x, const unsigned int y, const unsigned int z) {
+          return bitInterleave(x,y,z);
+        }
+
+        /*! returns the position of the highest set bit */
+        static __forceinline size_t highestBit(const Code v) {
+          return __bsr(int(v));
+        }
       };
 
+      /*! morton code with 21 bits per dimension for scenes with a large extent */
+      struct __aligned(16) MortonID64Bit
+      {
+        typedef uint64 Code;
+
+        static const size_t LATTICE_BITS_PER_DIM = 21;
+        static const size_t LATTICE_SIZE_PER_DIM = size_t(1) << LATTICE_BITS_PER_DIM;
+
+        uint64 code;
+        unsigned int index;
+        unsigned int pad;
+        
+        __forceinline unsigned int get(const unsigned int shift, const unsigned and_mask) const {
+          return (unsigned int)(code >> shift) & and_mask;
+        }
+        
+        __forceinline friend std::ostream &operator<<(std::ostream &o, const MortonID64Bit& mc) {
+          o << "index " << mc.index << " code = " << mc.code;
+          return o;
+        }
+        
+        __forceinline bool operator<(const MortonID64Bit &m) const { return code < m.code; } 
+        __forceinline bool operator>(const MortonID64Bit &m) const { return code > m.code; } 
+
+        /*! interleaves the bits of the lattice coordinates */
+        static __forceinline Code encode(const unsigned int x, const unsigned int y, const unsigned int z) {
+          return bitInterleave64<uint64>(x,y,z);
+        }
+
+        /*! returns the position of the highest set bit */
+        static __forceinline size_t highestBit(const Code v) 
+        {
+          const unsigned int hi = (unsigned int)(v >> 32);
+          if (hi) return 32 + __bsr(int(hi));
+          else    return __bsr(int(v));
+        }
+      };
+
+      /*! number of radix sort passes required to sort all bits of the morton codes */
+      template<typename MortonID>
+        static __forceinline size_t radixPasses() {
+        return (3*MortonID::LATTICE_BITS_PER_DIM + RADIX_BITS-1) / RADIX_BITS;
+      }
+
       struct MortonBuilderState
       {
         ALIGNED_CLASS;
@@ -142,7 +198,7 @@ namespace embree
       };
       
       /*! Constructor. */
-      BVH4BuilderMorton (BVH4* bvh, Scene* scene, TriangleMesh* mesh, size_t logBlockSize, bool needVertices, size_t primBytes, const size_t minLeafSize, const size_t maxLeafSize);
+      BVH4BuilderMorton (BVH4* bvh, Scene* scene, TriangleMesh* mesh, size_t mode, size_t logBlockSize, bool needVertices, size_t primBytes, const size_t minLeafSize, const size_t maxLeafSize);
       
       /*! Destruction */
       ~BVH4BuilderMorton ();
@@ -165,6 +221,20 @@ namespace embree
                               const size_t startGroup, const size_t startOffset, 
                               MortonID32Bit* __restrict__ const dest);
 
+      void computeMortonCodes(const size_t startID, const size_t endID, 
+                              const size_t startGroup, const size_t startOffset, 
+                              MortonID64Bit* __restrict__ const dest);
+
+      /*! sorts the morton codes of this thread's range using the temporary array tmp */
+      template<typename MortonID>
+        void radixsort(const size_t threadID, const size_t numThreads, MortonID* __restrict__ const morton, MortonID* __restrict__ const tmp);
+
+      /*! returns the array the morton codes have to be computed into before the radix sort */
+      template<typename MortonID>
+        static __forceinline MortonID* radixInput(MortonID* morton, MortonID* tmp) {
+        return (radixPasses<MortonID>() % 2) ? tmp : morton;
+      }
+
       /*! main build task */
       TASK_RUN_FUNCTION(BVH4BuilderMorton,build_parallel_morton);
       TaskScheduler::Task task;
@@ -194,6 +264,9 @@ namespace embree
       
       /*! split a build record into two */
       void split(BuildRecord& current, BuildRecord& left, BuildRecord& right) const;
+
+      template<typename MortonID>
+        void split(MortonID* __restrict__ const morton, BuildRecord& current, BuildRecord& left, BuildRecord& right) const;
       
       /*! main recursive build function */
       BBox3fa recurse(BuildRecord& current, 
@@ -214,7 +287,13 @@ namespace embree
       BBox3fa refit(NodeRef& index) const;
       
       /*! recreates morton codes when reaching a region where all codes are identical */
-      void recreateMortonCodes(BuildRecord& current) const;
+      template<typename MortonID>
+        void recreateMortonCodes(MortonID* __restrict__ const morton, BuildRecord& current) const;
+
+      /*! returns the encoded geometry and primitive ID of the i'th sorted primitive */
+      __forceinline unsigned int primIndex(const size_t i) const {
+        return use64BitCodes ? morton64[i].index : morton[i].index;
+      }
       
     public:
       BVH4* bvh;               //!< Output BVH
@@ -226,6 +305,8 @@ namespace embree
       size_t primBytes; 
       size_t minLeafSize;
       size_t maxLeafSize;
+      bool use64BitCodes;      //!< uses 64 bit morton codes with 21 bits per dimension
+      bool restructureTree;    //!< optimizes the BVH with treelet restructuring after the build
 
       size_t topLevelItemThreshold;
       size_t encodeShift;
@@ -235,6 +316,7 @@ namespace embree
             
     public:
       MortonID32Bit* __restrict__ morton;
+      MortonID64Bit* __restrict__ morton64;
       size_t bytesMorton;
       
     public:
@@ -251,8 +333,8 @@ namespace embree
     class BVH4Triangle1BuilderMorton : public BVH4BuilderMorton
     {
     public:
-      BVH4Triangle1BuilderMorton (BVH4* bvh, Scene* scene);
-      BVH4Triangle1BuilderMorton (BVH4* bvh, TriangleMesh* mesh);
+      BVH4Triangle1BuilderMorton (BVH4* bvh, Scene* scene, size_t mode);
+      BVH4Triangle1BuilderMorton (BVH4* bvh, TriangleMesh* mesh, size_t mode);
       BBox3fa leafBounds(NodeRef& ref) const;
       void createSmallLeaf(BuildRecord& current, Allocator& leafAlloc, size_t threadID, BBox3fa& box_o);
     };
@@ -260,8 +342,8 @@ namespace embree
     class BVH4Triangle4BuilderMorton : public BVH4BuilderMorton
     {
     public:
-      BVH4Triangle4BuilderMorton (BVH4* bvh, Scene* scene);
-      BVH4Triangle4BuilderMorton (BVH4* bvh, TriangleMesh* mesh);
+      BVH4Triangle4BuilderMorton (BVH4* bvh, Scene* scene, size_t mode);
+      BVH4Triangle4BuilderMorton (BVH4* bvh, TriangleMesh* mesh, size_t mode);
       BBox3fa leafBounds(NodeRef& ref) const;
       void createSmallLeaf(BuildRecord& current, Allocator& leafAlloc, size_t threadID, BBox3fa& box_o);
     };
@@ -269,8 +351,8 @@ namespace embree
     class BVH4Triangle8BuilderMorton : public BVH4BuilderMorton
     {
     public:
-      BVH4Triangle8BuilderMorton (BVH4* bvh, Scene* scene);
-      BVH4Triangle8BuilderMorton (BVH4* bvh, TriangleMesh* mesh);
+      BVH4Triangle8BuilderMorton (BVH4* bvh, Scene* scene, size_t mode);
+      BVH4Triangle8BuilderMorton (BVH4* bvh, TriangleMesh* mesh, size_t mode);
       BBox3fa leafBounds(NodeRef& ref) const;
       void createSmallLeaf(BuildRecord& current, Allocator& leafAlloc, size_t threadID, BBox3fa& box_o);
     };
@@ -278,8 +360,8 @@ namespace embree
     class BVH4Triangle1vBuilderMorton : public BVH4BuilderMorton
     {
     public:
-      BVH4Triangle1vBuilderMorton (BVH4* bvh, Scene* scene);
-      BVH4Triangle1vBuilderMorton (BVH4* bvh, TriangleMesh* mesh);
+      BVH4Triangle1vBuilderMorton (BVH4* bvh, Scene* scene, size_t mode);
+      BVH4Triangle1vBuilderMorton (BVH4* bvh, TriangleMesh* mesh, size_t mode);
       BBox3fa leafBounds(NodeRef& ref) const;
       void createSmallLeaf(BuildRecord& current, Allocator& leafAlloc, size_t threadID, BBox3fa& box_o);
     };
@@ -287,8 +369,8 @@ namespace embree
     class BVH4Triangle4vBuilderMorton : public BVH4BuilderMorton
     {
     public:
-      BVH4Triangle4vBuilderMorton (BVH4* bvh, Scene* scene);
-      BVH4Triangle4vBuilderMorton (BVH4* bvh, TriangleMesh* mesh);
+      BVH4Triangle4vBuilderMorton (BVH4* bvh, Scene* scene, size_t mode);
+      BVH4Triangle4vBuilderMorton (BVH4* bvh, TriangleMesh* mesh, size_t mode);
       BBox3fa leafBounds(NodeRef& ref) const;
       void createSmallLeaf(BuildRecord& current, Allocator& leafAlloc, size_t threadID, BBox3fa& box_o);
     };
@@ -296,8 +378,8 @@ namespace embree
     class BVH4Triangle4iBuilderMorton : public BVH4BuilderMorton
     {
     public:
-      BVH4Triangle4iBuilderMorton (BVH4* bvh, Scene* scene);
-      BVH4Triangle4iBuilderMorton (BVH4* bvh, TriangleMesh* mesh);
+      BVH4Triangle4iBuilderMorton (BVH4* bvh, Scene* scene, size_t mode);
+      BVH4Triangle4iBuilderMorton (BVH4* bvh, TriangleMesh* mesh, size_t mode);
       BBox3fa leafBounds(NodeRef& ref) const;
       void createSmallLeaf(BuildRecord& current, Allocator& leafAlloc, size_t threadID, BBox3fa& box_o);
     };
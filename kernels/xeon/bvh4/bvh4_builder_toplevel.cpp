@@ -31,11 +31,14 @@ namespace embree
 #define BUILD_RECORD_SPLIT_THRESHOLD 512
 #define THRESHOLD_FOR_SUBTREE_RECURSION 128
 #define MIN_OPEN_SIZE 2000
+#define MAX_INCREMENTAL_MODIFIED 0.25f
+#define INCREMENTAL_SAH_THRESHOLD 1.3f
 
     std::auto_ptr<BVH4BuilderTopLevel::GlobalState> BVH4BuilderTopLevel::g_state(NULL);
 
     BVH4BuilderTopLevel::BVH4BuilderTopLevel (BVH4* bvh, Scene* scene, const createTriangleMeshAccelTy createTriangleMeshAccel) 
-      : bvh(bvh), objects(bvh->objects), scene(scene), createTriangleMeshAccel(createTriangleMeshAccel) {}
+      : bvh(bvh), objects(bvh->objects), scene(scene), createTriangleMeshAccel(createTriangleMeshAccel), 
+        topSAH(0.0f), fullBuildSAH(0.0f), topValid(false) {}
     
     BVH4BuilderTopLevel::~BVH4BuilderTopLevel ()
     {
@@ -83,6 +86,22 @@ namespace embree
       /* sequential create of acceleration structures */
       for (size_t i=0; i<N; i++) 
         create_object(i);
+
+      /* detect modified objects, the toplevel BVH can only get updated if the set of referenced objects did not change */
+      bool incremental = topValid && included.size() == N;
+      size_t numIncluded = 0;
+      included.resize(N);
+      modified.clear();
+      for (size_t i=0; i<N; i++) 
+      {
+        TriangleMesh* mesh = scene->getTriangleMeshSafe(i);
+        const bool use = mesh && mesh->isEnabled() && mesh->numTimeSteps == 1;
+        incremental &= use == included[i];
+        included[i] = use;
+        numIncluded += use;
+        if (use && mesh->isModified()) modified.push_back(i);
+      }
+      incremental &= modified.size() <= MAX_INCREMENTAL_MODIFIED*numIncluded;
       
       /* reset bounds of each thread */
       for (size_t i=0; i<threadCount; i++)
@@ -98,9 +117,14 @@ namespace embree
       }
       
       allThreadBuilds.clear();
+
+      /* update toplevel BVH if only few objects changed */
+      if (incremental && update_toplevel())
+        return;
       
       /* build toplevel BVH */
       build_toplevel(threadIndex,threadCount);
+      record_toplevel();
     }
     
     void BVH4BuilderTopLevel::build_toplevel(size_t threadIndex, size_t threadCount)
@@ -170,6 +194,126 @@ namespace embree
       }
     }
     
+    void BVH4BuilderTopLevel::record_toplevel()
+    {
+      topNodes.clear();
+      topNodeParent.clear();
+      topNodeLeaves.clear();
+      topSlots.clear();
+      topSAH = 0.0f;
+      topValid = false;
+
+      /* a single reference is directly stored in the root */
+      if (refs.size() <= 1) 
+        return;
+
+      /* sort references by node for lookup */
+      std::vector<std::pair<size_t,size_t> > leaves(refs.size());
+      for (size_t i=0; i<refs.size(); i++)
+        leaves[i] = std::make_pair(size_t(refs[i].node),refs[i].objectID());
+      std::sort(leaves.begin(),leaves.end());
+
+      /* breadth first traversal of toplevel nodes */
+      topNodes.push_back(bvh->root.node());
+      topNodeParent.push_back(size_t(-1));
+      for (size_t n=0; n<topNodes.size(); n++)
+      {
+        Node* node = topNodes[n];
+        unsigned char mask = 0;
+        for (size_t c=0; c<BVH4::N; c++)
+        {
+          NodeRef child = node->child(c);
+          if (child == BVH4::emptyNode) continue;
+          std::vector<std::pair<size_t,size_t> >::iterator i = std::lower_bound(leaves.begin(),leaves.end(),std::make_pair(size_t(child),size_t(0)));
+          if (i != leaves.end() && i->first == size_t(child)) {
+            topSlots.push_back(TopLevelSlot(n,c,i->second));
+            mask |= 1 << c;
+          } else {
+            topNodes.push_back(child.node());
+            topNodeParent.push_back(n);
+            topSAH += area(node->bounds(c));
+          }
+        }
+        topNodeLeaves.push_back(mask);
+      }
+      topNodeDirty.assign(topNodes.size(),0);
+
+      /* sort slots by object ID */
+      const size_t N = included.size();
+      objectSlots.assign(N+1,0);
+      for (size_t i=0; i<topSlots.size(); i++) 
+        objectSlots[topSlots[i].objectID+1]++;
+      for (size_t i=0; i<N; i++) 
+        objectSlots[i+1] += objectSlots[i];
+      std::vector<TopLevelSlot> slots(topSlots.size());
+      std::vector<size_t> next(objectSlots.begin(),objectSlots.end()-1);
+      for (size_t i=0; i<topSlots.size(); i++)
+        slots[next[topSlots[i].objectID]++] = topSlots[i];
+      topSlots.swap(slots);
+
+      fullBuildSAH = 1.0f + topSAH/area(topNodes[0]->bounds());
+      topValid = true;
+    }
+
+    bool BVH4BuilderTopLevel::update_toplevel()
+    {
+      /* objects that were empty at the last full build have no slot to get inserted into */
+      for (size_t m=0; m<modified.size(); m++) {
+        const size_t objectID = modified[m];
+        if (objectSlots[objectID] == objectSlots[objectID+1] && objects[objectID]->root != BVH4::emptyNode)
+          return false;
+      }
+
+      /* replace references to modified objects, an object opened into multiple references gets reinserted as a single reference */
+      std::vector<size_t> dirty;
+      for (size_t m=0; m<modified.size(); m++)
+      {
+        const size_t objectID = modified[m];
+        for (size_t i=objectSlots[objectID]; i<objectSlots[objectID+1]; i++)
+        {
+          const TopLevelSlot& slot = topSlots[i];
+          if (i == objectSlots[objectID]) topNodes[slot.node]->set(slot.child,objects[objectID]->bounds,objects[objectID]->root);
+          else                            topNodes[slot.node]->set(slot.child,BBox3fa(empty),NodeRef(BVH4::emptyNode));
+
+          /* mark path to root for refit */
+          for (size_t n=slot.node; n!=size_t(-1) && !topNodeDirty[n]; n=topNodeParent[n]) {
+            topNodeDirty[n] = 1;
+            dirty.push_back(n);
+          }
+        }
+      }
+
+      /* refit marked nodes bottom up, children are stored after their parents */
+      std::sort(dirty.begin(),dirty.end());
+      for (ssize_t i=dirty.size()-1; i>=0; i--)
+      {
+        const size_t n = dirty[i];
+        Node* node = topNodes[n];
+        topNodeDirty[n] = 0;
+        for (size_t c=0; c<BVH4::N; c++) 
+        {
+          if (node->child(c) == BVH4::emptyNode || (topNodeLeaves[n] & (1 << c))) continue;
+          const BBox3fa bounds = node->child(c).node()->bounds();
+          topSAH += area(bounds)-area(node->bounds(c));
+          node->set(c,bounds);
+        }
+      }
+
+      /* fall back to full rebuild if the SAH degraded too much */
+      const BBox3fa bounds = topNodes[0]->bounds();
+      const float sah = 1.0f + topSAH/area(bounds);
+      if (!(sah <= INCREMENTAL_SAH_THRESHOLD*fullBuildSAH))
+        return false;
+
+      if (g_verbose >= 2) {
+        std::cout << "updated BVH4<" << bvh->primTy.name << "> toplevel for " << modified.size() << " modified objects, ";
+        std::cout << "SAH = " << sah << " (" << fullBuildSAH << " after last rebuild)" << std::endl;
+      }
+
+      bvh->bounds = bounds;
+      return true;
+    }
+    
     void BVH4BuilderTopLevel::create_object(size_t objectID)
     {
       TriangleMesh* mesh = scene->getTriangleMeshSafe(objectID);
@@ -217,7 +361,7 @@ namespace embree
       
       /* create build primitive */
       const BBox3fa bounds = object->bounds;
-      refs[nextRef++] = BuildRef(bounds,object->root);
+      refs[nextRef++] = BuildRef(bounds,object->root,objectID);
       return bounds;
     }
     
@@ -246,13 +390,14 @@ namespace embree
       {
         std::pop_heap (refs.begin(),refs.end()); 
         BVH4::NodeRef ref = refs.back().node;
+        const size_t objectID = refs.back().objectID();
         if (ref.isLeaf()) break;
         refs.pop_back();    
         
         BVH4::Node* node = ref.node();
         for (size_t i=0; i<4; i++) {
           if (node->child(i) == BVH4::emptyNode) continue;
-          refs.push_back(BuildRef(node->bounds(i),node->child(i)));
+          refs.push_back(BuildRef(node->bounds(i),node->child(i),objectID));
           std::push_heap (refs.begin(),refs.end()); 
         }
       }
@@ -306,6 +451,7 @@ namespace embree
 		  if (end-start == 0) break;
           std::pop_heap(&prefs1[start],&prefs1[end]); 
           BVH4::NodeRef ref = prefs1[end-1].node;
+          size_t objectID = prefs1[end-1].objectID();
           float vol = prefs1[end-1].lower.w;
 		  if (ref.isLeaf() || vol < 0.5f*max_volume) {
 			std::push_heap(&prefs1[start],&prefs1[end]); 
@@ -316,7 +462,7 @@ namespace embree
           BVH4::Node* node = ref.node();
           for (size_t i=0; i<4; i++) {
             if (node->child(i) == BVH4::emptyNode) continue;
-            prefs1[end++] = BuildRef(node->bounds(i),node->child(i));
+            prefs1[end++] = BuildRef(node->bounds(i),node->child(i),objectID);
             std::push_heap(&prefs1[start],&prefs1[end]); 
           }
         }
@@ -76,6 +76,12 @@ namespace embree
       void build(size_t threadIndex, size_t threadCount);
       
       void build_toplevel(size_t threadIndex, size_t threadCount);
+
+      /*! records the structure of the toplevel BVH for incremental updates */
+      void record_toplevel();
+
+      /*! updates the toplevel BVH for modified objects, fails if the SAH degrades too much */
+      bool update_toplevel();
       
       /*! parallel rebuild of geometry */
       TASK_RUN_FUNCTION(BVH4BuilderTopLevel,task_create_parallel);
@@ -112,6 +118,31 @@ namespace embree
       /*! build mode */
       enum { RECURSE = 1, BUILD_TOP_LEVEL = 3 };
       
+      /*! reference from a toplevel node into an object BVH */
+      struct TopLevelSlot 
+      {
+        __forceinline TopLevelSlot () {}
+        __forceinline TopLevelSlot (size_t node, size_t child, size_t objectID) 
+          : node(node), child(child), objectID(objectID) {}
+
+        size_t node;      //!< index of toplevel node
+        size_t child;     //!< child slot inside toplevel node
+        size_t objectID;  //!< ID of referenced object
+      };
+
+      /* toplevel structure for incremental updates */
+      std::vector<Node*> topNodes;           //!< toplevel nodes, parents before children
+      std::vector<size_t> topNodeParent;     //!< parent index of each toplevel node
+      std::vector<unsigned char> topNodeLeaves; //!< mask of children referencing object BVHs
+      std::vector<char> topNodeDirty;        //!< marks toplevel nodes that need a refit
+      std::vector<TopLevelSlot> topSlots;    //!< object references sorted by object ID
+      std::vector<size_t> objectSlots;       //!< first slot of each object
+      std::vector<bool> included;            //!< objects referenced by the toplevel BVH
+      std::vector<size_t> modified;          //!< objects modified in this build
+      float topSAH;                          //!< summed area of all non-root toplevel nodes
+      float fullBuildSAH;                    //!< SAH cost after last full rebuild
+      bool topValid;                         //!< true if the recorded toplevel structure is valid
+
       TaskScheduler::Task task;
       vector_t<BuildRef> refs;
       vector_t<BuildRef> refs1;
@@ -0,0 +1,148 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh4_compressor.h"
+
+namespace embree
+{
+  BVH4Compressor::BVH4Compressor (BVH4* bvh, Builder* builder)
+    : builder(builder), bvh(bvh), base(NULL) 
+  {
+    needAllThreads = builder->needAllThreads;
+  }
+  
+  BVH4Compressor::~BVH4Compressor () {
+    delete builder;
+  }
+
+  void BVH4Compressor::build(size_t threadIndex, size_t threadCount) 
+  {
+    builder->build(threadIndex,threadCount);
+    needAllThreads = builder->needAllThreads;
+    compress(threadIndex,threadCount);
+  }
+
+  size_t BVH4Compressor::store(NodeRef src, NodeRef* dst, char* base, size_t ofs, size_t depth, std::vector<Subtree>* subtrees) const
+  {
+    if (src.isLeaf()) 
+    {
+      size_t num; const char* prims = src.leaf(num);
+      const size_t bytes = num*bvh->primTy.bytes;
+      ofs = (ofs+BVH4::align_mask) & ~size_t(BVH4::align_mask);
+      if (base) {
+        memcpy(base+ofs,prims,bytes);
+        *dst = bvh->encodeLeaf(base+ofs,num);
+      }
+      return ofs+bytes;
+    }
+
+    const Node* node = src.node();
+    ofs = (ofs+63) & ~size_t(63);
+    CompressedNode* cnode = base ? (CompressedNode*)(base+ofs) : NULL;
+    ofs += sizeof(CompressedNode);
+    if (cnode) {
+      cnode->clear();
+      cnode->set(node->bounds());
+      for (size_t c=0; c<BVH4::N; c++) 
+        if (node->child(c) != BVH4::emptyNode) cnode->set(c,node->bounds(c));
+      *dst = bvh->encodeNode(cnode);
+    }
+
+    /* leaves follow their parent node */
+    for (size_t c=0; c<BVH4::N; c++) {
+      const NodeRef child = node->child(c);
+      if (child == BVH4::emptyNode || !child.isLeaf()) continue;
+      ofs = store(child,cnode ? &cnode->child(c) : NULL,base,ofs,depth,subtrees);
+    }
+
+    /* inner nodes below the top levels become subtrees */
+    for (size_t c=0; c<BVH4::N; c++) 
+    {
+      const NodeRef child = node->child(c);
+      if (child == BVH4::emptyNode || child.isLeaf()) continue;
+      if (subtrees && depth == 0) {
+        subtrees->push_back(Subtree(child));
+        subtrees->back().dst = cnode ? &cnode->child(c) : NULL;
+      }
+      else ofs = store(child,cnode ? &cnode->child(c) : NULL,base,ofs,depth-1,subtrees);
+    }
+    return ofs;
+  }
+
+  void BVH4Compressor::task_count(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event) {
+    bytes[taskIndex] = store(subtrees[taskIndex].src,NULL,NULL,0,0,NULL);
+  }
+
+  void BVH4Compressor::task_store(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event) {
+    const Subtree& subtree = subtrees[taskIndex];
+    store(subtree.src,subtree.dst,base+subtree.offset,0,0,NULL);
+  }
+
+  void BVH4Compressor::compress(size_t threadIndex, size_t threadCount)
+  {
+    if (bvh->root == BVH4::emptyNode) {
+      bvh->compressed = true;
+      return;
+    }
+
+    double t0 = 0.0;
+    if (g_verbose >= 2) {
+      std::cout << "compressing BVH4 <" << bvh->primTy.name << "> ... " << std::flush;
+      t0 = getSeconds();
+    }
+
+    /* calculate size of the top levels and of each subtree, subtrees start at cache line boundaries */
+    subtrees.clear();
+    size_t total = store(bvh->root,NULL,NULL,0,topLevels,&subtrees);
+    bytes.resize(subtrees.size());
+    if (needAllThreads && subtrees.size()) 
+      TaskScheduler::executeTask(threadIndex,threadCount,_task_count,this,subtrees.size(),"compress_count");
+    else 
+      for (size_t i=0; i<subtrees.size(); i++) task_count(threadIndex,threadCount,i,subtrees.size(),NULL);
+    for (size_t i=0; i<subtrees.size(); i++) {
+      subtrees[i].offset = (total+63) & ~size_t(63);
+      total = subtrees[i].offset + bytes[i];
+    }
+
+    /* the memory block replaces the memory of the builder */
+    LinearAllocatorPerThread dst;
+    dst.init_malloc(total);
+    base = (char*) dst.malloc_linear(total,64);
+
+    /* store the top levels, which also links in the subtrees, then convert all subtrees */
+    NodeRef root = BVH4::emptyNode;
+    std::vector<Subtree> top; 
+    store(bvh->root,&root,base,0,topLevels,&top);
+    for (size_t i=0; i<subtrees.size(); i++) subtrees[i].dst = top[i].dst;
+    if (needAllThreads && subtrees.size()) 
+      TaskScheduler::executeTask(threadIndex,threadCount,_task_store,this,subtrees.size(),"compress_store");
+    else 
+      for (size_t i=0; i<subtrees.size(); i++) task_store(threadIndex,threadCount,i,subtrees.size(),NULL);
+
+    bvh->root = root;
+    bvh->compressed = true;
+    bvh->alloc.swap(dst);
+    subtrees.clear();
+    bytes.clear();
+    base = NULL;
+
+    if (g_verbose >= 2) {
+      double t1 = getSeconds();
+      std::cout << "[DONE]" << std::endl;
+      std::cout << "  dt = " << 1000.0f*(t1-t0) << "ms, " << 1E-6*double(total) << " MB" << std::endl;
+    }
+  }
+}
@@ -0,0 +1,87 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "bvh4.h"
+
+namespace embree
+{
+  /*! Runs some BVH4 builder and converts the resulting BVH into a BVH
+   *  with quantized nodes. The result is written in a single pass into
+   *  one memory block, nodes are aligned to cache lines and the leaves
+   *  of a node directly follow the node. The subtrees below the top
+   *  levels get converted in parallel. */
+  class BVH4Compressor : public Builder
+  {
+    ALIGNED_CLASS;
+  public:
+
+    /*! Type shortcuts */
+    typedef BVH4::Node           Node;
+    typedef BVH4::CompressedNode CompressedNode;
+    typedef BVH4::NodeRef        NodeRef;
+
+    /*! number of levels stored before the remaining subtrees get converted in parallel */
+    static const size_t topLevels = 3;
+
+    /*! subtree that gets converted by one task */
+    struct Subtree 
+    {
+      Subtree (NodeRef src) : src(src), dst(NULL), offset(0) {}
+      NodeRef src;      //!< subtree of the uncompressed BVH
+      NodeRef* dst;     //!< child reference of the compressed parent
+      size_t offset;    //!< offset of the subtree inside the memory block
+    };
+
+  public:
+
+    /*! Constructor. */
+    BVH4Compressor (BVH4* bvh, Builder* builder);
+
+    /*! Destructor. */
+    ~BVH4Compressor ();
+
+    /*! builds the BVH and compresses it */
+    void build(size_t threadIndex, size_t threadCount);
+
+  private:
+
+    /*! converts the BVH into a BVH with quantized nodes */
+    void compress(size_t threadIndex, size_t threadCount);
+
+    /*! stores the compressed subtree at offset ofs of the block and
+     *  returns the end offset, only calculates the offsets if base is
+     *  NULL. Inner nodes deeper than depth levels get appended to
+     *  subtrees if subtrees is not NULL. */
+    size_t store(NodeRef src, NodeRef* dst, char* base, size_t ofs, size_t depth, std::vector<Subtree>* subtrees) const;
+
+    /*! calculates the size of each subtree */
+    TASK_RUN_FUNCTION(BVH4Compressor,task_count);
+
+    /*! converts each subtree */
+    TASK_RUN_FUNCTION(BVH4Compressor,task_store);
+
+  public:
+    Builder* builder;               //!< builder for the uncompressed BVH
+    BVH4* bvh;                      //!< BVH to compress
+
+  private:
+    std::vector<Subtree> subtrees;  //!< subtrees below the top levels
+    std::vector<size_t> bytes;      //!< size of each subtree
+    char* base;                     //!< start of the memory block
+  };
+}
@@ -42,7 +42,7 @@ namespace embree
       StackItemInt32<NodeRef> stack[stackSize];  //!< stack of nodes 
       StackItemInt32<NodeRef>* stackPtr = stack+1;        //!< current stack pointer
       StackItemInt32<NodeRef>* stackEnd = stack+stackSize;
-      stack[0].ptr = bvh->root;
+      stack[0].ptr = bvh->getRoot();
       stack[0].dist = neg_inf;
             
       /*! load the ray into SIMD registers */
@@ -179,7 +179,7 @@ namespace embree
       NodeRef stack[stackSize];  //!< stack of nodes that still need to get traversed
       NodeRef* stackPtr = stack+1;        //!< current stack pointer
       NodeRef* stackEnd = stack+stackSize;
-      stack[0] = bvh->root;
+      stack[0] = bvh->getRoot();
       
       /*! load the ray into SIMD registers */
       const sse3f norg(-ray.org.x,-ray.org.y,-ray.org.z);
@@ -47,7 +47,7 @@ namespace embree
       NodeRef stack_node[stackSize];
       stack_node[0] = BVH4::invalidNode;
       stack_near[0] = inf;
-      stack_node[1] = bvh->root;
+      stack_node[1] = bvh->getRoot();
       stack_near[1] = ray_tnear; 
       NodeRef* stackEnd = stack_node+stackSize;
       NodeRef* __restrict__ sptr_node = stack_node + 2;
@@ -177,7 +177,7 @@ namespace embree
       NodeRef stack_node[stackSize];
       stack_node[0] = BVH4::invalidNode;
       stack_near[0] = inf;
-      stack_node[1] = bvh->root;
+      stack_node[1] = bvh->getRoot();
       stack_near[1] = ray_tnear; 
       NodeRef* stackEnd = stack_node+stackSize;
       NodeRef* __restrict__ sptr_node = stack_node + 2;
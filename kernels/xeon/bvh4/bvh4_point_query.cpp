@@ -0,0 +1,108 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+#include "bvh4_point_query.h"
+#include "geometry/triangle_point_query.h"
+
+namespace embree
+{ 
+  namespace isa
+  {
+    template<typename PrimitivePointQuery>
+    void BVH4PointQuery<PrimitivePointQuery>::pointQuery(const BVH4* bvh, PointQuery& query)
+    {
+      /*! stack state */
+      StackItem stack[stackSize];            //!< stack of nodes 
+      StackItem* stackPtr = stack+1;         //!< current stack pointer
+      StackItem* stackEnd = stack+stackSize;
+      stack[0].ptr = bvh->getRoot();
+      stack[0].dist = neg_inf;
+
+      /*! load the query point into SIMD registers */
+      const sse3f p(query.p.x,query.p.y,query.p.z);
+      float radius2 = query.radius2();
+
+      /* pop loop */
+      while (true) pop:
+      {
+        /*! pop next node */
+        if (unlikely(stackPtr == stack)) break;
+        stackPtr--;
+        NodeRef cur = NodeRef(stackPtr->ptr);
+        
+        /*! if popped node is too far, pop next one */
+        if (unlikely(stackPtr->dist > radius2))
+          continue;
+        
+        /* downtraversal loop */
+        while (true)
+        {
+          /*! stop if we found a leaf */
+          if (unlikely(cur.isLeaf())) break;
+          STAT3(normal.trav_nodes,1,1,1);
+          
+          /*! squared distances of the query point to the 4 boxes */
+          const Node* node = cur.node();
+          const ssef dx = max(node->lower_x-p.x,p.x-node->upper_x,ssef(zero));
+          const ssef dy = max(node->lower_y-p.y,p.y-node->upper_y,ssef(zero));
+          const ssef dz = max(node->lower_z-p.z,p.z-node->upper_z,ssef(zero));
+          const ssef dist2 = dx*dx + dy*dy + dz*dz;
+          /*! empty children are only in range for an infinite radius, they are leaves without primitives */
+          size_t mask = movemask(dist2 <= ssef(radius2));
+
+          /*! if no child is in range, pop next node */
+          if (unlikely(mask == 0))
+            goto pop;
+          
+          /*! one child is in range, continue with that child */
+          size_t r = __bscf(mask);
+          if (likely(mask == 0)) {
+            cur = node->child(r); cur.prefetch();
+            continue;
+          }
+
+          /*! push all children in range onto the stack, sort them, and continue with the closest child */
+          StackItem* stackBegin = stackPtr;
+          assert(stackPtr < stackEnd); 
+          stackPtr->ptr = node->child(r); stackPtr->dist = dist2[r]; stackPtr++;
+          while (mask) {
+            r = __bscf(mask);
+            assert(stackPtr < stackEnd); 
+            stackPtr->ptr = node->child(r); stackPtr->dist = dist2[r]; stackPtr++;
+          }
+          switch (stackPtr-stackBegin) {
+          case 2: sort(stackPtr[-1],stackPtr[-2]); break;
+          case 3: sort(stackPtr[-1],stackPtr[-2],stackPtr[-3]); break;
+          case 4: sort(stackPtr[-1],stackPtr[-2],stackPtr[-3],stackPtr[-4]); break;
+          }
+          cur = (NodeRef) stackPtr[-1].ptr; stackPtr--;
+        }
+        
+        /*! this is a leaf node */
+        STAT3(normal.trav_leaves,1,1,1);
+        size_t num; Primitive* prim = (Primitive*) cur.leaf(num);
+        PrimitivePointQuery::pointQuery(query,prim,num,bvh->geometry);
+        radius2 = query.radius2();
+      }
+      AVX_ZERO_UPPER();
+    }
+
+    DEFINE_POINT_QUERY1(BVH4Triangle4PointQuery,BVH4PointQuery<Triangle4PointQuery>);
+    DEFINE_POINT_QUERY1(BVH4Triangle4vPointQuery,BVH4PointQuery<Triangle4vPointQuery>);
+#if defined(__AVX__)
+    DEFINE_POINT_QUERY1(BVH4Triangle8PointQuery,BVH4PointQuery<Triangle8PointQuery>);
+#endif
+  }
+}
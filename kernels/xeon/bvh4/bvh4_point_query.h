@@ -0,0 +1,43 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+#pragma once
+
+#include "bvh4.h"
+#include "common/point_query.h"
+#include "common/stack_item.h"
+
+namespace embree
+{
+  namespace isa
+  {
+    /*! BVH4 closest point query. Children are visited in the order of
+     *  their distance to the query point, and subtrees further away
+     *  than the closest point found so far are skipped. */
+    template<typename PrimitivePointQuery>
+      class BVH4PointQuery
+    {
+      /* shortcuts for frequently used types */
+      typedef typename PrimitivePointQuery::Primitive Primitive;
+      typedef typename BVH4::NodeRef NodeRef;
+      typedef typename BVH4::Node Node;
+      typedef StackItemT<NodeRef> StackItem;
+      static const size_t stackSize = 1+3*BVH4::maxDepth;
+      
+    public:
+      static void pointQuery(const BVH4* This, PointQuery& query);
+    };
+  }
+}
@@ -18,24 +18,15 @@
 #include "bvh4_statistics.h"
 #include "sys/tasklogger.h"
 
-#include <algorithm>
-
 namespace embree
 {
   namespace isa
   {
-    static const size_t block_size = 1024;
-    
-    __forceinline bool compare(const BVH4::NodeRef* a, const BVH4::NodeRef* b)
-    {
-      int sa = *(size_t*)a->node();
-      int sb = *(size_t*)b->node();
-      return sa < sb;
-    }
-    
-    BVH4Refit::BVH4Refit (BVH4* bvh, Builder* builder, TriangleMesh* mesh)
-    : builder(builder), mesh(mesh), primTy(bvh->primTy), bvh(bvh) 
+    BVH4Refit::BVH4Refit (BVH4* bvh, TriangleMeshBuilderFunc createBuilder, TriangleMesh* mesh, size_t mode)
+    : createBuilder(createBuilder), mode(mode), mesh(mesh), primTy(bvh->primTy), builder(NULL), bvh(bvh), refitSAH(0.0f), buildSAH(0.0f), 
+      rebuildPending(true), rebuildNeedsAllThreads(false)
     {
+      builder = createBuilder(bvh,mesh,mode);
       needAllThreads = builder->needAllThreads;
     }
 
@@ -43,19 +34,33 @@ namespace embree
       delete builder;
     }
     
+    void BVH4Refit::rebuild(size_t threadIndex, size_t threadCount)
+    {
+      /* the builder is only kept during the build, deleting it frees its primitive array and shrinks the BVH memory */
+      if (builder == NULL) builder = createBuilder(bvh,mesh,mode);
+      builder->build(threadIndex,threadCount);
+      rebuildNeedsAllThreads = builder->needAllThreads;
+      delete builder; builder = NULL;
+      needAllThreads = false;
+      rebuildPending = false;
+      buildSAH = BVH4Statistics(bvh).sah();
+
+      subtrees.clear();
+      if (bvh->root.isNode()) {
+        size_t lower = -1, upper = 0; float sah = 0.0f;
+        annotate_subtrees(bvh->root,bvh->bounds,lower,upper,sah);
+      }
+    }
+    
     void BVH4Refit::build(size_t threadIndex, size_t threadCount) 
     {
-      /* build initial BVH */
-      if (builder) {
-        builder->build(threadIndex,threadCount);
-        if (false) { //bvh->numPrimitives > 50000) {
-          annotate_tree_sizes(bvh->root);
-          calculate_refit_roots();
-          needAllThreads = false;
-        } else {
-          needAllThreads = false;
-        }
-        delete builder; builder = NULL;
+      /* build initial BVH, or rebuild if refitting degraded the BVH too much */
+      if (rebuildPending) {
+        if (g_verbose >= 2 && buildSAH != 0.0f)
+          std::cout << "rebuilding BVH4 <" << bvh->primTy.name << "> after refit ... " << std::endl;
+        rebuild(threadIndex,threadCount);
+        mesh->resetModifiedVertices();
+        return;
       }
       
       /* refit BVH */
@@ -65,98 +70,49 @@ namespace embree
         t0 = getSeconds();
       }
       
-      /* schedule refit tasks */
-      size_t numRoots = roots.size();
-      if (numRoots <= 1) {
-        size_t taskID = TaskLogger::beginTask(threadIndex,"BVH4Refit::sequential",0);
-        refit_sequential(threadIndex,threadCount,NULL);
-        TaskLogger::endTask(threadIndex,taskID);
+      size_t taskID = TaskLogger::beginTask(threadIndex,"BVH4Refit::sequential",0);
+      refit_sequential(threadIndex,threadCount,NULL);
+      TaskLogger::endTask(threadIndex,taskID);
+      
+      mesh->resetModifiedVertices();
+      
+      /* schedule a rebuild if the SAH cost grew too much relative to the last build */
+      const float sah = bvh->bounds.empty() ? 0.0f : refitSAH/area(bvh->bounds);
+      if (g_refit_rebuild_ratio > 0.0f && sah > g_refit_rebuild_ratio*buildSAH) {
+        rebuildPending = true;
+        needAllThreads = rebuildNeedsAllThreads;
       }
-      else
-        TaskScheduler::executeTask(threadIndex,threadCount,_task_refit_parallel,this,numRoots,_task_refit_complete,this,"BVH4Refit::parallel");
       
       if (g_verbose >= 2) {
         double t1 = getSeconds();
         std::cout << "[DONE]" << std::endl;
         std::cout << "  dt = " << 1000.0f*(t1-t0) << "ms, perf = " << 1E-6*double(mesh->numTriangles)/(t1-t0) << " Mprim/s" << std::endl;
+        std::cout << "  sah = " << sah << " (build sah = " << buildSAH << ")" << (rebuildPending ? ", rebuild scheduled" : "") << std::endl;
         std::cout << BVH4Statistics(bvh).str();
       }
     }
     
-    size_t BVH4Refit::annotate_tree_sizes(BVH4::NodeRef& ref)
-    {
-      if (ref.isNode())
-      {
-        Node* node = ref.node();
-        size_t n = 0;
-        for (size_t i=0; i<BVH4::N; i++) {
-          BVH4::NodeRef& child = node->child(i);
-          if (child == BVH4::emptyNode) continue;
-          n += annotate_tree_sizes(child); 
-        }
-        *((size_t*)node) = n;
-        return n;
-      }
-      else
-      {
-        size_t num; 
-        ref.leaf(num);
-        return num;
-      }
-    }
-    
-    void BVH4Refit::calculate_refit_roots ()
-    {
-      if (!bvh->root.isNode()) return;
-      
-      roots.push_back(&bvh->root);
-      std::make_heap (roots.begin(), roots.end(), compare);
-      
-      while (true)
-      {
-        std::pop_heap(roots.begin(), roots.end(), compare);
-        BVH4::NodeRef* node = roots.back();
-        roots.pop_back();
-        if (*(size_t*)node->node() < block_size) 
-          break;
-        
-        for (size_t i=0; i<BVH4::N; i++) {
-          BVH4::NodeRef* child = &node->node()->child(i);
-          if (child->isNode()) {
-            roots.push_back(child);
-            std::push_heap(roots.begin(), roots.end(), compare);
-          }
-        }
-      }
-    }
-    
-    __forceinline BBox3fa BVH4Refit::leaf_bounds(NodeRef& ref)
+    __forceinline BBox3fa BVH4Refit::leaf_bounds(NodeRef& ref, float& sah)
     {
       size_t num; char* tri = ref.leaf(num);
       if (unlikely(num == 0)) return empty;
-      return bvh->primTy.update(tri,num,mesh);
+      const BBox3fa bounds = bvh->primTy.update(tri,num,mesh);
+      sah += area(bounds)*bvh->primTy.intCost*num;
+      return bounds;
     }
     
-    __forceinline BBox3fa BVH4Refit::node_bounds(NodeRef& ref)
-    {
-      if (ref.isNode())
-        return ref.node()->bounds();
-      else
-        return leaf_bounds(ref);
-    }
-    
-    BBox3fa BVH4Refit::recurse_bottom(NodeRef& ref)
+    BBox3fa BVH4Refit::recurse_bottom(NodeRef& ref, float& sah)
     {
       /* this is a leaf node */
       if (unlikely(ref.isLeaf()))
-        return leaf_bounds(ref);
+        return leaf_bounds(ref,sah);
       
       /* recurse if this is an internal node */
       Node* node = ref.node();
-      const BBox3fa bounds0 = recurse_bottom(node->child(0));
-      const BBox3fa bounds1 = recurse_bottom(node->child(1));
-      const BBox3fa bounds2 = recurse_bottom(node->child(2));
-      const BBox3fa bounds3 = recurse_bottom(node->child(3));
+      const BBox3fa bounds0 = recurse_bottom(node->child(0),sah);
+      const BBox3fa bounds1 = recurse_bottom(node->child(1),sah);
+      const BBox3fa bounds2 = recurse_bottom(node->child(2),sah);
+      const BBox3fa bounds3 = recurse_bottom(node->child(3),sah);
       
       /* AOS to SOA transform */
       BBox<sse3f> bounds;
@@ -178,33 +134,72 @@ namespace embree
       const float upper_x = reduce_max(bounds.upper.x);
       const float upper_y = reduce_max(bounds.upper.y);
       const float upper_z = reduce_max(bounds.upper.z);
-      return BBox3fa(Vec3fa(lower_x,lower_y,lower_z),
-                    Vec3fa(upper_x,upper_y,upper_z));
+      const BBox3fa merged(Vec3fa(lower_x,lower_y,lower_z),
+                           Vec3fa(upper_x,upper_y,upper_z));
+      sah += area(merged)*BVH4::travCost;
+      return merged;
     }
     
-    BBox3fa BVH4Refit::recurse_top(NodeRef& ref)
+    void BVH4Refit::annotate_subtrees(NodeRef& ref, const BBox3fa& bounds, size_t& lower, size_t& upper, float& sah)
     {
-      /* stop here if we encounter a barrier */
-      if (unlikely(ref.isBarrier())) {
-        ref.clearBarrier();
-        return node_bounds(ref);
-      }
+      const size_t index = subtrees.size();
+      subtrees.push_back(Subtree());
       
-      /* this is a leaf node */
-      if (unlikely(ref.isLeaf()))
-        return leaf_bounds(ref);
+      Node* node = ref.node();
+      size_t nodeLower = -1, nodeUpper = 0;
+      float nodeSAH = area(bounds)*BVH4::travCost;
+      for (size_t i=0; i<BVH4::N; i++) 
+      {
+        NodeRef& child = node->child(i);
+        if (child.isNode()) {
+          annotate_subtrees(child,node->bounds(i),nodeLower,nodeUpper,nodeSAH);
+          continue;
+        }
+        size_t num; char* tri = child.leaf(num);
+        if (num == 0) continue;
+        bvh->primTy.vertexRange(tri,num,mesh,nodeLower,nodeUpper);
+        nodeSAH += area(node->bounds(i))*bvh->primTy.intCost*num;
+      }
       
-      /* recurse if this is an internal node */
+      Subtree& subtree = subtrees[index];
+      subtree.lower = (unsigned) min(nodeLower,size_t(0xFFFFFFFF));
+      subtree.upper = (unsigned) min(nodeUpper,size_t(0xFFFFFFFF));
+      subtree.numNodes = (unsigned) (subtrees.size()-index);
+      subtree.sah = nodeSAH;
+      lower = min(lower,nodeLower);
+      upper = max(upper,nodeUpper);
+      sah += nodeSAH;
+    }
+    
+    BBox3fa BVH4Refit::recurse_modified(NodeRef& ref, size_t& index, float& sah)
+    {
+      Subtree& subtree = subtrees[index++];
       Node* node = ref.node();
-      const BBox3fa bounds0 = recurse_top(node->child(0));
-      const BBox3fa bounds1 = recurse_top(node->child(1));
-      const BBox3fa bounds2 = recurse_top(node->child(2));
-      const BBox3fa bounds3 = recurse_top(node->child(3));
+      float nodeSAH = 0.0f;
+      
+      /* refit leaves and modified subtrees, keep the bounds of unmodified subtrees */
+      BBox3fa cbounds[BVH4::N];
+      for (size_t i=0; i<BVH4::N; i++) 
+      {
+        NodeRef& child = node->child(i);
+        if (child.isLeaf()) {
+          cbounds[i] = leaf_bounds(child,nodeSAH);
+          continue;
+        }
+        const Subtree& csubtree = subtrees[index];
+        if (mesh->verticesModified(csubtree.lower,csubtree.upper)) {
+          cbounds[i] = recurse_modified(child,index,nodeSAH);
+        } else {
+          cbounds[i] = node->bounds(i);
+          nodeSAH += csubtree.sah;
+          index += csubtree.numNodes;
+        }
+      }
       
       /* AOS to SOA transform */
       BBox<sse3f> bounds;
-      transpose((ssef&)bounds0.lower,(ssef&)bounds1.lower,(ssef&)bounds2.lower,(ssef&)bounds3.lower,bounds.lower.x,bounds.lower.y,bounds.lower.z);
-      transpose((ssef&)bounds0.upper,(ssef&)bounds1.upper,(ssef&)bounds2.upper,(ssef&)bounds3.upper,bounds.upper.x,bounds.upper.y,bounds.upper.z);
+      transpose((ssef&)cbounds[0].lower,(ssef&)cbounds[1].lower,(ssef&)cbounds[2].lower,(ssef&)cbounds[3].lower,bounds.lower.x,bounds.lower.y,bounds.lower.z);
+      transpose((ssef&)cbounds[0].upper,(ssef&)cbounds[1].upper,(ssef&)cbounds[2].upper,(ssef&)cbounds[3].upper,bounds.upper.x,bounds.upper.y,bounds.upper.z);
       
       /* set new bounds */
       node->lower_x = bounds.lower.x;
@@ -221,23 +216,128 @@ namespace embree
       const float upper_x = reduce_max(bounds.upper.x);
       const float upper_y = reduce_max(bounds.upper.y);
       const float upper_z = reduce_max(bounds.upper.z);
-      return BBox3fa(Vec3fa(lower_x,lower_y,lower_z),
-                    Vec3fa(upper_x,upper_y,upper_z));
+      const BBox3fa merged(Vec3fa(lower_x,lower_y,lower_z),
+                           Vec3fa(upper_x,upper_y,upper_z));
+      nodeSAH += area(merged)*BVH4::travCost;
+      subtree.sah = nodeSAH;
+      sah += nodeSAH;
+      return merged;
     }
     
-    void BVH4Refit::task_refit_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event) 
+    void BVH4Refit::refit_sequential(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event) {
+      refitSAH = 0.0f;
+      if (subtrees.empty()) {
+        bvh->bounds = recurse_bottom(bvh->root,refitSAH);
+        return;
+      }
+      
+      /* only refit subtrees that reference modified vertices */
+      const Subtree& root = subtrees[0];
+      if (mesh->verticesModified(root.lower,root.upper)) {
+        size_t index = 0;
+        bvh->bounds = recurse_modified(bvh->root,index,refitSAH);
+      }
+      else 
+        refitSAH = root.sah;
+    }
+
+    BVH4UserGeometryRefit::BVH4UserGeometryRefit (BVH4* bvh, SceneBuilderFunc createBuilder, Scene* scene, size_t mode)
+    : createBuilder(createBuilder), mode(mode), builder(NULL), bvh(bvh), scene(scene), buildSAH(0.0f), rebuildPending(true), rebuildNeedsAllThreads(false)
     {
-      NodeRef& ref = *roots[taskIndex];
-      recurse_bottom(ref);
-      ref.setBarrier();
+      builder = createBuilder(bvh,scene,mode);
+      needAllThreads = builder->needAllThreads;
     }
-    
-    void BVH4Refit::task_refit_complete(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event) {
-      bvh->bounds = recurse_top(bvh->root);
+
+    BVH4UserGeometryRefit::~BVH4UserGeometryRefit () {
+      delete builder;
     }
-    
-    void BVH4Refit::refit_sequential(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event) {
-      bvh->bounds = recurse_bottom(bvh->root);
+
+    bool BVH4UserGeometryRefit::record_geometries()
+    {
+      bool same = true;
+      size_t n = 0;
+      for (size_t i=0; i<scene->size(); i++) 
+      {
+        Geometry* geom = scene->get(i);
+        if (geom == NULL || geom->type != USER_GEOMETRY || !geom->isEnabled()) continue;
+        const std::pair<Geometry*,size_t> entry(geom,((UserGeometryBase*)geom)->numItems);
+        if (n < geometries.size()) {
+          same &= geometries[n] == entry;
+          geometries[n] = entry;
+        } else {
+          same = false;
+          geometries.push_back(entry);
+        }
+        n++;
+      }
+      same &= n == geometries.size();
+      geometries.resize(n);
+      return same;
+    }
+
+    void BVH4UserGeometryRefit::build(size_t threadIndex, size_t threadCount) 
+    {
+      /* rebuild if the set of user geometries changed or refitting degraded the BVH too much */
+      if (!record_geometries() || rebuildPending) 
+      {
+        /* the builder is only kept during the build, deleting it frees its primitive array and shrinks the BVH memory */
+        if (builder == NULL) builder = createBuilder(bvh,scene,mode);
+        builder->build(threadIndex,threadCount);
+        rebuildNeedsAllThreads = builder->needAllThreads;
+        delete builder; builder = NULL;
+        buildSAH = BVH4Statistics(bvh).sah();
+        rebuildPending = false;
+        needAllThreads = false;
+        return;
+      }
+      
+      /* refit BVH */
+      double t0 = 0.0;
+      if (g_verbose >= 2) {
+        std::cout << "refitting BVH4 <" << bvh->primTy.name << "> ... " << std::flush;
+        t0 = getSeconds();
+      }
+
+      float refitSAH = 0.0f;
+      bvh->bounds = recurse(bvh->root,refitSAH);
+      
+      /* schedule a rebuild if the SAH cost grew too much relative to the last build */
+      const float sah = bvh->bounds.empty() ? 0.0f : refitSAH/area(bvh->bounds);
+      if (g_refit_rebuild_ratio > 0.0f && sah > g_refit_rebuild_ratio*buildSAH) {
+        rebuildPending = true;
+        needAllThreads = rebuildNeedsAllThreads;
+      }
+      
+      if (g_verbose >= 2) {
+        double t1 = getSeconds();
+        std::cout << "[DONE]" << std::endl;
+        std::cout << "  dt = " << 1000.0f*(t1-t0) << "ms, perf = " << 1E-6*double(scene->numUserGeometries1)/(t1-t0) << " Mprim/s" << std::endl;
+        std::cout << "  sah = " << sah << " (build sah = " << buildSAH << ")" << (rebuildPending ? ", rebuild scheduled" : "") << std::endl;
+      }
+    }
+
+    BBox3fa BVH4UserGeometryRefit::recurse(NodeRef& ref, float& sah)
+    {
+      /* recompute the bounds of all items of a leaf */
+      if (unlikely(ref.isLeaf())) 
+      {
+        size_t num; char* prim = ref.leaf(num);
+        if (unlikely(num == 0)) return empty;
+        const BBox3fa bounds = bvh->primTy.update(prim,num,NULL);
+        sah += area(bounds)*bvh->primTy.intCost*num;
+        return bounds;
+      }
+      
+      /* recurse if this is an internal node */
+      Node* node = ref.node();
+      BBox3fa merged = empty;
+      for (size_t i=0; i<BVH4::N; i++) {
+        const BBox3fa cbounds = recurse(node->child(i),sah);
+        node->set(i,cbounds);
+        merged.extend(cbounds);
+      }
+      sah += area(merged)*BVH4::travCost;
+      return merged;
     }
 
     Builder* BVH4Triangle1MeshBuilderFast  (void* bvh, TriangleMesh* mesh, size_t mode);
@@ -249,14 +349,18 @@ namespace embree
     Builder* BVH4Triangle4vMeshBuilderFast (void* bvh, TriangleMesh* mesh, size_t mode);
     Builder* BVH4Triangle4iMeshBuilderFast (void* bvh, TriangleMesh* mesh, size_t mode);
 
-    Builder* BVH4Triangle1MeshRefitFast (void* accel, TriangleMesh* mesh, size_t mode) { return new BVH4Refit((BVH4*)accel,BVH4Triangle1MeshBuilderFast(accel,mesh,mode),mesh); }
-    Builder* BVH4Triangle4MeshRefitFast (void* accel, TriangleMesh* mesh, size_t mode) { return new BVH4Refit((BVH4*)accel,BVH4Triangle4MeshBuilderFast(accel,mesh,mode),mesh); }
+    Builder* BVH4UserGeometryBuilderFast (void* bvh, Scene* scene, size_t mode);
+
+    Builder* BVH4UserGeometryRefitFast (void* accel, Scene* scene, size_t mode) { return new BVH4UserGeometryRefit((BVH4*)accel,BVH4UserGeometryBuilderFast,scene,mode); }
+
+    Builder* BVH4Triangle1MeshRefitFast (void* accel, TriangleMesh* mesh, size_t mode) { return new BVH4Refit((BVH4*)accel,BVH4Triangle1MeshBuilderFast,mesh,mode); }
+    Builder* BVH4Triangle4MeshRefitFast (void* accel, TriangleMesh* mesh, size_t mode) { return new BVH4Refit((BVH4*)accel,BVH4Triangle4MeshBuilderFast,mesh,mode); }
 #if defined(__AVX__)
-    Builder* BVH4Triangle8MeshRefitFast (void* accel, TriangleMesh* mesh, size_t mode) { return new BVH4Refit((BVH4*)accel,BVH4Triangle8MeshBuilderFast(accel,mesh,mode),mesh); }
+    Builder* BVH4Triangle8MeshRefitFast (void* accel, TriangleMesh* mesh, size_t mode) { return new BVH4Refit((BVH4*)accel,BVH4Triangle8MeshBuilderFast,mesh,mode); }
 #endif
-    Builder* BVH4Triangle1vMeshRefitFast (void* accel, TriangleMesh* mesh, size_t mode) { return new BVH4Refit((BVH4*)accel,BVH4Triangle1vMeshBuilderFast(accel,mesh,mode),mesh); }
-    Builder* BVH4Triangle4vMeshRefitFast (void* accel, TriangleMesh* mesh, size_t mode) { return new BVH4Refit((BVH4*)accel,BVH4Triangle4vMeshBuilderFast(accel,mesh,mode),mesh); }
-    Builder* BVH4Triangle4iMeshRefitFast (void* accel, TriangleMesh* mesh, size_t mode) { return new BVH4Refit((BVH4*)accel,BVH4Triangle4iMeshBuilderFast(accel,mesh,mode),mesh); }
+    Builder* BVH4Triangle1vMeshRefitFast (void* accel, TriangleMesh* mesh, size_t mode) { return new BVH4Refit((BVH4*)accel,BVH4Triangle1vMeshBuilderFast,mesh,mode); }
+    Builder* BVH4Triangle4vMeshRefitFast (void* accel, TriangleMesh* mesh, size_t mode) { return new BVH4Refit((BVH4*)accel,BVH4Triangle4vMeshBuilderFast,mesh,mode); }
+    Builder* BVH4Triangle4iMeshRefitFast (void* accel, TriangleMesh* mesh, size_t mode) { return new BVH4Refit((BVH4*)accel,BVH4Triangle4iMeshBuilderFast,mesh,mode); }
   }
 }
 
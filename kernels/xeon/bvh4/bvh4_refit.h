@@ -35,38 +35,94 @@ namespace embree
       
       void build(size_t threadIndex, size_t threadCount);
       
-      /*! Constructor. */
-      BVH4Refit (BVH4* bvh, Builder* builder, TriangleMesh* mesh);
+      /*! Constructor. The builder gets created for each (re)build of the BVH. */
+      BVH4Refit (BVH4* bvh, TriangleMeshBuilderFunc createBuilder, TriangleMesh* mesh, size_t mode);
 
       ~BVH4Refit();
 
       TASK_COMPLETE_FUNCTION(BVH4Refit,refit_sequential);
       
-      TASK_RUN_FUNCTION(BVH4Refit,task_refit_parallel);
-      TASK_COMPLETE_FUNCTION(BVH4Refit,task_refit_complete);
-      
     private:
-      size_t annotate_tree_sizes(NodeRef& ref);
-      void calculate_refit_roots ();
-      
-      BBox3fa leaf_bounds(NodeRef& ref);
-      BBox3fa node_bounds(NodeRef& ref);
-      BBox3fa recurse_bottom(NodeRef& ref);
-      BBox3fa recurse_top(NodeRef& ref);
+      BBox3fa leaf_bounds(NodeRef& ref, float& sah);
+      BBox3fa recurse_bottom(NodeRef& ref, float& sah);
+
+      /*! records vertex range and SAH cost of all subtrees */
+      void annotate_subtrees(NodeRef& ref, const BBox3fa& bounds, size_t& lower, size_t& upper, float& sah);
+
+      /*! refits only subtrees that reference modified vertices */
+      BBox3fa recurse_modified(NodeRef& ref, size_t& index, float& sah);
+
+      /*! builds the BVH from scratch and remembers its SAH cost */
+      void rebuild(size_t threadIndex, size_t threadCount);
       
     private:
       //BuildSource* source;           //!< input geometry
       //void* geometry;                //!< input geometry
+      TriangleMeshBuilderFunc createBuilder; //!< creates the builder used to (re)build the BVH
+      size_t mode;                   //!< build mode passed to the builder
       TriangleMesh* mesh;
       
     public:
       const PrimitiveType& primTy;   //!< primitve type stored in BVH
-      TaskScheduler::Task task;      //!< parallel refit task
+      
+      /*! vertex range and SAH cost of a subtree */
+      struct Subtree
+      {
+        unsigned lower;     //!< smallest vertex ID referenced by the subtree
+        unsigned upper;     //!< largest vertex ID referenced by the subtree
+        unsigned numNodes;  //!< number of inner nodes of the subtree
+        float sah;          //!< unnormalized SAH cost of the subtree
+      };
+      
+    public:
+      Builder* builder;               //!< builder of the next (re)build, NULL after the build
+      BVH4* bvh;                      //!< BVH to refit
+      std::vector<Subtree> subtrees;  //!< all inner nodes in depth first order
+      float refitSAH;                 //!< unnormalized SAH cost of the last refit
+      float buildSAH;                 //!< SAH cost of the BVH after the last rebuild
+      bool rebuildPending;            //!< rebuild the BVH on the next build call
+      bool rebuildNeedsAllThreads;    //!< the last build requested all threads
+    };
+
+    /*! Refits the BVH over the user geometries and instances of a
+     *  scene when only their bounds changed (e.g. through
+     *  rtcSetTransform), and rebuilds it if user geometries got
+     *  added, deleted, enabled, or disabled. */
+    class BVH4UserGeometryRefit : public Builder
+    {
+      ALIGNED_CLASS;
+    public:
+      
+      /*! Type shortcuts */
+      typedef BVH4::Node    Node;
+      typedef BVH4::NodeRef NodeRef;
       
     public:
-      Builder* builder;
+      
+      /*! Constructor. The builder gets created for each (re)build of the BVH. */
+      BVH4UserGeometryRefit (BVH4* bvh, SceneBuilderFunc createBuilder, Scene* scene, size_t mode);
+
+      ~BVH4UserGeometryRefit();
+
+      void build(size_t threadIndex, size_t threadCount);
+      
+    private:
+
+      /*! records the enabled user geometries, returns false if they changed since the last call */
+      bool record_geometries();
+
+      BBox3fa recurse(NodeRef& ref, float& sah);
+      
+    private:
+      SceneBuilderFunc createBuilder; //!< creates the builder used to (re)build the BVH
+      size_t mode;                    //!< build mode passed to the builder
+      Builder* builder;               //!< builder of the next (re)build, NULL after the build
       BVH4* bvh;                      //!< BVH to refit
-      std::vector<NodeRef*> roots;    //!< List of equal sized subtrees for bvh refit
+      Scene* scene;                   //!< scene the user geometries belong to
+      std::vector<std::pair<Geometry*,size_t> > geometries; //!< enabled user geometries and their number of items at the last build
+      float buildSAH;                 //!< SAH cost of the BVH after the last rebuild
+      bool rebuildPending;            //!< rebuild the BVH on the next build call
+      bool rebuildNeedsAllThreads;    //!< the last build requested all threads
     };
   }
 }
@@ -0,0 +1,221 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh4_restructure.h"
+
+namespace embree
+{
+  static const size_t MAX_TREELET_LEAVES = BVH4Restructure::MAX_TREELET_LEAVES;
+  static const size_t MAX_TREELET_SETS = 1 << MAX_TREELET_LEAVES;
+
+  typedef BVH4::Node Node;
+  typedef BVH4::NodeRef NodeRef;
+
+  /*! Treelet of subtrees and the optimal BVH4 over all subsets of these subtrees. */
+  struct Treelet
+  {
+    /*! returns the parts the optimal node over the set S splits S into */
+    __forceinline size_t parts(size_t S, size_t part[BVH4::N]) const
+    {
+      size_t n = 0;
+      for (size_t k=arity[S]; k>1; k--) {
+        part[n++] = split[k-2][S];
+        S ^= split[k-2][S];
+      }
+      part[n++] = S;
+      return n;
+    }
+
+    /*! returns the depth of the optimal subtree over the set S */
+    int depth(size_t S) const
+    {
+      if ((S & (S-1)) == 0) return leafDepth[__bsf(S)];
+      size_t part[BVH4::N]; 
+      const size_t n = parts(S,part);
+      int d = 0;
+      for (size_t i=0; i<n; i++) d = max(d,depth(part[i]));
+      return 1+d;
+    }
+
+    /*! writes the optimal subtree over the set S into node */
+    void build(BVH4* bvh, size_t S, Node* node, BVH4Restructure::Allocator& alloc)
+    {
+      size_t part[BVH4::N]; 
+      const size_t n = parts(S,part);
+      node->clear();
+      for (size_t i=0; i<n; i++) 
+      {
+        const size_t P = part[i];
+        if ((P & (P-1)) == 0) {
+          const size_t leaf = __bsf(P);
+          node->set(i,bounds[leaf],leaves[leaf]);
+          continue;
+        }
+        Node* child = nextNode < numNodes ? nodes[nextNode++] : (Node*) alloc.malloc(sizeof(Node));
+        build(bvh,P,child,alloc);
+        node->set(i,box[P],bvh->encodeNode(child));
+      }
+    }
+
+  public:
+    size_t numLeaves;                        //!< number of subtrees of the treelet
+    NodeRef leaves[MAX_TREELET_LEAVES];      //!< subtrees of the treelet
+    BBox3fa bounds[MAX_TREELET_LEAVES];      //!< bounds of the subtrees
+    int leafDepth[MAX_TREELET_LEAVES];       //!< conservative depth of the subtrees
+
+    size_t numNodes;                         //!< number of internal nodes of the treelet
+    size_t nextNode;                         //!< next internal node to reuse
+    Node* nodes[MAX_TREELET_LEAVES];         //!< internal nodes of the treelet, the first one is the treelet root
+
+    BBox3fa box[MAX_TREELET_SETS];           //!< bounds of each set of subtrees
+    float cost[MAX_TREELET_SETS];            //!< SAH cost of the optimal subtree over each set
+    float costN[3][MAX_TREELET_SETS];        //!< SAH cost of splitting each set into 2, 3, and 4 parts
+    unsigned char arity[MAX_TREELET_SETS];   //!< number of children of the optimal node over each set
+    unsigned char split[3][MAX_TREELET_SETS];//!< first part when splitting each set into 2, 3, and 4 parts
+  };
+
+  /*! Reorganizes the treelet rooted at parent and returns the new depth of the subtree. */
+  static __noinline int restructureTreelet(BVH4* bvh, Node* parent, const int cdepth[BVH4::N], const int oldDepth, const size_t depth, BVH4Restructure::Allocator& alloc)
+  {
+    /*! the treelet starts with the children of the node */
+    __aligned(64) Treelet treelet;
+    treelet.numLeaves = 0;
+    for (size_t c=0; c<BVH4::N; c++) {
+      if (parent->child(c) == BVH4::emptyNode) continue;
+      treelet.leaves   [treelet.numLeaves] = parent->child(c);
+      treelet.bounds   [treelet.numLeaves] = parent->bounds(c);
+      treelet.leafDepth[treelet.numLeaves] = cdepth[c];
+      treelet.numLeaves++;
+    }
+    treelet.nodes[0] = parent;
+    treelet.numNodes = 1;
+
+    /*! grow the treelet by opening the subtree with the largest surface area */
+    float oldCost = 0.0f;
+    while (treelet.numNodes < MAX_TREELET_LEAVES)
+    {
+      ssize_t best = -1; 
+      float bestArea = neg_inf;
+      for (size_t i=0; i<treelet.numLeaves; i++) 
+      {
+        if (treelet.leaves[i].isBarrier() || treelet.leaves[i].isLeaf()) continue;
+        const float area = halfArea(treelet.bounds[i]);
+        if (area > bestArea) { best = i; bestArea = area; }
+      }
+      if (best == -1) break;
+
+      Node* node = treelet.leaves[best].node();
+      size_t numChildren = 0;
+      for (size_t c=0; c<BVH4::N; c++) 
+        numChildren += node->child(c) != BVH4::emptyNode;
+      if (treelet.numLeaves-1+numChildren > MAX_TREELET_LEAVES) break;
+
+      /*! replace the subtree by its children, the depth of a child is at most one less than the depth of the subtree */
+      const int childDepth = max(0,treelet.leafDepth[best]-1);
+      ssize_t slot = best;
+      for (size_t c=0; c<BVH4::N; c++) 
+      {
+        if (node->child(c) == BVH4::emptyNode) continue;
+        if (slot == -1) slot = treelet.numLeaves++;
+        treelet.leaves   [slot] = node->child(c);
+        treelet.bounds   [slot] = node->bounds(c);
+        treelet.leafDepth[slot] = childDepth;
+        slot = -1;
+      }
+      treelet.nodes[treelet.numNodes++] = node;
+      oldCost += bestArea;
+    }
+
+    /*! nothing to restructure if no subtree could get opened */
+    if (treelet.numNodes == 1) return oldDepth;
+
+    /*! find the optimal BVH4 over all subsets of the treelet leaves,
+     *  subsets are processed in increasing order thus all proper
+     *  subsets of a set are processed before the set itself */
+    const size_t numSets = size_t(1) << treelet.numLeaves;
+    for (size_t S=1; S<numSets; S++)
+    {
+      const size_t low = S & (0-S);
+      const size_t rest = S ^ low;
+      if (rest == 0) {
+        treelet.box[S] = treelet.bounds[__bsf(S)];
+        treelet.cost[S] = 0.0f;
+        treelet.costN[0][S] = treelet.costN[1][S] = treelet.costN[2][S] = inf;
+        treelet.arity[S] = 1;
+        continue;
+      }
+      treelet.box[S] = merge(treelet.box[rest],treelet.box[low]);
+
+      /*! enumerate all first parts that contain the lowest subtree of the set */
+      float best[3] = { inf, inf, inf };
+      unsigned char bestSplit[3] = { 0, 0, 0 };
+      for (size_t sub=(rest-1)&rest;; sub=(sub-1)&rest)
+      {
+        const size_t T = low | sub;
+        const size_t R = S ^ T;
+        const float c2 = treelet.cost[T] + treelet.cost[R];
+        const float c3 = treelet.cost[T] + treelet.costN[0][R];
+        const float c4 = treelet.cost[T] + treelet.costN[1][R];
+        if (c2 < best[0]) { best[0] = c2; bestSplit[0] = (unsigned char)T; }
+        if (c3 < best[1]) { best[1] = c3; bestSplit[1] = (unsigned char)T; }
+        if (c4 < best[2]) { best[2] = c4; bestSplit[2] = (unsigned char)T; }
+        if (sub == 0) break;
+      }
+
+      size_t k = 0;
+      for (size_t i=0; i<3; i++) {
+        treelet.costN[i][S] = best[i];
+        treelet.split[i][S] = bestSplit[i];
+        if (best[i] < best[k]) k = i;
+      }
+      treelet.arity[S] = (unsigned char)(k+2);
+      treelet.cost[S] = halfArea(treelet.box[S]) + best[k];
+    }
+
+    /*! keep the treelet if restructuring does not reduce the SAH cost of its inner nodes */
+    const size_t all = numSets-1;
+    const float newCost = treelet.cost[all]-halfArea(treelet.box[all]);
+    if (!(newCost < 0.999f*oldCost)) return oldDepth;
+
+    /*! only accept treelets that fulfill the depth constraint */
+    const int newDepth = treelet.depth(all);
+    if (newDepth > oldDepth && int(depth)-1+newDepth > int(BVH4::maxBuildDepth)) return oldDepth;
+
+    /*! write the treelet, reusing its inner nodes */
+    treelet.nextNode = 1;
+    treelet.build(bvh,all,parent,alloc);
+    return newDepth;
+  }
+
+  size_t BVH4Restructure::restructure(BVH4* bvh, NodeRef parentRef, Allocator& alloc, size_t depth)
+  {
+    /*! nothing to restructure if we reached a leaf node. */
+    if (parentRef.isBarrier()) return 0;
+    if (parentRef.isLeaf()) return 0;
+    Node* parent = parentRef.node();
+
+    /*! restructure all children first */
+    int cdepth[BVH4::N];
+    int oldDepth = 0;
+    for (size_t c=0; c<BVH4::N; c++) {
+      cdepth[c] = (int)restructure(bvh,parent->child(c),alloc,depth+1);
+      oldDepth = max(oldDepth,1+cdepth[c]);
+    }
+
+    /*! reorganize the treelet of this node */
+    return restructureTreelet(bvh,parent,cdepth,oldDepth,depth,alloc);
+  }
+}
@@ -0,0 +1,43 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "bvh4.h"
+
+namespace embree
+{
+  /* BVH4 Treelet Restructuring. Reorganizes small treelets of a
+   * node and its largest descendants into the SAH optimal BVH4 over
+   * the treelet's subtrees. */
+  class BVH4Restructure
+  {
+  public:
+    typedef BVH4::Node Node;
+    typedef BVH4::NodeRef NodeRef;
+    typedef LinearAllocatorPerThread::ThreadAllocator Allocator;
+
+    /*! maximal number of subtrees a treelet is formed of */
+    static const size_t MAX_TREELET_LEAVES = 7;
+
+  public:
+
+    /*! Restructures the subtree bottom up and returns its depth. The
+     *  restructuring does not enter nodes marked as barrier. Nodes
+     *  additionally required by a treelet are taken from alloc. */
+    static size_t restructure(BVH4* bvh, NodeRef parentRef, Allocator& alloc, size_t depth = 1);
+  };
+}
@@ -562,6 +562,11 @@ namespace embree
       return (char*) alloc.malloc(thread,num*primTy.bytes,1 << 4);
     }
 
+    /*! calculates the amount of bytes allocated */
+    size_t bytesAllocated() const {
+      return alloc.bytes();
+    }
+
     /*! Encodes an alingned node */
     __forceinline NodeRef encodeNode(AlignedNode* node) { 
       return NodeRef((size_t) node);
@@ -58,7 +58,9 @@ namespace embree
 
   void BVH4MB::clear() 
   {
-    root = (Base*)Base::empty;
+    for (size_t i=0; i<numTimeSegments; i++)
+      roots[i] = (Base*)Base::empty;
+    numTimeSegments = 1;
     bounds = empty;
     alloc.clear();
   }
@@ -248,7 +250,12 @@ namespace embree
   {
     /* calculate statistics */
     numNodes = numLeaves = numPrimBlocks = numPrims = depth = 0;
-    bvhSAH = statistics(root,0.0f,depth);
+    bvhSAH = 0.0f;
+    for (size_t i=0; i<numTimeSegments; i++) {
+      size_t cdepth = 0;
+      bvhSAH += statistics(roots[i],0.0f,cdepth);
+      depth = max(depth,cdepth);
+    }
 
     /* output statistics */
     std::ostringstream stream;
@@ -259,6 +266,7 @@ namespace embree
     stream.setf(std::ios::scientific, std::ios::floatfield);
     stream.precision(2);
     stream << "sah = " << bvhSAH << std::endl;
+    stream << "segments = " << numTimeSegments << std::endl;
     stream.setf(std::ios::fixed, std::ios::floatfield);
     stream.precision(1);
     stream << "depth = " << depth << std::endl;
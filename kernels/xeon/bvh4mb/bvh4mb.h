@@ -225,7 +225,11 @@ namespace embree
 
     /*! BVH4MB default constructor. */
     BVH4MB (const PrimitiveType& primTy, void* geometry = NULL)
-      : primTy(primTy), geometry(geometry), root((Base*)Base::empty) {}
+      : primTy(primTy), geometry(geometry), numTimeSegments(1) 
+    {
+      for (size_t i=0; i<RTC_MAX_TIME_STEPS-1; i++)
+        roots[i] = (Base*)Base::empty;
+    }
 
     ~BVH4MB () {
       clear();
@@ -238,6 +242,11 @@ namespace embree
     /*! clears the acceleration structure */
     void clear ();
 
+    /*! calculates the amount of bytes allocated */
+    size_t bytesAllocated() const {
+      return alloc.bytes();
+    }
+
     /*! prints statistics */
     void print();
 
@@ -252,7 +261,16 @@ namespace embree
     AllocatorPerThread alloc;          //!< allocator for nodes and triangles
     const PrimitiveType& primTy;       //!< primitive type stored in the BVH
     void* geometry;                    //!< pointer to geometry for intersection
-    Base* root;                      //!< Root node (can also be a leaf).
+    size_t numTimeSegments;            //!< number of time segments with a separate tree
+    Base* roots[RTC_MAX_TIME_STEPS-1]; //!< Root node of each time segment (can also be a leaf).
+
+    /*! returns the time segment of time t in [0,1] and the time inside this segment */
+    __forceinline float segmentTime(float t, size_t& segment) const 
+    {
+      const float ft = t*float(numTimeSegments);
+      segment = min(size_t(max(ft,0.0f)),numTimeSegments-1);
+      return ft-float(segment);
+    }
 
     __forceinline Node* allocNode(size_t thread) {
       Node* node = (Node*) alloc.malloc(thread,sizeof(Node),1 << alignment); node->clear(); return node;
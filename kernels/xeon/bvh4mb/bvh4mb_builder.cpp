@@ -42,7 +42,7 @@ namespace embree
     BVH4MBBuilder::BVH4MBBuilder (BVH4MB* bvh, Scene* scene, TriangleMesh* mesh, size_t mode,
 				size_t logBlockSize, size_t logSAHBlockSize, float intCost, 
 				bool needVertices, size_t primBytes, const size_t minLeafSize, const size_t maxLeafSize)
-      : scene(scene), mesh(mesh), bvh(bvh), enableSpatialSplits(mode > 0), remainingReplications(0),
+      : scene(scene), mesh(mesh), bvh(bvh), time0(0.0f), time1(1.0f), enableSpatialSplits(mode > 0), remainingReplications(0),
 	logBlockSize(logBlockSize), logSAHBlockSize(logSAHBlockSize), intCost(intCost), 
 	needVertices(needVertices), primBytes(primBytes), minLeafSize(minLeafSize), maxLeafSize(maxLeafSize)
      {
@@ -282,7 +282,7 @@ namespace embree
       
       /* insert all triangles */
       PrimRefList::block_iterator_unsafe iter(prims);
-      for (size_t i=0; i<N; i++) leaf[i].fill(iter,scene);
+      for (size_t i=0; i<N; i++) leaf[i].fill(iter,scene,time0,time1);
       assert(!iter);
       
       /* free all primitive blocks */
@@ -491,6 +491,29 @@ namespace embree
     }
 #endif
 
+    size_t BVH4MBBuilder::countTimeSegments() const
+    {
+      if (mesh) return mesh->numTimeSteps-1;
+      return scene->numTimeSegments();
+    }
+
+    void BVH4MBBuilder::segmentBounds(PrimRefList& prims, PrimInfo& pinfo)
+    {
+      pinfo = PrimInfo(empty);
+      for (PrimRefList::block_iterator_unsafe iter(prims); iter; iter++)
+      {
+        const TriangleMesh* mesh = scene->getTriangleMesh(iter->geomID());
+        const TriangleMesh::Triangle& tri = mesh->triangle(iter->primID());
+        BBox3fa bounds = empty;
+        for (size_t i=0; i<3; i++) {
+          bounds.extend(mesh->vertexAtTime(tri.v[i],time0));
+          bounds.extend(mesh->vertexAtTime(tri.v[i],time1));
+        }
+        *iter = PrimRef(bounds,iter->geomID(),iter->primID());
+        pinfo.add(bounds,iter->center2());
+      }
+    }
+
     void BVH4MBBuilder::build(size_t threadIndex, size_t threadCount) 
     {
       /*! calculate number of primitives */
@@ -522,56 +545,67 @@ namespace embree
       if (g_verbose >= 2 || g_benchmark)
 	t0 = getSeconds();
       
-      /* generate list of build primitives */
-      PrimRefList prims; PrimInfo pinfo(empty);
-      if (mesh) PrimRefListGenFromGeometry<TriangleMesh>::generate(threadIndex,threadCount,&alloc,mesh ,prims,pinfo);
-      else      PrimRefListGen                          ::generate(threadIndex,threadCount,&alloc,scene,TRIANGLE_MESH,2,prims,pinfo);
-      
-      /* perform initial split */
-      const Split split = find<true>(threadIndex,threadCount,1,prims,pinfo,enableSpatialSplits);
-      const BuildRecord record(1,prims,pinfo,split,&bvh->root);
-      tasks.push_back(record); 
-      activeBuildRecords=1;
-
-      /* work in multithreaded toplevel mode until sufficient subtasks got generated */
-      while (tasks.size() > 0 && tasks.size() < threadCount)
+      /* build a separate tree for each time segment */
+      bvh->numTimeSegments = countTimeSegments();
+      BBox3fa bounds = empty;
+      for (size_t segment=0; segment<bvh->numTimeSegments; segment++)
       {
-	/* pop largest item for better load balancing */
-	BuildRecord task = tasks.front();
-	std::pop_heap(tasks.begin(),tasks.end());
-	tasks.pop_back();
-	activeBuildRecords--;
-	
-	/* process this item in parallel */
-	BuildRecord children[BVH4MB::N];
-	size_t N = createNode<true>(threadIndex,threadCount,this,task,children);
-	for (size_t i=0; i<N; i++) {
-	  tasks.push_back(children[i]);
-	  std::push_heap(tasks.begin(),tasks.end());
-	  activeBuildRecords++;
-	}
-      }
-      
-      /*! process each generated subtask in its own thread */
-      TaskScheduler::executeTask(threadIndex,threadCount,_build_parallel,this,threadCount,"BVH4MBBuilder::build");
-                  
-      /* perform tree rotations of top part of the tree */
+        time0 = float(segment+0)/float(bvh->numTimeSegments);
+        time1 = float(segment+1)/float(bvh->numTimeSegments);
+
+        /* generate list of build primitives */
+        PrimRefList prims; PrimInfo pinfo(empty);
+        if (mesh) PrimRefListGenFromGeometry<TriangleMesh>::generate(threadIndex,threadCount,&alloc,mesh ,prims,pinfo);
+        else      PrimRefListGen                          ::generate(threadIndex,threadCount,&alloc,scene,TRIANGLE_MESH,2,prims,pinfo);
+        segmentBounds(prims,pinfo);
+        
+        /* perform initial split */
+        const Split split = find<true>(threadIndex,threadCount,1,prims,pinfo,enableSpatialSplits);
+        const BuildRecord record(1,prims,pinfo,split,&bvh->roots[segment]);
+        tasks.push_back(record); 
+        activeBuildRecords=1;
+
+        /* work in multithreaded toplevel mode until sufficient subtasks got generated */
+        while (tasks.size() > 0 && tasks.size() < threadCount)
+        {
+	  /* pop largest item for better load balancing */
+	  BuildRecord task = tasks.front();
+	  std::pop_heap(tasks.begin(),tasks.end());
+	  tasks.pop_back();
+	  activeBuildRecords--;
+	  
+	  /* process this item in parallel */
+	  BuildRecord children[BVH4MB::N];
+	  size_t N = createNode<true>(threadIndex,threadCount,this,task,children);
+	  for (size_t i=0; i<N; i++) {
+	    tasks.push_back(children[i]);
+	    std::push_heap(tasks.begin(),tasks.end());
+	    activeBuildRecords++;
+	  }
+        }
+        
+        /*! process each generated subtask in its own thread */
+        TaskScheduler::executeTask(threadIndex,threadCount,_build_parallel,this,threadCount,"BVH4MBBuilder::build");
+                    
+        /* perform tree rotations of top part of the tree */
 /*#if ROTATE_TREE
-      for (int i=0; i<5; i++) 
-	BVH4MBRotate::rotate(bvh,bvh->root);
-	#endif*/
+        for (int i=0; i<5; i++) 
+	  BVH4MBRotate::rotate(bvh,bvh->root);
+	  #endif*/
 
-      /* layout top nodes */
-      //bvh->root = layout_top_nodes(threadIndex,bvh->root);
-      bvh->refit(scene,bvh->root);
-      //bvh->clearBarrier(bvh->root);
-      //bvh->numPrimitives = pinfo.size();
-      bvh->bounds = pinfo.geomBounds;
+        /* layout top nodes */
+        //bvh->root = layout_top_nodes(threadIndex,bvh->root);
+        bvh->refit(scene,bvh->roots[segment]);
+        //bvh->clearBarrier(bvh->root);
+        //bvh->numPrimitives = pinfo.size();
+        bounds.extend(pinfo.geomBounds);
 
 #if RESTRUCTURE_TREE
-      for (int i=0; i<5; i++) 
-        restructureTree(bvh->root,0);
+        for (int i=0; i<5; i++) 
+          restructureTree(bvh->roots[segment],0);
 #endif
+      }
+      bvh->bounds = bounds;
       
       /* free all temporary memory blocks */
       Alloc::global.clear();
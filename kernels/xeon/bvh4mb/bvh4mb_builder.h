@@ -102,11 +102,19 @@ namespace embree
       /*! performs some brute force restructuring of the tree */
       void restructureTree(NodeRef& ref, size_t depth);
 
+      /*! returns the number of time segments, such that each time step of each motion blurred mesh is a segment boundary */
+      size_t countTimeSegments() const;
+
+      /*! sets the build primitive bounds to the bounds over the current time segment */
+      void segmentBounds(PrimRefList& prims, PrimInfo& pinfo);
+
     protected:
       Scene* scene;                       //!< input geometry
       TriangleMesh* mesh;                 //!< input triangle mesh
       PrimRefBlockAlloc<PrimRef> alloc;   //!< Allocator for primitive blocks
       BVH4MB* bvh;                          //!< Output BVH4MB
+      float time0;                        //!< start time of the time segment currently build
+      float time1;                        //!< end time of the time segment currently build
 
       /*! build record task list */
     private:
@@ -24,13 +24,13 @@ namespace embree
   namespace isa
   {
     template<typename TriangleIntersector>
-    void BVH4MBIntersector1<TriangleIntersector>::intersect(const BVH4MB* bvh, Ray& ray)
+    void BVH4MBIntersector1<TriangleIntersector>::intersectSegment(const BVH4MB* bvh, Base* root, Ray& ray, const float time)
     {
       AVX_ZERO_UPPER();
       STAT3(normal.travs,1,1,1);
       
       /*! stack state */
-      Base* popCur  = bvh->root;              //!< pre-popped top node from the stack
+      Base* popCur  = root;                   //!< pre-popped top node from the stack
       float popDist = neg_inf;                //!< pre-popped distance of top node from the stack
       StackItem stack[1+3*BVH4MB::maxDepth];  //!< stack of nodes that still need to get traversed
       StackItem* stackPtr = stack+1;          //!< current stack pointer
@@ -76,16 +76,16 @@ namespace embree
           const ssef* pNearX = (const ssef*)((const char*)node+nearX);
           const ssef* pNearY = (const ssef*)((const char*)node+nearY);
           const ssef* pNearZ = (const ssef*)((const char*)node+nearZ);
-          const ssef tNearX = (norg.x + ssef(pNearX[0]) + ray.time*pNearX[1]) * rdir.x;
-          const ssef tNearY = (norg.y + ssef(pNearY[0]) + ray.time*pNearY[1]) * rdir.y;
-          const ssef tNearZ = (norg.z + ssef(pNearZ[0]) + ray.time*pNearZ[1]) * rdir.z;
+          const ssef tNearX = (norg.x + ssef(pNearX[0]) + time*pNearX[1]) * rdir.x;
+          const ssef tNearY = (norg.y + ssef(pNearY[0]) + time*pNearY[1]) * rdir.y;
+          const ssef tNearZ = (norg.z + ssef(pNearZ[0]) + time*pNearZ[1]) * rdir.z;
           const ssef tNear = max(tNearX,tNearY,tNearZ,rayNear);
           const ssef* pFarX = (const ssef*)((const char*)node+farX);
           const ssef* pFarY = (const ssef*)((const char*)node+farY);
           const ssef* pFarZ = (const ssef*)((const char*)node+farZ);
-          const ssef tFarX = (norg.x + ssef(pFarX[0]) + ray.time*pFarX[1]) * rdir.x;
-          const ssef tFarY = (norg.y + ssef(pFarY[0]) + ray.time*pFarY[1]) * rdir.y;
-          const ssef tFarZ = (norg.z + ssef(pFarZ[0]) + ray.time*pFarZ[1]) * rdir.z;
+          const ssef tFarX = (norg.x + ssef(pFarX[0]) + time*pFarX[1]) * rdir.x;
+          const ssef tFarY = (norg.y + ssef(pFarY[0]) + time*pFarY[1]) * rdir.y;
+          const ssef tFarZ = (norg.z + ssef(pFarZ[0]) + time*pFarZ[1]) * rdir.z;
           popCur = (Base*) stackPtr[-1].ptr;      //!< pre-pop of topmost stack item
           popDist = stackPtr[-1].dist;            //!< pre-pop of distance of topmost stack item
           const ssef tFar = min(tFarX,tFarY,tFarZ,rayFar);
@@ -139,7 +139,7 @@ namespace embree
           STAT3(normal.trav_leaves,1,1,1);
           size_t num; Triangle* tri = (Triangle*) cur->leaf(num);
           for (size_t i=0; i<num; i++)
-            TriangleIntersector::intersect(ray,tri[i],bvh->geometry);
+            TriangleIntersector::intersect(ray,time,tri[i],bvh->geometry);
           
           popCur = (Base*) stackPtr[-1].ptr;  //!< pre-pop of topmost stack item
           popDist = stackPtr[-1].dist;        //!< pre-pop of distance of topmost stack item
@@ -150,7 +150,7 @@ namespace embree
     }
     
     template<typename TriangleIntersector>
-    void BVH4MBIntersector1<TriangleIntersector>::occluded(const BVH4MB* bvh, Ray& ray)
+    void BVH4MBIntersector1<TriangleIntersector>::occludedSegment(const BVH4MB* bvh, Base* root, Ray& ray, const float time)
     {
       AVX_ZERO_UPPER();
       STAT3(shadow.travs,1,1,1);
@@ -158,7 +158,7 @@ namespace embree
       /*! stack state */
       Base* stack[1+3*BVH4MB::maxDepth];  //!< stack of nodes that still need to get traversed
       Base** stackPtr = stack+1;          //!< current stack pointer
-      stack[0] = bvh->root;               //!< push first node onto stack
+      stack[0] = root;                    //!< push first node onto stack
             
       /*! load the ray into SIMD registers */
       const sse3f norg(-ray.org.x,-ray.org.y,-ray.org.z);
@@ -192,16 +192,16 @@ namespace embree
           const ssef* pNearX = (const ssef*)((const char*)node+nearX);
           const ssef* pNearY = (const ssef*)((const char*)node+nearY);
           const ssef* pNearZ = (const ssef*)((const char*)node+nearZ);
-          const ssef tNearX = (norg.x + ssef(pNearX[0]) + ray.time*pNearX[1]) * rdir.x;
-          const ssef tNearY = (norg.y + ssef(pNearY[0]) + ray.time*pNearY[1]) * rdir.y;
-          const ssef tNearZ = (norg.z + ssef(pNearZ[0]) + ray.time*pNearZ[1]) * rdir.z;
+          const ssef tNearX = (norg.x + ssef(pNearX[0]) + time*pNearX[1]) * rdir.x;
+          const ssef tNearY = (norg.y + ssef(pNearY[0]) + time*pNearY[1]) * rdir.y;
+          const ssef tNearZ = (norg.z + ssef(pNearZ[0]) + time*pNearZ[1]) * rdir.z;
           const ssef tNear = max(tNearX,tNearY,tNearZ,rayNear);
           const ssef* pFarX = (const ssef*)((const char*)node+farX);
           const ssef* pFarY = (const ssef*)((const char*)node+farY);
           const ssef* pFarZ = (const ssef*)((const char*)node+farZ);
-          const ssef tFarX = (norg.x + ssef(pFarX[0]) + ray.time*pFarX[1]) * rdir.x;
-          const ssef tFarY = (norg.y + ssef(pFarY[0]) + ray.time*pFarY[1]) * rdir.y;
-          const ssef tFarZ = (norg.z + ssef(pFarZ[0]) + ray.time*pFarZ[1]) * rdir.z;
+          const ssef tFarX = (norg.x + ssef(pFarX[0]) + time*pFarX[1]) * rdir.x;
+          const ssef tFarY = (norg.y + ssef(pFarY[0]) + time*pFarY[1]) * rdir.y;
+          const ssef tFarZ = (norg.z + ssef(pFarZ[0]) + time*pFarZ[1]) * rdir.z;
           const ssef tFar = min(tFarX,tFarY,tFarZ,rayFar);
           size_t _hit = movemask(tNear <= tFar);
           
@@ -226,7 +226,7 @@ namespace embree
           STAT3(shadow.trav_leaves,1,1,1);
           size_t num; Triangle* tri = (Triangle*) cur->leaf(num);
           for (size_t i=0; i<num; i++)
-            if (TriangleIntersector::occluded(ray,tri[i],bvh->geometry)) {
+            if (TriangleIntersector::occluded(ray,time,tri[i],bvh->geometry)) {
               ray.geomID = 0;
               break;
             }
@@ -235,6 +235,31 @@ namespace embree
       AVX_ZERO_UPPER();
     }
 
+    template<typename TriangleIntersector>
+    void BVH4MBIntersector1<TriangleIntersector>::intersect(const BVH4MB* bvh, Ray& ray)
+    {
+      if (likely(bvh->numTimeSegments == 1)) {
+        intersectSegment(bvh,bvh->roots[0],ray,ray.time);
+        return;
+      }
+
+      /*! traverse the tree of the time segment of the ray with the time inside the segment */
+      size_t segment; const float time = bvh->segmentTime(ray.time,segment);
+      intersectSegment(bvh,bvh->roots[segment],ray,time);
+    }
+
+    template<typename TriangleIntersector>
+    void BVH4MBIntersector1<TriangleIntersector>::occluded(const BVH4MB* bvh, Ray& ray)
+    {
+      if (likely(bvh->numTimeSegments == 1)) {
+        occludedSegment(bvh,bvh->roots[0],ray,ray.time);
+        return;
+      }
+
+      size_t segment; const float time = bvh->segmentTime(ray.time,segment);
+      occludedSegment(bvh,bvh->roots[segment],ray,time);
+    }
+
     DEFINE_INTERSECTOR1(BVH4MBTriangle1vIntersector1Moeller,BVH4MBIntersector1<Triangle1vIntersector1MoellerTrumboreMB>);
     //DEFINE_INTERSECTOR1(BVH4MBTriangle4vIntersector1Moeller,BVH4MBIntersector1<Triangle4vIntersector1MoellerTrumboreMB>);
   }
@@ -37,6 +37,11 @@ namespace embree
     public:
       static void intersect(const BVH4MB* This, Ray& ray);
       static void occluded (const BVH4MB* This, Ray& ray);
+
+    private:
+      /*! traverses the tree of a single time segment */
+      static void intersectSegment(const BVH4MB* This, Base* root, Ray& ray, const float time);
+      static void occludedSegment (const BVH4MB* This, Base* root, Ray& ray, const float time);
     };
   }
 }
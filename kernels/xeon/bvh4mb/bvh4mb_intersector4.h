@@ -37,6 +37,11 @@ namespace embree
     public:
       static void intersect(sseb* valid, BVH4MB* bvh, Ray4& ray);
       static void occluded (sseb* valid, BVH4MB* bvh, Ray4& ray);
+
+    private:
+      /*! traverses the tree of a single time segment */
+      static void intersectSegment(sseb* valid, BVH4MB* bvh, Base* root, Ray4& ray, const ssef& time);
+      static void occludedSegment (sseb* valid, BVH4MB* bvh, Base* root, Ray4& ray, const ssef& time);
     };
   }
 }
@@ -50,16 +50,16 @@ namespace embree
     };
     
     /* ray/box intersection */
-    __forceinline size_t intersectBox(const Ray8& ray, const avxf& ray_tfar, const avx3f& rdir, const BVH4MB::Node* node, const int i, avxf& dist) 
+    __forceinline size_t intersectBox(const Ray8& ray, const avxf& time, const avxf& ray_tfar, const avx3f& rdir, const BVH4MB::Node* node, const int i, avxf& dist) 
     {
       if (unlikely(node->child[i]->isEmptyLeaf())) return 0;
       
-      const avxf lower_x = avxf(node->lower_x[i]) + ray.time * avxf(node->lower_dx[i]);
-      const avxf lower_y = avxf(node->lower_y[i]) + ray.time * avxf(node->lower_dy[i]);
-      const avxf lower_z = avxf(node->lower_z[i]) + ray.time * avxf(node->lower_dz[i]);
-      const avxf upper_x = avxf(node->upper_x[i]) + ray.time * avxf(node->upper_dx[i]);
-      const avxf upper_y = avxf(node->upper_y[i]) + ray.time * avxf(node->upper_dy[i]);
-      const avxf upper_z = avxf(node->upper_z[i]) + ray.time * avxf(node->upper_dz[i]);
+      const avxf lower_x = avxf(node->lower_x[i]) + time * avxf(node->lower_dx[i]);
+      const avxf lower_y = avxf(node->lower_y[i]) + time * avxf(node->lower_dy[i]);
+      const avxf lower_z = avxf(node->lower_z[i]) + time * avxf(node->lower_dz[i]);
+      const avxf upper_x = avxf(node->upper_x[i]) + time * avxf(node->upper_dx[i]);
+      const avxf upper_y = avxf(node->upper_y[i]) + time * avxf(node->upper_dy[i]);
+      const avxf upper_z = avxf(node->upper_z[i]) + time * avxf(node->upper_dz[i]);
       
       const avxf dminx = (lower_x - ray.org.x) * rdir.x;
       const avxf dminy = (lower_y - ray.org.y) * rdir.y;
@@ -84,7 +84,7 @@ namespace embree
     }
     
     template<typename TriangleIntersector>
-    void BVH4MBIntersector8Chunk<TriangleIntersector>::intersect(avxb* valid_i, BVH4MB* bvh, Ray8& ray)
+    void BVH4MBIntersector8Chunk<TriangleIntersector>::intersectSegment(avxb* valid_i, BVH4MB* bvh, Base* root, Ray8& ray, const avxf& time)
     {
       avxb valid = *valid_i;
       Precalculations pre(valid,ray);
@@ -92,7 +92,7 @@ namespace embree
       
       StackItemBVH4MBPacket8 stack[2+3*BVH4MB::maxDepth];
       StackItemBVH4MBPacket8* stackPtr = stack+1; //!< current stack pointer
-      stack[0].ptr = bvh->root; 
+      stack[0].ptr = root; 
       stack[0].dist = neg_inf;
       
       /* let inactive rays miss all boxes */
@@ -119,10 +119,10 @@ namespace embree
           
           /* intersect packet with all boxes */
           const BVH4MB::Node* node = cur->node();
-          avxf dist0; size_t hit0 = intersectBox(ray,ray_tfar,rdir,node,0,dist0);
-          avxf dist1; size_t hit1 = intersectBox(ray,ray_tfar,rdir,node,1,dist1);
-          avxf dist2; size_t hit2 = intersectBox(ray,ray_tfar,rdir,node,2,dist2);
-          avxf dist3; size_t hit3 = intersectBox(ray,ray_tfar,rdir,node,3,dist3);
+          avxf dist0; size_t hit0 = intersectBox(ray,time,ray_tfar,rdir,node,0,dist0);
+          avxf dist1; size_t hit1 = intersectBox(ray,time,ray_tfar,rdir,node,1,dist1);
+          avxf dist2; size_t hit2 = intersectBox(ray,time,ray_tfar,rdir,node,2,dist2);
+          avxf dist3; size_t hit3 = intersectBox(ray,time,ray_tfar,rdir,node,3,dist3);
           
           /* push hit nodes onto stack */
           size_t cnt = 0;
@@ -166,23 +166,23 @@ namespace embree
         {
           STAT3(normal.trav_leaves,1,popcnt(valid),4);
           size_t num; Triangle* tri = (Triangle*) cur->leaf(num);
-          TriangleIntersector::intersect(valid,pre,ray,tri,num,bvh->geometry);
+          TriangleIntersector::intersect(valid,pre,ray,time,tri,num,bvh->geometry);
           ray_tfar = select(valid,ray.tfar,avxf(neg_inf));
         }
       }
     }
     
     /* ray/box intersection */
-    __forceinline size_t intersectBox(const Ray8& ray, const avx3f& rdir, const avxf& ray_far, const BVH4MB::Node* node, const int i) 
+    __forceinline size_t intersectBox(const Ray8& ray, const avxf& time, const avx3f& rdir, const avxf& ray_far, const BVH4MB::Node* node, const int i) 
     {
       if (unlikely(node->child[i]->isEmptyLeaf())) return 0;
       
-      const avxf lower_x = avxf(node->lower_x[i]) + ray.time * avxf(node->lower_dx[i]);
-      const avxf lower_y = avxf(node->lower_y[i]) + ray.time * avxf(node->lower_dy[i]);
-      const avxf lower_z = avxf(node->lower_z[i]) + ray.time * avxf(node->lower_dz[i]);
-      const avxf upper_x = avxf(node->upper_x[i]) + ray.time * avxf(node->upper_dx[i]);
-      const avxf upper_y = avxf(node->upper_y[i]) + ray.time * avxf(node->upper_dy[i]);
-      const avxf upper_z = avxf(node->upper_z[i]) + ray.time * avxf(node->upper_dz[i]);
+      const avxf lower_x = avxf(node->lower_x[i]) + time * avxf(node->lower_dx[i]);
+      const avxf lower_y = avxf(node->lower_y[i]) + time * avxf(node->lower_dy[i]);
+      const avxf lower_z = avxf(node->lower_z[i]) + time * avxf(node->lower_dz[i]);
+      const avxf upper_x = avxf(node->upper_x[i]) + time * avxf(node->upper_dx[i]);
+      const avxf upper_y = avxf(node->upper_y[i]) + time * avxf(node->upper_dy[i]);
+      const avxf upper_z = avxf(node->upper_z[i]) + time * avxf(node->upper_dz[i]);
       
       const avxf dminx = (lower_x - ray.org.x) * rdir.x;
       const avxf dminy = (lower_y - ray.org.y) * rdir.y;
@@ -206,7 +206,7 @@ namespace embree
     }
     
     template<typename TriangleIntersector>
-    void BVH4MBIntersector8Chunk<TriangleIntersector>::occluded(avxb* valid_i, BVH4MB* bvh, Ray8& ray)
+    void BVH4MBIntersector8Chunk<TriangleIntersector>::occludedSegment(avxb* valid_i, BVH4MB* bvh, Base* root, Ray8& ray, const avxf& time)
     {
       avxb valid = *valid_i;
       Precalculations pre(valid,ray);
@@ -215,7 +215,7 @@ namespace embree
       
       BVH4MB::Base* stack[2+3*BVH4MB::maxDepth];
       BVH4MB::Base** stackPtr = stack+1; //!< current stack pointer
-      stack[0] = bvh->root; 
+      stack[0] = root; 
       
       /* let terminated rays miss all boxes */
       avx3f rdir = rcp_safe(ray.dir);
@@ -232,10 +232,10 @@ namespace embree
         {
           STAT3(shadow.trav_nodes,1,popcnt(valid),4);
           const BVH4MB::Node* node = cur->node();
-          if (unlikely(intersectBox(ray,rdir,rayFar,node,0) != 0)) { *stackPtr = node->child[0]; stackPtr++; }
-          if (unlikely(intersectBox(ray,rdir,rayFar,node,1) != 0)) { *stackPtr = node->child[1]; stackPtr++; }
-          if (unlikely(intersectBox(ray,rdir,rayFar,node,2) != 0)) { *stackPtr = node->child[2]; stackPtr++; }
-          if (unlikely(intersectBox(ray,rdir,rayFar,node,3) != 0)) { *stackPtr = node->child[3]; stackPtr++; }
+          if (unlikely(intersectBox(ray,time,rdir,rayFar,node,0) != 0)) { *stackPtr = node->child[0]; stackPtr++; }
+          if (unlikely(intersectBox(ray,time,rdir,rayFar,node,1) != 0)) { *stackPtr = node->child[1]; stackPtr++; }
+          if (unlikely(intersectBox(ray,time,rdir,rayFar,node,2) != 0)) { *stackPtr = node->child[2]; stackPtr++; }
+          if (unlikely(intersectBox(ray,time,rdir,rayFar,node,3) != 0)) { *stackPtr = node->child[3]; stackPtr++; }
         }
         
         /* this is a leaf node */
@@ -243,7 +243,7 @@ namespace embree
         {
           STAT3(shadow.trav_leaves,1,popcnt(valid),4);
           size_t num; Triangle* tri = (Triangle*) cur->leaf(num);
-          terminated |= TriangleIntersector::occluded(valid,pre,ray,tri,num,bvh->geometry);
+          terminated |= TriangleIntersector::occluded(valid,pre,ray,time,tri,num,bvh->geometry);
           if (all(terminated)) break;
           
           /* let terminated rays miss all boxes */
@@ -254,6 +254,49 @@ namespace embree
       AVX_ZERO_UPPER();
     }
 
+    template<typename TriangleIntersector>
+    void BVH4MBIntersector8Chunk<TriangleIntersector>::intersect(avxb* valid_i, BVH4MB* bvh, Ray8& ray)
+    {
+      if (likely(bvh->numTimeSegments == 1)) {
+        intersectSegment(valid_i,bvh,bvh->roots[0],ray,ray.time);
+        return;
+      }
+
+      /*! traverse the tree of each time segment with the rays of that segment */
+      const avxf ft = ray.time*avxf(float(bvh->numTimeSegments));
+      const avxf segment = clamp(floor(ft),avxf(zero),avxf(float(bvh->numTimeSegments-1)));
+      const avxf time = ft-segment;
+      avxb todo = *valid_i;
+      while (any(todo)) 
+      {
+        const float s = segment[__bsf(movemask(todo))];
+        avxb valid = todo & (segment == avxf(s));
+        intersectSegment(&valid,bvh,bvh->roots[size_t(s)],ray,time);
+        todo &= !valid;
+      }
+    }
+
+    template<typename TriangleIntersector>
+    void BVH4MBIntersector8Chunk<TriangleIntersector>::occluded(avxb* valid_i, BVH4MB* bvh, Ray8& ray)
+    {
+      if (likely(bvh->numTimeSegments == 1)) {
+        occludedSegment(valid_i,bvh,bvh->roots[0],ray,ray.time);
+        return;
+      }
+
+      const avxf ft = ray.time*avxf(float(bvh->numTimeSegments));
+      const avxf segment = clamp(floor(ft),avxf(zero),avxf(float(bvh->numTimeSegments-1)));
+      const avxf time = ft-segment;
+      avxb todo = *valid_i;
+      while (any(todo)) 
+      {
+        const float s = segment[__bsf(movemask(todo))];
+        avxb valid = todo & (segment == avxf(s));
+        occludedSegment(&valid,bvh,bvh->roots[size_t(s)],ray,time);
+        todo &= !valid;
+      }
+    }
+
     DEFINE_INTERSECTOR8(BVH4MBTriangle1vIntersector8ChunkMoeller, BVH4MBIntersector8Chunk<Triangle1vIntersector8MoellerTrumboreMB>);
   }
 }
@@ -37,6 +37,11 @@ namespace embree
     public:
       static void intersect(avxb* valid, BVH4MB* bvh, Ray8& ray);
       static void occluded (avxb* valid, BVH4MB* bvh, Ray8& ray);
+
+    private:
+      /*! traverses the tree of a single time segment */
+      static void intersectSegment(avxb* valid, BVH4MB* bvh, Base* root, Ray8& ray, const avxf& time);
+      static void occludedSegment (avxb* valid, BVH4MB* bvh, Base* root, Ray8& ray, const avxf& time);
     };
   }
 }
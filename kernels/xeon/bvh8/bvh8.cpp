@@ -17,6 +17,7 @@
 #include "bvh8.h"
 #include "geometry/triangle8.h"
 #include "common/accelinstance.h"
+#include "common/bvh_serializer.h"
 
 namespace embree
 {
@@ -26,6 +27,7 @@ namespace embree
   DECLARE_SYMBOL(Accel::Intersector8,BVH8Triangle8Intersector8ChunkMoeller);
   DECLARE_SYMBOL(Accel::Intersector8,BVH8Triangle8Intersector8HybridMoeller);
   DECLARE_SYMBOL(Accel::Intersector8,BVH8Triangle8Intersector8HybridMoellerNoFilter);
+  DECLARE_SYMBOL(Accel::PointQuery1,BVH8Triangle8PointQuery);
 
   DECLARE_SCENE_BUILDER(BVH8Triangle8Builder);
 
@@ -47,6 +49,9 @@ namespace embree
     SELECT_SYMBOL_AVX_AVX2(features,BVH8Triangle8Intersector8ChunkMoeller);
     SELECT_SYMBOL_AVX_AVX2(features,BVH8Triangle8Intersector8HybridMoeller);
     SELECT_SYMBOL_AVX_AVX2(features,BVH8Triangle8Intersector8HybridMoellerNoFilter);
+
+    /* select point queries */
+    SELECT_SYMBOL_AVX_AVX2(features,BVH8Triangle8PointQuery);
   }
 
   BVH8::BVH8 (const PrimitiveType& primTy, void* geometry)
@@ -93,6 +98,14 @@ namespace embree
     }
   }
 
+  bool BVH8::store(std::ostream& out) const {
+    return BVHSerializer<BVH8>::store(this,"BVH8",out);
+  }
+
+  bool BVH8::load(char*& ptr, char* end) {
+    return BVHSerializer<BVH8>::load(this,"BVH8",ptr,end);
+  }
+
   Accel::Intersectors BVH8Triangle8Intersectors(BVH8* bvh)
   {
     Accel::Intersectors intersectors;
@@ -103,6 +116,7 @@ namespace embree
     intersectors.intersector8_filter = BVH8Triangle8Intersector8HybridMoeller;
     intersectors.intersector8_nofilter = BVH8Triangle8Intersector8HybridMoellerNoFilter;
     intersectors.intersector16 = NULL;
+    intersectors.pointQuery1 = BVH8Triangle8PointQuery;
     return intersectors;
   }
 
@@ -114,6 +128,7 @@ namespace embree
     Builder* builder = NULL;
     if      (g_tri_builder == "default"     ) builder = BVH8Triangle8Builder(accel,scene,0);
     else if (g_tri_builder == "spatialsplit") builder = BVH8Triangle8Builder(accel,scene,1);
+    else if (g_tri_builder == "presplits"   ) builder = BVH8Triangle8Builder(accel,scene,2);
     else if (g_tri_builder == "objectsplit" ) builder = BVH8Triangle8Builder(accel,scene,0);
     else throw std::runtime_error("unknown builder "+g_tri_builder+" for BVH8<Triangle8>");
     
@@ -135,5 +150,13 @@ namespace embree
     Builder* builder = BVH8Triangle8Builder(accel,scene,1);
     return new AccelInstance(accel,builder,intersectors);
   }
+
+  Accel* BVH8::BVH8Triangle8PreSplit(Scene* scene)
+  {
+    BVH8* accel = new BVH8(SceneTriangle8::type,scene);
+    Accel::Intersectors intersectors= BVH8Triangle8Intersectors(accel);
+    Builder* builder = BVH8Triangle8Builder(accel,scene,2);
+    return new AccelInstance(accel,builder,intersectors);
+  }
 }
 
@@ -221,6 +221,7 @@ namespace embree
     static Accel* BVH8Triangle8(Scene* scene);
     static Accel* BVH8Triangle8ObjectSplit(Scene* scene);
     static Accel* BVH8Triangle8SpatialSplit(Scene* scene);
+    static Accel* BVH8Triangle8PreSplit(Scene* scene);
 
     /*! initializes the acceleration structure */
     void init (size_t numPrimitives = 0, size_t numThreads = 1);
@@ -228,6 +229,12 @@ namespace embree
     /*! Clears the barrier bits of a subtree. */
     void clearBarrier(NodeRef& node);
 
+    /*! writes the BVH to a stream */
+    bool store (std::ostream& out) const;
+
+    /*! restores the BVH from a mapped file */
+    bool load (char*& ptr, char* end);
+
     LinearAllocatorPerThread alloc;
 
 #if defined (__AVX__)
@@ -254,8 +261,12 @@ namespace embree
   public:
     
     /*! calculates the amount of bytes allocated */
-    size_t bytesAllocated() {
-      return alloc.bytes();
+    size_t bytesAllocated() const 
+    {
+      size_t bytes = alloc.bytes();
+      for (size_t i=0; i<objects.size(); i++)
+        if (objects[i]) bytes += objects[i]->bytesAllocated();
+      return bytes;
     }
 
   public:
@@ -19,6 +19,7 @@
 //#include "bvh8_refit.h"
 //#include "bvh8_rotate.h"
 #include "bvh8_statistics.h"
+#include "builders/presplit.h"
 
 #include "geometry/triangle1.h"
 #include "geometry/triangle4.h"
@@ -40,7 +41,7 @@ namespace embree
     BVH8Builder::BVH8Builder (BVH8* bvh, Scene* scene, TriangleMesh* mesh, size_t mode,
 				size_t logBlockSize, size_t logSAHBlockSize, float intCost, 
 				bool needVertices, size_t primBytes, const size_t minLeafSize, const size_t maxLeafSize)
-      : scene(scene), mesh(mesh), bvh(bvh), enableSpatialSplits(mode > 0), remainingReplications(0),
+      : scene(scene), mesh(mesh), bvh(bvh), enableSpatialSplits(mode == 1), enablePreSplits(mode == 2), remainingReplications(0),
 	logBlockSize(logBlockSize), logSAHBlockSize(logSAHBlockSize), intCost(intCost), 
 	needVertices(needVertices), primBytes(primBytes), minLeafSize(minLeafSize), maxLeafSize(maxLeafSize)
      {
@@ -285,8 +286,12 @@ namespace embree
       if (enableSpatialSplits)
 	remainingReplications = numPrimitives;
 
+      /*! pre-splits replicate primitives before the build */
+      size_t numPrimRefs = numPrimitives+remainingReplications;
+      if (enablePreSplits) numPrimRefs = PreSplitArrayGen::capacity(numPrimitives);
+
       /*! initialize internal buffers of BVH */
-      bvh->init(numPrimitives+remainingReplications);
+      bvh->init(numPrimRefs);
       
       /*! skip build for empty scene */
       if (numPrimitives == 0) 
@@ -296,6 +301,7 @@ namespace embree
       if (g_verbose >= 2) {
 	std::cout << "building BVH8<" << bvh->primTy.name << "> with " << TOSTRING(isa) "::BVH8Builder(";
 	if (enableSpatialSplits) std::cout << "spatialsplits";
+	if (enablePreSplits    ) std::cout << "presplits";
 	std::cout << ") ... " << std::flush;
       }
 
@@ -306,8 +312,9 @@ namespace embree
       
       /* generate list of build primitives */
       PrimRefList prims; PrimInfo pinfo(empty);
-      if (mesh) PrimRefListGenFromGeometry<TriangleMesh>::generate(threadIndex,threadCount,&alloc,mesh ,prims,pinfo);
-      else      PrimRefListGen                          ::generate(threadIndex,threadCount,&alloc,scene,TRIANGLE_MESH,1,prims,pinfo);
+      if      (mesh)            PrimRefListGenFromGeometry<TriangleMesh>::generate(threadIndex,threadCount,&alloc,mesh ,prims,pinfo);
+      else if (enablePreSplits) PreSplitListGen                         ::generate(threadIndex,threadCount,&alloc,scene,prims,pinfo);
+      else                      PrimRefListGen                          ::generate(threadIndex,threadCount,&alloc,scene,TRIANGLE_MESH,1,prims,pinfo);
       
       /* perform initial split */
       const Split split = find<true>(threadIndex,threadCount,1,prims,pinfo,enableSpatialSplits);
@@ -0,0 +1,102 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+#include "bvh8_point_query.h"
+#include "geometry/triangle_point_query.h"
+
+namespace embree
+{ 
+  namespace isa
+  {
+    template<typename PrimitivePointQuery>
+    void BVH8PointQuery<PrimitivePointQuery>::pointQuery(const BVH8* bvh, PointQuery& query)
+    {
+      /*! stack state */
+      StackItem stack[stackSize];            //!< stack of nodes 
+      StackItem* stackPtr = stack+1;         //!< current stack pointer
+      StackItem* stackEnd = stack+stackSize;
+      stack[0].ptr = bvh->root;
+      stack[0].dist = neg_inf;
+
+      /*! load the query point into SIMD registers */
+      const avx3f p(query.p.x,query.p.y,query.p.z);
+      float radius2 = query.radius2();
+
+      /* pop loop */
+      while (true) pop:
+      {
+        /*! pop next node */
+        if (unlikely(stackPtr == stack)) break;
+        stackPtr--;
+        NodeRef cur = NodeRef(stackPtr->ptr);
+        
+        /*! if popped node is too far, pop next one */
+        if (unlikely(stackPtr->dist > radius2))
+          continue;
+        
+        /* downtraversal loop */
+        while (true)
+        {
+          /*! stop if we found a leaf */
+          if (unlikely(cur.isLeaf())) break;
+          STAT3(normal.trav_nodes,1,1,1);
+          
+          /*! squared distances of the query point to the 8 boxes */
+          const Node* node = cur.node();
+          const avxf dx = max(node->lower_x-p.x,p.x-node->upper_x,avxf(zero));
+          const avxf dy = max(node->lower_y-p.y,p.y-node->upper_y,avxf(zero));
+          const avxf dz = max(node->lower_z-p.z,p.z-node->upper_z,avxf(zero));
+          const avxf dist2 = dx*dx + dy*dy + dz*dz;
+          /*! empty children are only in range for an infinite radius, they are leaves without primitives */
+          size_t mask = movemask(dist2 <= avxf(radius2));
+
+          /*! if no child is in range, pop next node */
+          if (unlikely(mask == 0))
+            goto pop;
+          
+          /*! one child is in range, continue with that child */
+          size_t r = __bscf(mask);
+          if (likely(mask == 0)) {
+            cur = node->child(r); cur.prefetch();
+            continue;
+          }
+
+          /*! insert all children in range into the stack such that the closest child is on top */
+          StackItem* stackBegin = stackPtr;
+          mask |= size_t(1) << r;
+          while (mask) 
+          {
+            r = __bscf(mask);
+            assert(stackPtr < stackEnd); 
+            StackItem item; item.ptr = node->child(r); item.dist = dist2[r];
+            StackItem* pos = stackPtr++;
+            for (; pos > stackBegin && pos[-1].dist < item.dist; pos--) pos[0] = pos[-1];
+            *pos = item;
+          }
+          cur = (NodeRef) stackPtr[-1].ptr; stackPtr--;
+        }
+        
+        /*! this is a leaf node */
+        STAT3(normal.trav_leaves,1,1,1);
+        size_t num; Primitive* prim = (Primitive*) cur.leaf(num);
+        PrimitivePointQuery::pointQuery(query,prim,num,bvh->geometry);
+        radius2 = query.radius2();
+      }
+      AVX_ZERO_UPPER();
+    }
+
+    DEFINE_POINT_QUERY1(BVH8Triangle8PointQuery,BVH8PointQuery<Triangle8PointQuery>);
+  }
+}
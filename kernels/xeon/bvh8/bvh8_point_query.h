@@ -0,0 +1,42 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+#pragma once
+
+#include "bvh8.h"
+#include "common/point_query.h"
+#include "common/stack_item.h"
+
+namespace embree
+{
+  namespace isa
+  {
+    /*! BVH8 closest point query. Children are visited in the order of
+     *  their distance to the query point. */
+    template<typename PrimitivePointQuery>
+      class BVH8PointQuery
+    {
+      /* shortcuts for frequently used types */
+      typedef typename PrimitivePointQuery::Primitive Primitive;
+      typedef typename BVH8::NodeRef NodeRef;
+      typedef typename BVH8::Node Node;
+      typedef StackItemT<NodeRef> StackItem;
+      static const size_t stackSize = 1+7*BVH8::maxDepth;
+      
+    public:
+      static void pointQuery(const BVH8* This, PointQuery& query);
+    };
+  }
+}
@@ -20,21 +20,36 @@ namespace embree
 {
   namespace isa
   {
+    /*! maximal number of boxes of the instanced object that get transformed */
+    static const size_t maxInstanceBoxes = 64;
+
     void InstanceBoundsFunction(const Instance* instance, size_t item, BBox3fa& bounds_o)
     {
-      Vec3fa lower = instance->object->bounds.lower;
-      Vec3fa upper = instance->object->bounds.upper;
-      AffineSpace3fa local2world = instance->local2world;
-      Vec3fa p000 = xfmPoint(local2world,Vec3fa(lower.x,lower.y,lower.z));
-      Vec3fa p001 = xfmPoint(local2world,Vec3fa(lower.x,lower.y,upper.z));
-      Vec3fa p010 = xfmPoint(local2world,Vec3fa(lower.x,upper.y,lower.z));
-      Vec3fa p011 = xfmPoint(local2world,Vec3fa(lower.x,upper.y,upper.z));
-      Vec3fa p100 = xfmPoint(local2world,Vec3fa(upper.x,lower.y,lower.z));
-      Vec3fa p101 = xfmPoint(local2world,Vec3fa(upper.x,lower.y,upper.z));
-      Vec3fa p110 = xfmPoint(local2world,Vec3fa(upper.x,upper.y,lower.z));
-      Vec3fa p111 = xfmPoint(local2world,Vec3fa(upper.x,upper.y,upper.z));
-      bounds_o.lower = min(min(min(p000,p001),min(p010,p011)),min(min(p100,p101),min(p110,p111)));
-      bounds_o.upper = max(max(max(p000,p001),max(p010,p011)),max(max(p100,p101),max(p110,p111)));
+      /* transforming the boxes of the top levels of the instanced BVH gives much tighter bounds for rotated objects than transforming its root box */
+      BBox3fa boxes[maxInstanceBoxes];
+      const size_t numBoxes = instance->object->childBounds(g_instance_bounds_depth,boxes,maxInstanceBoxes);
+
+      /* points move linearly between two time steps, thus merging the bounds of all time steps is conservative */
+      bounds_o = empty;
+      for (size_t i=0; i<instance->numTimeSteps; i++)
+      {
+        const AffineSpace3fa local2world = instance->local2worlds[i];
+        for (size_t j=0; j<numBoxes; j++)
+        {
+          const Vec3fa lower = boxes[j].lower;
+          const Vec3fa upper = boxes[j].upper;
+          Vec3fa p000 = xfmPoint(local2world,Vec3fa(lower.x,lower.y,lower.z));
+          Vec3fa p001 = xfmPoint(local2world,Vec3fa(lower.x,lower.y,upper.z));
+          Vec3fa p010 = xfmPoint(local2world,Vec3fa(lower.x,upper.y,lower.z));
+          Vec3fa p011 = xfmPoint(local2world,Vec3fa(lower.x,upper.y,upper.z));
+          Vec3fa p100 = xfmPoint(local2world,Vec3fa(upper.x,lower.y,lower.z));
+          Vec3fa p101 = xfmPoint(local2world,Vec3fa(upper.x,lower.y,upper.z));
+          Vec3fa p110 = xfmPoint(local2world,Vec3fa(upper.x,upper.y,lower.z));
+          Vec3fa p111 = xfmPoint(local2world,Vec3fa(upper.x,upper.y,upper.z));
+          bounds_o.lower = min(bounds_o.lower,min(min(min(p000,p001),min(p010,p011)),min(min(p100,p101),min(p110,p111))));
+          bounds_o.upper = max(bounds_o.upper,max(max(max(p000,p001),max(p010,p011)),max(max(p100,p101),max(p110,p111))));
+        }
+      }
     }
 
     RTCBoundsFunc InstanceBoundsFunc = (RTCBoundsFunc) InstanceBoundsFunction;
@@ -44,17 +59,26 @@ namespace embree
       const Vec3fa ray_org = ray.org;
       const Vec3fa ray_dir = ray.dir;
       const int ray_geomID = ray.geomID;
-      const int ray_instID = ray.instID;
-      ray.org = xfmPoint (instance->world2local,ray_org);
-      ray.dir = xfmVector(instance->world2local,ray_dir);
+      const size_t level = Instance::level;
+      int ray_instID[RTC_MAX_INSTANCE_LEVELS];
+      for (size_t i=level; i<RTC_MAX_INSTANCE_LEVELS; i++) {
+        ray_instID[i] = ray.instIDLevel(i);
+        ray.instIDLevel(i) = -1;
+      }
+      if (level < RTC_MAX_INSTANCE_LEVELS) ray.instIDLevel(level) = instance->id;
+      const AffineSpace3fa world2local = instance->getWorld2Local(ray.time);
+      ray.org = xfmPoint (world2local,ray_org);
+      ray.dir = xfmVector(world2local,ray_dir);
       ray.geomID = -1;
-      ray.instID = instance->id;
+      Instance::level = level+1;
       instance->object->intersect((RTCRay&)ray);
+      Instance::level = level;
       ray.org = ray_org;
       ray.dir = ray_dir;
       if (ray.geomID == -1) {
         ray.geomID = ray_geomID;
-        ray.instID = ray_instID;
+        for (size_t i=level; i<RTC_MAX_INSTANCE_LEVELS; i++)
+          ray.instIDLevel(i) = ray_instID[i];
       }
     }
     
@@ -62,10 +86,14 @@ namespace embree
     {
       const Vec3fa ray_org = ray.org;
       const Vec3fa ray_dir = ray.dir;
-      ray.org = xfmPoint (instance->world2local,ray_org);
-      ray.dir = xfmVector(instance->world2local,ray_dir);
-      ray.instID = instance->id;
+      const AffineSpace3fa world2local = instance->getWorld2Local(ray.time);
+      ray.org = xfmPoint (world2local,ray_org);
+      ray.dir = xfmVector(world2local,ray_dir);
+      const size_t level = Instance::level;
+      if (level < RTC_MAX_INSTANCE_LEVELS) ray.instIDLevel(level) = instance->id;
+      Instance::level = level+1;
       instance->object->occluded((RTCRay&)ray);
+      Instance::level = level;
       ray.org = ray_org;
       ray.dir = ray_dir;
     }
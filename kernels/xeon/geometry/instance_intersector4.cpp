@@ -21,24 +21,59 @@ namespace embree
   namespace isa
   {
     typedef AffineSpaceT<LinearSpace3<sse3f> > AffineSpace3faSSE;
+
+    /*! transforms the rays into the local space of the instance, with the transformation interpolated to the time of each ray */
+    __forceinline void xfmRay(const sseb& valid, const Instance* instance, const sse3f& org, const sse3f& dir, Ray4& ray)
+    {
+      if (likely(instance->numTimeSteps == 1)) {
+        const AffineSpace3faSSE world2local(instance->world2local);
+        ray.org = xfmPoint (world2local,org);
+        ray.dir = xfmVector(world2local,dir);
+        return;
+      }
+
+      /* process all rays of the same time segment together */
+      const float numTimeSegments = float(instance->numTimeSteps-1);
+      const ssef ft = clamp(ray.time,ssef(zero),ssef(one))*ssef(numTimeSegments);
+      const ssef segment = clamp(ssef(floori(ft)),ssef(zero),ssef(numTimeSegments-1.0f));
+      const ssef f = ft-segment;
+      sseb todo = valid;
+      while (any(todo))
+      {
+        const float s = segment[__bsf(movemask(todo))];
+        const sseb m = todo & (segment == ssef(s));
+        const AffineSpace3faSSE local2world0(instance->local2worlds[size_t(s)+0]);
+        const AffineSpace3faSSE local2world1(instance->local2worlds[size_t(s)+1]);
+        const AffineSpace3faSSE world2local = rcp((ssef(one)-f)*local2world0 + f*local2world1);
+        ray.org = select(m,xfmPoint (world2local,org),ray.org);
+        ray.dir = select(m,xfmVector(world2local,dir),ray.dir);
+        todo &= !m;
+      }
+    }
     
     void FastInstanceIntersector4::intersect(sseb* valid, const Instance* instance, Ray4& ray, size_t item)
     {
       const sse3f ray_org = ray.org;
       const sse3f ray_dir = ray.dir;
       const ssei ray_geomID = ray.geomID;
-      const ssei ray_instID = ray.instID;
-      const AffineSpace3faSSE world2local(instance->world2local);
-      ray.org = xfmPoint (world2local,ray_org);
-      ray.dir = xfmVector(world2local,ray_dir);
+      const size_t level = Instance::level;
+      ssei ray_instID[RTC_MAX_INSTANCE_LEVELS];
+      for (size_t i=level; i<RTC_MAX_INSTANCE_LEVELS; i++) {
+        ray_instID[i] = ray.instIDLevel(i);
+        ray.instIDLevel(i) = -1;
+      }
+      if (level < RTC_MAX_INSTANCE_LEVELS) ray.instIDLevel(level) = instance->id;
+      xfmRay(*valid,instance,ray_org,ray_dir,ray);
       ray.geomID = -1;
-      ray.instID = instance->id;
+      Instance::level = level+1;
       instance->object->intersect4(valid,(RTCRay4&)ray);
+      Instance::level = level;
       ray.org = ray_org;
       ray.dir = ray_dir;
       sseb nohit = ray.geomID == ssei(-1);
       ray.geomID = select(nohit,ray_geomID,ray.geomID);
-      ray.instID = select(nohit,ray_instID,ray.instID);
+      for (size_t i=level; i<RTC_MAX_INSTANCE_LEVELS; i++)
+        ray.instIDLevel(i) = select(nohit,ray_instID[i],ray.instIDLevel(i));
     }
     
     void FastInstanceIntersector4::occluded (sseb* valid, const Instance* instance, Ray4& ray, size_t item)
@@ -46,11 +81,12 @@ namespace embree
       const sse3f ray_org = ray.org;
       const sse3f ray_dir = ray.dir;
       const ssei ray_geomID = ray.geomID;
-      const AffineSpace3faSSE world2local(instance->world2local);
-      ray.org = xfmPoint (world2local,ray_org);
-      ray.dir = xfmVector(world2local,ray_dir);
-      ray.instID = instance->id;
+      xfmRay(*valid,instance,ray_org,ray_dir,ray);
+      const size_t level = Instance::level;
+      if (level < RTC_MAX_INSTANCE_LEVELS) ray.instIDLevel(level) = instance->id;
+      Instance::level = level+1;
       instance->object->occluded4(valid,(RTCRay4&)ray);
+      Instance::level = level;
       ray.org = ray_org;
       ray.dir = ray_dir;
     }
@@ -21,24 +21,59 @@ namespace embree
   namespace isa
   {
     typedef AffineSpaceT<LinearSpace3<avx3f> > AffineSpace3faAVX;
+
+    /*! transforms the rays into the local space of the instance, with the transformation interpolated to the time of each ray */
+    __forceinline void xfmRay(const avxb& valid, const Instance* instance, const avx3f& org, const avx3f& dir, Ray8& ray)
+    {
+      if (likely(instance->numTimeSteps == 1)) {
+        const AffineSpace3faAVX world2local(instance->world2local);
+        ray.org = xfmPoint (world2local,org);
+        ray.dir = xfmVector(world2local,dir);
+        return;
+      }
+
+      /* process all rays of the same time segment together */
+      const float numTimeSegments = float(instance->numTimeSteps-1);
+      const avxf ft = clamp(ray.time,avxf(zero),avxf(one))*avxf(numTimeSegments);
+      const avxf segment = clamp(floor(ft),avxf(zero),avxf(numTimeSegments-1.0f));
+      const avxf f = ft-segment;
+      avxb todo = valid;
+      while (any(todo))
+      {
+        const float s = segment[__bsf(movemask(todo))];
+        const avxb m = todo & (segment == avxf(s));
+        const AffineSpace3faAVX local2world0(instance->local2worlds[size_t(s)+0]);
+        const AffineSpace3faAVX local2world1(instance->local2worlds[size_t(s)+1]);
+        const AffineSpace3faAVX world2local = rcp((avxf(one)-f)*local2world0 + f*local2world1);
+        ray.org = select(m,xfmPoint (world2local,org),ray.org);
+        ray.dir = select(m,xfmVector(world2local,dir),ray.dir);
+        todo &= !m;
+      }
+    }
     
     void FastInstanceIntersector8::intersect(avxb* valid, const Instance* instance, Ray8& ray, size_t item)
     {
       const avx3f ray_org = ray.org;
       const avx3f ray_dir = ray.dir;
       const avxi ray_geomID = ray.geomID;
-      const avxi ray_instID = ray.instID;
-      const AffineSpace3faAVX world2local(instance->world2local);
-      ray.org = xfmPoint (world2local,ray_org);
-      ray.dir = xfmVector(world2local,ray_dir);
+      const size_t level = Instance::level;
+      avxi ray_instID[RTC_MAX_INSTANCE_LEVELS];
+      for (size_t i=level; i<RTC_MAX_INSTANCE_LEVELS; i++) {
+        ray_instID[i] = ray.instIDLevel(i);
+        ray.instIDLevel(i) = -1;
+      }
+      if (level < RTC_MAX_INSTANCE_LEVELS) ray.instIDLevel(level) = instance->id;
+      xfmRay(*valid,instance,ray_org,ray_dir,ray);
       ray.geomID = -1;
-      ray.instID = instance->id;
+      Instance::level = level+1;
       instance->object->intersect8(valid,(RTCRay8&)ray);
+      Instance::level = level;
       ray.org = ray_org;
       ray.dir = ray_dir;
       avxb nohit = ray.geomID == avxi(-1);
       ray.geomID = select(nohit,ray_geomID,ray.geomID);
-      ray.instID = select(nohit,ray_instID,ray.instID);
+      for (size_t i=level; i<RTC_MAX_INSTANCE_LEVELS; i++)
+        ray.instIDLevel(i) = select(nohit,ray_instID[i],ray.instIDLevel(i));
     }
     
     void FastInstanceIntersector8::occluded (avxb* valid, const Instance* instance, Ray8& ray, size_t item)
@@ -46,11 +81,12 @@ namespace embree
       const avx3f ray_org = ray.org;
       const avx3f ray_dir = ray.dir;
       const avxi ray_geomID = ray.geomID;
-      const AffineSpace3faAVX world2local(instance->world2local);
-      ray.org = xfmPoint (world2local,ray_org);
-      ray.dir = xfmVector(world2local,ray_dir);
-      ray.instID = instance->id;
+      xfmRay(*valid,instance,ray_org,ray_dir,ray);
+      const size_t level = Instance::level;
+      if (level < RTC_MAX_INSTANCE_LEVELS) ray.instIDLevel(level) = instance->id;
+      Instance::level = level+1;
       instance->object->occluded8(valid,(RTCRay8&)ray);
+      Instance::level = level;
       ray.org = ray_org;
       ray.dir = ray_dir;
     }
@@ -40,6 +40,9 @@ namespace embree
     /*! Updates all primitives stored in a leaf */
     virtual BBox3fa update(char* prim, size_t num, void* geom) const { return BBox3fa(empty); }
 
+    /*! Extends the range [lower,upper] by the vertices referenced by all primitives stored in a leaf */
+    virtual void vertexRange(const char* prim, size_t num, void* geom, size_t& lower, size_t& upper) const { lower = 0; upper = -1; }
+
     /*! Updates all primitives stored in a leaf */
     virtual std::pair<BBox3fa,BBox3fa> update2(char* prim, size_t num, void* geom) const { return std::pair<BBox3fa,BBox3fa>(empty,empty); }
 
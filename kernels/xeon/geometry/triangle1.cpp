@@ -131,4 +131,11 @@ namespace embree
     }
     return bounds; 
   }
+
+  void TriangleMeshTriangle1::vertexRange(const char* prim, size_t num, void* geom, size_t& lower, size_t& upper) const
+  {
+    const TriangleMesh* mesh = (const TriangleMesh*) geom;
+    for (size_t j=0; j<num; j++) 
+      mesh->extendVertexRange(((const Triangle1*) prim)[j].primID(),lower,upper);
+  }
 }
@@ -83,5 +83,6 @@ namespace embree
     void pack(char* dst, atomic_set<PrimRefBlock>::block_iterator_unsafe& prims, void* geom) const;
     void pack(char* dst, const PrimRef* prims, size_t num, void* geom) const;
     BBox3fa update(char* prim, size_t num, void* geom) const;
+    void vertexRange(const char* prim, size_t num, void* geom, size_t& lower, size_t& upper) const;
   };
 }
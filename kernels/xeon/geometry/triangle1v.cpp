@@ -241,4 +241,11 @@ namespace embree
     }
     return std::pair<BBox3fa,BBox3fa>(bounds0,bounds1);
   }
+
+  void TriangleMeshTriangle1v::vertexRange(const char* prim, size_t num, void* geom, size_t& lower, size_t& upper) const
+  {
+    const TriangleMesh* mesh = (const TriangleMesh*) geom;
+    for (size_t j=0; j<num; j++) 
+      mesh->extendVertexRange(((const Triangle1v*) prim)[j].primID(),lower,upper);
+  }
 }
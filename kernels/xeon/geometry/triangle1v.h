@@ -82,6 +82,7 @@ namespace embree
     void pack(char* dst, atomic_set<PrimRefBlock>::block_iterator_unsafe& prims, void* geom) const;
     void pack(char* dst, const PrimRef* prims, size_t num, void* geom) const;
     BBox3fa update(char* prim, size_t num, void* geom) const;
+    void vertexRange(const char* prim, size_t num, void* geom, size_t& lower, size_t& upper) const;
   };
 
   struct Triangle1vMB
@@ -103,20 +104,20 @@ namespace embree
     __forceinline unsigned geomID() const { return v1.a; }
     __forceinline unsigned mask  () const { return v2.a; }
 
-    /*! fill triangle from triangle list */
-    __forceinline void fill(atomic_set<PrimRefBlock>::block_iterator_unsafe& prims, Scene* scene)
+    /*! fill triangle from triangle list, using the vertices at times t0 and t1 */
+    __forceinline void fill(atomic_set<PrimRefBlock>::block_iterator_unsafe& prims, Scene* scene, float t0 = 0.0f, float t1 = 1.0f)
     {
       const PrimRef& prim = *prims;
       const unsigned geomID = prim.geomID();
       const unsigned primID = prim.primID();
       const TriangleMesh* mesh = scene->getTriangleMesh(geomID);
       const TriangleMesh::Triangle& tri = mesh->triangle(primID);
-      const Vec3fa& a0 = mesh->vertex(tri.v[0],0);
-      const Vec3fa& a1 = mesh->vertex(tri.v[0],1);
-      const Vec3fa& b0 = mesh->vertex(tri.v[1],0);
-      const Vec3fa& b1 = mesh->vertex(tri.v[1],1);
-      const Vec3fa& c0 = mesh->vertex(tri.v[2],0);
-      const Vec3fa& c1 = mesh->vertex(tri.v[2],1);
+      const Vec3fa a0 = mesh->vertexAtTime(tri.v[0],t0);
+      const Vec3fa a1 = mesh->vertexAtTime(tri.v[0],t1);
+      const Vec3fa b0 = mesh->vertexAtTime(tri.v[1],t0);
+      const Vec3fa b1 = mesh->vertexAtTime(tri.v[1],t1);
+      const Vec3fa c0 = mesh->vertexAtTime(tri.v[2],t0);
+      const Vec3fa c1 = mesh->vertexAtTime(tri.v[2],t1);
       new (this) Triangle1vMB(a0,a1,b0,b1,c0,c1,mesh->id,primID,mesh->mask);
       prims++;
     }
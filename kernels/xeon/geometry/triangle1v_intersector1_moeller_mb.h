@@ -35,14 +35,16 @@ namespace embree
   {
     typedef Triangle1vMB Primitive;
 
-    /*! Intersect a ray with the triangle and updates the hit. */
-    static __forceinline void intersect(Ray& ray, const Triangle1vMB& tri, const void* geom)
+    /*! Intersect a ray with the triangle at the specified time and
+     *  updates the hit. The time is relative to the time segment of
+     *  the triangle, thus the time of the ray is not used. */
+    static __forceinline void intersect(Ray& ray, const float time, const Triangle1vMB& tri, const void* geom)
     {
       /* load triangle */
       STAT3(normal.trav_prims,1,1,1);
-      const Vec3fa tri_v0 = tri.v0+ray.time*tri.d0;
-      const Vec3fa tri_v1 = tri.v1+ray.time*tri.d1;
-      const Vec3fa tri_v2 = tri.v2+ray.time*tri.d2;
+      const Vec3fa tri_v0 = tri.v0+time*tri.d0;
+      const Vec3fa tri_v1 = tri.v1+time*tri.d1;
+      const Vec3fa tri_v2 = tri.v2+time*tri.d2;
       const Vec3fa e1 = tri_v0-tri_v1;
       const Vec3fa e2 = tri_v2-tri_v0;
       const Vec3fa tri_Ng = cross(e1,e2);
@@ -107,20 +109,20 @@ namespace embree
       ray.primID = primID;
     }
 
-    static __forceinline void intersect(Ray& ray, const Triangle1vMB* tri, size_t num, void* geom)
+    static __forceinline void intersect(Ray& ray, const float time, const Triangle1vMB* tri, size_t num, void* geom)
     {
       for (size_t i=0; i<num; i++)
-        intersect(ray,tri[i],geom);
+        intersect(ray,time,tri[i],geom);
     }
 
-    /*! Test if the ray is occluded by one of the triangles. */
-    static __forceinline bool occluded(Ray& ray, const Triangle1vMB& tri, const void* geom)
+    /*! Test if the ray is occluded by the triangle at the specified time. */
+    static __forceinline bool occluded(Ray& ray, const float time, const Triangle1vMB& tri, const void* geom)
     {
       /* load triangle */
       STAT3(shadow.trav_prims,1,1,1);
-      const Vec3fa tri_v0 = tri.v0+ray.time*tri.d0;
-      const Vec3fa tri_v1 = tri.v1+ray.time*tri.d1;
-      const Vec3fa tri_v2 = tri.v2+ray.time*tri.d2;
+      const Vec3fa tri_v0 = tri.v0+time*tri.d0;
+      const Vec3fa tri_v1 = tri.v1+time*tri.d1;
+      const Vec3fa tri_v2 = tri.v2+time*tri.d2;
       const Vec3fa e1 = tri_v0-tri_v1;
       const Vec3fa e2 = tri_v2-tri_v0;
       const Vec3fa tri_Ng = cross(e1,e2);
@@ -178,10 +180,10 @@ namespace embree
       return true;
     }
 
-    static __forceinline bool occluded(Ray& ray, const Triangle1vMB* tri, size_t num, void* geom) 
+    static __forceinline bool occluded(Ray& ray, const float time, const Triangle1vMB* tri, size_t num, void* geom) 
     {
       for (size_t i=0; i<num; i++) 
-        if (occluded(ray,tri[i],geom))
+        if (occluded(ray,time,tri[i],geom))
           return true;
 
       return false;
@@ -37,7 +37,7 @@ namespace embree
       __forceinline Precalculations (const sseb& valid, const Ray4& ray) {}
     };
 
-    static __forceinline void intersect(const sseb& valid_i, Precalculations& pre, Ray4& ray, const Triangle1vMB* __restrict__ tris, size_t num, const void* geom)
+    static __forceinline void intersect(const sseb& valid_i, Precalculations& pre, Ray4& ray, const ssef& time, const Triangle1vMB* __restrict__ tris, size_t num, const void* geom)
     {
       for (size_t i=0; i<num; i++) 
       {
@@ -50,9 +50,9 @@ namespace embree
         const Triangle1vMB& tri = tris[i];
         
         /* load vertices and calculate edges */
-        const sse3f v0 = sse3f(tri.v0)+ray.time*sse3f(tri.d0);
-        const sse3f v1 = sse3f(tri.v1)+ray.time*sse3f(tri.d1);
-        const sse3f v2 = sse3f(tri.v2)+ray.time*sse3f(tri.d2);
+        const sse3f v0 = sse3f(tri.v0)+time*sse3f(tri.d0);
+        const sse3f v1 = sse3f(tri.v1)+time*sse3f(tri.d1);
+        const sse3f v2 = sse3f(tri.v2)+time*sse3f(tri.d2);
         const sse3f e1 = v0-v1;
         const sse3f e2 = v2-v0;
         
@@ -119,7 +119,7 @@ namespace embree
       }
     }
 
-    static __forceinline sseb occluded(const sseb& valid_i, Precalculations& pre, Ray4& ray, const Triangle1vMB* __restrict__ tris, size_t num, const void* geom)
+    static __forceinline sseb occluded(const sseb& valid_i, Precalculations& pre, Ray4& ray, const ssef& time, const Triangle1vMB* __restrict__ tris, size_t num, const void* geom)
     {
       sseb valid0 = valid_i;
 
@@ -134,9 +134,9 @@ namespace embree
         const Triangle1vMB& tri = tris[i];
         
         /* load vertices and calculate edges */
-        const sse3f v0 = sse3f(tri.v0)+ray.time*sse3f(tri.d0);
-        const sse3f v1 = sse3f(tri.v1)+ray.time*sse3f(tri.d1);
-        const sse3f v2 = sse3f(tri.v2)+ray.time*sse3f(tri.d2);
+        const sse3f v0 = sse3f(tri.v0)+time*sse3f(tri.d0);
+        const sse3f v1 = sse3f(tri.v1)+time*sse3f(tri.d1);
+        const sse3f v2 = sse3f(tri.v2)+time*sse3f(tri.d2);
         const sse3f e1 = v0-v1;
         const sse3f e2 = v2-v0;
         
@@ -37,7 +37,7 @@ namespace embree
       __forceinline Precalculations (const avxb& valid, const Ray8& ray) {}
     };
 
-    static __forceinline void intersect(const avxb& valid_i, Precalculations& pre, Ray8& ray, const Triangle1vMB* __restrict__ tris, size_t num, const void* geom)
+    static __forceinline void intersect(const avxb& valid_i, Precalculations& pre, Ray8& ray, const avxf& time, const Triangle1vMB* __restrict__ tris, size_t num, const void* geom)
     {
       for (size_t i=0; i<num; i++) 
       {
@@ -50,9 +50,9 @@ namespace embree
         const Triangle1vMB& tri = tris[i];
         
         /* load vertices and calculate edges */
-        const avx3f v0 = avx3f(tri.v0)+ray.time*avx3f(tri.d0);
-        const avx3f v1 = avx3f(tri.v1)+ray.time*avx3f(tri.d1);
-        const avx3f v2 = avx3f(tri.v2)+ray.time*avx3f(tri.d2);
+        const avx3f v0 = avx3f(tri.v0)+time*avx3f(tri.d0);
+        const avx3f v1 = avx3f(tri.v1)+time*avx3f(tri.d1);
+        const avx3f v2 = avx3f(tri.v2)+time*avx3f(tri.d2);
         const avx3f e1 = v0-v1;
         const avx3f e2 = v2-v0;
         
@@ -119,7 +119,7 @@ namespace embree
       }
     }
 
-    static __forceinline avxb occluded(const avxb& valid_i, Precalculations& pre, Ray8& ray, const Triangle1vMB* __restrict__ tris, size_t num, const void* geom)
+    static __forceinline avxb occluded(const avxb& valid_i, Precalculations& pre, Ray8& ray, const avxf& time, const Triangle1vMB* __restrict__ tris, size_t num, const void* geom)
     {
       avxb valid0 = valid_i;
 
@@ -134,9 +134,9 @@ namespace embree
         const Triangle1vMB& tri = tris[i];
         
         /* load vertices and calculate edges */
-        const avx3f v0 = avx3f(tri.v0)+ray.time*avx3f(tri.d0);
-        const avx3f v1 = avx3f(tri.v1)+ray.time*avx3f(tri.d1);
-        const avx3f v2 = avx3f(tri.v2)+ray.time*avx3f(tri.d2);
+        const avx3f v0 = avx3f(tri.v0)+time*avx3f(tri.d0);
+        const avx3f v1 = avx3f(tri.v1)+time*avx3f(tri.d1);
+        const avx3f v2 = avx3f(tri.v2)+time*avx3f(tri.d2);
         const avx3f e1 = v0-v1;
         const avx3f e2 = v2-v0;
         
@@ -191,4 +191,17 @@ namespace embree
     }
     return bounds; 
   }
+
+  void TriangleMeshTriangle4::vertexRange(const char* prim, size_t num, void* geom, size_t& lower, size_t& upper) const
+  {
+    const TriangleMesh* mesh = (const TriangleMesh*) geom;
+    for (size_t j=0; j<num; j++) 
+    {
+      const Triangle4& tri = ((const Triangle4*) prim)[j];
+      for (size_t i=0; i<4; i++) {
+        if (tri.primID[i] == -1) break;
+        mesh->extendVertexRange(tri.primID[i],lower,upper);
+      }
+    }
+  }
 }
@@ -151,4 +151,17 @@ namespace embree
     }
     return bounds; 
   }
+
+  void TriangleMeshTriangle4i::vertexRange(const char* prim, size_t num, void* geom, size_t& lower, size_t& upper) const
+  {
+    const TriangleMesh* mesh = (const TriangleMesh*) geom;
+    for (size_t j=0; j<num; j++) 
+    {
+      const Triangle4i& tri = ((const Triangle4i*) prim)[j];
+      for (size_t i=0; i<4; i++) {
+        if (tri.primID[i] == -1) break;
+        mesh->extendVertexRange(tri.primID[i],lower,upper);
+      }
+    }
+  }
 }
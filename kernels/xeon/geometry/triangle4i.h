@@ -131,5 +131,6 @@ namespace embree
     static TriangleMeshTriangle4i type;
     void pack(char* This, atomic_set<PrimRefBlock>::block_iterator_unsafe& prims, void* geom) const;
     BBox3fa update(char* prim, size_t num, void* geom) const;
+    void vertexRange(const char* prim, size_t num, void* geom, size_t& lower, size_t& upper) const;
   };
 }
@@ -224,5 +224,17 @@ namespace embree
       }
       return !valid0;
     }
+
+    /*! Intersect a ray with the 4 triangles and updates the hit. */
+    static __forceinline void intersect(Precalculations& pre, Ray8& ray, size_t k, const Triangle4i* tri, size_t num, const void* geom) {
+      intersect(avxb(int(1<<k)),pre,ray,tri,num,geom);
+    }
+
+    /*! Test if the ray is occluded by one of the triangles. */
+    static __forceinline bool occluded(Precalculations& pre, Ray8& ray, size_t k, const Triangle4i* tri, size_t num, const void* geom) 
+    {
+      const avxb valid(int(1<<k));
+      return any(occluded(valid,pre,ray,tri,num,geom) & valid);
+    }
   };
 }
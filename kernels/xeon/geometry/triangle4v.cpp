@@ -180,4 +180,17 @@ namespace embree
     }
     return bounds; 
   }
+
+  void TriangleMeshTriangle4v::vertexRange(const char* prim, size_t num, void* geom, size_t& lower, size_t& upper) const
+  {
+    const TriangleMesh* mesh = (const TriangleMesh*) geom;
+    for (size_t j=0; j<num; j++) 
+    {
+      const Triangle4v& tri = ((const Triangle4v*) prim)[j];
+      for (size_t i=0; i<4; i++) {
+        if (tri.primID[i] == -1) break;
+        mesh->extendVertexRange(tri.primID[i],lower,upper);
+      }
+    }
+  }
 }
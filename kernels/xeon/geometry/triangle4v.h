@@ -140,5 +140,6 @@ namespace embree
     static TriangleMeshTriangle4v type;
     void pack(char* This, atomic_set<PrimRefBlock>::block_iterator_unsafe& prims, void* geom) const;
     BBox3fa update(char* prim, size_t num, void* geom) const;
+    void vertexRange(const char* prim, size_t num, void* geom, size_t& lower, size_t& upper) const;
   };
 }
@@ -0,0 +1,172 @@
+// ======================================================================== //
+// Copyright 2009-2014 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "triangle4.h"
+#include "triangle4v.h"
+#if defined(__AVX__)
+#include "triangle8.h"
+#endif
+#include "common/point_query.h"
+
+namespace embree
+{
+  /*! Calculates the barycentric coordinates u,v of the closest points
+   *  to p on N triangles a,b,c and returns their squared distances to
+   *  p. The Voronoi region of the triangle that contains p is
+   *  determined as in "Real-Time Collision Detection" by Christer
+   *  Ericson, but all regions are evaluated branch free for all
+   *  triangles at once. */
+  template<typename tsseb, typename tssef, typename tsse3f>
+    __forceinline tssef closestPointTriangle(const tsse3f& p, const tsse3f& a, const tsse3f& b, const tsse3f& c, tssef& u_o, tssef& v_o)
+  {
+    const tsse3f ab = b-a, ac = c-a;
+    const tsse3f ap = p-a, bp = p-b, cp = p-c;
+    const tssef d1 = dot(ab,ap), d2 = dot(ac,ap);
+    const tssef d3 = dot(ab,bp), d4 = dot(ac,bp);
+    const tssef d5 = dot(ab,cp), d6 = dot(ac,cp);
+    const tssef va = d3*d6-d5*d4;
+    const tssef vb = d5*d2-d1*d6;
+    const tssef vc = d1*d4-d3*d2;
+    const tssef zero_(zero), one_(one);
+
+    /* inside the triangle */
+    const tssef rcpDen = one_/(va+vb+vc);
+    tssef u = vb*rcpDen;
+    tssef v = vc*rcpDen;
+
+    /* on edge bc */
+    const tssef e43 = d4-d3, e56 = d5-d6;
+    const tsseb inBC = (va <= zero_) & (e43 >= zero_) & (e56 >= zero_);
+    const tssef wBC = e43/(e43+e56);
+    u = select(inBC,one_-wBC,u);
+    v = select(inBC,wBC,v);
+
+    /* at vertex c */
+    const tsseb inC = (d6 >= zero_) & (d5 <= d6);
+    u = select(inC,zero_,u);
+    v = select(inC,one_,v);
+
+    /* on edge ac */
+    const tsseb inAC = (vb <= zero_) & (d2 >= zero_) & (d6 <= zero_);
+    u = select(inAC,zero_,u);
+    v = select(inAC,d2/(d2-d6),v);
+
+    /* on edge ab */
+    const tsseb inAB = (vc <= zero_) & (d1 >= zero_) & (d3 <= zero_);
+    u = select(inAB,d1/(d1-d3),u);
+    v = select(inAB,zero_,v);
+
+    /* at vertex b */
+    const tsseb inB = (d3 >= zero_) & (d4 <= d3);
+    u = select(inB,one_,u);
+    v = select(inB,zero_,v);
+
+    /* at vertex a */
+    const tsseb inA = (d1 <= zero_) & (d2 <= zero_);
+    u = select(inA,zero_,u);
+    v = select(inA,zero_,v);
+
+    u_o = u; v_o = v;
+    const tsse3f d = ap - u*ab - v*ac;
+    return dot(d,d);
+  }
+
+  /*! Updates the point query with the closest of the valid triangles
+   *  if it lies within the search radius. */
+  template<typename tsseb, typename tssef, typename tsse3f, typename tssei>
+    __forceinline void updatePointQuery(PointQuery& query, tsseb valid, const tssef& dist2, const tssef& u, const tssef& v, 
+                                        const tsse3f& a, const tsse3f& b, const tsse3f& c, const tssei& geomID, const tssei& primID)
+  {
+    valid &= dist2 <= tssef(query.radius2());
+    if (likely(none(valid))) return;
+    const size_t i = select_min(valid,dist2);
+    const Vec3f a_i(a.x[i],a.y[i],a.z[i]), b_i(b.x[i],b.y[i],b.z[i]), c_i(c.x[i],c.y[i],c.z[i]);
+    query.radius = sqrt(dist2[i]);
+    query.closest = a_i + u[i]*(b_i-a_i) + v[i]*(c_i-a_i);
+    query.u = u[i];
+    query.v = v[i];
+    query.geomID = geomID[i];
+    query.primID = primID[i];
+  }
+
+  /*! Point query for 4 triangles stored as base vertex and edges. */
+  struct Triangle4PointQuery
+  {
+    typedef Triangle4 Primitive;
+
+    static __forceinline void pointQuery(PointQuery& query, const Triangle4& tri, void* geom)
+    {
+      STAT3(normal.trav_prims,1,1,1);
+      const sse3f p(query.p.x,query.p.y,query.p.z);
+      const sse3f v1 = tri.v0-tri.e1, v2 = tri.v0+tri.e2;
+      ssef u,v; const ssef dist2 = closestPointTriangle<sseb>(p,tri.v0,v1,v2,u,v);
+      updatePointQuery(query,tri.valid(),dist2,u,v,tri.v0,v1,v2,tri.geomID,tri.primID);
+    }
+
+    static __forceinline void pointQuery(PointQuery& query, const Triangle4* tri, size_t num, void* geom)
+    {
+      for (size_t i=0; i<num; i++)
+        pointQuery(query,tri[i],geom);
+    }
+  };
+
+  /*! Point query for 4 triangles stored as vertices. */
+  struct Triangle4vPointQuery
+  {
+    typedef Triangle4v Primitive;
+
+    static __forceinline void pointQuery(PointQuery& query, const Triangle4v& tri, void* geom)
+    {
+      STAT3(normal.trav_prims,1,1,1);
+      const sse3f p(query.p.x,query.p.y,query.p.z);
+      ssef u,v; const ssef dist2 = closestPointTriangle<sseb>(p,tri.v0,tri.v1,tri.v2,u,v);
+      updatePointQuery(query,tri.valid(),dist2,u,v,tri.v0,tri.v1,tri.v2,tri.geomID,tri.primID);
+    }
+
+    static __forceinline void pointQuery(PointQuery& query, const Triangle4v* tri, size_t num, void* geom)
+    {
+      for (size_t i=0; i<num; i++)
+        pointQuery(query,tri[i],geom);
+    }
+  };
+
+#if defined(__AVX__)
+
+  /*! Point query for 8 triangles stored as base vertex and edges. */
+  struct Triangle8PointQuery
+  {
+    typedef Triangle8 Primitive;
+
+    static __forceinline void pointQuery(PointQuery& query, const Triangle8& tri, void* geom)
+    {
+      STAT3(normal.trav_prims,1,1,1);
+      const avx3f p(query.p.x,query.p.y,query.p.z);
+      const avx3f v1 = tri.v0-tri.e1, v2 = tri.v0+tri.e2;
+      avxf u,v; const avxf dist2 = closestPointTriangle<avxb>(p,tri.v0,v1,v2,u,v);
+      updatePointQuery(query,tri.valid(),dist2,u,v,tri.v0,v1,v2,tri.geomID,tri.primID);
+    }
+
+    static __forceinline void pointQuery(PointQuery& query, const Triangle8* tri, size_t num, void* geom)
+    {
+      for (size_t i=0; i<num; i++)
+        pointQuery(query,tri[i],geom);
+    }
+  };
+
+#endif
+}
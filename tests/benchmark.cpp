@@ -16,11 +16,16 @@
 
 #include "sys/platform.h"
 #include "sys/ref.h"
+#include "sys/taskscheduler.h"
 #include "embree2/rtcore.h"
 #include "embree2/rtcore_ray.h"
 #include "math/vec3.h"
 #include "../kernels/common/default.h"
 #include <vector>
+#include <sstream>
+#if defined(__LINUX__)
+#include <unistd.h>
+#endif
 
 namespace embree
 {
@@ -28,6 +33,11 @@ namespace embree
 
   /* configuration */
   static std::string g_rtcore = "";
+  static bool g_scaling = false;                  //!< runs the multi-threaded ray throughput benchmarks
+  static size_t g_max_threads = 0;                //!< maximal number of threads for scaling benchmarks
+  static size_t g_scene_size = 1000000;           //!< approximate number of primitives of generated scenes
+  static std::vector<std::string> g_scene_types;  //!< scene types for scaling benchmarks
+  static std::string g_json = "";                 //!< file to write scaling results to
   
   /* vertex and triangle layout */
   struct Vertex   { float x,y,z,a; };
@@ -123,6 +133,58 @@ namespace embree
     fflush(stdout);
   }
 
+  size_t g_num_flat_tasks = 1000000;
+  size_t g_task_tree_depth = 18;
+
+  void benchmark_tasks_empty(void* data, size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event) {
+  }
+
+  void benchmark_tasks_recurse(void* data, size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event)
+  {
+    size_t depth = (size_t) data;
+    if (depth == 0) return;
+    TaskScheduler::executeTask(threadIndex,threadCount,benchmark_tasks_recurse,(void*)(depth-1),2,"benchmark_tasks_recurse");
+  }
+
+  double benchmark_tasks_run(TaskScheduler::runFunction run, void* data, size_t elts)
+  {
+    TaskScheduler::EventSync event;
+    TaskScheduler::Task task(&event,run,data,elts,NULL,NULL,"benchmark_tasks");
+    double t0 = getSeconds();
+    TaskScheduler::addTask(-1,TaskScheduler::GLOBAL_BACK,&task);
+    event.sync();
+    double t1 = getSeconds();
+    return t1-t0;
+  }
+
+  void benchmark_tasks ()
+  {
+    size_t maxThreads = getNumberOfLogicalThreads();
+#if defined (__MIC__)
+    maxThreads -= 4;
+#endif
+    for (size_t numThreads=1; ; numThreads=min(2*numThreads,maxThreads))
+    {
+      TaskScheduler::create(numThreads);
+      char name[64];
+
+      /* many elements of a single task */
+      double dt0 = benchmark_tasks_run(benchmark_tasks_empty,NULL,g_num_flat_tasks);
+      sprintf(name,"tasks_flat_%d",int(numThreads));
+      printf("%30s ... %f Mtasks/s\n",name,1E-6*g_num_flat_tasks/dt0);
+
+      /* binary tree of tasks spawned from the worker threads */
+      size_t numTreeTasks = (size_t(2) << g_task_tree_depth)-1;
+      double dt1 = benchmark_tasks_run(benchmark_tasks_recurse,(void*)g_task_tree_depth,1);
+      sprintf(name,"tasks_nested_%d",int(numThreads));
+      printf("%30s ... %f Mtasks/s\n",name,1E-6*numTreeTasks/dt1);
+      fflush(stdout);
+
+      TaskScheduler::destroy();
+      if (numThreads == maxThreads) break;
+    }
+  }
+
   void benchmark_barrier_sys_thread2(void* ptr) {
     g_barrier2.wait();
   }
@@ -248,6 +310,31 @@ namespace embree
         g_rtcore = argv[++i];
       }
 
+      /* run multi-threaded throughput benchmarks */
+      else if (tag == "-scaling") {
+        g_scaling = true;
+      }
+
+      /* maximal number of threads */
+      else if (tag == "-threads" && i+1<argc) {
+        g_max_threads = atoi(argv[++i]);
+      }
+
+      /* number of primitives of generated scenes */
+      else if (tag == "-size" && i+1<argc) {
+        g_scene_size = atoi(argv[++i]);
+      }
+
+      /* scene type: triangles, hair, instances, or motion */
+      else if (tag == "-scene" && i+1<argc) {
+        g_scene_types.push_back(argv[++i]);
+      }
+
+      /* write results in JSON format */
+      else if (tag == "-json" && i+1<argc) {
+        g_json = argv[++i];
+      }
+
       /* skip unknown command line parameter */
       else {
         std::cerr << "unknown command line parameter: " << tag << " ";
@@ -590,12 +677,321 @@ namespace embree
     rtcDeleteScene(scene);
   }
 
+  /* returns the resident memory of the process in bytes */
+  size_t getResidentMemory()
+  {
+#if defined(__LINUX__)
+    FILE* file = fopen("/proc/self/statm","r");
+    if (!file) return 0;
+    unsigned long pages = 0, resident = 0;
+    if (fscanf(file,"%lu %lu",&pages,&resident) != 2) resident = 0;
+    fclose(file);
+    return resident*size_t(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+  }
+
+  /* results of one scaling benchmark */
+  struct ScalingResult
+  {
+    std::string scene;
+    size_t threads;
+    size_t prims;
+    double build;       //!< build performance in primitives per second
+    size_t memory;      //!< resident memory allocated by the build in bytes
+    double coherent;    //!< coherent rays per second
+    double incoherent;  //!< incoherent rays per second
+    double shadow;      //!< shadow rays per second
+  };
+
+  std::vector<ScalingResult> g_scaling_results;
+
+  /* adds a triangulated sphere, optionally moving by some offset over the shutter interval */
+  size_t addSphereMB (RTCScene scene, const Vec3f pos, const float r, size_t numPhi, const Vec3f motion)
+  {
+    Mesh mesh; createSphereMesh (pos, r, numPhi, mesh);
+    const bool mb = motion != Vec3f(zero);
+    unsigned geom = rtcNewTriangleMesh (scene, RTC_GEOMETRY_STATIC, mesh.triangles.size(), mesh.vertices.size(), mb ? 2 : 1);
+    memcpy(rtcMapBuffer(scene,geom,RTC_INDEX_BUFFER), &mesh.triangles[0], mesh.triangles.size()*sizeof(Triangle));
+    memcpy(rtcMapBuffer(scene,geom,RTC_VERTEX_BUFFER0), &mesh.vertices[0], mesh.vertices.size()*sizeof(Vertex));
+    rtcUnmapBuffer(scene,geom,RTC_INDEX_BUFFER);
+    rtcUnmapBuffer(scene,geom,RTC_VERTEX_BUFFER0);
+    if (mb) {
+      Vertex* vertices1 = (Vertex*) rtcMapBuffer(scene,geom,RTC_VERTEX_BUFFER1);
+      for (size_t i=0; i<mesh.vertices.size(); i++) {
+        vertices1[i] = mesh.vertices[i];
+        vertices1[i].x += motion.x; vertices1[i].y += motion.y; vertices1[i].z += motion.z;
+      }
+      rtcUnmapBuffer(scene,geom,RTC_VERTEX_BUFFER1);
+    }
+    return mesh.triangles.size();
+  }
+
+  /* adds randomly placed hair curves inside [-1,1]^3 */
+  size_t addRandomHair (RTCScene scene, size_t numHairs)
+  {
+    unsigned geom = rtcNewHairGeometry (scene, RTC_GEOMETRY_STATIC, numHairs, 4*numHairs, 1);
+    Vertex* vertices = (Vertex*) rtcMapBuffer(scene,geom,RTC_VERTEX_BUFFER);
+    int* indices = (int*) rtcMapBuffer(scene,geom,RTC_INDEX_BUFFER);
+    for (size_t i=0; i<numHairs; i++) 
+    {
+      indices[i] = 4*i;
+      const Vec3f p(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+      const Vec3f d(0.1f*drand48()-0.05f,0.1f*drand48(),0.1f*drand48()-0.05f);
+      for (size_t j=0; j<4; j++) {
+        Vertex& v = vertices[4*i+j];
+        v.x = p.x + float(j)*d.x; v.y = p.y + float(j)*d.y; v.z = p.z + float(j)*d.z; v.a = 0.002f;
+      }
+    }
+    rtcUnmapBuffer(scene,geom,RTC_VERTEX_BUFFER);
+    rtcUnmapBuffer(scene,geom,RTC_INDEX_BUFFER);
+    return numHairs;
+  }
+
+  /* creates a scene of about N primitives inside [-1,1]^3, returns the number of primitives to build */
+  size_t createScalingScene (RTCScene scene, RTCScene& object, const std::string& type, size_t N)
+  {
+    /* 3x3x3 grid of spheres */
+    const size_t numSpheres = 27;
+    const size_t numPhi = max(size_t(sqrt(double(N)/double(4*numSpheres))),size_t(3));
+    const float r = 0.3f;
+
+    if (type == "hair") 
+      return addRandomHair(scene,N);
+
+    size_t prims = 0;
+    if (type == "instances") 
+    {
+      /* a single sphere instanced at all grid locations, the object gets committed as part of the timed build */
+      object = rtcNewScene(RTC_SCENE_STATIC,aflags);
+      prims += addSphereMB(object,zero,r,numPhi,zero);
+    }
+
+    for (size_t z=0; z<3; z++) {
+      for (size_t y=0; y<3; y++) {
+        for (size_t x=0; x<3; x++) 
+        {
+          const Vec3f pos(0.66f*float(x)-0.66f,0.66f*float(y)-0.66f,0.66f*float(z)-0.66f);
+          if (type == "instances") {
+            unsigned geom = rtcNewInstance(scene,object);
+            const float xfm[12] = { 1,0,0, 0,1,0, 0,0,1, pos.x,pos.y,pos.z };
+            rtcSetTransform(scene,geom,RTC_MATRIX_COLUMN_MAJOR,xfm);
+            prims++;
+          }
+          else if (type == "motion") 
+            prims += addSphereMB(scene,pos,r,numPhi,Vec3f(0.05f,0,0));
+          else
+            prims += addSphereMB(scene,pos,r,numPhi,zero);
+        }
+      }
+    }
+    return prims;
+  }
+
+  /* simple linear congruential generator that is fast and identical on all platforms */
+  __forceinline float nextRandom(unsigned int& state) {
+    state = 1664525*state + 1013904223;
+    return float(state >> 8)*(1.0f/16777216.0f);
+  }
+
+  /* the workload that is shared by all threads of a scaling benchmark */
+  struct ScalingWorkload
+  {
+    enum Type { COHERENT, INCOHERENT, SHADOW };
+    RTCScene scene;
+    Type type;
+    bool motion;
+    size_t numRays;
+    atomic_t next;
+    BarrierSys barrier;
+  };
+
+  ScalingWorkload g_workload;
+
+  static const size_t SCALING_WIDTH = 1024;
+  static const size_t SCALING_BLOCK = 256;
+
+  /* traces blocks of rays until all rays of the workload got traced */
+  void traceScalingRays()
+  {
+    ScalingWorkload& w = g_workload;
+    const float rcpWidth = 1.0f/float(SCALING_WIDTH);
+    while (true)
+    {
+      const ssize_t block = atomic_add(&w.next,1);
+      const size_t begin = size_t(block)*SCALING_BLOCK;
+      if (begin >= w.numRays) break;
+      const size_t end = min(begin+SCALING_BLOCK,w.numRays);
+
+      /* each block has its own deterministic random sequence */
+      unsigned int seed = (unsigned int)(begin+1);
+      for (size_t i=begin; i<end; i++)
+      {
+        const float r0 = nextRandom(seed);
+        const float r1 = nextRandom(seed);
+        const float r2 = nextRandom(seed);
+        RTCRay ray;
+        switch (w.type) 
+        {
+        case ScalingWorkload::COHERENT: {
+          const float x = float(i%SCALING_WIDTH)*rcpWidth-0.5f;
+          const float y = float(i/SCALING_WIDTH)*rcpWidth-0.5f;
+          ray = makeRay(Vec3f(0,0,-3),Vec3f(x,y,1));
+          break;
+        }
+        case ScalingWorkload::INCOHERENT: {
+          ray = makeRay(Vec3f(2.0f*r0-1.0f,2.0f*r1-1.0f,2.0f*r2-1.0f),
+                        Vec3f(nextRandom(seed)-0.5f,nextRandom(seed)-0.5f,nextRandom(seed)-0.5f));
+          break;
+        }
+        case ScalingWorkload::SHADOW: {
+          const Vec3f p0(2.0f*r0-1.0f,2.0f*r1-1.0f,2.0f*r2-1.0f);
+          const Vec3f p1(2.0f*nextRandom(seed)-1.0f,2.0f*nextRandom(seed)-1.0f,2.0f*nextRandom(seed)-1.0f);
+          ray = makeRay(p0,p1-p0,0.0f,1.0f);
+          break;
+        }
+        }
+        if (w.motion) ray.time = nextRandom(seed);
+        if (w.type == ScalingWorkload::SHADOW) rtcOccluded(w.scene,ray);
+        else                                   rtcIntersect(w.scene,ray);
+      }
+    }
+  }
+
+  void traceScalingRaysThread(void* ptr) 
+  {
+    g_workload.barrier.wait();
+    traceScalingRays();
+    g_workload.barrier.wait();
+  }
+
+  /* traces a workload using numThreads threads, returns rays per second */
+  double traceScalingWorkload(RTCScene scene, ScalingWorkload::Type type, bool motion, size_t numRays, size_t numThreads)
+  {
+    g_workload.scene = scene;
+    g_workload.type = type;
+    g_workload.motion = motion;
+    g_workload.numRays = numRays;
+    g_workload.next = 0;
+    g_workload.barrier.init(numThreads);
+
+    for (size_t i=1; i<numThreads; i++)
+      g_threads.push_back(createThread(traceScalingRaysThread,(void*)i,1000000,i));
+    setAffinity(0);
+
+    g_workload.barrier.wait();
+    double t0 = getSeconds();
+    traceScalingRays();
+    g_workload.barrier.wait();
+    double t1 = getSeconds();
+
+    for (size_t i=0; i<g_threads.size(); i++)
+      join(g_threads[i]);
+    g_threads.clear();
+
+    return double(numRays)/(t1-t0);
+  }
+
+  /* builds a scene and traces the coherent, incoherent, and shadow ray workloads with numThreads threads */
+  void rtcore_scaling_benchmark(const std::string& type, size_t numThreads)
+  {
+    std::string cfg = g_rtcore;
+    if (cfg != "") cfg += ",";
+    std::stringstream str; str << "threads=" << numThreads;
+    rtcInit((cfg+str.str()).c_str());
+
+    ScalingResult result;
+    result.scene = type;
+    result.threads = numThreads;
+
+    RTCScene object = NULL;
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    result.prims = createScalingScene(scene,object,type,g_scene_size);
+    
+    size_t m0 = getResidentMemory();
+    double t0 = getSeconds();
+    if (object) rtcCommit (object);
+    rtcCommit (scene);
+    double t1 = getSeconds();
+    size_t m1 = getResidentMemory();
+    result.build = double(result.prims)/(t1-t0);
+    result.memory = m1 > m0 ? m1-m0 : 0;
+
+    const bool motion = type == "motion";
+    const size_t numRays = SCALING_WIDTH*SCALING_WIDTH;
+    result.coherent   = traceScalingWorkload(scene,ScalingWorkload::COHERENT  ,motion,numRays,numThreads);
+    result.incoherent = traceScalingWorkload(scene,ScalingWorkload::INCOHERENT,motion,numRays,numThreads);
+    result.shadow     = traceScalingWorkload(scene,ScalingWorkload::SHADOW    ,motion,numRays,numThreads);
+
+    rtcDeleteScene(scene);
+    if (object) rtcDeleteScene(object);
+    if (rtcGetError() != RTC_NO_ERROR) 
+      std::cerr << "scaling benchmark " << type << " failed" << std::endl;
+    rtcExit();
+
+    char name[64];
+    sprintf(name,"%s_%d",type.c_str(),int(numThreads));
+    printf("%30s ... build %f Mprims/s, %f MB, coherent %f Mrps, incoherent %f Mrps, shadow %f Mrps\n",name,
+           1E-6*result.build,1E-6*double(result.memory),1E-6*result.coherent,1E-6*result.incoherent,1E-6*result.shadow);
+    fflush(stdout);
+    g_scaling_results.push_back(result);
+  }
+
+  /* writes the results of the scaling benchmarks in JSON format */
+  void writeScalingResults(const std::string& fileName)
+  {
+    FILE* file = fopen(fileName.c_str(),"w");
+    if (!file) throw std::runtime_error("cannot open file "+fileName);
+    fprintf(file,"{\n  \"rtcore\": \"%s\",\n  \"size\": %d,\n  \"results\": [\n",g_rtcore.c_str(),int(g_scene_size));
+    for (size_t i=0; i<g_scaling_results.size(); i++) 
+    {
+      const ScalingResult& r = g_scaling_results[i];
+      fprintf(file,"    { \"scene\": \"%s\", \"threads\": %d, \"prims\": %d, \"build_mprims_per_s\": %f, \"memory_mb\": %f, "
+              "\"coherent_mrays_per_s\": %f, \"incoherent_mrays_per_s\": %f, \"shadow_mrays_per_s\": %f }%s\n",
+              r.scene.c_str(),int(r.threads),int(r.prims),1E-6*r.build,1E-6*double(r.memory),1E-6*r.coherent,1E-6*r.incoherent,1E-6*r.shadow,
+              i+1 < g_scaling_results.size() ? "," : "");
+    }
+    fprintf(file,"  ]\n}\n");
+    fclose(file);
+  }
+
+  void rtcore_scaling_benchmarks()
+  {
+    size_t maxThreads = g_max_threads ? g_max_threads : getNumberOfLogicalThreads();
+    if (g_scene_types.size() == 0) {
+      g_scene_types.push_back("triangles");
+      g_scene_types.push_back("hair");
+      g_scene_types.push_back("instances");
+      g_scene_types.push_back("motion");
+    }
+
+    for (size_t i=0; i<g_scene_types.size(); i++) {
+      for (size_t numThreads=1; ; numThreads=min(2*numThreads,maxThreads)) {
+        rtcore_scaling_benchmark(g_scene_types[i],numThreads);
+        if (numThreads == maxThreads) break;
+      }
+    }
+
+    if (g_json != "") 
+      writeScalingResults(g_json);
+  }
+
   /* main function in embree namespace */
   int main(int argc, char** argv) 
   {
     /* parse command line */  
     parseCommandLine(argc,argv);
 
+    /* the scaling benchmarks initialize Embree for each number of threads */
+    if (g_scaling) {
+      rtcore_scaling_benchmarks();
+      return 0;
+    }
+
+    /* the task benchmark creates its own schedulers, thus run it before Embree starts its threads */
+    benchmark_tasks();
+
     /* perform tests */
     rtcInit(g_rtcore.c_str());
 #if 1
@@ -27,6 +27,7 @@
 #include "embree2/rtcore_ray.h"
 #include "../kernels/common/default.h"
 #include <vector>
+#include <cstdio>
 
 namespace embree
 {
@@ -1013,6 +1014,493 @@ namespace embree
     return true;
   }
 
+  bool rtcore_partial_refit()
+  {
+    RTCScene scene = rtcNewScene(RTC_SCENE_DYNAMIC,aflags);
+    AssertNoError();
+    size_t numPhi = 50;
+    size_t numVertices = 2*numPhi*(numPhi+1);
+    unsigned geom = addSphere(scene,RTC_GEOMETRY_DEFORMABLE,Vec3fa(0,0,0),1.0f,numPhi);
+    rtcCommit (scene);
+    AssertNoError();
+
+    /* move the upper half of the sphere up and the lower half down,
+     * but only pass the vertex range of the upper half, the subtrees
+     * of the lower half are not refitted and keep their old bounds
+     * and triangles, a full refit would move the lower pole to -2 */
+    Vec3fa* vertices = (Vec3fa*) rtcMapBuffer(scene,geom,RTC_VERTEX_BUFFER); 
+    for (size_t j=0; j<numVertices/2; j++) vertices[j].y += 1.0f;
+    for (size_t j=numVertices/2; j<numVertices; j++) vertices[j].y -= 1.0f;
+    rtcUnmapBuffer(scene,geom,RTC_VERTEX_BUFFER);
+    rtcUpdateBufferRange(scene,geom,RTC_VERTEX_BUFFER,0,numVertices/2);
+    rtcCommit (scene);
+    AssertNoError();
+
+    RTCRay ray0 = makeRay(Vec3fa(0.1f,+10,0.1f),Vec3fa(0,-1,0)); 
+    RTCRay ray1 = makeRay(Vec3fa(0.1f,-10,0.1f),Vec3fa(0,+1,0)); 
+    rtcIntersect(scene,ray0);
+    rtcIntersect(scene,ray1);
+    rtcDeleteScene (scene);
+    AssertNoError();
+    if (ray0.geomID != geom || fabs(ray0.tfar-8.0f) > 0.1f) return false;
+    if (ray1.geomID == geom && fabs(ray1.tfar-8.0f) < 0.1f) return false;
+    return true;
+  }
+
+  bool rtcore_deform_mesh(RTCGeometryFlags flags)
+  {
+    RTCScene scene = rtcNewScene(RTC_SCENE_DYNAMIC,aflags);
+    AssertNoError();
+    size_t numPhi = 50;
+    size_t numVertices = 2*numPhi*(numPhi+1);
+    unsigned geom = addSphere(scene,flags,Vec3fa(0,0,0),1.0f,numPhi);
+    rtcCommit (scene);
+    AssertNoError();
+
+    Vec3fa* vertices = (Vec3fa*) rtcMapBuffer(scene,geom,RTC_VERTEX_BUFFER); 
+    std::vector<Vec3fa> original(vertices,vertices+numVertices);
+    rtcUnmapBuffer(scene,geom,RTC_VERTEX_BUFFER);
+
+    /* rotating the sphere scatters the vertices of each subtree over
+     * the sphere, which degrades the refitted BVH until it gets
+     * rebuilt, stretching it along x changes the hit distances */
+    for (size_t f=1; f<16; f++) 
+    {
+      const float a = 0.7f*float(f), sx = 1.0f+0.25f*float(f);
+      vertices = (Vec3fa*) rtcMapBuffer(scene,geom,RTC_VERTEX_BUFFER); 
+      for (size_t i=0; i<numVertices; i++) {
+        const Vec3fa& v = original[i];
+        vertices[i].x = sx*(cosf(a)*v.x - sinf(a)*v.y);
+        vertices[i].y = sinf(a)*v.x + cosf(a)*v.y;
+        vertices[i].z = v.z;
+      }
+      rtcUnmapBuffer(scene,geom,RTC_VERTEX_BUFFER);
+      rtcUpdate(scene,geom);
+      rtcCommit (scene);
+      AssertNoError();
+
+      RTCRay ray0 = makeRay(Vec3fa(0.01f,+10,0.013f),Vec3fa(0,-1,0)); 
+      RTCRay ray1 = makeRay(Vec3fa(+20,0.013f,0.01f),Vec3fa(-1,0,0)); 
+      RTCRay ray2 = makeRay(Vec3fa(0.013f,0.01f,-10),Vec3fa(0,0,+1)); 
+      rtcIntersect(scene,ray0);
+      rtcIntersect(scene,ray1);
+      rtcIntersect(scene,ray2);
+      if (ray0.geomID != geom || fabs(ray0.tfar-9.0f) > 0.05f) return false;
+      if (ray1.geomID != geom || fabs(ray1.tfar-(20.0f-sx)) > 0.05f*sx) return false;
+      if (ray2.geomID != geom || fabs(ray2.tfar-9.0f) > 0.05f) return false;
+    }
+    rtcDeleteScene (scene);
+    AssertNoError();
+    return true;
+  }
+
+  bool rtcore_update_range(RTCGeometryFlags flags)
+  {
+    RTCScene scene = rtcNewScene(RTC_SCENE_DYNAMIC,aflags);
+    AssertNoError();
+    size_t numPhi = 50;
+    size_t numVertices = 2*numPhi*(numPhi+1);
+    unsigned geom = addSphere(scene,flags,Vec3fa(0,0,0),1.0f,numPhi);
+    rtcCommit (scene);
+    AssertNoError();
+
+    for (size_t i=0; i<4; i++) 
+    {
+      /* move the upper half of the sphere up and only pass its vertex range */
+      Vec3fa* vertices = (Vec3fa*) rtcMapBuffer(scene,geom,RTC_VERTEX_BUFFER); 
+      for (size_t j=0; j<numVertices/2; j++) vertices[j].y += 1.0f;
+      rtcUnmapBuffer(scene,geom,RTC_VERTEX_BUFFER);
+      rtcUpdateBufferRange(scene,geom,RTC_VERTEX_BUFFER,0,numVertices/2);
+      rtcCommit (scene);
+      AssertNoError();
+
+      RTCRay ray0 = makeRay(Vec3fa(0.1f,+10,0.1f),Vec3fa(0,-1,0)); 
+      RTCRay ray1 = makeRay(Vec3fa(0.1f,-10,0.1f),Vec3fa(0,+1,0)); 
+      rtcIntersect(scene,ray0);
+      rtcIntersect(scene,ray1);
+      if (ray0.geomID != geom || fabs(ray0.tfar-(8.0f-i)) > 0.1f) return false;
+      if (ray1.geomID != geom || fabs(ray1.tfar-9.0f) > 0.1f) return false;
+    }
+
+    rtcUpdateBufferRange(scene,geom,RTC_VERTEX_BUFFER,numVertices,1);
+    AssertError(RTC_INVALID_ARGUMENT);
+    rtcDeleteScene (scene);
+    AssertNoError();
+    return true;
+  }
+
+  /* stores the time of the ray seen by the filter in the user data */
+  void motionTimeFilter1(void* ptr, RTCRay& ray) {
+    *(float*)ptr = ray.time;
+  }
+
+  /* adds a quad at height y that moves along x and returns at the end of the time range */
+  unsigned addMotionQuad (RTCScene scene, size_t numTimeSteps, float y)
+  {
+    unsigned geom = rtcNewTriangleMesh (scene, RTC_GEOMETRY_STATIC, 2, 4, numTimeSteps);
+    if (geom == RTC_INVALID_GEOMETRY_ID) return geom;
+
+    Triangle* triangles = (Triangle*) rtcMapBuffer(scene,geom,RTC_INDEX_BUFFER);
+    triangles[0].v0 = 0; triangles[0].v1 = 1; triangles[0].v2 = 2;
+    triangles[1].v0 = 0; triangles[1].v1 = 2; triangles[1].v2 = 3;
+    rtcUnmapBuffer(scene,geom,RTC_INDEX_BUFFER);
+
+    for (size_t t=0; t<numTimeSteps; t++) 
+    {
+      const float x = 4.0f*sinf(float(pi)*float(t)/float(numTimeSteps-1));
+      Vec3fa* vertices = (Vec3fa*) rtcMapBuffer(scene,geom,RTCBufferType(RTC_VERTEX_BUFFER0+t));
+      vertices[0] = Vec3fa(x-1.0f,y-1.0f,0.0f);
+      vertices[1] = Vec3fa(x+1.0f,y-1.0f,0.0f);
+      vertices[2] = Vec3fa(x+1.0f,y+1.0f,0.0f);
+      vertices[3] = Vec3fa(x-1.0f,y+1.0f,0.0f);
+      rtcUnmapBuffer(scene,geom,RTCBufferType(RTC_VERTEX_BUFFER0+t));
+    }
+    return geom;
+  }
+
+  bool rtcore_motion_segments(size_t numTimeSteps)
+  {
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    AssertNoError();
+    unsigned geom = addMotionQuad(scene,numTimeSteps,0.0f);
+    AssertNoError();
+
+    float filterTime = -1.0f;
+    rtcSetUserData(scene,geom,&filterTime);
+    rtcSetIntersectionFilterFunction(scene,geom,motionTimeFilter1);
+    rtcCommit (scene);
+    AssertNoError();
+
+    /* rays at the time steps hit the quad at its keyframe positions and miss it at the start position */
+    for (size_t t=1; t<numTimeSteps-1; t++)
+    {
+      const float time = float(t)/float(numTimeSteps-1);
+      const float x = 4.0f*sinf(float(pi)*time);
+      RTCRay ray0 = makeRay(Vec3fa(x,0.0f,10.0f),Vec3fa(0,0,-1)); ray0.time = time;
+      RTCRay ray1 = makeRay(Vec3fa(0.0f,0.0f,10.0f),Vec3fa(0,0,-1)); ray1.time = time;
+      rtcIntersect(scene,ray0);
+      if (ray0.time != time || filterTime != time) return false;
+      rtcIntersect(scene,ray1);
+      if (ray0.geomID != geom || fabs(ray0.tfar-10.0f) > 0.01f) return false;
+      if (x > 1.5f && ray1.geomID != RTC_INVALID_GEOMETRY_ID) return false;
+    }
+
+    rtcNewTriangleMesh (scene, RTC_GEOMETRY_STATIC, 2, 4, RTC_MAX_TIME_STEPS+1);
+    AssertError(RTC_INVALID_OPERATION);
+    rtcDeleteScene (scene);
+    AssertNoError();
+    return true;
+  }
+
+  bool rtcore_motion_segments_mixed()
+  {
+    /* 2 and 3 time segments get sampled with 6 common segments, so the middle keyframe of the first quad is exact */
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    AssertNoError();
+    unsigned geom0 = addMotionQuad(scene,3,0.0f);
+    unsigned geom1 = addMotionQuad(scene,4,10.0f);
+    AssertNoError();
+    rtcCommit (scene);
+    AssertNoError();
+
+    bool passed = true;
+    RTCRay ray0 = makeRay(Vec3fa(3.9f,0.0f,10.0f),Vec3fa(0,0,-1)); ray0.time = 0.5f;
+    RTCRay ray1 = makeRay(Vec3fa(4.0f*sinf(float(pi)/3.0f),10.0f,10.0f),Vec3fa(0,0,-1)); ray1.time = 1.0f/3.0f;
+    rtcIntersect(scene,ray0);
+    rtcIntersect(scene,ray1);
+    passed &= ray0.geomID == geom0 && fabs(ray0.tfar-10.0f) < 0.01f;
+    passed &= ray1.geomID == geom1 && fabs(ray1.tfar-10.0f) < 0.01f;
+    rtcDeleteScene (scene);
+    AssertNoError();
+    if (!passed) return false;
+
+    /* 2, 3 and 4 time segments need 12 common segments, which is more than supported */
+    scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    AssertNoError();
+    addMotionQuad(scene,3,0.0f);
+    addMotionQuad(scene,4,10.0f);
+    addMotionQuad(scene,5,20.0f);
+    AssertNoError();
+    rtcCommit (scene);
+    passed = rtcGetError() == RTC_INVALID_OPERATION;
+    rtcDeleteScene (scene);
+    AssertNoError();
+    return passed;
+  }
+
+  bool rtcore_motion_instance()
+  {
+    RTCScene object = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    addSphere(object,RTC_GEOMETRY_STATIC,Vec3fa(0,0,0),1.0f,50);
+    rtcCommit (object);
+    AssertNoError();
+
+    /* instance that moves the sphere from x=0 to x=10 */
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    unsigned inst = rtcNewInstance2(scene,object,2);
+    AssertNoError();
+    float xfm0[12] = { 1,0,0, 0,1,0, 0,0,1,  0,0,0 };
+    float xfm1[12] = { 1,0,0, 0,1,0, 0,0,1, 10,0,0 };
+    rtcSetTransform2(scene,inst,RTC_MATRIX_COLUMN_MAJOR,xfm0,0);
+    rtcSetTransform2(scene,inst,RTC_MATRIX_COLUMN_MAJOR,xfm1,1);
+    AssertNoError();
+    rtcSetTransform2(scene,inst,RTC_MATRIX_COLUMN_MAJOR,xfm1,2);
+    AssertError(RTC_INVALID_ARGUMENT);
+    rtcCommit (scene);
+    AssertNoError();
+
+    for (size_t i=0; i<=4; i++)
+    {
+      const float time = 0.25f*float(i);
+      RTCRay ray0 = makeRay(Vec3fa(10.0f*time,0.0f,10.0f),Vec3fa(0,0,-1)); ray0.time = time;
+      RTCRay ray1 = makeRay(Vec3fa(10.0f*time-5.0f,0.0f,10.0f),Vec3fa(0,0,-1)); ray1.time = time;
+      rtcIntersect(scene,ray0);
+      rtcIntersect(scene,ray1);
+      if (ray0.instID != inst || fabs(ray0.tfar-9.0f) > 0.1f) return false;
+      if (ray1.geomID != RTC_INVALID_GEOMETRY_ID) return false;
+    }
+
+    rtcDeleteScene (scene);
+    rtcDeleteScene (object);
+    AssertNoError();
+    return true;
+  }
+
+  bool rtcore_nested_instance()
+  {
+    RTCScene object = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    addSphere(object,RTC_GEOMETRY_STATIC,Vec3fa(0,0,0),1.0f,50);
+    rtcCommit (object);
+    AssertNoError();
+
+    /* three instance levels that each move the sphere by 1 along x */
+    float xfm[12] = { 1,0,0, 0,1,0, 0,0,1, 1,0,0 };
+    RTCScene level2 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    addSphere(level2,RTC_GEOMETRY_STATIC,Vec3fa(100,0,0),1.0f,10);
+    unsigned inst2 = rtcNewInstance(level2,object);
+    rtcSetTransform(level2,inst2,RTC_MATRIX_COLUMN_MAJOR,xfm);
+    rtcCommit (level2);
+    RTCScene level1 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    addSphere(level1,RTC_GEOMETRY_STATIC,Vec3fa(100,0,0),1.0f,10);
+    addSphere(level1,RTC_GEOMETRY_STATIC,Vec3fa(200,0,0),1.0f,10);
+    unsigned inst1 = rtcNewInstance(level1,level2);
+    rtcSetTransform(level1,inst1,RTC_MATRIX_COLUMN_MAJOR,xfm);
+    rtcCommit (level1);
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    unsigned inst0 = rtcNewInstance(scene,level1);
+    rtcSetTransform(scene,inst0,RTC_MATRIX_COLUMN_MAJOR,xfm);
+    rtcCommit (scene);
+    AssertNoError();
+
+    RTCRay ray0 = makeRay(Vec3fa(3,0,10),Vec3fa(0,0,-1)); 
+    rtcIntersect(scene,ray0);
+    if (ray0.geomID != 0 || fabs(ray0.tfar-9.0f) > 0.1f) return false;
+    if (ray0.instID != inst0 || ray0.instIDStack[0] != inst1 || ray0.instIDStack[1] != inst2) return false;
+    for (size_t i=2; i<RTC_MAX_INSTANCE_LEVELS-1; i++)
+      if (ray0.instIDStack[i] != RTC_INVALID_GEOMETRY_ID) return false;
+
+    RTCRay ray1 = makeRay(Vec3fa(0,0,10),Vec3fa(0,0,-1)); 
+    rtcIntersect(scene,ray1);
+    if (ray1.geomID != RTC_INVALID_GEOMETRY_ID || ray1.instID != RTC_INVALID_GEOMETRY_ID) return false;
+
+    RTCRay ray2 = makeRay(Vec3fa(3,0,10),Vec3fa(0,0,-1)); 
+    rtcOccluded(scene,ray2);
+    if (ray2.geomID != 0) return false;
+
+    rtcDeleteScene (scene);
+    rtcDeleteScene (level1);
+    rtcDeleteScene (level2);
+    rtcDeleteScene (object);
+    AssertNoError();
+    return true;
+  }
+
+  bool rtcore_rotated_instance()
+  {
+    /* elongated object of spheres along the x axis */
+    RTCScene object = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    for (int i=-10; i<=10; i++)
+      addSphere(object,RTC_GEOMETRY_STATIC,Vec3fa(float(i),0,0),0.4f,10);
+    rtcCommit (object);
+    AssertNoError();
+
+    /* instance rotated by 45 degrees around the z axis */
+    const float c = sqrtf(0.5f);
+    float xfm[12] = { c,c,0, -c,c,0, 0,0,1, 0,0,0 };
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    unsigned inst = rtcNewInstance(scene,object);
+    rtcSetTransform(scene,inst,RTC_MATRIX_COLUMN_MAJOR,xfm);
+    rtcCommit (scene);
+    AssertNoError();
+
+    for (int i=-10; i<=10; i++) 
+    {
+      RTCRay ray = makeRay(Vec3fa(c*float(i),c*float(i),10),Vec3fa(0,0,-1)); 
+      rtcIntersect(scene,ray);
+      if (ray.geomID != i+10 || ray.instID != inst || fabs(ray.tfar-9.6f) > 0.1f) return false;
+    }
+
+    rtcDeleteScene (scene);
+    rtcDeleteScene (object);
+    AssertNoError();
+
+    /* four spheres on the x and y axis, rotating their root box by 45
+     * degrees gives an extent of 2*10.4/c in x and y, while the boxes
+     * of the single spheres only extend to about 2*(10*c+0.6) */
+    object = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    addSphere(object,RTC_GEOMETRY_STATIC,Vec3fa(+10,0,0),0.4f,10);
+    addSphere(object,RTC_GEOMETRY_STATIC,Vec3fa(-10,0,0),0.4f,10);
+    addSphere(object,RTC_GEOMETRY_STATIC,Vec3fa(0,+10,0),0.4f,10);
+    addSphere(object,RTC_GEOMETRY_STATIC,Vec3fa(0,-10,0),0.4f,10);
+    rtcCommit (object);
+    scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    inst = rtcNewInstance(scene,object);
+    rtcSetTransform(scene,inst,RTC_MATRIX_COLUMN_MAJOR,xfm);
+    rtcCommit (scene);
+    RTCBounds bounds; rtcGetBounds(scene,bounds);
+    AssertNoError();
+    if (bounds.lower_x > -10.0f*c || bounds.upper_x < 10.0f*c) return false;
+    if (bounds.lower_y > -10.0f*c || bounds.upper_y < 10.0f*c) return false;
+    if (bounds.upper_x-bounds.lower_x > 20.0f || bounds.upper_y-bounds.lower_y > 20.0f) return false;
+
+    rtcDeleteScene (scene);
+    rtcDeleteScene (object);
+    AssertNoError();
+    return true;
+  }
+
+  bool rtcore_move_instances(size_t N)
+  {
+    RTCScene object = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    addSphere(object,RTC_GEOMETRY_STATIC,Vec3fa(0,0,0),1.0f,20);
+    rtcCommit (object);
+    AssertNoError();
+
+    RTCScene scene = rtcNewScene(RTC_SCENE_DYNAMIC,aflags);
+    std::vector<unsigned> instIDs(N);
+    for (size_t i=0; i<N; i++) 
+      instIDs[i] = rtcNewInstance(scene,object);
+    AssertNoError();
+
+    /* move all instances in each frame, and disable one in the last frame */
+    std::vector<float> xfms(12*N);
+    for (size_t f=0; f<8; f++) 
+    {
+      for (size_t i=0; i<N; i++) {
+        float xfm[12] = { 1,0,0, 0,1,0, 0,0,1, 4.0f*float(i), 0.5f*float(f), 0 };
+        for (size_t j=0; j<12; j++) xfms[12*i+j] = xfm[j];
+      }
+      rtcSetTransforms(scene,&instIDs[0],N,RTC_MATRIX_COLUMN_MAJOR,&xfms[0]);
+      if (f == 7) rtcDisable(scene,instIDs[0]);
+      rtcCommit (scene);
+      AssertNoError();
+
+      for (size_t i=0; i<N; i++) {
+        RTCRay ray = makeRay(Vec3fa(4.0f*float(i),0.5f*float(f),10),Vec3fa(0,0,-1)); 
+        rtcIntersect(scene,ray);
+        if (f == 7 && i == 0) { if (ray.geomID != RTC_INVALID_GEOMETRY_ID) return false; }
+        else if (ray.instID != instIDs[i] || fabs(ray.tfar-9.0f) > 0.1f) return false;
+      }
+    }
+
+    /* a batch containing an invalid ID leaves all transformations unchanged */
+    std::vector<unsigned> invalidIDs(instIDs);
+    invalidIDs[N-1] = RTC_INVALID_GEOMETRY_ID;
+    for (size_t i=0; i<N; i++) xfms[12*i+9] += 100.0f;
+    rtcSetTransforms(scene,&invalidIDs[0],N,RTC_MATRIX_COLUMN_MAJOR,&xfms[0]);
+    AssertError(RTC_INVALID_ARGUMENT);
+    rtcCommit (scene);
+    AssertNoError();
+    for (size_t i=1; i<N; i++) {
+      RTCRay ray = makeRay(Vec3fa(4.0f*float(i),3.5f,10),Vec3fa(0,0,-1)); 
+      rtcIntersect(scene,ray);
+      if (ray.instID != instIDs[i]) return false;
+    }
+
+    rtcDeleteScene (scene);
+    rtcDeleteScene (object);
+    AssertNoError();
+    return true;
+  }
+
+  bool rtcore_update_few(RTCGeometryFlags flags, size_t N)
+  {
+    RTCScene scene = rtcNewScene(RTC_SCENE_DYNAMIC,aflags);
+    AssertNoError();
+    size_t numPhi = 10;
+    size_t numVertices = 2*numPhi*(numPhi+1);
+    std::vector<Vec3fa> pos(N*N);
+    for (size_t i=0; i<N*N; i++) {
+      pos[i] = Vec3fa(4.0f*float(i%N),0.0f,4.0f*float(i/N));
+      addSphere(scene,flags,pos[i],1.0f,numPhi);
+    }
+    rtcCommit (scene);
+    AssertNoError();
+
+    /* move only a single mesh per frame */
+    bool passed = true;
+    for (size_t f=0; f<32 && passed; f++) 
+    {
+      size_t k = (7*f) % (N*N);
+      Vec3fa ds(0.5f,0.1f*float(f%4),0.5f);
+      move_mesh(scene,k,numVertices,ds); pos[k] += ds;
+      rtcCommit (scene);
+      passed &= rtcGetError() == RTC_NO_ERROR;
+
+      for (size_t i=0; i<N*N; i++) {
+        RTCRay ray = makeRay(pos[i]+Vec3fa(0,10,0),Vec3fa(0,-1,0)); 
+        rtcIntersect(scene,ray);
+        passed &= ray.geomID == i;
+      }
+    }
+    rtcDeleteScene (scene);
+    AssertNoError();
+    return passed;
+  }
+
+  bool rtcore_save_load_scene(size_t N)
+  {
+    const char* fileName = "verify_scene.bvh";
+    std::vector<Vec3fa> pos(N*N);
+    for (size_t i=0; i<N*N; i++) 
+      pos[i] = Vec3fa(4.0f*float(i%N),0.0f,4.0f*float(i/N));
+
+    /* build scene and store it */
+    RTCScene scene0 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    for (size_t i=0; i<N*N; i++) addSphere(scene0,RTC_GEOMETRY_STATIC,pos[i],1.0f,10);
+    std::remove(fileName);
+    if (rtcLoadScene(scene0,fileName)) return false;
+    AssertNoError();
+    rtcCommit (scene0);
+    rtcSaveScene(scene0,fileName);
+    AssertNoError();
+    rtcDeleteScene (scene0);
+
+    /* load scene with identical geometry */
+    RTCScene scene1 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    for (size_t i=0; i<N*N; i++) addSphere(scene1,RTC_GEOMETRY_STATIC,pos[i],1.0f,10);
+    bool loaded = rtcLoadScene(scene1,fileName);
+    AssertNoError();
+    if (!loaded) { std::remove(fileName); return false; }
+    for (size_t i=0; i<N*N; i++) {
+      RTCRay ray = makeRay(pos[i]+Vec3fa(0,10,0),Vec3fa(0,-1,0)); 
+      rtcIntersect(scene1,ray);
+      if (ray.geomID != i) { std::remove(fileName); return false; }
+    }
+    rtcDeleteScene (scene1);
+
+    /* modified geometry must not match */
+    RTCScene scene2 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    for (size_t i=0; i<N*N; i++) addSphere(scene2,RTC_GEOMETRY_STATIC,pos[i]+Vec3fa(0.0f,i == 0 ? 1.0f : 0.0f,0.0f),1.0f,10);
+    loaded = rtcLoadScene(scene2,fileName);
+    AssertNoError();
+    rtcCommit (scene2);
+    AssertNoError();
+    rtcDeleteScene (scene2);
+    std::remove(fileName);
+    return !loaded;
+  }
+
   bool rtcore_ray_masks_intersect(RTCSceneFlags sflags, RTCGeometryFlags gflags)
   {
     bool passed = true;
@@ -2117,6 +2605,448 @@ namespace embree
 #endif
   }
 
+  bool rtcore_commit_async()
+  {
+    RTCScene scene0 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    addSphere(scene0,RTC_GEOMETRY_STATIC,Vec3fa(0,0,0),1.0f,50);
+    rtcCommit (scene0);
+    AssertNoError();
+
+    /* trace the committed scene while the other one is building */
+    RTCScene scene1 = rtcNewScene(RTC_SCENE_DYNAMIC,aflags);
+    addSphere(scene1,RTC_GEOMETRY_STATIC,Vec3fa(0,0,0),1.0f,500);
+    rtcCommitAsync (scene1);
+    AssertNoError();
+    RTCRay ray0 = makeRay(Vec3fa(-2,0,0),Vec3fa(1,0,0));
+    rtcIntersect(scene0,ray0);
+    rtcWaitCommit (scene1);
+    AssertNoError();
+    if (!rtcIsCommitted(scene1)) return false;
+    RTCRay ray1 = makeRay(Vec3fa(-2,0,0),Vec3fa(1,0,0));
+    rtcIntersect(scene1,ray1);
+    
+    /* polling has to eventually see the commit finish */
+    rtcCommitAsync (scene1);
+    while (!rtcIsCommitted(scene1));
+    rtcWaitCommit (scene1);
+    AssertNoError();
+    RTCRay ray2 = makeRay(Vec3fa(-2,0,0),Vec3fa(1,0,0));
+    rtcIntersect(scene1,ray2);
+
+    rtcDeleteScene (scene0);
+    rtcDeleteScene (scene1);
+    AssertNoError();
+    return ray0.geomID == 0 && ray1.geomID == 0 && ray2.geomID == 0;
+  }
+
+  struct CommitThreadData 
+  {
+    RTCScene scene;
+    unsigned int threadIndex;
+    unsigned int threadCount;
+  };
+
+  void rtcore_commit_thread_thread(void* ptr)
+  {
+    CommitThreadData* data = (CommitThreadData*) ptr;
+    rtcCommitThread(data->scene,data->threadIndex,data->threadCount);
+  }
+
+  bool rtcore_commit_thread(size_t numThreads)
+  {
+    /* restart Embree without internal threads */
+    rtcExit();
+    std::string cfg = g_rtcore == "" ? "user_threads=" : g_rtcore+",user_threads=";
+    std::stringstream str; str << cfg << numThreads;
+    rtcInit(str.str().c_str());
+    AssertNoError();
+
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    addSphere(scene,RTC_GEOMETRY_STATIC,Vec3fa(0,0,0),1.0f,500);
+    rtcCommit (scene);
+    AssertError(RTC_INVALID_OPERATION);
+
+    std::vector<CommitThreadData> data(numThreads);
+    for (size_t i=0; i<numThreads; i++) {
+      data[i].scene = scene;
+      data[i].threadIndex = i;
+      data[i].threadCount = numThreads;
+    }
+    for (size_t i=1; i<numThreads; i++)
+      g_threads.push_back(createThread(rtcore_commit_thread_thread,&data[i],1000000,-1));
+    rtcore_commit_thread_thread(&data[0]);
+    for (size_t i=0; i<g_threads.size(); i++)
+      join(g_threads[i]);
+    g_threads.clear();
+    AssertNoError();
+
+    RTCRay ray = makeRay(Vec3fa(-2,0,0),Vec3fa(1,0,0));
+    rtcIntersect(scene,ray);
+    rtcDeleteScene (scene);
+    AssertNoError();
+
+    /* restart Embree with original configuration */
+    rtcExit();
+    rtcInit(g_rtcore.c_str());
+    return ray.geomID == 0;
+  }
+
+  /* compares a static scene against a dynamic scene that serves as reference */
+  bool rtcore_compare_to_dynamic(RTCSceneFlags sflags, size_t N)
+  {
+    RTCScene scene0 = rtcNewScene(sflags,aflags);
+    RTCScene scene1 = rtcNewScene(RTC_SCENE_DYNAMIC,aflags);
+    for (size_t i=0; i<8; i++) {
+      const Vec3fa pos(float(i%2)-0.5f,float((i/2)%2)-0.5f,float(i/4)-0.5f);
+      addSphere(scene0,RTC_GEOMETRY_STATIC,pos,0.4f,50);
+      addSphere(scene1,RTC_GEOMETRY_STATIC,pos,0.4f,50);
+    }
+    rtcCommit (scene0);
+    rtcCommit (scene1);
+    AssertNoError();
+
+    bool passed = true;
+    for (size_t i=0; i<N; i++) 
+    {
+      Vec3fa org(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+      Vec3fa dir(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+      RTCRay ray0 = makeRay(org,dir); rtcIntersect(scene0,ray0);
+      RTCRay ray1 = makeRay(org,dir); rtcIntersect(scene1,ray1);
+      passed &= ray0.geomID == ray1.geomID;
+      passed &= ray0.geomID == RTC_INVALID_GEOMETRY_ID || fabs(ray0.tfar-ray1.tfar) < 1E-4f;
+    }
+    rtcDeleteScene (scene0);
+    rtcDeleteScene (scene1);
+    AssertNoError();
+    return passed;
+  }
+
+  bool rtcore_bvh_layout(const char* layout, size_t N)
+  {
+    /* restart Embree with compaction of static BVHs, only BVH4s get compacted */
+    rtcExit();
+    std::string cfg = g_rtcore == "" ? "tri_accel=bvh4.triangle4,bvh_layout=" : g_rtcore+",tri_accel=bvh4.triangle4,bvh_layout=";
+    rtcInit((cfg+layout).c_str());
+    AssertNoError();
+
+    bool passed = rtcore_compare_to_dynamic(RTC_SCENE_STATIC,N);
+
+    /* restart Embree with original configuration */
+    rtcExit();
+    rtcInit(g_rtcore.c_str());
+    return passed;
+  }
+
+  /* restarts Embree with some builder configuration and checks the hits on a grid of spheres */
+  bool rtcore_build_config(const char* config, size_t N)
+  {
+    rtcExit();
+    std::string cfg = g_rtcore == "" ? std::string(config) : g_rtcore+","+config;
+    rtcInit(cfg.c_str());
+    AssertNoError();
+
+    /* the distant sphere makes the spheres of the grid share the upper bits of their morton codes */
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    std::vector<Vec3fa> pos(N*N*N);
+    for (size_t i=0; i<N*N*N; i++) {
+      pos[i] = Vec3fa(4.0f*float(i%N),4.0f*float((i/N)%N),4.0f*float(i/(N*N)));
+      addSphere(scene,RTC_GEOMETRY_STATIC,pos[i],1.0f,10);
+    }
+    addSphere(scene,RTC_GEOMETRY_STATIC,Vec3fa(1E5f),1.0f,10);
+    rtcCommit (scene);
+    AssertNoError();
+
+    /* rays start between the spheres and hit the top of the sphere below */
+    bool passed = true;
+    for (size_t i=0; i<N*N*N; i++) {
+      RTCRay ray = makeRay(pos[i]+Vec3fa(0.01f,1.9f,0.013f),Vec3fa(0,-1,0)); 
+      rtcIntersect(scene,ray);
+      passed &= ray.geomID == i && fabs(ray.tfar-0.9f) < 0.01f;
+    }
+    rtcDeleteScene (scene);
+    AssertNoError();
+
+    /* restart Embree with original configuration */
+    rtcExit();
+    rtcInit(g_rtcore.c_str());
+    return passed;
+  }
+
+  /* memory monitor that rejects all allocations while g_memory_monitor_reject is set */
+  bool g_memory_monitor_reject = false;
+  bool rejectingMemoryMonitor(const long long bytes, const bool post) {
+    return post || !g_memory_monitor_reject;
+  }
+
+  bool rtcore_memory_monitor(RTCSceneFlags sflags)
+  {
+    rtcSetMemoryMonitorFunction(rejectingMemoryMonitor);
+
+    /* a rejected build reports an error, releases its memory and leaves the scene uncommitted */
+    g_memory_monitor_reject = true;
+    RTCScene scene = rtcNewScene(sflags,aflags);
+    unsigned geom = addSphere(scene,RTC_GEOMETRY_STATIC,Vec3fa(0,0,0),1.0f,50);
+    rtcCommit (scene);
+    AssertError(RTC_OUT_OF_MEMORY);
+    RTCMemoryStats stats;
+    rtcGetMemoryStats(scene,stats);
+    bool passed = stats.sceneBytes == 0;
+
+    /* the scene can get committed again once memory is available */
+    g_memory_monitor_reject = false;
+    rtcCommit (scene);
+    AssertNoError();
+    RTCRay ray0 = makeRay(Vec3fa(-2,0,0),Vec3fa(1,0,0));
+    rtcIntersect(scene,ray0);
+    passed &= ray0.geomID == geom;
+
+    /* a rejected update of a dynamic scene rebuilds all geometries with the next commit */
+    if (sflags == RTC_SCENE_DYNAMIC) 
+    {
+      rtcUpdate(scene,geom);
+      g_memory_monitor_reject = true;
+      rtcCommit (scene);
+      AssertError(RTC_OUT_OF_MEMORY);
+      g_memory_monitor_reject = false;
+      rtcCommit (scene);
+      AssertNoError();
+      RTCRay ray1 = makeRay(Vec3fa(-2,0,0),Vec3fa(1,0,0));
+      rtcIntersect(scene,ray1);
+      passed &= ray1.geomID == geom;
+    }
+
+    rtcDeleteScene (scene);
+    rtcSetMemoryMonitorFunction(NULL);
+    AssertNoError();
+    return passed;
+  }
+
+  bool rtcore_memory_stats()
+  {
+    /* the nodes of motion blur BVHs are allocated from the pool */
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    addSphere(scene,RTC_GEOMETRY_STATIC,Vec3fa(0,0,0),1.0f,50,-1,0.1f);
+    rtcCommit (scene);
+    AssertNoError();
+
+    RTCMemoryStats stats;
+    rtcGetMemoryStats(scene,stats);
+    bool passed = stats.sceneBytes > 0 && stats.poolUsedBytes > 0;
+    rtcDeleteScene (scene);
+
+    /* the build temporaries of hair BVHs return to the pool at the end of the commit */
+    scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    addHair(scene,RTC_GEOMETRY_STATIC,Vec3fa(0,0,0),0.1f,50000);
+    rtcCommit (scene);
+    AssertNoError();
+    RTCMemoryStats stats0;
+    rtcGetMemoryStats(NULL,stats0);
+    rtcDeleteScene (scene);
+
+    /* trimming returns the idle memory to the OS and keeps the pool usable */
+    rtcTrimMemory();
+    RTCMemoryStats stats1;
+    rtcGetMemoryStats(NULL,stats1);
+    passed &= stats1.poolBytes < stats0.poolBytes;
+    passed &= stats1.poolBytes-stats1.poolUsedBytes < stats0.poolBytes-stats0.poolUsedBytes;
+    AssertNoError();
+    return passed && rtcore_compare_to_dynamic(RTC_SCENE_STATIC,100);
+  }
+
+  bool rtcore_trim_threshold(const char* threshold, bool trimmed)
+  {
+    /* restart Embree with the trim threshold in MB, huge pages would keep free blocks of used chunks */
+    rtcExit();
+    std::string cfg = g_rtcore == "" ? "huge_pages=0,trim_threshold=" : g_rtcore+",huge_pages=0,trim_threshold=";
+    rtcInit((cfg+threshold).c_str());
+    AssertNoError();
+
+    /* the build temporaries of hair BVHs return to the pool at the end of the commit */
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    addHair(scene,RTC_GEOMETRY_STATIC,Vec3fa(0,0,0),0.1f,50000);
+    rtcCommit (scene);
+    AssertNoError();
+    RTCMemoryStats stats;
+    rtcGetMemoryStats(NULL,stats);
+    const size_t idleBytes = stats.poolBytes-stats.poolUsedBytes;
+    rtcDeleteScene (scene);
+
+    /* restart Embree with original configuration */
+    rtcExit();
+    rtcInit(g_rtcore.c_str());
+    AssertNoError();
+    return trimmed ? idleBytes <= 1024*1024 : idleBytes > 1024*1024;
+  }
+
+  bool rtcore_ray_stream(RTCSceneFlags sflags, size_t N)
+  {
+    RTCScene scene = rtcNewScene(sflags,aflags);
+    addSphere(scene,RTC_GEOMETRY_STATIC,Vec3fa(-1,0,0),1.0f,50);
+    addSphere(scene,RTC_GEOMETRY_STATIC,Vec3fa(+1,0,0),1.0f,50);
+    rtcCommit (scene);
+    AssertNoError();
+
+    /* trace random rays individually as reference */
+    std::vector<RTCRay> rays0(N), rays1(N), rays2(N);
+    for (size_t i=0; i<N; i++) {
+      Vec3fa org(4.0f*drand48()-2.0f,4.0f*drand48()-2.0f,4.0f*drand48()-2.0f);
+      Vec3fa dir(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+      rays0[i] = rays1[i] = rays2[i] = makeRay(org,dir);
+      rtcIntersect(scene,rays0[i]);
+    }
+
+    /* trace the same rays as stream in AOS and SOA layout */
+    ::rtcIntersectN(scene,&rays1[0],N,sizeof(RTCRay));
+    std::vector<float> orgx(N), orgy(N), orgz(N), dirx(N), diry(N), dirz(N), tnear(N), tfar(N), time(N);
+    std::vector<float> Ngx(N), Ngy(N), Ngz(N), u(N), v(N);
+    std::vector<int> mask(N), geomID(N), primID(N), instID(N);
+    RTCRayNp soa = { &orgx[0], &orgy[0], &orgz[0], &dirx[0], &diry[0], &dirz[0], &tnear[0], &tfar[0], &time[0], &mask[0],
+                     &Ngx[0], &Ngy[0], &Ngz[0], &u[0], &v[0], &geomID[0], &primID[0], &instID[0] };
+    for (size_t i=0; i<N; i++) {
+      orgx[i] = rays2[i].org[0]; orgy[i] = rays2[i].org[1]; orgz[i] = rays2[i].org[2];
+      dirx[i] = rays2[i].dir[0]; diry[i] = rays2[i].dir[1]; dirz[i] = rays2[i].dir[2];
+      tnear[i] = rays2[i].tnear; tfar[i] = rays2[i].tfar; time[i] = rays2[i].time; mask[i] = rays2[i].mask;
+      geomID[i] = rays2[i].geomID; primID[i] = rays2[i].primID; instID[i] = rays2[i].instID;
+    }
+    ::rtcIntersectNp(scene,soa,N);
+    AssertNoError();
+
+    bool passed = true;
+    for (size_t i=0; i<N; i++) {
+      passed &= rays1[i].geomID == rays0[i].geomID && geomID[i] == rays0[i].geomID;
+      if (rays0[i].geomID == RTC_INVALID_GEOMETRY_ID) continue;
+      passed &= abs(rays1[i].tfar-rays0[i].tfar) <= 1E-4f*abs(rays0[i].tfar);
+      passed &= abs(tfar[i]-rays0[i].tfar) <= 1E-4f*abs(rays0[i].tfar);
+    }
+
+    /* occlusion has to agree with the intersection results */
+    for (size_t i=0; i<N; i++) rays1[i] = makeRay(Vec3fa(rays0[i].org[0],rays0[i].org[1],rays0[i].org[2]),
+                                                   Vec3fa(rays0[i].dir[0],rays0[i].dir[1],rays0[i].dir[2]));
+    ::rtcOccludedN(scene,&rays1[0],N,sizeof(RTCRay));
+    AssertNoError();
+    for (size_t i=0; i<N; i++) 
+      passed &= (rays1[i].geomID == 0) == (rays0[i].geomID != -1);
+
+    rtcDeleteScene (scene);
+    return passed;
+  }
+
+  bool rtcore_compact_scene(size_t N)
+  {
+    /* the compact scene uses a BVH with quantized nodes, results have to match the default scene */
+    RTCScene scene0 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    RTCScene scene1 = rtcNewScene(RTCSceneFlags(RTC_SCENE_STATIC | RTC_SCENE_COMPACT),aflags);
+    addSphere(scene0,RTC_GEOMETRY_STATIC,Vec3fa(-1,0,0),1.0f,50);
+    addSphere(scene0,RTC_GEOMETRY_STATIC,Vec3fa(+1,0,0),1.0f,50);
+    addSphere(scene1,RTC_GEOMETRY_STATIC,Vec3fa(-1,0,0),1.0f,50);
+    addSphere(scene1,RTC_GEOMETRY_STATIC,Vec3fa(+1,0,0),1.0f,50);
+    rtcCommit (scene0);
+    rtcCommit (scene1);
+    AssertNoError();
+
+    int sizes[3] = { 1, 4, 8 };
+    size_t numSizes = 2;
+#if defined(__TARGET_AVX__) || defined(__TARGET_AVX2__)
+    if (has_feature(AVX)) numSizes = 3;
+#endif
+
+    bool passed = true;
+    for (size_t i=0; i<N; i++) 
+    {
+      Vec3fa org(4.0f*drand48()-2.0f,4.0f*drand48()-2.0f,4.0f*drand48()-2.0f);
+      Vec3fa dir(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+      RTCRay ray0 = makeRay(org,dir); 
+      rtcIntersect(scene0,ray0);
+
+      for (size_t j=0; j<numSizes; j++) 
+      {
+        RTCRay ray1 = makeRay(org,dir); 
+        rtcIntersectN(scene1,ray1,sizes[j]);
+        passed &= ray1.geomID == ray0.geomID;
+        passed &= ray0.geomID == RTC_INVALID_GEOMETRY_ID || abs(ray1.tfar-ray0.tfar) <= 1E-4f*abs(ray0.tfar);
+
+        RTCRay ray2 = makeRay(org,dir); 
+        rtcOccludedN(scene1,ray2,sizes[j]);
+        passed &= (ray2.geomID == 0) == (ray0.geomID != -1);
+      }
+    }
+    AssertNoError();
+
+    rtcDeleteScene (scene0);
+    rtcDeleteScene (scene1);
+    return passed;
+  }
+
+  bool rtcore_point_query(RTCSceneFlags sflags, size_t N)
+  {
+    RTCScene scene = rtcNewScene(sflags,aflags);
+    unsigned geom = addSphere(scene,RTC_GEOMETRY_STATIC,zero,1.0f,50);
+    rtcCommit (scene);
+    AssertNoError();
+
+    bool passed = true;
+    for (size_t i=0; i<N; i++) 
+    {
+      const Vec3fa p(6.0f*drand48()-3.0f,6.0f*drand48()-3.0f,6.0f*drand48()-3.0f);
+      RTCPointQuery query;
+      query.p[0] = p.x; query.p[1] = p.y; query.p[2] = p.z;
+      query.radius = inf;
+      query.geomID = -1;
+      rtcPointQuery(scene,query);
+      AssertNoError();
+
+      /* triangulated sphere approximates the unit sphere up to a small error */
+      const Vec3fa c(query.closest[0],query.closest[1],query.closest[2]);
+      passed &= query.geomID == (int)geom;
+      passed &= abs(query.radius-abs(length(p)-1.0f)) < 0.01f;
+      passed &= abs(length(c-p)-query.radius) < 1E-4f;
+
+      /* nothing is found within a too small search radius */
+      query.radius = 0.5f*query.radius;
+      query.geomID = -1;
+      rtcPointQuery(scene,query);
+      passed &= query.geomID == -1;
+    }
+    rtcDeleteScene (scene);
+    return passed;
+  }
+
+  bool rtcore_statistics(size_t N)
+  {
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    addSphere(scene,RTC_GEOMETRY_STATIC,zero,1.0f,50);
+    rtcCommit (scene);
+    AssertNoError();
+
+    for (size_t i=0; i<N; i++) {
+      RTCRay ray0 = makeRay(zero,Vec3fa(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f)); 
+      rtcIntersect(scene,ray0);
+      RTCRay ray1 = makeRay(Vec3fa(4.0f,0,0),Vec3fa(-1,0,0)); 
+      rtcOccluded(scene,ray1);
+    }
+
+    bool passed = true;
+    RTCStatistics stats;
+    rtcGetStatistics(scene,stats);
+#if defined(__USE_STAT_COUNTERS__)
+    AssertNoError();
+    passed &= stats.normal.rays == N && stats.shadow.rays == N;
+    passed &= stats.normal.nodes >= N && stats.normal.prims >= N;
+    passed &= stats.shadow.nodes >= N && stats.shadow.prims >= N;
+
+    rtcResetStatistics(scene);
+    rtcGetStatistics(scene,stats);
+    AssertNoError();
+    passed &= stats.normal.rays == 0 && stats.normal.nodes == 0 && stats.shadow.rays == 0;
+#else
+    AssertError(RTC_INVALID_OPERATION);
+    passed &= stats.normal.rays == 0 && stats.shadow.rays == 0;
+#endif
+
+    rtcDeleteScene (scene);
+    return passed;
+  }
+
   bool rtcore_regression_static()
   {
     for (size_t i=0; i<regressionN; i++) 
@@ -2292,6 +3222,21 @@ namespace embree
     POSITIVE("dynamic_enable_disable",    rtcore_dynamic_enable_disable());
     POSITIVE("update_deformable",         rtcore_update(RTC_GEOMETRY_DEFORMABLE));
     POSITIVE("update_dynamic",            rtcore_update(RTC_GEOMETRY_DYNAMIC));
+    POSITIVE("update_few_dynamic",        rtcore_update_few(RTC_GEOMETRY_DYNAMIC,8));
+    POSITIVE("update_range_deformable",   rtcore_update_range(RTC_GEOMETRY_DEFORMABLE));
+    POSITIVE("update_range_dynamic",      rtcore_update_range(RTC_GEOMETRY_DYNAMIC));
+#if !defined(__MIC__)
+    POSITIVE("motion_segments",           rtcore_motion_segments(3));
+    POSITIVE("motion_segments_max",       rtcore_motion_segments(RTC_MAX_TIME_STEPS));
+    POSITIVE("motion_instance",           rtcore_motion_instance());
+    POSITIVE("nested_instance",           rtcore_nested_instance());
+    POSITIVE("motion_segments_mixed",     rtcore_motion_segments_mixed());
+#endif
+    POSITIVE("partial_refit",             rtcore_partial_refit());
+    POSITIVE("deform_mesh_deformable",    rtcore_deform_mesh(RTC_GEOMETRY_DEFORMABLE));
+    POSITIVE("rotated_instance",          rtcore_rotated_instance());
+    POSITIVE("move_instances",            rtcore_move_instances(64));
+    POSITIVE("save_load_scene",           rtcore_save_load_scene(4));
     POSITIVE("overlapping_triangles",     rtcore_overlapping_triangles(100000));
     POSITIVE("overlapping_hair",          rtcore_overlapping_hair(100000));
     POSITIVE("new_delete_geometry",       rtcore_new_delete_geometry());
@@ -2354,6 +3299,31 @@ namespace embree
 #endif
 
 
+    POSITIVE("commit_async",              rtcore_commit_async());
+#if !defined(__MIC__)
+    POSITIVE("commit_thread",             rtcore_commit_thread(4));
+    POSITIVE("bvh_layout_depth_first",    rtcore_bvh_layout("depth_first",1000));
+    POSITIVE("bvh_layout_veb",            rtcore_bvh_layout("veb",1000));
+    POSITIVE("numa_interleave",           rtcore_compare_to_dynamic(RTC_SCENE_NUMA_INTERLEAVE,1000));
+    POSITIVE("numa_replicate",            rtcore_compare_to_dynamic(RTC_SCENE_NUMA_REPLICATE,1000));
+    POSITIVE("memory_monitor_static",     rtcore_memory_monitor(RTC_SCENE_STATIC));
+    POSITIVE("memory_monitor_dynamic",    rtcore_memory_monitor(RTC_SCENE_DYNAMIC));
+    POSITIVE("build_morton64",            rtcore_build_config("tri_accel=bvh4.triangle4,tri_builder=morton64",8));
+    POSITIVE("build_morton_restructure",  rtcore_build_config("tri_accel=bvh4.triangle4,tri_builder=morton.restructure",8));
+    POSITIVE("build_morton64_restructure",rtcore_build_config("tri_accel=bvh4.triangle4,tri_builder=morton64.restructure",8));
+    POSITIVE("memory_stats",              rtcore_memory_stats());
+    POSITIVE("trim_threshold_disabled",   rtcore_trim_threshold("0",false));
+    POSITIVE("trim_threshold",            rtcore_trim_threshold("1",true));
+#endif
+    POSITIVE("ray_stream_static",         rtcore_ray_stream(RTC_SCENE_STATIC,10000));
+    POSITIVE("ray_stream_dynamic",        rtcore_ray_stream(RTC_SCENE_DYNAMIC,10000));
+    POSITIVE("compact_scene",             rtcore_compact_scene(10000));
+    POSITIVE("statistics",                rtcore_statistics(1000));
+#if !defined(__MIC__)
+    POSITIVE("point_query_static",        rtcore_point_query(RTC_SCENE_STATIC,1000));
+    POSITIVE("point_query_dynamic",       rtcore_point_query(RTC_SCENE_DYNAMIC,1000));
+#endif
+
     POSITIVE("regression_static",         rtcore_regression_static());
     POSITIVE("regression_dynamic",        rtcore_regression_dynamic());
 
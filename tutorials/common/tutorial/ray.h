@@ -65,6 +65,7 @@
     int geomID;           //!< geometry ID
     int primID;           //!< primitive ID
     int instID;           //!< instance ID
+    int instIDStack[3];   //!< instance IDs of the nested instance levels below instID (RTC_MAX_INSTANCE_LEVELS-1)
   };
 
   /*! Outputs ray to stream. */
@@ -58,6 +58,7 @@ struct RTCRay2
   int geomID;    //!< geometry ID
   int primID;    //!< primitive ID
   int instID;    //!< instance ID
+  int instIDStack[3]; //!< instance IDs of the nested instance levels below instID (RTC_MAX_INSTANCE_LEVELS-1)
 
   // ray extensions
   float transparency; //!< accumulated transparency value